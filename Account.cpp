@@ -1,6 +1,17 @@
 #include "Account.hpp"
 
+#include <algorithm>
+#include <climits>
+
 #include "Bank.hpp"
+#include "Ledger.hpp"
+#include "Transaction.hpp"
+
+HistoryPage::HistoryPage()
+    : transactions(),
+      nextCursor(0),
+      loaded() {
+}
 
 Account::Account(Bank* owningBank,
                  const std::string& ownerName,
@@ -12,8 +23,17 @@ Account::Account(Bank* owningBank,
       ownerName_(ownerName),
       accountNumber_(accountNumber),
       balance_(initialFunds >= 0 ? initialFunds : 0),
+      initialFunds_(balance_),
       accountCard_(linkedCard),
-      password_(password) {
+      password_(password),
+      recent_(),
+      recentCount_(0),
+      recordedCount_(0),
+      balanceVersions_(initialFunds >= 0 ? initialFunds : 0),
+      activeSessions_(0),
+      balanceObserver_(nullptr),
+      balanceCookie_(0),
+      balanceChangePending_(false) {
 }
 
 const std::string& Account::getAccountNumber() const {
@@ -25,9 +45,14 @@ const std::string& Account::getOwnerName() const {
 }
 
 long long Account::getBalance() const {
+    std::lock_guard<std::mutex> lock(mutex_);
     return balance_;
 }
 
+long long Account::getInitialFunds() const {
+    return initialFunds_;
+}
+
 Card* Account::getLinkedCard() const {
     return accountCard_;
 }
@@ -48,26 +73,173 @@ void Account::deposit(long long amount) {
     if (amount <= 0) {
         return;
     }
+    std::lock_guard<std::mutex> lock(mutex_);
     balance_ += amount;
+    VersionStore::Instance().Commit(balanceVersions_, balance_);
+    notifyBalanceChange();
 }
 
 bool Account::withdraw(long long amount) {
     if (amount <= 0) {
         return false;
     }
+    std::lock_guard<std::mutex> lock(mutex_);
     if (amount > balance_) {
         return false;
     }
     balance_ -= amount;
+    VersionStore::Instance().Commit(balanceVersions_, balance_);
+    notifyBalanceChange();
+    return true;
+}
+
+bool Account::transferTo(Account* destination, long long debit, long long credit) {
+    if (destination == nullptr || debit <= 0 || credit <= 0) {
+        return false;
+    }
+    if (destination == this) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (debit > balance_) {
+            return false;
+        }
+        balance_ += credit - debit;
+        VersionStore::Instance().Commit(balanceVersions_, balance_);
+        notifyBalanceChange();
+        return true;
+    }
+    std::unique_lock<std::mutex> sourceLock(mutex_, std::defer_lock);
+    std::unique_lock<std::mutex> destinationLock(destination->mutex_, std::defer_lock);
+    std::lock(sourceLock, destinationLock);
+    if (debit > balance_) {
+        return false;
+    }
+    balance_ -= debit;
+    destination->balance_ += credit;
+    VersionStore::Instance().Commit(balanceVersions_, balance_,
+                                    destination->balanceVersions_, destination->balance_);
+    notifyBalanceChange();
+    destination->notifyBalanceChange();
     return true;
 }
 
 void Account::recordTransaction(Transaction* accountTransaction) {
-    if (accountTransaction != nullptr) {
-        transactionHistory_.push_back(accountTransaction);
+    if (accountTransaction == nullptr) {
+        return;
+    }
+    const long long id = accountTransaction->getId();
+    std::lock_guard<std::mutex> lock(mutex_);
+    ++recordedCount_;
+    if (!recent_) {
+        recent_.reset(new RecentTransaction[ACCOUNT_RECENT_TRANSACTIONS]);
     }
+    std::size_t slot = recentCount_;
+    if (recentCount_ == ACCOUNT_RECENT_TRANSACTIONS) {
+        // Two ATMs finishing at once can record out of ID order.
+        if (id < recent_[0].id) {
+            return;
+        }
+        std::copy(recent_.get() + 1, recent_.get() + recentCount_, recent_.get());
+        slot = recentCount_ - 1;
+    } else {
+        ++recentCount_;
+    }
+    while (slot > 0 && recent_[slot - 1].id > id) {
+        recent_[slot] = recent_[slot - 1];
+        --slot;
+    }
+    recent_[slot].id = id;
+    recent_[slot].transaction = accountTransaction;
+}
+
+HistoryPage Account::getHistory(long long cursor,
+                                std::size_t pageSize,
+                                const TransactionLedger* archive) const {
+    HistoryPage page;
+    if (pageSize == 0) {
+        return page;
+    }
+    const long long before = cursor > 0 ? cursor : LLONG_MAX;
+    // A segmented ledger owns the transactions and frees the ones it seals,
+    // so the kept pointers are not read; it copies the page out instead.
+    if (archive != nullptr && archive->HasSegments()) {
+        archive->FindAccountHistory(accountNumber_, before, pageSize, page.transactions, page.loaded);
+    } else {
+        long long lowestKept = before;
+        bool older = false;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            for (std::size_t i = recentCount_; i > 0 && page.transactions.size() < pageSize; --i) {
+                if (recent_[i - 1].id < before) {
+                    page.transactions.push_back(recent_[i - 1].transaction);
+                }
+            }
+            if (recentCount_ > 0) {
+                lowestKept = std::min(before, recent_[0].id);
+            }
+            older = recordedCount_ > static_cast<long long>(recentCount_);
+        }
+        if (page.transactions.size() < pageSize && older && archive != nullptr) {
+            archive->FindAccountHistory(accountNumber_, lowestKept, pageSize - page.transactions.size(),
+                                        page.transactions, page.loaded);
+        }
+    }
+    if (page.transactions.size() == pageSize) {
+        page.nextCursor = page.transactions.back()->getId();
+    }
+    return page;
+}
+
+long long Account::getTransactionCount() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return recordedCount_;
 }
 
 bool Account::checkPassword(const std::string& enteredPassword) const {
     return password_ == enteredPassword;
 }
+
+const VersionChain<long long>& Account::getBalanceVersions() const {
+    return balanceVersions_;
+}
+
+void Account::beginUse() {
+    activeSessions_.fetch_add(1, std::memory_order_relaxed);
+}
+
+void Account::endUse() {
+    activeSessions_.fetch_sub(1, std::memory_order_relaxed);
+}
+
+bool Account::isInUse() const {
+    return activeSessions_.load(std::memory_order_relaxed) > 0;
+}
+
+bool Account::watchBalance(BalanceObserver* observer, unsigned long long cookie) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (balanceObserver_ != nullptr && balanceObserver_ != observer) {
+        return false;
+    }
+    balanceObserver_ = observer;
+    balanceCookie_ = cookie;
+    balanceChangePending_.store(false, std::memory_order_relaxed);
+    return true;
+}
+
+void Account::unwatchBalance(BalanceObserver* observer) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (balanceObserver_ == observer) {
+        balanceObserver_ = nullptr;
+    }
+}
+
+void Account::acknowledgeBalanceChange() {
+    balanceChangePending_.store(false, std::memory_order_seq_cst);
+}
+
+void Account::notifyBalanceChange() {
+    if (balanceObserver_ == nullptr || balanceChangePending_.load(std::memory_order_relaxed) ||
+        balanceChangePending_.exchange(true, std::memory_order_seq_cst)) {
+        return;
+    }
+    balanceObserver_->BalanceChanged(balanceCookie_);
+}
@@ -1,13 +1,47 @@
 #ifndef ACCOUNT_HPP
 #define ACCOUNT_HPP
 
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <mutex>
 #include <string>
 #include <vector>
 
+#include "Transaction.hpp"
+#include "Versions.hpp"
+
 class Bank;
 class Card;
-class Transaction;
+class TransactionLedger;
+
+// Transactions an account keeps in memory for its mini-statement; older
+// ones are read back from the ledger.
+const std::size_t ACCOUNT_RECENT_TRANSACTIONS = 10;
+
+// One page of an account's history, newest first.
+struct HistoryPage {
+    std::vector<Transaction*> transactions;
+    // Cursor for the next page; 0 when there is none.
+    long long nextCursor;
+    // Owns the entries read back from ledger segments.
+    LoadedTransactions loaded;
+
+    HistoryPage();
+};
+
+// Told about an account's committed balance changes, on the committing
+// thread and while the account is locked, so it must not lock accounts.
+class BalanceObserver {
+public:
+    virtual void BalanceChanged(unsigned long long cookie) = 0;
 
+protected:
+    ~BalanceObserver() = default;
+};
+
+// Balance and history are guarded by a per-account mutex, since ATMs on
+// different executor threads may touch the same account.
 class Account {
 public:
     Account(Bank* owningBank,
@@ -20,23 +54,77 @@ public:
     const std::string& getAccountNumber() const;
     const std::string& getOwnerName() const;
     long long getBalance() const;
+    // The balance the account opened with; with the ledger's postings it
+    // accounts for getBalance().
+    long long getInitialFunds() const;
     Card* getLinkedCard() const;
     Bank* getBank() const;
     const std::string& getBankName() const;
 
     void deposit(long long amount);
     bool withdraw(long long amount);
+    // Debits this account and credits destination as one step, holding both
+    // account locks so concurrent ATMs never observe a half-done transfer.
+    bool transferTo(Account* destination, long long debit, long long credit);
     void recordTransaction(Transaction* accountTransaction);
+    // Up to pageSize transactions with an ID below cursor (0 starts at the
+    // newest), newest first. The most recent come from memory and the rest
+    // from archive; without one, paging stops where memory ends. A
+    // segmented archive answers the whole page, since it may have freed
+    // the kept entries.
+    HistoryPage getHistory(long long cursor, std::size_t pageSize, const TransactionLedger* archive) const;
+    long long getTransactionCount() const;
     bool checkPassword(const std::string& password) const;
 
+    // Committed balance history, for reading through a ReadView without
+    // taking the account lock.
+    const VersionChain<long long>& getBalanceVersions() const;
+    // Counts the customer sessions currently logged in to this account.
+    void beginUse();
+    void endUse();
+    bool isInUse() const;
+    // Attaches observer, which is then told cookie after the next balance
+    // commit and not again until it calls acknowledgeBalanceChange(). An
+    // account has one observer at a time; returns false if another holds it.
+    // Once unwatchBalance returns, the observer is not called again.
+    bool watchBalance(BalanceObserver* observer, unsigned long long cookie);
+    void unwatchBalance(BalanceObserver* observer);
+    // Call before reading the balance the observer was told about, so a
+    // commit made after the read is reported again.
+    void acknowledgeBalanceChange();
+
 private:
+    Account(const Account&) = delete;
+    Account& operator=(const Account&) = delete;
+
+    mutable std::mutex mutex_;
     Bank* bank_;
     std::string ownerName_;
     std::string accountNumber_;
     long long balance_;
+    long long initialFunds_;
     Card* accountCard_;
     std::string password_;
-    std::vector<Transaction*> transactionHistory_;
+    // The ID is kept alongside so entries can be ordered without touching
+    // the transaction, which a segmented ledger may have freed.
+    struct RecentTransaction {
+        long long id;
+        Transaction* transaction;
+    };
+
+    // The highest-ID transactions recorded, lowest first, allocated on the
+    // first one. Every transaction not kept has a lower ID than all kept.
+    std::unique_ptr<RecentTransaction[]> recent_;
+    std::size_t recentCount_;
+    long long recordedCount_;
+    VersionChain<long long> balanceVersions_;
+    std::atomic<int> activeSessions_;
+    BalanceObserver* balanceObserver_;
+    unsigned long long balanceCookie_;
+    std::atomic<bool> balanceChangePending_;
+
+    // After each commit, with the account locked.
+    void notifyBalanceChange();
 };
 
 #endif // ACCOUNT_HPP
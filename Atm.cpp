@@ -1,104 +1,83 @@
 #include "Atm.hpp"
 
 #include <iostream>
+#include <unordered_map>
 
 #include "Account.hpp"
 #include "Bank.hpp"
 #include "Card.hpp"
+#include "Ledger.hpp"
+#include "Receipt.hpp"
+#include "Settlement.hpp"
 #include "Transaction.hpp"
 
-static const int CASH_BILL_VALUES[CASH_TYPE_COUNT] = {1000, 5000, 10000, 50000};
-
 namespace {
 
+const long long MAX_WITHDRAWAL_AMOUNT = 500000;
+// Cached plans beyond this many are dropped all at once.
+const std::size_t MAX_CACHED_PLANS = 4096;
+// A session log bigger than this is freed rather than kept for reuse.
+const std::size_t MAX_KEPT_LOG_EVENTS = 64;
+const std::size_t MAX_KEPT_LOG_TEXT = 8192;
+
 std::string TLang(ATMLanguage lang, const std::string& en, const std::string& kr) {
     return (lang == ATMLanguage_Korean) ? kr : en;
 }
 
-void Say(ATMLanguage lang, const std::string& en, const std::string& kr) {
-    std::cout << TLang(lang, en, kr);
-}
-
-bool BuildWithdrawalBundle(long long amount, const CashDrawer& inventory, CashDrawer& bundle) {
-    bundle = CashDrawer();
-    long long remaining = amount;
-    for (int i = CASH_TYPE_COUNT - 1; i >= 0; --i) {
-        int billValue = CASH_BILL_VALUES[i];
-        long long needed = remaining / billValue;
-        if (needed <= 0) {
-            continue;
-        }
-        long long inStock = inventory.noteCounts[i];
-        if (inStock > needed) {
-            inStock = needed;
+// Bit i is set when cassette i holds fewer notes than a plan for amount
+// could take from it. Only those cassettes can change the fewest-notes plan.
+unsigned LimitingCassetteMask(const CashDrawer& inventory, long long amount) {
+    unsigned mask = 0;
+    for (int i = 0; i < CASH_TYPE_COUNT; ++i) {
+        if (inventory.noteCounts[i] < amount / CASH_BILL_VALUES[i]) {
+            mask |= 1u << i;
         }
-        int usable = static_cast<int>(inStock);
-        bundle.noteCounts[i] = usable;
-        remaining -= static_cast<long long>(usable) * billValue;
     }
-    return remaining == 0;
-}
-
-}
-
-ATMFees ATMFees::CreateDefault() {
-    ATMFees fees;
-    fees.depositPrimary = 0;
-    fees.depositNonPrimary = 1000;
-    fees.withdrawalPrimary = 1000;
-    fees.withdrawalNonPrimary = 2000;
-    fees.transferPrimaryToPrimary = 1000;
-    fees.transferPrimaryToOther = 2000;
-    fees.transferNonPrimaryToNonPrimary = 4000;
-    fees.cashTransferAny = 2000;
-    return fees;
+    return mask;
 }
 
-CashDrawer::CashDrawer() {
-    for (int i = 0; i < CASH_TYPE_COUNT; ++i) {
-        noteCounts[i] = 0;
+AcceptedBanks PrimaryOnly(const Bank* primaryBank) {
+    AcceptedBanks accepted;
+    if (primaryBank != NULL) {
+        accepted.Insert(primaryBank);
     }
+    return accepted;
 }
 
-long long CashDrawer::TotalValue() const {
-    long long total = 0;
+unsigned DenominationMask(const CashDrawer& cash) {
+    unsigned mask = 0;
     for (int i = 0; i < CASH_TYPE_COUNT; ++i) {
-        total += static_cast<long long>(noteCounts[i]) * CASH_BILL_VALUES[i];
+        if (cash.noteCounts[i] != 0) {
+            mask |= 1u << i;
+        }
     }
-    return total;
+    return mask;
 }
 
-int CashDrawer::ItemCount() const {
-    int total = 0;
-    for (int i = 0; i < CASH_TYPE_COUNT; ++i) {
-        total += noteCounts[i];
-    }
-    return total;
 }
 
-void CashDrawer::Add(const CashDrawer& other) {
-    for (int i = 0; i < CASH_TYPE_COUNT; ++i) {
-        noteCounts[i] += other.noteCounts[i];
-    }
+AcceptedBanks::AcceptedBanks()
+    : words(),
+      count(0) {
 }
 
-bool CashDrawer::HasEnoughBills(const CashDrawer& requested) const {
-    for (int i = 0; i < CASH_TYPE_COUNT; ++i) {
-        if (requested.noteCounts[i] > noteCounts[i]) {
-            return false;
-        }
-    }
-    return true;
+bool AcceptedBanks::Contains(const Bank* bank) const {
+    std::size_t index = bank->getIndex();
+    std::size_t word = index / 64;
+    return word < words.size() && (words[word] >> (index % 64) & 1u) != 0;
 }
 
-void CashDrawer::Remove(const CashDrawer& requested) {
-    if (!HasEnoughBills(requested)) {
-        return;
+bool AcceptedBanks::Insert(const Bank* bank) {
+    if (Contains(bank)) {
+        return false;
     }
-
-    for (int i = 0; i < CASH_TYPE_COUNT; ++i) {
-        noteCounts[i] -= requested.noteCounts[i];
+    std::size_t index = bank->getIndex();
+    if (index / 64 >= words.size()) {
+        words.resize(index / 64 + 1, 0);
     }
+    words[index / 64] |= 1ULL << (index % 64);
+    ++count;
+    return true;
 }
 
 SessionEvent::SessionEvent()
@@ -108,7 +87,57 @@ SessionEvent::SessionEvent()
       sourceAccount(""),
       targetAccount(""),
       cashChange(),
-      note("") {
+      note(""),
+      time(Timestamp::Now()) {
+}
+
+SessionLog::SessionLog()
+    : events_(),
+      text_() {
+}
+
+void SessionLog::Append(const SessionEvent& event) {
+    LoggedEvent logged;
+    logged.transactionType = event.transactionType;
+    logged.amount = event.amount;
+    logged.feeCharged = event.feeCharged;
+    logged.cashChange = event.cashChange;
+    logged.sourceAccount = Store(event.sourceAccount);
+    logged.targetAccount = Store(event.targetAccount);
+    logged.note = Store(event.note);
+    logged.time = event.time;
+    events_.push_back(logged);
+}
+
+void SessionLog::Reset() {
+    if (events_.capacity() > MAX_KEPT_LOG_EVENTS || text_.capacity() > MAX_KEPT_LOG_TEXT) {
+        std::vector<LoggedEvent>().swap(events_);
+        std::vector<char>().swap(text_);
+        return;
+    }
+    // Both hold trivially destructible elements, so this is O(1).
+    events_.clear();
+    text_.clear();
+}
+
+std::size_t SessionLog::Size() const {
+    return events_.size();
+}
+
+const LoggedEvent& SessionLog::operator[](std::size_t index) const {
+    return events_[index];
+}
+
+void SessionLog::AppendText(ReceiptWriter& out, LogText text) const {
+    out.Append(text_.data() + text.offset, text.size);
+}
+
+LogText SessionLog::Store(const std::string& text) {
+    LogText stored;
+    stored.offset = static_cast<std::uint32_t>(text_.size());
+    stored.size = static_cast<std::uint32_t>(text.size());
+    text_.insert(text_.end(), text.begin(), text.end());
+    return stored;
 }
 
 SessionState::SessionState()
@@ -117,7 +146,7 @@ SessionState::SessionState()
       adminCard(NULL),
       primaryAccount(NULL),
       isPrimaryBankCard(false),
-      recordCount(0),
+      log(),
       withdrawalCount(0) {
 }
 
@@ -127,24 +156,29 @@ ATM::ATM(const std::string& serialNumber,
          bool bilingual)
     : serialNumber_(serialNumber),
       primaryBank_(primaryBank),
-      acceptedBankCount_(0),
+      acceptedBanks_(PrimaryOnly(primaryBank)),
       accessMode_(accessMode),
       bilingual_(bilingual),
       language_(ATMLanguage_English),
-      fees_(ATMFees::CreateDefault()),
+      fees_(FeeTable(FeeSchedule(), primaryBank)),
+      dispenseObjective_(DispenseObjective_FewestNotes),
+      planCache_(),
+      planCacheHits_(0),
+      planCacheLookups_(0),
+      dispenseRates_(),
+      cashVersions_(CashDrawer()),
+      cashLoaded_(0),
+      checksDeposited_(0),
       sessionActive_(false),
+      console_(&std::cout),
+      settlement_(nullptr),
+      ledger_(nullptr),
+      receipt_(),
+      receiptSink_(nullptr),
       transactions_(),
       totalSessions_(0),
       customerSessions_(0),
       adminSessions_(0) {
-    for (int i = 0; i < MAX_BANK_SLOTS; ++i) {
-        acceptedBanks_[i] = NULL;
-    }
-
-    if (primaryBank_ != NULL && acceptedBankCount_ < MAX_BANK_SLOTS) {
-        acceptedBanks_[acceptedBankCount_] = primaryBank_;
-        ++acceptedBankCount_;
-    }
 }
 
 const std::string& ATM::GetSerialNumber() const {
@@ -161,23 +195,32 @@ void ATM::AddAcceptedBank(Bank* bank) {
     }
 
     if (accessMode_ == ATMBankAccess_SingleBank && bank != primaryBank_) {
-        Say(language_, "This ATM accepts only its primary bank.\n", "이 ATM은 기본 은행 카드만 허용합니다.\n");
+        Say("This ATM accepts only its primary bank.\n", "이 ATM은 기본 은행 카드만 허용합니다.\n");
         return;
     }
 
-    for (int i = 0; i < acceptedBankCount_; ++i) {
-        if (acceptedBanks_[i] == bank) {
-            return;
-        }
+    if (acceptedBanks_.Read().Contains(bank)) {
+        return;
     }
+    acceptedBanks_.Modify([bank](AcceptedBanks& accepted) {
+        accepted.Insert(bank);
+    });
+}
 
-    if (acceptedBankCount_ >= MAX_BANK_SLOTS) {
-        Say(language_, "Accepted bank list is full.\n", "허용 가능한 은행 목록이 가득 찼습니다.\n");
+void ATM::AddAcceptedBanks(const std::vector<Bank*>& banks) {
+    if (accessMode_ == ATMBankAccess_SingleBank) {
+        for (Bank* bank : banks) {
+            AddAcceptedBank(bank);
+        }
         return;
     }
-
-    acceptedBanks_[acceptedBankCount_] = bank;
-    ++acceptedBankCount_;
+    acceptedBanks_.Modify([&banks](AcceptedBanks& accepted) {
+        for (const Bank* bank : banks) {
+            if (bank != NULL) {
+                accepted.Insert(bank);
+            }
+        }
+    });
 }
 
 bool ATM::SupportsBank(const Bank* bank) const {
@@ -185,13 +228,7 @@ bool ATM::SupportsBank(const Bank* bank) const {
         return false;
     }
 
-    for (int i = 0; i < acceptedBankCount_; ++i) {
-        if (acceptedBanks_[i] == bank) {
-            return true;
-        }
-    }
-
-    return false;
+    return acceptedBanks_.Read().Contains(bank);
 }
 
 ATMBankAccess ATM::GetBankAccessMode() const {
@@ -204,7 +241,7 @@ bool ATM::IsBilingual() const {
 
 void ATM::SetLanguage(ATMLanguage language) {
     if (!bilingual_ && language == ATMLanguage_Korean) {
-        Say(language_, "This ATM supports English only.\n", "이 ATM은 영어만 지원합니다.\n");
+        Say("This ATM supports English only.\n", "이 ATM은 영어만 지원합니다.\n");
         language_ = ATMLanguage_English;
         return;
     }
@@ -216,40 +253,184 @@ ATMLanguage ATM::GetActiveLanguage() const {
 }
 
 const ATMFees& ATM::GetFees() const {
-    return fees_;
+    return fees_.Read().GetSchedule().base;
 }
 
 void ATM::SetFees(const ATMFees& fees) {
-    fees_ = fees;
+    const Bank* primaryBank = primaryBank_;
+    fees_.Modify([&fees, primaryBank](FeeTable& table) {
+        FeeSchedule schedule = table.GetSchedule();
+        schedule.base = fees;
+        table = FeeTable(schedule, primaryBank);
+    });
+}
+
+const FeeTable& ATM::GetFeeTable() const {
+    return fees_.Read();
+}
+
+void ATM::SetFeeSchedule(const FeeSchedule& schedule) {
+    fees_.Publish(FeeTable(schedule, primaryBank_));
+}
+
+DispenseObjective ATM::GetDispenseObjective() const {
+    return dispenseObjective_;
+}
+
+void ATM::SetDispenseObjective(DispenseObjective objective) {
+    if (objective != dispenseObjective_) {
+        planCache_.clear();
+    }
+    dispenseObjective_ = objective;
+}
+
+long long ATM::GetPlanCacheHits() const {
+    return planCacheHits_;
+}
+
+long long ATM::GetPlanCacheLookups() const {
+    return planCacheLookups_;
+}
+
+const DispenseRateTracker& ATM::GetDispenseRates() const {
+    return dispenseRates_;
+}
+
+bool ATM::PlanWithdrawal(long long amount, CashDrawer& bundle) {
+    ++planCacheLookups_;
+    const long long key = (amount << CASH_TYPE_COUNT) | LimitingCassetteMask(cashInventory_, amount);
+    std::unordered_map<long long, CashDrawer>::const_iterator cached = planCache_.find(key);
+    if (cached != planCache_.end() && cashInventory_.HasEnoughBills(cached->second)) {
+        ++planCacheHits_;
+        bundle = cached->second;
+        return true;
+    }
+
+    if (!PlanDispense(amount, cashInventory_, dispenseObjective_, bundle)) {
+        return false;
+    }
+    if (planCache_.size() >= MAX_CACHED_PLANS) {
+        planCache_.clear();
+    }
+    planCache_[key] = bundle;
+    return true;
+}
+
+void ATM::AddCash(const CashDrawer& cash) {
+    cashInventory_.Add(cash);
+    VersionStore::Instance().Commit(cashVersions_, cashInventory_);
+    InvalidatePlans(DenominationMask(cash));
+}
+
+void ATM::RemoveCash(const CashDrawer& cash) {
+    cashInventory_.Remove(cash);
+    VersionStore::Instance().Commit(cashVersions_, cashInventory_);
+    InvalidatePlans(DenominationMask(cash));
+}
+
+void ATM::InvalidatePlans(unsigned changedCassettes) {
+    if (changedCassettes == 0 || planCache_.empty()) {
+        return;
+    }
+    // A plan depends on the exact count of each cassette that limited it,
+    // recorded in the bottom bits of its key. Other cassettes held enough
+    // that any count still above the limit yields the same plan, and a
+    // count below it makes lookups use a different key.
+    const long long keyMask = (1LL << CASH_TYPE_COUNT) - 1;
+    for (std::unordered_map<long long, CashDrawer>::iterator it = planCache_.begin(); it != planCache_.end();) {
+        if ((static_cast<unsigned>(it->first & keyMask) & changedCassettes) != 0) {
+            it = planCache_.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
+
+void ATM::SetConsole(std::ostream* console) {
+    console_ = console != nullptr ? console : &std::cout;
+}
+
+void ATM::SetReceiptSink(ReceiptSink* sink) {
+    receiptSink_ = sink;
+}
+
+ReceiptSink* ATM::GetReceiptSink() const {
+    return receiptSink_;
+}
+
+void ATM::SetSettlement(SettlementLedger* settlement) {
+    settlement_ = settlement;
+}
+
+void ATM::SetLedger(TransactionLedger* ledger) {
+    ledger_ = ledger;
+}
+
+std::ostream& ATM::GetConsole() const {
+    return *console_;
 }
 
 const CashDrawer& ATM::GetCashInventory() const {
     return cashInventory_;
 }
 
+const VersionChain<CashDrawer>& ATM::GetCashVersions() const {
+    return cashVersions_;
+}
+
+long long ATM::GetCashLoaded() const {
+    return cashLoaded_;
+}
+
+long long ATM::GetChecksDeposited() const {
+    return checksDeposited_;
+}
+
 void ATM::LoadCash(const CashDrawer& cash) {
-    cashInventory_.Add(cash);
+    AddCash(cash);
+    cashLoaded_ += cash.TotalValue();
 }
 
 bool ATM::TryGiveCash(const CashDrawer& cash) {
     if (!cashInventory_.HasEnoughBills(cash)) {
-        Say(language_, "Not enough cash available in the ATM.\n", "ATM에 충분한 현금이 없습니다.\n");
+        Say("Not enough cash available in the ATM.\n", "ATM에 충분한 현금이 없습니다.\n");
         return false;
     }
 
-    cashInventory_.Remove(cash);
+    RemoveCash(cash);
+    cashLoaded_ -= cash.TotalValue();
     return true;
 }
 
 void ATM::AddTransaction(Transaction* t) {
-    if (t != nullptr) {
-        transactions_.push_back(t);
+    if (t == nullptr) {
+        return;
     }
+    if (ledger_ != nullptr) {
+        ledger_->Add(t);
+        // A segmented ledger owns the transaction and may free it once
+        // another thread seals it, so it is handed over last.
+        if (ledger_->HasSegments()) {
+            return;
+        }
+    }
+    transactions_.push_back(t);
+}
+
+const std::vector<Transaction*>& ATM::ReadTransactions(std::vector<Transaction*>& found,
+                                                       LoadedTransactions& loaded) const {
+    if (ledger_ == nullptr || !ledger_->HasSegments()) {
+        return transactions_;
+    }
+    TransactionQuery query;
+    query.atmSerial = serialNumber_;
+    ledger_->Find(query, found, loaded);
+    return found;
 }
 
 void ATM::StartCustomerSession(const Card* card, Account* account, bool primaryBankCard) {
     if (sessionActive_) {
-        Say(language_, "A session is already running.\n", "이미 세션이 진행 중입니다.\n");
+        Say("A session is already running.\n", "이미 세션이 진행 중입니다.\n");
         return;
     }
 
@@ -259,16 +440,19 @@ void ATM::StartCustomerSession(const Card* card, Account* account, bool primaryB
     sessionInfo_.card = card;
     sessionInfo_.primaryAccount = account;
     sessionInfo_.isPrimaryBankCard = primaryBankCard;
+    if (account != NULL) {
+        account->beginUse();
+    }
 
     if (account == NULL) {
-        Say(language_, "Invalid card. Session ended.\n", "유효하지 않은 카드입니다. 세션을 종료합니다.\n");
+        Say("Invalid card. Session ended.\n", "유효하지 않은 카드입니다. 세션을 종료합니다.\n");
         EndSession();
     }
 }
 
 void ATM::StartAdminSession(const Card* card) {
     if (sessionActive_) {
-        Say(language_, "A session is already running.\n", "이미 세션이 진행 중입니다.\n");
+        Say("A session is already running.\n", "이미 세션이 진행 중입니다.\n");
         return;
     }
 
@@ -283,8 +467,18 @@ void ATM::EndSession() {
         return;
     }
 
+    if (sessionInfo_.mode == ATMMode_Customer) {
+        dispenseRates_.EndSession();
+        if (sessionInfo_.primaryAccount != nullptr) {
+            sessionInfo_.primaryAccount->endUse();
+        }
+    }
     sessionActive_ = false;
     ClearSession();
+    // Nothing on this ATM's strand still holds fees or accepted banks read
+    // during the session, so replaced versions can go.
+    fees_.Reclaim();
+    acceptedBanks_.Reclaim();
 }
 
 bool ATM::HasActiveSession() const {
@@ -302,11 +496,11 @@ const SessionState& ATM::GetSessionState() const {
     return sessionInfo_;
 }
 
-long long ATM::GetDepositFeeForCurrentSession() const {
+long long ATM::GetDepositFeeForCurrentSession(long long amount) const {
     if (!sessionActive_ || sessionInfo_.mode != ATMMode_Customer) {
         return 0;
     }
-    return sessionInfo_.isPrimaryBankCard ? fees_.depositPrimary : fees_.depositNonPrimary;
+    return fees_.Read().Fee(ATMTransaction_Deposit, CardBank(), nullptr, amount);
 }
 
 void ATM::RecordEvent(const SessionEvent& event) {
@@ -314,74 +508,86 @@ void ATM::RecordEvent(const SessionEvent& event) {
         return;
     }
 
-    if (sessionInfo_.recordCount >= MAX_SESSION_EVENTS) {
-        Say(language_, "Session log is full. Event not recorded.\n",
-            "세션 기록이 가득 찼습니다. 이벤트가 기록되지 않았습니다.\n");
-        EndSession();
-        return;
-    }
-
-    sessionInfo_.records[sessionInfo_.recordCount] = event;
-    ++sessionInfo_.recordCount;
+    sessionInfo_.log.Append(event);
 }
 
 void ATM::PrintReceipt(std::ostream& out) const {
+    StreamReceiptSink sink(out);
+    PrintReceipt(sink);
+}
+
+void ATM::PrintReceipt(ReceiptSink& sink) const {
+    const bool kr = (language_ == ATMLanguage_Korean);
+    ReceiptWriter& r = receipt_;
+    r.Clear();
     if (!sessionActive_) {
-        out << "No active session. Nothing to print.\n";
+        r.Append("No active session. Nothing to print.\n");
+        sink.Write(r.Data(), r.Size());
         return;
     }
 
-    out << "\n========================================\n";
-    out << TLang(language_, "           SESSION SUMMARY              ",
-                "           세션 요약                     ") << "\n";
-    out << "========================================\n";
-    out << "  " << TLang(language_, "ATM Serial", "ATM 일련번호") << " : " << serialNumber_ << "\n";
-    out << "  " << TLang(language_, "Mode", "모드") << "       : "
-        << (sessionInfo_.mode == ATMMode_Admin ? TLang(language_, "Admin", "관리자")
-                                               : TLang(language_, "Customer", "고객"))
-        << "\n";
-    out << "  " << TLang(language_, "Transactions", "거래 수") << ": " << sessionInfo_.recordCount << "\n";
-    out << "----------------------------------------\n";
+    r.Append("\n========================================\n");
+    r.Append(kr ? "           세션 요약                     " : "           SESSION SUMMARY              ").Append("\n");
+    r.Append("========================================\n");
+    r.Append("  ").Append(kr ? "ATM 일련번호" : "ATM Serial").Append(" : ").Append(serialNumber_).Append("\n");
+    r.Append("  ").Append(kr ? "모드" : "Mode").Append("       : ");
+    if (sessionInfo_.mode == ATMMode_Admin) {
+        r.Append(kr ? "관리자" : "Admin");
+    } else {
+        r.Append(kr ? "고객" : "Customer");
+    }
+    r.Append("\n");
+    const SessionLog& log = sessionInfo_.log;
+    r.Append("  ").Append(kr ? "거래 수" : "Transactions").Append(": ")
+        .AppendInteger(static_cast<long long>(log.Size())).Append("\n");
+    r.Append("----------------------------------------\n");
 
-    if (sessionInfo_.recordCount == 0) {
-        out << "  " << TLang(language_, "No transactions were recorded.\n", "기록된 거래가 없습니다.\n");
+    if (log.Size() == 0) {
+        r.Append("  ").Append(kr ? "기록된 거래가 없습니다.\n" : "No transactions were recorded.\n");
     } else {
-        for (int i = 0; i < sessionInfo_.recordCount; ++i) {
-            const SessionEvent& entry = sessionInfo_.records[i];
-            out << "  #" << (i + 1) << " - ";
+        for (std::size_t i = 0; i < log.Size(); ++i) {
+            const LoggedEvent& entry = log[i];
+            r.Append("  #").AppendInteger(static_cast<long long>(i + 1)).Append(" - ");
             switch (entry.transactionType) {
             case ATMTransaction_Deposit:
-                out << TLang(language_, "Deposit", "입금");
+                r.Append(kr ? "입금" : "Deposit");
                 break;
             case ATMTransaction_Withdrawal:
-                out << TLang(language_, "Withdrawal", "출금");
+                r.Append(kr ? "출금" : "Withdrawal");
                 break;
             case ATMTransaction_AccountTransfer:
-                out << TLang(language_, "Account Transfer", "계좌 이체");
+                r.Append(kr ? "계좌 이체" : "Account Transfer");
                 break;
             case ATMTransaction_CashTransfer:
-                out << TLang(language_, "Cash Transfer", "현금 이체");
+                r.Append(kr ? "현금 이체" : "Cash Transfer");
                 break;
             default:
-                out << TLang(language_, "Unknown", "알 수 없음");
+                r.Append(kr ? "알 수 없음" : "Unknown");
                 break;
             }
-            out << "\n";
-            out << "    " << TLang(language_, "Amount", "금액") << " : " << entry.amount << "\n";
-            out << "    " << TLang(language_, "Fee", "수수료") << "    : " << entry.feeCharged << "\n";
-            if (!entry.sourceAccount.empty()) {
-                out << "    " << TLang(language_, "From", "출금 계좌") << "   : " << entry.sourceAccount << "\n";
+            r.Append("\n");
+            r.Append("    ").Append(kr ? "금액" : "Amount").Append(" : ").AppendInteger(entry.amount).Append("\n");
+            r.Append("    ").Append(kr ? "수수료" : "Fee").Append("    : ").AppendInteger(entry.feeCharged).Append("\n");
+            if (entry.sourceAccount.size > 0) {
+                r.Append("    ").Append(kr ? "출금 계좌" : "From").Append("   : ");
+                log.AppendText(r, entry.sourceAccount);
+                r.Append("\n");
             }
-            if (!entry.targetAccount.empty()) {
-                out << "    " << TLang(language_, "To", "입금 계좌") << "     : " << entry.targetAccount << "\n";
+            if (entry.targetAccount.size > 0) {
+                r.Append("    ").Append(kr ? "입금 계좌" : "To").Append("     : ");
+                log.AppendText(r, entry.targetAccount);
+                r.Append("\n");
             }
-            if (!entry.note.empty()) {
-                out << "    " << TLang(language_, "Note", "비고") << "   : " << entry.note << "\n";
+            if (entry.note.size > 0) {
+                r.Append("    ").Append(kr ? "비고" : "Note").Append("   : ");
+                log.AppendText(r, entry.note);
+                r.Append("\n");
             }
-            out << "----------------------------------------\n";
+            r.Append("----------------------------------------\n");
         }
     }
-    out << "========================================\n";
+    r.Append("========================================\n");
+    sink.Write(r.Data(), r.Size());
 }
 
 void ATM::RequestDeposit(const CashDrawer& cash, long long checkAmount, const CashDrawer& feeCash, int checkCount) {
@@ -391,73 +597,78 @@ void ATM::RequestDeposit(const CashDrawer& cash, long long checkAmount, const Ca
 
     int totalItems = cash.ItemCount() + checkCount;
     if (totalItems > MAX_INSERT_ITEMS) {
-        Say(language_, "Deposit exceeds the 50 item limit.\n", "입금은 최대 50개까지만 가능합니다.\n");
+        Say("Deposit exceeds the 50 item limit.\n", "입금은 최대 50개까지만 가능합니다.\n");
         EndSession();
         return;
     }
 
     Account* account = sessionInfo_.primaryAccount;
     if (account == nullptr) {
-        Say(language_, "No account is linked to this session.\n", "이 세션에 연결된 계좌가 없습니다.\n");
+        Say("No account is linked to this session.\n", "이 세션에 연결된 계좌가 없습니다.\n");
         EndSession();
         return;
     }
 
     Bank* accountBank = account->getBank();
     if (accountBank == nullptr) {
-        Say(language_, "Unable to locate the bank for this account.\n", "계좌의 은행을 찾을 수 없습니다.\n");
+        Say("Unable to locate the bank for this account.\n", "계좌의 은행을 찾을 수 없습니다.\n");
         EndSession();
         return;
     }
 
     long long depositAmount = cash.TotalValue() + checkAmount;
     if (depositAmount <= 0) {
-        Say(language_, "Deposit amount must be positive.\n", "입금 금액은 0보다 커야 합니다.\n");
+        Say("Deposit amount must be positive.\n", "입금 금액은 0보다 커야 합니다.\n");
         return;
     }
 
     SessionEvent event;
     event.transactionType = ATMTransaction_Deposit;
     event.amount = depositAmount;
-    event.feeCharged = sessionInfo_.isPrimaryBankCard ? fees_.depositPrimary : fees_.depositNonPrimary;
+    event.feeCharged = fees_.Read().Fee(ATMTransaction_Deposit, CardBank(), nullptr, depositAmount);
 
     long long feeCashValue = feeCash.TotalValue();
     if (feeCashValue != event.feeCharged) {
-        Say(language_, "Fee cash must match the exact fee amount.\n", "수수료 금액과 동일한 현금을 넣어야 합니다.\n");
+        Say("Fee cash must match the exact fee amount.\n", "수수료 금액과 동일한 현금을 넣어야 합니다.\n");
         EndSession();
         return;
     }
     if (event.feeCharged > 0) {
-        Say(language_, "Fee cash accepted.\n", "수수료 현금을 확인했습니다.\n");
+        Say("Fee cash accepted.\n", "수수료 현금을 확인했습니다.\n");
     }
 
     if (!accountBank->deposit(account, depositAmount)) {
-        Say(language_, "Deposit failed.\n", "입금에 실패했습니다.\n");
+        Say("Deposit failed.\n", "입금에 실패했습니다.\n");
         EndSession();
         return;
     }
-    Say(language_, "Deposit completed", "입금이 완료되었습니다");
+    // This ATM's bank keeps the cash and checks it took for another bank.
+    if (settlement_ != nullptr) {
+        settlement_->Post(primaryBank_, accountBank, depositAmount);
+    }
+    Say("Deposit completed", "입금이 완료되었습니다");
     if (event.feeCharged > 0) {
-        std::cout << TLang(language_,
+        *console_ << TLang(language_,
                            " (fee ",
                            " (수수료 ") << event.feeCharged
                   << TLang(language_,
                            " paid in cash and not added to balance)",
                            "가 현금으로 지불되었으며 잔액에 추가되지 않습니다)");
     }
-    std::cout << ".\n";
+    *console_ << ".\n";
 
     CashDrawer addedCash;
     if (cash.ItemCount() > 0) {
-        cashInventory_.Add(cash);
+        AddCash(cash);
         addedCash = cash;
     }
     event.cashChange = addedCash;
     event.sourceAccount.clear();
     event.targetAccount = account->getAccountNumber();
     if (feeCash.ItemCount() > 0) {
-        cashInventory_.Add(feeCash);
+        AddCash(feeCash);
     }
+    checksDeposited_ += checkAmount;
 
     if (checkAmount > 0) {
         if (event.feeCharged > 0) {
@@ -500,9 +711,9 @@ void ATM::RequestDeposit(const CashDrawer& cash, long long checkAmount, const Ca
                                                       depositAmount,
                                                       event.feeCharged,
                                                       event.note);
-    AddTransaction(transaction);
     accountBank->addTransaction(transaction);
     account->recordTransaction(transaction);
+    AddTransaction(transaction);
 }
 
 void ATM::RequestWithdrawal(long long amount) {
@@ -511,44 +722,45 @@ void ATM::RequestWithdrawal(long long amount) {
     }
 
     if (sessionInfo_.withdrawalCount >= 3) {
-        Say(language_, "You reached the maximum of 3 withdrawals this session.\n",
+        Say("You reached the maximum of 3 withdrawals this session.\n",
             "이 세션에서 출금은 최대 3회까지 가능합니다.\n");
         return;
     }
 
-    if (amount <= 0 || amount % 1000 != 0) {
-        Say(language_, "Enter an amount that is a positive multiple of 1,000.\n",
-            "1,000원 단위의 양수 금액을 입력하세요.\n");
+    if (amount <= 0 || amount % CASH_UNIT != 0) {
+        std::string unit = FormatNoteValue(CASH_UNIT);
+        Say("Enter an amount that is a positive multiple of " + unit + ".\n",
+            unit + "원 단위의 양수 금액을 입력하세요.\n");
         return;
     }
 
-    if (amount > 500000) {
-        Say(language_, "Maximum withdrawal per transaction is 500,000.\n",
+    if (amount > MAX_WITHDRAWAL_AMOUNT) {
+        Say("Maximum withdrawal per transaction is 500,000.\n",
             "한 번에 출금할 수 있는 최대 금액은 500,000원입니다.\n");
         return;
     }
 
     CashDrawer bundle;
-    if (!BuildWithdrawalBundle(amount, cashInventory_, bundle)) {
-        Say(language_, "ATM does not have the right bills for that amount.\n",
+    if (!PlanWithdrawal(amount, bundle)) {
+        Say("ATM does not have the right bills for that amount.\n",
             "해당 금액을 만들 수 있는 지폐 구성이 없습니다.\n");
         return;
     }
 
     if (!cashInventory_.HasEnoughBills(bundle)) {
-        Say(language_, "ATM is out of cash for that request.\n", "요청 금액을 지급할 현금이 부족합니다.\n");
+        Say("ATM is out of cash for that request.\n", "요청 금액을 지급할 현금이 부족합니다.\n");
         return;
     }
 
     Account* account = sessionInfo_.primaryAccount;
     if (account == nullptr) {
-        Say(language_, "No account is linked to this session.\n", "이 세션에 연결된 계좌가 없습니다.\n");
+        Say("No account is linked to this session.\n", "이 세션에 연결된 계좌가 없습니다.\n");
         return;
     }
 
     Bank* accountBank = account->getBank();
     if (accountBank == nullptr) {
-        Say(language_, "Unable to locate the bank for this account.\n", "계좌의 은행을 찾을 수 없습니다.\n");
+        Say("Unable to locate the bank for this account.\n", "계좌의 은행을 찾을 수 없습니다.\n");
         return;
     }
 
@@ -556,21 +768,27 @@ void ATM::RequestWithdrawal(long long amount) {
     event.transactionType = ATMTransaction_Withdrawal;
     event.amount = amount;
     event.cashChange = bundle;
-    event.feeCharged = sessionInfo_.isPrimaryBankCard ? fees_.withdrawalPrimary : fees_.withdrawalNonPrimary;
+    event.feeCharged = fees_.Read().Fee(ATMTransaction_Withdrawal, CardBank(), nullptr, amount);
 
     long long totalCost = amount + event.feeCharged;
     if (!accountBank->withdraw(account, totalCost)) {
-        Say(language_, "Insufficient funds in the account.\n", "계좌 잔액이 부족합니다.\n");
+        Say("Insufficient funds in the account.\n", "계좌 잔액이 부족합니다.\n");
         return;
     }
 
-    cashInventory_.Remove(bundle);
-    Say(language_, "Withdrawal complete", "출금이 완료되었습니다");
+    RemoveCash(bundle);
+    dispenseRates_.RecordDispense(bundle);
+    // The account's bank took the amount and the fee, but this ATM's bank
+    // paid out the cash and earned the fee.
+    if (settlement_ != nullptr) {
+        settlement_->Post(accountBank, primaryBank_, totalCost);
+    }
+    Say("Withdrawal complete", "출금이 완료되었습니다");
     if (event.feeCharged > 0) {
-        std::cout << TLang(language_, "; fee ", "; 수수료 ") << event.feeCharged
+        *console_ << TLang(language_, "; fee ", "; 수수료 ") << event.feeCharged
                   << TLang(language_, " deducted from account", "가 계좌에서 차감되었습니다");
     }
-    std::cout << ".\n";
+    *console_ << ".\n";
     event.sourceAccount = account->getAccountNumber();
     event.targetAccount.clear();
     if (event.feeCharged > 0) {
@@ -595,76 +813,68 @@ void ATM::RequestWithdrawal(long long amount) {
                                                          amount,
                                                          event.feeCharged,
                                                          event.note);
-    AddTransaction(transaction);
     accountBank->addTransaction(transaction);
     account->recordTransaction(transaction);
+    AddTransaction(transaction);
 }
 
-namespace {
-
-long long DetermineTransferFee(const Bank* primaryBank,
-                               Bank* sourceBank,
-                               Bank* destinationBank,
-                               const ATMFees& fees) {
-    bool sourceIsPrimary = (primaryBank != nullptr && sourceBank == primaryBank);
-    bool destinationIsPrimary = (primaryBank != nullptr && destinationBank == primaryBank);
-
-    if (sourceIsPrimary && destinationIsPrimary) {
-        return fees.transferPrimaryToPrimary;
-    }
-    if (sourceIsPrimary || destinationIsPrimary) {
-        return fees.transferPrimaryToOther;
-    }
-    return fees.transferNonPrimaryToNonPrimary;
-}
-
-} // namespace
-
 void ATM::RequestAccountTransfer(Account* destination, long long amount) {
     if (!CheckSessionActive(ATMMode_Customer)) {
         return;
     }
 
     if (destination == nullptr) {
-        Say(language_, "Destination account is invalid.\n", "목적지 계좌가 올바르지 않습니다.\n");
+        Say("Destination account is invalid.\n", "목적지 계좌가 올바르지 않습니다.\n");
         return;
     }
 
     Account* source = sessionInfo_.primaryAccount;
     if (source == nullptr) {
-        Say(language_, "No source account is linked to this session.\n", "이 세션에 출금 계좌가 없습니다.\n");
+        Say("No source account is linked to this session.\n", "이 세션에 출금 계좌가 없습니다.\n");
         return;
     }
 
     if (source == destination) {
-        Say(language_, "Cannot transfer to the same account.\n", "동일한 계좌로는 이체할 수 없습니다.\n");
+        Say("Cannot transfer to the same account.\n", "동일한 계좌로는 이체할 수 없습니다.\n");
         return;
     }
 
     if (amount <= 0) {
-        Say(language_, "Transfer amount must be positive.\n", "이체 금액은 0보다 커야 합니다.\n");
+        Say("Transfer amount must be positive.\n", "이체 금액은 0보다 커야 합니다.\n");
         return;
     }
 
     Bank* sourceBank = source->getBank();
     Bank* destinationBank = destination->getBank();
     if (sourceBank == nullptr || destinationBank == nullptr) {
-        Say(language_, "Unable to locate the banks for the accounts.\n", "계좌의 은행을 찾을 수 없습니다.\n");
+        Say("Unable to locate the banks for the accounts.\n", "계좌의 은행을 찾을 수 없습니다.\n");
         return;
     }
 
-    long long fee = DetermineTransferFee(primaryBank_, sourceBank, destinationBank, fees_);
+    long long fee = fees_.Read().Fee(ATMTransaction_AccountTransfer, sourceBank, destinationBank, amount);
     if (!sourceBank->transfer(source, destination, amount, fee)) {
-        Say(language_, "Transfer failed due to insufficient funds or invalid accounts.\n",
+        Say("Transfer failed due to insufficient funds or invalid accounts.\n",
             "잔액 부족 또는 잘못된 계좌로 인해 이체에 실패했습니다.\n");
         return;
     }
-    Say(language_, "Account transfer complete", "계좌 이체가 완료되었습니다");
+    // The source bank owes the amount to the destination bank and the fee,
+    // which it collected, to this ATM's bank.
+    if (settlement_ != nullptr) {
+        Obligation obligations[2];
+        obligations[0].debtor = sourceBank;
+        obligations[0].creditor = destinationBank;
+        obligations[0].amount = amount;
+        obligations[1].debtor = sourceBank;
+        obligations[1].creditor = primaryBank_;
+        obligations[1].amount = fee;
+        settlement_->Post(obligations, 2);
+    }
+    Say("Account transfer complete", "계좌 이체가 완료되었습니다");
     if (fee > 0) {
-        std::cout << TLang(language_, "; fee ", "; 수수료 ") << fee
+        *console_ << TLang(language_, "; fee ", "; 수수료 ") << fee
                   << TLang(language_, " deducted from source account", "가 출금 계좌에서 차감되었습니다");
     }
-    std::cout << ".\n";
+    *console_ << ".\n";
 
     SessionEvent event;
     event.transactionType = ATMTransaction_AccountTransfer;
@@ -695,10 +905,10 @@ void ATM::RequestAccountTransfer(Account* destination, long long amount) {
                                                               amount,
                                                               fee,
                                                               event.note);
-    AddTransaction(transaction);
     sourceBank->addTransaction(transaction);
     source->recordTransaction(transaction);
     destination->recordTransaction(transaction);
+    AddTransaction(transaction);
 }
 
 void ATM::RequestCashTransfer(Account* destination, const CashDrawer& cashInserted) {
@@ -708,56 +918,59 @@ void ATM::RequestCashTransfer(Account* destination, const CashDrawer& cashInsert
 
     Account* source = sessionInfo_.primaryAccount;
     if (source == nullptr) {
-        Say(language_, "No source account is linked to this session.\n", "이 세션에 출금 계좌가 없습니다.\n");
+        Say("No source account is linked to this session.\n", "이 세션에 출금 계좌가 없습니다.\n");
         return;
     }
 
     if (destination == nullptr) {
-        Say(language_, "Destination account is invalid.\n", "목적지 계좌가 올바르지 않습니다.\n");
+        Say("Destination account is invalid.\n", "목적지 계좌가 올바르지 않습니다.\n");
         return;
     }
 
     if (cashInserted.ItemCount() == 0) {
-        Say(language_, "Please insert cash to transfer.\n", "이체할 현금을 넣어 주세요.\n");
+        Say("Please insert cash to transfer.\n", "이체할 현금을 넣어 주세요.\n");
         return;
     }
 
     if (cashInserted.ItemCount() > MAX_INSERT_ITEMS) {
-        Say(language_,
-            "Cash transfer exceeds the 50 item limit.\n",
+        Say("Cash transfer exceeds the 50 item limit.\n",
             "현금 이체는 최대 50개까지만 가능합니다.\n");
         return;
     }
 
     Bank* destinationBank = destination->getBank();
     if (destinationBank == nullptr) {
-        Say(language_, "Unable to locate the bank for the destination account.\n", "목적지 계좌의 은행을 찾을 수 없습니다.\n");
+        Say("Unable to locate the bank for the destination account.\n", "목적지 계좌의 은행을 찾을 수 없습니다.\n");
         return;
     }
 
     long long totalCash = cashInserted.TotalValue();
-    long long fee = fees_.cashTransferAny;
+    long long fee = fees_.Read().Fee(ATMTransaction_CashTransfer, CardBank(), destinationBank, totalCash);
     long long transferAmount = totalCash - fee;
     if (transferAmount <= 0) {
-        Say(language_, "Inserted cash does not cover the transfer fee. Insert more cash.\n",
+        Say("Inserted cash does not cover the transfer fee. Insert more cash.\n",
             "넣은 현금이 수수료보다 적습니다. 현금을 더 넣어 주세요.\n");
         return;
     }
 
     if (!destinationBank->deposit(destination, transferAmount)) {
-        Say(language_, "Cash transfer failed.\n", "현금 이체에 실패했습니다.\n");
+        Say("Cash transfer failed.\n", "현금 이체에 실패했습니다.\n");
         return;
     }
 
-    cashInventory_.Add(cashInserted);
-    Say(language_, "Cash transfer complete", "현금 이체가 완료되었습니다");
+    AddCash(cashInserted);
+    // This ATM's bank holds the cash; the fee part of it is its own.
+    if (settlement_ != nullptr) {
+        settlement_->Post(primaryBank_, destinationBank, transferAmount);
+    }
+    Say("Cash transfer complete", "현금 이체가 완료되었습니다");
     if (fee > 0) {
-        std::cout << TLang(language_, "; fee ", "; 수수료 ") << fee
+        *console_ << TLang(language_, "; fee ", "; 수수료 ") << fee
                   << TLang(language_,
                            " paid in cash and not deposited to the destination account",
                            "가 현금으로 지불되었으며 입금 계좌에 추가되지 않습니다");
     }
-    std::cout << ".\n";
+    *console_ << ".\n";
 
     SessionEvent event;
     event.transactionType = ATMTransaction_CashTransfer;
@@ -789,23 +1002,42 @@ void ATM::RequestCashTransfer(Account* destination, const CashDrawer& cashInsert
                                                            transferAmount,
                                                            fee,
                                                            event.note);
-    AddTransaction(transaction);
     destinationBank->addTransaction(transaction);
     destination->recordTransaction(transaction);
+    AddTransaction(transaction);
+}
+
+void ATM::Say(const std::string& en, const std::string& kr) const {
+    *console_ << TLang(language_, en, kr);
+}
+
+const Bank* ATM::CardBank() const {
+    if (sessionInfo_.isPrimaryBankCard) {
+        return primaryBank_;
+    }
+    Account* account = sessionInfo_.primaryAccount;
+    return account != nullptr ? account->getBank() : nullptr;
 }
 
 void ATM::ClearSession() {
-    sessionInfo_ = SessionState();
+    // Field by field, so the event log keeps its memory.
+    sessionInfo_.mode = ATMMode_Idle;
+    sessionInfo_.card = NULL;
+    sessionInfo_.adminCard = NULL;
+    sessionInfo_.primaryAccount = NULL;
+    sessionInfo_.isPrimaryBankCard = false;
+    sessionInfo_.log.Reset();
+    sessionInfo_.withdrawalCount = 0;
 }
 
 bool ATM::CheckSessionActive(ATMMode expectedMode) const {
     if (!sessionActive_) {
-        Say(language_, "Please start a session first.\n", "먼저 세션을 시작하세요.\n");
+        Say("Please start a session first.\n", "먼저 세션을 시작하세요.\n");
         return false;
     }
 
     if (expectedMode != ATMMode_Idle && sessionInfo_.mode != expectedMode) {
-        Say(language_, "That action is not allowed in this session.\n", "이 세션에서는 해당 작업을 수행할 수 없습니다.\n");
+        Say("That action is not allowed in this session.\n", "이 세션에서는 해당 작업을 수행할 수 없습니다.\n");
         return false;
     }
 
@@ -1,14 +1,26 @@
 #ifndef ATM_HPP
 #define ATM_HPP
 
+#include <cstdint>
 #include <iostream>
 #include <string>
+#include <unordered_map>
 #include <vector>
 
+#include "CashDrawer.hpp"
+#include "Fees.hpp"
+#include "Forecast.hpp"
+#include "Rcu.hpp"
+#include "Receipt.hpp"
+#include "TimeIndex.hpp"
+#include "Transaction.hpp"
+#include "Versions.hpp"
+
 class Account;
 class Bank;
 class Card;
-class Transaction;
+class SettlementLedger;
+class TransactionLedger;
 
 enum ATMMode {
     ATMMode_Idle,
@@ -26,43 +38,29 @@ enum ATMLanguage {
     ATMLanguage_Korean
 };
 
-enum ATMTransactionKind {
-    ATMTransaction_Deposit,
-    ATMTransaction_Withdrawal,
-    ATMTransaction_AccountTransfer,
-    ATMTransaction_CashTransfer
-};
-
-const int CASH_TYPE_COUNT = 4;
-const int MAX_SESSION_EVENTS = 50;
-const int MAX_BANK_SLOTS = 10;
+const int CASH_TYPE_COUNT = ActiveDenominations::Count;
+// Face value of each note slot, smallest first.
+const int CASH_BILL_VALUES[CASH_TYPE_COUNT] = {ATM_DENOMINATIONS};
+// Every dispensable amount is a multiple of this.
+const int CASH_UNIT = ActiveDenominations::Unit();
 const int MAX_INSERT_ITEMS = 50;
 
-struct ATMFees {
-    long long depositPrimary;
-    long long depositNonPrimary;
-    long long withdrawalPrimary;
-    long long withdrawalNonPrimary;
-    long long transferPrimaryToPrimary;
-    long long transferPrimaryToOther;
-    long long transferNonPrimaryToNonPrimary;
-    long long cashTransferAny;
-
-    static ATMFees CreateDefault();
-};
+// Banks whose cards an ATM accepts, as a bitset over Bank::getIndex();
+// replaced as a whole on every change.
+struct AcceptedBanks {
+    std::vector<unsigned long long> words;
+    std::size_t count;
 
-struct CashDrawer {
-    int noteCounts[CASH_TYPE_COUNT];
+    AcceptedBanks();
 
-    CashDrawer();
-
-    long long TotalValue() const;
-    int ItemCount() const;
-    void Add(const CashDrawer& other);
-    bool HasEnoughBills(const CashDrawer& requested) const;
-    void Remove(const CashDrawer& requested);
+    bool Contains(const Bank* bank) const;
+    // Returns false if the bank was already accepted.
+    bool Insert(const Bank* bank);
 };
 
+// Same as PlanDispense with DispenseObjective_FewestNotes.
+bool BuildWithdrawalBundle(long long amount, const CashDrawer& inventory, CashDrawer& bundle);
+
 struct SessionEvent {
     ATMTransactionKind transactionType;
     long long amount;
@@ -71,18 +69,60 @@ struct SessionEvent {
     std::string targetAccount;
     CashDrawer cashChange;
     std::string note;
+    // Set when the event is created.
+    Timestamp time;
 
     SessionEvent();
 };
 
+// A span of a SessionLog's text arena.
+struct LogText {
+    std::uint32_t offset;
+    std::uint32_t size;
+};
+
+// A SessionEvent as the log keeps it: its strings live in the log's arena.
+struct LoggedEvent {
+    ATMTransactionKind transactionType;
+    long long amount;
+    long long feeCharged;
+    CashDrawer cashChange;
+    LogText sourceAccount;
+    LogText targetAccount;
+    LogText note;
+    Timestamp time;
+};
+
+// Growable event log of one session. Events are plain records and their
+// strings are packed into one text arena, so Reset() only rewinds both and
+// the memory is reused by the ATM's next session.
+class SessionLog {
+public:
+    SessionLog();
+
+    void Append(const SessionEvent& event);
+    // Keeps the memory for the next session, unless an unusually long
+    // session grew it past a few kilobytes.
+    void Reset();
+
+    std::size_t Size() const;
+    const LoggedEvent& operator[](std::size_t index) const;
+    void AppendText(ReceiptWriter& out, LogText text) const;
+
+private:
+    LogText Store(const std::string& text);
+
+    std::vector<LoggedEvent> events_;
+    std::vector<char> text_;
+};
+
 struct SessionState {
     ATMMode mode;
     const Card* card;
     const Card* adminCard;
     Account* primaryAccount;
     bool isPrimaryBankCard;
-    SessionEvent records[MAX_SESSION_EVENTS];
-    int recordCount;
+    SessionLog log;
     int withdrawalCount;
 
     SessionState();
@@ -98,6 +138,8 @@ public:
     const std::string& GetSerialNumber() const;
     Bank* GetPrimaryBank() const;
     void AddAcceptedBank(Bank* bank);
+    // Accepts every bank in one update, instead of one per bank.
+    void AddAcceptedBanks(const std::vector<Bank*>& banks);
     bool SupportsBank(const Bank* bank) const;
 
     ATMBankAccess GetBankAccessMode() const;
@@ -105,10 +147,44 @@ public:
     void SetLanguage(ATMLanguage language);
     ATMLanguage GetActiveLanguage() const;
 
+    // Stream for customer-facing messages; defaults to std::cout.
+    void SetConsole(std::ostream* console);
+    std::ostream& GetConsole() const;
+
+    // Ledger for the interbank obligations of this ATM's transactions; null
+    // (the default) records none.
+    void SetSettlement(SettlementLedger* settlement);
+    // Searchable history every transaction of this ATM is added to; null
+    // (the default) adds none.
+    void SetLedger(TransactionLedger* ledger);
+
+    // Fees and accepted banks can be replaced from any thread while the ATM
+    // serves customers; a request in flight keeps the version it started
+    // with. References returned by GetFees() and GetFeeTable() stay valid
+    // until the ATM's current session ends.
     const ATMFees& GetFees() const;
+    // Replaces the base fees and keeps the bands and overrides.
     void SetFees(const ATMFees& fees);
+    const FeeTable& GetFeeTable() const;
+    void SetFeeSchedule(const FeeSchedule& schedule);
+
+    DispenseObjective GetDispenseObjective() const;
+    void SetDispenseObjective(DispenseObjective objective);
+    // Withdrawals served from the per-ATM plan cache, and all plan lookups.
+    long long GetPlanCacheHits() const;
+    long long GetPlanCacheLookups() const;
+    // Notes dispensed per customer session, for cash forecasting.
+    const DispenseRateTracker& GetDispenseRates() const;
 
     const CashDrawer& GetCashInventory() const;
+    // Committed inventory history, for reading through a ReadView while
+    // the ATM keeps serving customers.
+    const VersionChain<CashDrawer>& GetCashVersions() const;
+    // Value of the cash put in with LoadCash, less what TryGiveCash took
+    // out, and of the checks deposited, which are kept apart from the cash.
+    // With the ledger's cash in and out these account for the drawer.
+    long long GetCashLoaded() const;
+    long long GetChecksDeposited() const;
     void LoadCash(const CashDrawer& cash);
     bool TryGiveCash(const CashDrawer& cash);
 
@@ -120,7 +196,15 @@ public:
     const SessionState& GetSessionState() const;
 
     void RecordEvent(const SessionEvent& event);
+    // Renders the receipt into this ATM's reusable buffer and hands it to
+    // out or sink in one write.
     void PrintReceipt(std::ostream& out) const;
+    void PrintReceipt(ReceiptSink& sink) const;
+    // Where this ATM's sessions send receipts; null (the default) for the
+    // session's own output. PrintReceipt does not consult it, so callers
+    // pick the destination themselves.
+    void SetReceiptSink(ReceiptSink* sink);
+    ReceiptSink* GetReceiptSink() const;
 
     void RequestDeposit(const CashDrawer& cash, long long checkAmount, const CashDrawer& feeCash, int checkCount);
     void RequestWithdrawal(long long amount);
@@ -129,23 +213,47 @@ public:
     void CheckInsertedCard();
 
     // Helper to preview the deposit fee for the current customer session.
-    long long GetDepositFeeForCurrentSession() const;
+    long long GetDepositFeeForCurrentSession(long long amount) const;
 
 private:
     std::string serialNumber_;
     Bank* primaryBank_;
-    Bank* acceptedBanks_[MAX_BANK_SLOTS];
-    int acceptedBankCount_;
+    RcuCell<AcceptedBanks> acceptedBanks_;
     ATMBankAccess accessMode_;
     bool bilingual_;
     ATMLanguage language_;
-    ATMFees fees_;
+    RcuCell<FeeTable> fees_;
+    DispenseObjective dispenseObjective_;
+    // Dispense plans keyed by (amount << CASH_TYPE_COUNT) | mask of the
+    // cassettes too low to cover that amount alone.
+    std::unordered_map<long long, CashDrawer> planCache_;
+    long long planCacheHits_;
+    long long planCacheLookups_;
+    DispenseRateTracker dispenseRates_;
     CashDrawer cashInventory_;
+    VersionChain<CashDrawer> cashVersions_;
+    long long cashLoaded_;
+    long long checksDeposited_;
     SessionState sessionInfo_;
     bool sessionActive_;
-
+    std::ostream* console_;
+    SettlementLedger* settlement_;
+    TransactionLedger* ledger_;
+    mutable ReceiptWriter receipt_;
+    ReceiptSink* receiptSink_;
+
+    void Say(const std::string& en, const std::string& kr) const;
+    // Bank the session's card is charged as: the primary bank for a session
+    // started as a primary-bank card, otherwise the account's bank.
+    const Bank* CardBank() const;
     void ClearSession();
 
+    bool PlanWithdrawal(long long amount, CashDrawer& bundle);
+    // All inventory changes go through these so cached plans stay valid.
+    void AddCash(const CashDrawer& cash);
+    void RemoveCash(const CashDrawer& cash);
+    void InvalidatePlans(unsigned changedCassettes);
+
     bool CheckSessionActive(ATMMode expectedMode) const;
 
     std::vector<Transaction*> transactions_;
@@ -154,8 +262,17 @@ private:
     int adminSessions_;
 
 public:
+    // Recorded here and in the ledger, if any. A ledger with segments keeps
+    // them instead, so GetTransactions finds nothing; ReadTransactions
+    // works either way. Searches by time go through the ledger's indexes
+    // with atmSerial set.
     void AddTransaction(Transaction* t);
     const std::vector<Transaction*>& GetTransactions() const { return transactions_; }
+    // Every transaction of this ATM in ID order: GetTransactions(), or with
+    // a segmented ledger the ledger's matches for this serial, appended to
+    // found and owned by loaded.
+    const std::vector<Transaction*>& ReadTransactions(std::vector<Transaction*>& found,
+                                                      LoadedTransactions& loaded) const;
     void IncrementCustomerSession() { ++totalSessions_; ++customerSessions_; }
     void IncrementAdminSession() { ++totalSessions_; ++adminSessions_; }
     int GetTotalSessions() const { return totalSessions_; }
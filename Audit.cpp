@@ -0,0 +1,477 @@
+#include "Audit.hpp"
+
+#include <algorithm>
+#include <string>
+
+namespace {
+
+const unsigned char LEAF_PREFIX = 0x00;
+const unsigned char NODE_PREFIX = 0x01;
+const unsigned char BLOCK_PREFIX = 0x02;
+const std::uint32_t ABSENT_STRING = 0xFFFFFFFF;
+
+void PutU64(std::string& out, std::uint64_t value) {
+    for (int i = 0; i < 8; ++i) {
+        out.push_back(static_cast<char>(value >> (8 * i)));
+    }
+}
+
+void PutU32(std::string& out, std::uint32_t value) {
+    for (int i = 0; i < 4; ++i) {
+        out.push_back(static_cast<char>(value >> (8 * i)));
+    }
+}
+
+void PutString(std::string& out, const std::string* text) {
+    if (text == nullptr) {
+        PutU32(out, ABSENT_STRING);
+        return;
+    }
+    PutU32(out, static_cast<std::uint32_t>(text->size()));
+    out += *text;
+}
+
+void PutDigest(std::string& out, const Sha256Digest& digest) {
+    out.append(reinterpret_cast<const char*>(digest.bytes), sizeof(digest.bytes));
+}
+
+Sha256Digest HashBytes(const std::string& bytes) {
+    Sha256 hash;
+    hash.Update(bytes.data(), bytes.size());
+    return hash.Finish();
+}
+
+Sha256Digest HashNode(const Sha256Digest& left, const Sha256Digest& right) {
+    Sha256 hash;
+    hash.Update(&NODE_PREFIX, 1);
+    hash.Update(left.bytes, sizeof(left.bytes));
+    hash.Update(right.bytes, sizeof(right.bytes));
+    return hash.Finish();
+}
+
+// Leaves in the left subtree of a tree of size > 1 leaves.
+std::size_t SplitPoint(std::size_t size) {
+    std::size_t split = 1;
+    while (split * 2 < size) {
+        split *= 2;
+    }
+    return split;
+}
+
+Sha256Digest RootOf(const Sha256Digest* leaves, std::size_t size) {
+    if (size == 0) {
+        return Sha256().Finish();
+    }
+    if (size == 1) {
+        return leaves[0];
+    }
+    std::size_t split = SplitPoint(size);
+    return HashNode(RootOf(leaves, split), RootOf(leaves + split, size - split));
+}
+
+// Appends the siblings needed for [begin, end) of the size leaves, deepest
+// first on each side, and returns the root; RebuildRoot reads the siblings
+// back in the same order.
+Sha256Digest CollectRangePath(const Sha256Digest* leaves,
+                              std::size_t size,
+                              std::size_t begin,
+                              std::size_t end,
+                              std::vector<Sha256Digest>& path) {
+    if (begin == 0 && end == size) {
+        return RootOf(leaves, size);
+    }
+    std::size_t split = SplitPoint(size);
+    Sha256Digest left;
+    Sha256Digest right;
+    if (end <= split) {
+        left = CollectRangePath(leaves, split, begin, end, path);
+        right = RootOf(leaves + split, size - split);
+        path.push_back(right);
+    } else if (begin >= split) {
+        left = RootOf(leaves, split);
+        path.push_back(left);
+        right = CollectRangePath(leaves + split, size - split, begin - split, end - split, path);
+    } else {
+        left = CollectRangePath(leaves, split, begin, split, path);
+        right = CollectRangePath(leaves + split, size - split, 0, end - split, path);
+    }
+    return HashNode(left, right);
+}
+
+struct RangeCursor {
+    const Sha256Digest* leaf;
+    const Sha256Digest* path;
+    const Sha256Digest* pathEnd;
+};
+
+bool RebuildRoot(std::size_t size, std::size_t begin, std::size_t end, RangeCursor& cursor, Sha256Digest& root) {
+    if (begin == 0 && end == size) {
+        root = RootOf(cursor.leaf, size);
+        cursor.leaf += size;
+        return true;
+    }
+    std::size_t split = SplitPoint(size);
+    Sha256Digest left;
+    Sha256Digest right;
+    if (end <= split) {
+        if (!RebuildRoot(split, begin, end, cursor, left) || cursor.path == cursor.pathEnd) {
+            return false;
+        }
+        right = *cursor.path++;
+    } else if (begin >= split) {
+        if (cursor.path == cursor.pathEnd) {
+            return false;
+        }
+        left = *cursor.path++;
+        if (!RebuildRoot(size - split, begin - split, end - split, cursor, right)) {
+            return false;
+        }
+    } else if (!RebuildRoot(split, begin, split, cursor, left) ||
+               !RebuildRoot(size - split, 0, end - split, cursor, right)) {
+        return false;
+    }
+    root = HashNode(left, right);
+    return true;
+}
+
+// Levels up from the leaves to the node over size leaves: the smallest
+// level whose nodes span that many.
+std::size_t LevelSpanning(std::size_t size) {
+    std::size_t level = 0;
+    while ((static_cast<std::size_t>(1) << level) < size) {
+        ++level;
+    }
+    return level;
+}
+
+// CollectRangePath over kept levels. Every subtree the recursion visits
+// starts at a multiple of its level's span, so it is one kept node.
+bool CollectKeptPath(const MerkleNodeReader& read,
+                     std::size_t offset,
+                     std::size_t size,
+                     std::size_t begin,
+                     std::size_t end,
+                     std::vector<Sha256Digest>& path,
+                     Sha256Digest& root) {
+    if (begin == 0 && end == size) {
+        const std::size_t level = LevelSpanning(size);
+        return read(level, offset >> level, root);
+    }
+    std::size_t split = SplitPoint(size);
+    Sha256Digest left;
+    Sha256Digest right;
+    if (end <= split) {
+        if (!CollectKeptPath(read, offset, split, begin, end, path, left) ||
+            !CollectKeptPath(read, offset + split, size - split, 0, size - split, path, right)) {
+            return false;
+        }
+        path.push_back(right);
+    } else if (begin >= split) {
+        if (!CollectKeptPath(read, offset, split, 0, split, path, left)) {
+            return false;
+        }
+        path.push_back(left);
+        if (!CollectKeptPath(read, offset + split, size - split, begin - split, end - split, path, right)) {
+            return false;
+        }
+    } else if (!CollectKeptPath(read, offset, split, begin, split, path, left) ||
+               !CollectKeptPath(read, offset + split, size - split, 0, end - split, path, right)) {
+        return false;
+    }
+    root = HashNode(left, right);
+    return true;
+}
+
+} // namespace
+
+Sha256Digest HashTransaction(const Transaction& transaction) {
+    const TransferTarget* target = transaction.getTarget();
+
+    std::string bytes;
+    bytes.reserve(128);
+    bytes.push_back(static_cast<char>(LEAF_PREFIX));
+    PutU64(bytes, static_cast<std::uint64_t>(transaction.getId()));
+    bytes.push_back(static_cast<char>(transaction.getKind()));
+    PutU64(bytes, static_cast<std::uint64_t>(transaction.getTime().wallMicros));
+    PutU64(bytes, static_cast<std::uint64_t>(transaction.getTime().monotonicNanos));
+    PutU64(bytes, static_cast<std::uint64_t>(transaction.getAmount()));
+    PutU64(bytes, static_cast<std::uint64_t>(transaction.getFee()));
+    PutString(bytes, &transaction.getAtmSerial());
+    PutString(bytes, &transaction.getCardNumber());
+    PutString(bytes, &transaction.getSourceBankName());
+    PutString(bytes, &transaction.getSourceAccountNumber());
+    PutString(bytes, target != nullptr ? &target->bankName : nullptr);
+    PutString(bytes, target != nullptr ? &target->accountNumber : nullptr);
+    PutString(bytes, &transaction.getNote());
+    return HashBytes(bytes);
+}
+
+bool AuditOrder(const Transaction* a, const Transaction* b) {
+    if (a->getTime().wallMicros != b->getTime().wallMicros) {
+        return a->getTime().wallMicros < b->getTime().wallMicros;
+    }
+    return a->getId() < b->getId();
+}
+
+bool AuditOrder(const AuditLeaf& a, const AuditLeaf& b) {
+    if (a.wallMicros != b.wallMicros) {
+        return a.wallMicros < b.wallMicros;
+    }
+    return a.id < b.id;
+}
+
+Sha256Digest MerkleRoot(const std::vector<Sha256Digest>& leaves) {
+    return RootOf(leaves.data(), leaves.size());
+}
+
+std::vector<Sha256Digest> MerkleRangeProof(const std::vector<Sha256Digest>& leaves,
+                                           std::size_t begin,
+                                           std::size_t end,
+                                           Sha256Digest& root) {
+    std::vector<Sha256Digest> path;
+    if (begin < end && end <= leaves.size()) {
+        root = CollectRangePath(leaves.data(), leaves.size(), begin, end, path);
+    } else {
+        root = MerkleRoot(leaves);
+    }
+    return path;
+}
+
+bool MerkleRootFromRange(std::size_t size,
+                         std::size_t begin,
+                         const std::vector<Sha256Digest>& rangeLeaves,
+                         const std::vector<Sha256Digest>& proof,
+                         Sha256Digest& root) {
+    if (rangeLeaves.empty() || begin >= size || rangeLeaves.size() > size - begin) {
+        return false;
+    }
+    RangeCursor cursor = {rangeLeaves.data(), proof.data(), proof.data() + proof.size()};
+    // Every proof entry must be used; a longer proof is a different shape.
+    return RebuildRoot(size, begin, begin + rangeLeaves.size(), cursor, root) && cursor.path == cursor.pathEnd;
+}
+
+std::vector<Sha256Digest> MerkleLevels(const std::vector<Sha256Digest>& leaves) {
+    std::vector<Sha256Digest> nodes;
+    nodes.reserve(MerkleLevelOffset(leaves.size(), MerkleLevelCount(leaves.size())));
+    nodes.assign(leaves.begin(), leaves.end());
+    std::size_t begin = 0;
+    for (std::size_t size = leaves.size(); size > 1; size = (size + 1) / 2) {
+        for (std::size_t i = 0; i + 1 < size; i += 2) {
+            nodes.push_back(HashNode(nodes[begin + i], nodes[begin + i + 1]));
+        }
+        if (size % 2 != 0) {
+            nodes.push_back(nodes[begin + size - 1]);
+        }
+        begin += size;
+    }
+    return nodes;
+}
+
+std::size_t MerkleLevelCount(std::size_t size) {
+    return size == 0 ? 0 : LevelSpanning(size) + 1;
+}
+
+std::size_t MerkleLevelOffset(std::size_t size, std::size_t level) {
+    std::size_t offset = 0;
+    for (std::size_t below = 0; below < level; ++below) {
+        offset += size;
+        size = (size + 1) / 2;
+    }
+    return offset;
+}
+
+bool MerkleRangeProofFromLevels(std::size_t size,
+                                std::size_t begin,
+                                std::size_t end,
+                                const MerkleNodeReader& read,
+                                std::vector<Sha256Digest>& proof,
+                                Sha256Digest& root) {
+    proof.clear();
+    if (size == 0 || begin >= end || end > size) {
+        return false;
+    }
+    return CollectKeptPath(read, 0, size, begin, end, proof, root);
+}
+
+MerkleFrontier::MerkleFrontier()
+    : subtrees_(),
+      size_(0) {
+}
+
+void MerkleFrontier::Append(const Sha256Digest& leaf) {
+    Subtree subtree = {leaf, 1};
+    while (!subtrees_.empty() && subtrees_.back().size == subtree.size) {
+        subtree.root = HashNode(subtrees_.back().root, subtree.root);
+        subtree.size *= 2;
+        subtrees_.pop_back();
+    }
+    subtrees_.push_back(subtree);
+    ++size_;
+}
+
+Sha256Digest MerkleFrontier::Root() const {
+    if (subtrees_.empty()) {
+        return Sha256().Finish();
+    }
+    // Each subtree is the left half of everything to its right.
+    Sha256Digest root = subtrees_.back().root;
+    for (std::size_t i = subtrees_.size() - 1; i > 0; --i) {
+        root = HashNode(subtrees_[i - 1].root, root);
+    }
+    return root;
+}
+
+std::uint64_t MerkleFrontier::Size() const {
+    return size_;
+}
+
+AuditBlock::AuditBlock()
+    : number(0),
+      count(0),
+      firstId(0),
+      lastId(0),
+      minTime(0),
+      maxTime(0),
+      root(),
+      previous(),
+      hash() {
+}
+
+bool BlockOverlaps(const AuditBlock& block, long long fromMicros, long long toMicros) {
+    return block.count > 0 && block.minTime < toMicros && block.maxTime >= fromMicros;
+}
+
+Sha256Digest ComputeBlockHash(const AuditBlock& block) {
+    std::string bytes;
+    bytes.reserve(1 + 6 * 8 + 2 * sizeof(block.root.bytes));
+    bytes.push_back(static_cast<char>(BLOCK_PREFIX));
+    PutU64(bytes, block.number);
+    PutU64(bytes, block.count);
+    PutU64(bytes, static_cast<std::uint64_t>(block.firstId));
+    PutU64(bytes, static_cast<std::uint64_t>(block.lastId));
+    PutU64(bytes, static_cast<std::uint64_t>(block.minTime));
+    PutU64(bytes, static_cast<std::uint64_t>(block.maxTime));
+    PutDigest(bytes, block.root);
+    PutDigest(bytes, block.previous);
+    return HashBytes(bytes);
+}
+
+AuditBlock MakeAuditBlock(const std::vector<AuditLeaf>& leaves,
+                          const Sha256Digest& root,
+                          const AuditBlock* previous) {
+    AuditBlock block;
+    block.number = previous != nullptr ? previous->number + 1 : 0;
+    block.count = leaves.size();
+    if (!leaves.empty()) {
+        block.firstId = leaves.front().id;
+        block.lastId = block.firstId;
+        for (const AuditLeaf& leaf : leaves) {
+            block.firstId = std::min(block.firstId, leaf.id);
+            block.lastId = std::max(block.lastId, leaf.id);
+        }
+        block.minTime = leaves.front().wallMicros;
+        block.maxTime = leaves.back().wallMicros;
+    }
+    block.root = root;
+    if (previous != nullptr) {
+        block.previous = previous->hash;
+    }
+    block.hash = ComputeBlockHash(block);
+    return block;
+}
+
+TransactionProof::TransactionProof()
+    : block(),
+      leaf(0),
+      blockPath(),
+      blockCount(0),
+      ledgerPath() {
+}
+
+bool VerifyTransactionProof(const Transaction& transaction,
+                            const TransactionProof& proof,
+                            const Sha256Digest& ledgerRoot) {
+    Sha256Digest blockRoot;
+    Sha256Digest ledger;
+    return MerkleRootFromRange(proof.block.count, proof.leaf, {HashTransaction(transaction)}, proof.blockPath,
+                               blockRoot) &&
+           blockRoot == proof.block.root && ComputeBlockHash(proof.block) == proof.block.hash &&
+           MerkleRootFromRange(proof.blockCount, proof.block.number, {proof.block.hash}, proof.ledgerPath,
+                               ledger) &&
+           ledger == ledgerRoot;
+}
+
+BlockRangeProof::BlockRangeProof()
+    : block(0),
+      begin(0),
+      transactions(),
+      path() {
+}
+
+TimeRangeProof::TimeRangeProof()
+    : fromMicros(0),
+      toMicros(0),
+      blocks(),
+      ranges(),
+      loaded() {
+}
+
+bool VerifyTimeRangeProof(const TimeRangeProof& proof,
+                          const Sha256Digest& ledgerRoot,
+                          std::vector<const Transaction*>& inRange) {
+    inRange.clear();
+    std::vector<Sha256Digest> hashes;
+    hashes.reserve(proof.blocks.size());
+    for (std::size_t i = 0; i < proof.blocks.size(); ++i) {
+        const AuditBlock& block = proof.blocks[i];
+        const Sha256Digest previous = i > 0 ? proof.blocks[i - 1].hash : Sha256Digest();
+        if (block.number != i || block.previous != previous || ComputeBlockHash(block) != block.hash) {
+            return false;
+        }
+        hashes.push_back(block.hash);
+    }
+    if (MerkleRoot(hashes) != ledgerRoot) {
+        return false;
+    }
+
+    std::size_t next = 0;
+    for (const AuditBlock& block : proof.blocks) {
+        if (!BlockOverlaps(block, proof.fromMicros, proof.toMicros)) {
+            continue;
+        }
+        if (next == proof.ranges.size() || proof.ranges[next].block != block.number) {
+            return false;
+        }
+        const BlockRangeProof& range = proof.ranges[next++];
+        const std::vector<Transaction*>& transactions = range.transactions;
+        if (transactions.empty() || range.begin >= block.count ||
+            transactions.size() > block.count - range.begin) {
+            return false;
+        }
+        std::vector<Sha256Digest> leaves;
+        leaves.reserve(transactions.size());
+        for (std::size_t i = 0; i < transactions.size(); ++i) {
+            if (transactions[i] == nullptr || (i > 0 && !AuditOrder(transactions[i - 1], transactions[i]))) {
+                return false;
+            }
+            leaves.push_back(HashTransaction(*transactions[i]));
+        }
+        const bool startsBlock = range.begin == 0;
+        const bool endsBlock = range.begin + transactions.size() == block.count;
+        if ((!startsBlock && transactions.front()->getTime().wallMicros >= proof.fromMicros) ||
+            (!endsBlock && transactions.back()->getTime().wallMicros < proof.toMicros)) {
+            return false;
+        }
+        Sha256Digest root;
+        if (!MerkleRootFromRange(block.count, range.begin, leaves, range.path, root) || root != block.root) {
+            return false;
+        }
+        for (const Transaction* transaction : transactions) {
+            long long time = transaction->getTime().wallMicros;
+            if (time >= proof.fromMicros && time < proof.toMicros) {
+                inRange.push_back(transaction);
+            }
+        }
+    }
+    return next == proof.ranges.size();
+}
@@ -0,0 +1,185 @@
+#ifndef AUDIT_HPP
+#define AUDIT_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+#include "Sha256.hpp"
+#include "Transaction.hpp"
+
+// Tamper evidence for the ledger. Transactions are closed into blocks; each
+// block is a Merkle tree over its transactions' hashes, and its header
+// chains to the header before it. A Merkle tree over the block hashes gives
+// the ledger one root, so a single transaction is proved by two
+// logarithmic paths. Trees follow RFC 6962: leaves hash 0x00 || data,
+// inner nodes 0x01 || left || right, and a tree of n leaves splits after
+// the largest power of two below n.
+
+// 0x00, then the fields little-endian with strings length-prefixed; a
+// missing transfer target has length 0xFFFFFFFF.
+Sha256Digest HashTransaction(const Transaction& transaction);
+
+// Order of the leaves within a block: wall-clock time, then ID, so any time
+// range is one run of leaves.
+bool AuditOrder(const Transaction* a, const Transaction* b);
+
+// A transaction as its block needs it once hashed: where it sorts, and its
+// leaf.
+struct AuditLeaf {
+    long long wallMicros;
+    long long id;
+    Sha256Digest hash;
+};
+
+bool AuditOrder(const AuditLeaf& a, const AuditLeaf& b);
+
+Sha256Digest MerkleRoot(const std::vector<Sha256Digest>& leaves);
+// Sibling hashes that, with leaves [begin, end), give the root of all of
+// leaves; that root goes to root, for the cost of MerkleRoot alone. A
+// single leaf's path has at most log2(n) + 1 entries.
+std::vector<Sha256Digest> MerkleRangeProof(const std::vector<Sha256Digest>& leaves,
+                                           std::size_t begin,
+                                           std::size_t end,
+                                           Sha256Digest& root);
+// Recomputes the root of a tree of size leaves from rangeLeaves, which sit
+// at begin, and proof. False if the proof does not fit the shape.
+bool MerkleRootFromRange(std::size_t size,
+                         std::size_t begin,
+                         const std::vector<Sha256Digest>& rangeLeaves,
+                         const std::vector<Sha256Digest>& proof,
+                         Sha256Digest& root);
+
+// Every level of the tree over leaves, leaves first, back to back. Each
+// level pairs the nodes of the one below and moves an unpaired last node up
+// as it is, which gives the same tree as above with its inner nodes kept.
+std::vector<Sha256Digest> MerkleLevels(const std::vector<Sha256Digest>& leaves);
+// Levels in MerkleLevels' output for a tree of size leaves, and where one
+// of them starts; MerkleLevelOffset(size, MerkleLevelCount(size)) is the
+// node count.
+std::size_t MerkleLevelCount(std::size_t size);
+std::size_t MerkleLevelOffset(std::size_t size, std::size_t level);
+
+// Reads node index of level (the leaves are level 0) from kept levels; false
+// if it can't be read.
+typedef std::function<bool(std::size_t level, std::size_t index, Sha256Digest& node)> MerkleNodeReader;
+
+// MerkleRangeProof for a tree of size leaves whose levels were kept: it
+// reads about two nodes per level instead of hashing the tree, and hashes
+// only to recompute root. False if a node could not be read.
+bool MerkleRangeProofFromLevels(std::size_t size,
+                                std::size_t begin,
+                                std::size_t end,
+                                const MerkleNodeReader& read,
+                                std::vector<Sha256Digest>& proof,
+                                Sha256Digest& root);
+
+// The right edge of a Merkle tree being appended to: one root per perfect
+// subtree, so Append and Root cost O(log n) hashes.
+class MerkleFrontier {
+public:
+    MerkleFrontier();
+
+    void Append(const Sha256Digest& leaf);
+    // The empty tree's root is the hash of nothing.
+    Sha256Digest Root() const;
+    std::uint64_t Size() const;
+
+private:
+    struct Subtree {
+        Sha256Digest root;
+        std::uint64_t size;
+    };
+
+    std::vector<Subtree> subtrees_;
+    std::uint64_t size_;
+};
+
+struct AuditBlock {
+    // From 0, in closing order.
+    std::uint64_t number;
+    std::uint64_t count;
+    long long firstId;
+    long long lastId;
+    // Wall-clock microseconds of the first and last leaf.
+    long long minTime;
+    long long maxTime;
+    // Merkle root of the block's transactions in AuditOrder.
+    Sha256Digest root;
+    // Hash of the block before; all zero for the first.
+    Sha256Digest previous;
+    Sha256Digest hash;
+
+    AuditBlock();
+};
+
+// Whether the block's time span meets [fromMicros, toMicros).
+bool BlockOverlaps(const AuditBlock& block, long long fromMicros, long long toMicros);
+// 0x02, then every field above but hash.
+Sha256Digest ComputeBlockHash(const AuditBlock& block);
+// Closes leaves, which must be in AuditOrder and have the given Merkle
+// root, into the block after previous (nullptr for the first).
+AuditBlock MakeAuditBlock(const std::vector<AuditLeaf>& leaves,
+                          const Sha256Digest& root,
+                          const AuditBlock* previous);
+
+enum AuditStatus {
+    AuditStatus_Proved,
+    AuditStatus_NotFound,
+    // Known to the ledger but not closed into a block yet.
+    AuditStatus_Open,
+    // A block's transactions no longer hash to its root.
+    AuditStatus_Tampered,
+    AuditStatus_Unreadable
+};
+
+// Ties one transaction to a ledger root.
+struct TransactionProof {
+    AuditBlock block;
+    std::uint64_t leaf;
+    std::vector<Sha256Digest> blockPath;
+    // Blocks under the ledger root.
+    std::uint64_t blockCount;
+    std::vector<Sha256Digest> ledgerPath;
+
+    TransactionProof();
+};
+
+bool VerifyTransactionProof(const Transaction& transaction,
+                            const TransactionProof& proof,
+                            const Sha256Digest& ledgerRoot);
+
+// A contiguous run of one block's leaves. Unless the run starts the block
+// its first transaction is before the range, and unless it ends the block
+// its last is at or after the range's end, which shows nothing in the
+// range was left out.
+struct BlockRangeProof {
+    std::uint64_t block;
+    std::uint64_t begin;
+    std::vector<Transaction*> transactions;
+    std::vector<Sha256Digest> path;
+
+    BlockRangeProof();
+};
+
+// Every transaction with a wall-clock time in [fromMicros, toMicros).
+// Carries every block header, so the verifier can check the chain and tell
+// which blocks overlap the range, and one run per overlapping block.
+struct TimeRangeProof {
+    long long fromMicros;
+    long long toMicros;
+    std::vector<AuditBlock> blocks;
+    std::vector<BlockRangeProof> ranges;
+    // Owns the transactions read back from segments.
+    LoadedTransactions loaded;
+
+    TimeRangeProof();
+};
+
+// Fills inRange, in AuditOrder block by block, when the proof holds.
+bool VerifyTimeRangeProof(const TimeRangeProof& proof,
+                          const Sha256Digest& ledgerRoot,
+                          std::vector<const Transaction*>& inRange);
+
+#endif // AUDIT_HPP
@@ -1,21 +1,36 @@
 #include "Bank.hpp"
 
+#include <mutex>
+
 #include "Account.hpp"
 #include "Card.hpp"
 #include "Transaction.hpp"
 
+namespace {
+
+// Every bank appends to the one system-wide transaction list.
+std::mutex g_transactionLogMutex;
+
+} // namespace
+
 Bank::Bank(const std::string& bankName,
            const std::string& bankId,
            std::vector<Bank*>* allBanks,
            std::vector<Transaction*>* transactions)
     : bankName_(bankName),
       bankID_(bankId),
+      index_(allBanks != 0 ? allBanks->size() : 0),
       accounts_(),
       cards_(),
+      accountsByNumber_(),
+      accountsByCard_(),
       allBanks_(allBanks),
       transactions_(transactions),
       adminCard_(0),
       adminPassword_() {
+    if (allBanks_ != 0) {
+        allBanks_->push_back(this);
+    }
 }
 
 Bank::~Bank() {
@@ -33,6 +48,10 @@ const std::string& Bank::getBankID() const {
     return bankID_;
 }
 
+std::size_t Bank::getIndex() const {
+    return index_;
+}
+
 const std::vector<Account*>& Bank::getAccounts() const {
     return accounts_;
 }
@@ -46,11 +65,8 @@ void Bank::addAccount(Account* account) {
         return;
     }
 
-    for (const Account* existing : accounts_) {
-        if (existing != nullptr &&
-            existing->getAccountNumber() == account->getAccountNumber()) {
-            return;
-        }
+    if (!accountsByNumber_.emplace(account->getAccountNumber(), account).second) {
+        return;
     }
 
     accounts_.push_back(account);
@@ -60,38 +76,19 @@ void Bank::addAccount(Account* account) {
         return;
     }
 
-    bool found = false;
-    for (std::size_t i = 0; i < cards_.size(); ++i) {
-        if (cards_[i] == linkedCard) {
-            found = true;
-            break;
-        }
-    }
-    if (!found) {
+    if (accountsByCard_.emplace(linkedCard->getNumber(), account).second) {
         cards_.push_back(linkedCard);
     }
 }
 
 Account* Bank::findAccountByAccountNumber(const std::string& accountNumber) const {
-    for (Account* account : accounts_) {
-        if (account != nullptr && account->getAccountNumber() == accountNumber) {
-            return account;
-        }
-    }
-    return nullptr;
+    auto it = accountsByNumber_.find(accountNumber);
+    return it != accountsByNumber_.end() ? it->second : nullptr;
 }
 
 Account* Bank::findAccountByCardNumber(const std::string& cardNumber) const {
-    for (Account* account : accounts_) {
-        if (account == nullptr) {
-            continue;
-        }
-        Card* card = account->getLinkedCard();
-        if (card != nullptr && card->getNumber() == cardNumber) {
-            return account;
-        }
-    }
-    return nullptr;
+    auto it = accountsByCard_.find(cardNumber);
+    return it != accountsByCard_.end() ? it->second : nullptr;
 }
 
 void Bank::setAdminCard(const std::string& cardNumber, const std::string& password) {
@@ -141,9 +138,14 @@ void Bank::addTransaction(Transaction* transaction) {
     if (transaction == nullptr || transactions_ == nullptr) {
         return;
     }
+    std::lock_guard<std::mutex> lock(g_transactionLogMutex);
     transactions_->push_back(transaction);
 }
 
+void Bank::setTransactionLog(std::vector<Transaction*>* transactions) {
+    transactions_ = transactions;
+}
+
 void Bank::setAllBanks(std::vector<Bank*>* allBanks) {
     allBanks_ = allBanks;
 }
@@ -177,10 +179,5 @@ bool Bank::transfer(Account* fromAccount,
     if (amount <= 0 || fee < 0) {
         return false;
     }
-    const long long totalCost = amount + fee;
-    if (!fromAccount->withdraw(totalCost)) {
-        return false;
-    }
-    toAccount->deposit(amount);
-    return true;
+    return fromAccount->transferTo(toAccount, amount + fee, amount);
 }
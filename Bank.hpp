@@ -1,7 +1,9 @@
 #ifndef BANK_HPP
 #define BANK_HPP
 
+#include <cstddef>
 #include <string>
+#include <unordered_map>
 #include <vector>
 
 class Account;
@@ -10,6 +12,7 @@ class Transaction;
 
 class Bank {
 public:
+    // Appends itself to allBanks, so getIndex() is its position there.
     Bank(const std::string& bankName,
          const std::string& bankId,
          std::vector<Bank*>* allBanks,
@@ -19,6 +22,9 @@ public:
 
     const std::string& getBankName() const;
     const std::string& getBankID() const;
+    // Dense 0-based position in allBanks, fixed at construction; 0 for a
+    // bank created without a list.
+    std::size_t getIndex() const;
     const std::vector<Account*>& getAccounts() const;
     const std::vector<Card*>& getCards() const;
 
@@ -34,6 +40,8 @@ public:
                                 const std::string& password) const;
 
     void addTransaction(Transaction* transaction);
+    // Where addTransaction logs to; null stops logging.
+    void setTransactionLog(std::vector<Transaction*>* transactions);
     void setAllBanks(std::vector<Bank*>* allBanks);
     std::vector<Bank*>* getAllBanks() const;
 
@@ -50,8 +58,12 @@ private:
 
     std::string bankName_;
     std::string bankID_;
+    std::size_t index_;
     std::vector<Account*> accounts_;
     std::vector<Card*> cards_;
+    // Lookup indexes over accounts_, keyed by account number and linked card number.
+    std::unordered_map<std::string, Account*> accountsByNumber_;
+    std::unordered_map<std::string, Account*> accountsByCard_;
     std::vector<Bank*>* allBanks_;
     std::vector<Transaction*>* transactions_;
     Card* adminCard_;
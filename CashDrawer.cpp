@@ -0,0 +1,63 @@
+#include "CashDrawer.hpp"
+
+DynamicCashDrawer::DynamicCashDrawer(const std::vector<int>& values)
+    : noteValues(values),
+      noteCounts(values.size(), 0) {
+}
+
+int DynamicCashDrawer::Count() const {
+    return static_cast<int>(noteValues.size());
+}
+
+long long DynamicCashDrawer::TotalValue() const {
+    long long total = 0;
+    for (std::size_t i = 0; i < noteCounts.size(); ++i) {
+        total += static_cast<long long>(noteCounts[i]) * noteValues[i];
+    }
+    return total;
+}
+
+int DynamicCashDrawer::ItemCount() const {
+    int total = 0;
+    for (int count : noteCounts) {
+        total += count;
+    }
+    return total;
+}
+
+void DynamicCashDrawer::Add(const DynamicCashDrawer& other) {
+    for (std::size_t i = 0; i < noteCounts.size(); ++i) {
+        noteCounts[i] += other.noteCounts[i];
+    }
+}
+
+bool DynamicCashDrawer::HasEnoughBills(const DynamicCashDrawer& requested) const {
+    for (std::size_t i = 0; i < noteCounts.size(); ++i) {
+        if (requested.noteCounts[i] > noteCounts[i]) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void DynamicCashDrawer::Remove(const DynamicCashDrawer& requested) {
+    if (!HasEnoughBills(requested)) {
+        return;
+    }
+
+    for (std::size_t i = 0; i < noteCounts.size(); ++i) {
+        noteCounts[i] -= requested.noteCounts[i];
+    }
+}
+
+std::string FormatNoteValue(int value) {
+    std::string digits = std::to_string(value);
+    std::string formatted;
+    for (std::size_t i = 0; i < digits.size(); ++i) {
+        if (i > 0 && (digits.size() - i) % 3 == 0) {
+            formatted += ',';
+        }
+        formatted += digits[i];
+    }
+    return formatted;
+}
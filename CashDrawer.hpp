@@ -0,0 +1,228 @@
+#ifndef CASH_DRAWER_HPP
+#define CASH_DRAWER_HPP
+
+#include <cstddef>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+// Note values the ATM is built for, smallest first. Markets with another
+// note set override it at build time, e.g.
+//   g++ -DATM_DENOMINATIONS="1000,5000,10000,20000,50000" ...
+#ifndef ATM_DENOMINATIONS
+#define ATM_DENOMINATIONS 1000, 5000, 10000, 50000
+#endif
+
+// A note set fixed at compile time, smallest value first.
+template <int... NoteValues>
+struct DenominationSet {
+    static const int Count = sizeof...(NoteValues);
+
+    static constexpr int Value(int index) {
+        const int values[] = {NoteValues...};
+        return values[index];
+    }
+
+    // The same values as an array, for code that walks them at run time.
+    static const int* Values() {
+        static const int values[] = {NoteValues...};
+        return values;
+    }
+
+    // Every amount a bundle can form is a multiple of the unit.
+    static constexpr int Unit() {
+        const int values[] = {NoteValues...};
+        int unit = 0;
+        for (int i = 0; i < Count; ++i) {
+            int a = values[i];
+            int b = unit;
+            while (b != 0) {
+                int r = a % b;
+                a = b;
+                b = r;
+            }
+            unit = a;
+        }
+        return unit;
+    }
+
+    // When every value divides the next, the greedy bundle is also the one
+    // with the fewest notes.
+    static constexpr bool IsDivisibilityChain() {
+        const int values[] = {NoteValues...};
+        for (int i = 1; i < Count; ++i) {
+            if (values[i] % values[i - 1] != 0) {
+                return false;
+            }
+        }
+        return true;
+    }
+};
+
+template <int... NoteValues>
+const int DenominationSet<NoteValues...>::Count;
+
+typedef DenominationSet<ATM_DENOMINATIONS> ActiveDenominations;
+
+// Note counts per denomination of Set. Every operation is expanded per slot
+// at compile time with the note values as constants, so there is no loop
+// or table lookup on the hot withdrawal and deposit paths.
+template <typename Set>
+struct BasicCashDrawer {
+    typedef Set Denominations;
+
+    int noteCounts[Set::Count];
+
+    BasicCashDrawer() : noteCounts() {}
+
+    long long TotalValue() const {
+        return TotalValue(std::make_index_sequence<Set::Count>());
+    }
+
+    int ItemCount() const {
+        return ItemCount(std::make_index_sequence<Set::Count>());
+    }
+
+    void Add(const BasicCashDrawer& other) {
+        Add(other, std::make_index_sequence<Set::Count>());
+    }
+
+    bool HasEnoughBills(const BasicCashDrawer& requested) const {
+        return HasEnoughBills(requested, std::make_index_sequence<Set::Count>());
+    }
+
+    // Does nothing unless every requested note is present.
+    void Remove(const BasicCashDrawer& requested) {
+        if (!HasEnoughBills(requested)) {
+            return;
+        }
+        Remove(requested, std::make_index_sequence<Set::Count>());
+    }
+
+private:
+    // Each helper expands its pack into an array initializer, which runs the
+    // per-slot expressions in order.
+    template <std::size_t... I>
+    long long TotalValue(std::index_sequence<I...>) const {
+        long long total = 0;
+        int expand[] = {0, (total += static_cast<long long>(noteCounts[I]) *
+                                     std::integral_constant<int, Set::Value(I)>::value,
+                            0)...};
+        (void)expand;
+        return total;
+    }
+
+    template <std::size_t... I>
+    int ItemCount(std::index_sequence<I...>) const {
+        int total = 0;
+        int expand[] = {0, (total += noteCounts[I], 0)...};
+        (void)expand;
+        return total;
+    }
+
+    template <std::size_t... I>
+    void Add(const BasicCashDrawer& other, std::index_sequence<I...>) {
+        int expand[] = {0, (noteCounts[I] += other.noteCounts[I], 0)...};
+        (void)expand;
+    }
+
+    template <std::size_t... I>
+    bool HasEnoughBills(const BasicCashDrawer& requested, std::index_sequence<I...>) const {
+        bool enough = true;
+        int expand[] = {0, (enough = enough && requested.noteCounts[I] <= noteCounts[I], 0)...};
+        (void)expand;
+        return enough;
+    }
+
+    template <std::size_t... I>
+    void Remove(const BasicCashDrawer& requested, std::index_sequence<I...>) {
+        int expand[] = {0, (noteCounts[I] -= requested.noteCounts[I], 0)...};
+        (void)expand;
+    }
+};
+
+typedef BasicCashDrawer<ActiveDenominations> CashDrawer;
+
+// Counterpart of BasicCashDrawer for a note set only known at run time, for
+// example read from a configuration file. Same operations, plain loops.
+// Both drawers in a binary operation must use the same note set.
+struct DynamicCashDrawer {
+    // Note values, smallest first.
+    std::vector<int> noteValues;
+    std::vector<int> noteCounts;
+
+    explicit DynamicCashDrawer(const std::vector<int>& values);
+
+    int Count() const;
+    long long TotalValue() const;
+    int ItemCount() const;
+    void Add(const DynamicCashDrawer& other);
+    bool HasEnoughBills(const DynamicCashDrawer& requested) const;
+    void Remove(const DynamicCashDrawer& requested);
+};
+
+// Formats a note value with thousands separators, e.g. 50000 -> "50,000".
+std::string FormatNoteValue(int value);
+
+enum DispenseObjective {
+    // Fewest notes in the bundle.
+    DispenseObjective_FewestNotes,
+    // Prefer notes from well-stocked cassettes so the mix stays even.
+    DispenseObjective_Balanced
+};
+
+// Planner shared by every drawer type. values (ascending), inventory and
+// bundle each hold count entries; bundle is left empty on failure.
+// Defined in Dispense.cpp.
+bool PlanDispenseNotes(long long amount, const int* values, const int* inventory,
+                       int count, DispenseObjective objective, int* bundle);
+
+// Greedy fill from the largest note down, one expanded step per slot.
+template <typename Set, int Index>
+struct GreedyDispenseStep {
+    static void Apply(long long& remaining, const int* inventory, int* bundle) {
+        const int value = Set::Value(Index);
+        long long needed = remaining / value;
+        if (needed > inventory[Index]) {
+            needed = inventory[Index] > 0 ? inventory[Index] : 0;
+        }
+        bundle[Index] = static_cast<int>(needed);
+        remaining -= needed * value;
+        GreedyDispenseStep<Set, Index - 1>::Apply(remaining, inventory, bundle);
+    }
+};
+
+template <typename Set>
+struct GreedyDispenseStep<Set, -1> {
+    static void Apply(long long&, const int*, int*) {}
+};
+
+// Finds a bundle worth exactly amount within the inventory whenever one
+// exists and, among those, the cheapest one under the objective. Returns
+// false, with an empty bundle, if the amount cannot be formed.
+template <typename Set>
+bool PlanDispense(long long amount, const BasicCashDrawer<Set>& inventory,
+                  DispenseObjective objective, BasicCashDrawer<Set>& bundle) {
+    bundle = BasicCashDrawer<Set>();
+    if (amount < 0) {
+        return false;
+    }
+    if (objective == DispenseObjective_FewestNotes && Set::IsDivisibilityChain()) {
+        long long remaining = amount;
+        GreedyDispenseStep<Set, Set::Count - 1>::Apply(remaining, inventory.noteCounts,
+                                                       bundle.noteCounts);
+        if (remaining != 0) {
+            bundle = BasicCashDrawer<Set>();
+            return false;
+        }
+        return true;
+    }
+    return PlanDispenseNotes(amount, Set::Values(), inventory.noteCounts, Set::Count,
+                             objective, bundle.noteCounts);
+}
+
+bool PlanDispense(long long amount, const DynamicCashDrawer& inventory,
+                  DispenseObjective objective, DynamicCashDrawer& bundle);
+
+#endif // CASH_DRAWER_HPP
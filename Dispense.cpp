@@ -0,0 +1,386 @@
+#include "Atm.hpp"
+#include "CashDrawer.hpp"
+
+#include <algorithm>
+#include <cstddef>
+#include <limits>
+#include <vector>
+
+namespace {
+
+// Per-note cost under the balanced objective for a cassette that holds
+// exactly its even share of the notes; fuller cassettes cost less.
+const long long BALANCE_SCALE = 16;
+const long long NO_PLAN = std::numeric_limits<long long>::max();
+
+long long Gcd(long long a, long long b) {
+    while (b != 0) {
+        long long r = a % b;
+        a = b;
+        b = r;
+    }
+    return a;
+}
+
+// When every denomination divides the next, taking as many of the largest
+// note as fit finds a bundle whenever one exists, and it has the fewest notes.
+bool IsDivisibilityChain(const int* values, int count) {
+    for (int i = 1; i < count; ++i) {
+        if (values[i] % values[i - 1] != 0) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool PlanGreedy(long long amount, const int* values, const int* inventory, int count,
+                int* bundle) {
+    long long remaining = amount;
+    for (int i = count - 1; i >= 0; --i) {
+        long long needed = remaining / values[i];
+        if (needed > inventory[i]) {
+            needed = inventory[i] > 0 ? inventory[i] : 0;
+        }
+        bundle[i] = static_cast<int>(needed);
+        remaining -= needed * values[i];
+    }
+    return remaining == 0;
+}
+
+void NoteCosts(const int* inventory, int count, DispenseObjective objective, long long* costs) {
+    long long totalNotes = 0;
+    for (int i = 0; i < count; ++i) {
+        costs[i] = 1;
+        if (inventory[i] > 0) {
+            totalNotes += inventory[i];
+        }
+    }
+    if (objective != DispenseObjective_Balanced) {
+        return;
+    }
+    for (int i = 0; i < count; ++i) {
+        long long stock = inventory[i];
+        if (stock <= 0) {
+            continue;
+        }
+        long long evenShare = static_cast<long long>(count) * stock;
+        long long cost = (BALANCE_SCALE * totalNotes + evenShare - 1) / evenShare;
+        costs[i] = cost > 0 ? cost : 1;
+    }
+}
+
+// Cheapest bundle of the two smallest notes, of a chain, worth remaining.
+// Trading ratio small notes for one larger changes the cost by
+// costs[1] - ratio * costs[0] whatever the counts, so the best plan takes
+// as many of the larger note as the stock allows, or as few. Returns the
+// cost, or NO_PLAN.
+long long PlanSmallestPair(long long remaining, const int* values, const int* inventory,
+                           const long long* costs, int* pair) {
+    if (remaining % values[0] != 0) {
+        return NO_PLAN;
+    }
+    const long long smallNeeded = remaining / values[0];
+    const long long ratio = values[1] / values[0];
+    const long long smallStock = inventory[0] > 0 ? inventory[0] : 0;
+    const long long largeStock = inventory[1] > 0 ? inventory[1] : 0;
+    const long long most = std::min(largeStock, smallNeeded / ratio);
+    const long long least = smallNeeded > smallStock ? (smallNeeded - smallStock + ratio - 1) / ratio : 0;
+    if (least > most) {
+        return NO_PLAN;
+    }
+    const long long large = costs[1] <= ratio * costs[0] ? most : least;
+    pair[0] = static_cast<int>(smallNeeded - ratio * large);
+    pair[1] = static_cast<int>(large);
+    return costs[0] * pair[0] + costs[1] * pair[1];
+}
+
+// Rounds toward negative infinity, for counts that may go below zero.
+long long FloorDiv(long long a, long long b) {
+    return a >= 0 ? a / b : -((-a + b - 1) / b);
+}
+
+// Cheapest bundle of the three smallest notes of a chain worth remaining.
+// With q = values[2] / values[1], each note of the third kind moves both
+// bounds on the pair's larger note by exactly q, so the cost is piecewise
+// linear in that count with a kink where either bound meets the stock, and
+// the best count is an end of the feasible range or next to a kink.
+long long PlanSmallestThree(long long remaining, const int* values, const int* inventory,
+                            const long long* costs, int* three) {
+    if (remaining % values[0] != 0) {
+        return NO_PLAN;
+    }
+    const long long smallNeeded = remaining / values[0];
+    const long long ratio = values[1] / values[0];
+    const long long q = values[2] / values[1];
+    const long long smallStock = inventory[0] > 0 ? inventory[0] : 0;
+    const long long largeStock = inventory[1] > 0 ? inventory[1] : 0;
+    // Without notes of the third kind the pair's larger note is bounded by
+    // [least, most]; each one lowers both by q.
+    const long long most = smallNeeded / ratio;
+    const long long least = FloorDiv(smallNeeded - smallStock + ratio - 1, ratio);
+    long long low = least > largeStock ? FloorDiv(least - largeStock + q - 1, q) : 0;
+    long long high = std::min(most / q, remaining / values[2]);
+    if (inventory[2] < high) {
+        high = inventory[2] > 0 ? inventory[2] : 0;
+    }
+    if (low > high) {
+        return NO_PLAN;
+    }
+    const long long candidates[] = {
+        low, high, FloorDiv(most - largeStock, q), FloorDiv(most - largeStock, q) + 1, FloorDiv(least, q),
+        FloorDiv(least, q) + 1,
+    };
+    long long bestCost = NO_PLAN;
+    int pair[2];
+    for (long long notes : candidates) {
+        if (notes < low || notes > high) {
+            continue;
+        }
+        long long cost = PlanSmallestPair(remaining - notes * values[2], values, inventory, costs, pair);
+        if (cost == NO_PLAN) {
+            continue;
+        }
+        cost += notes * costs[2];
+        if (cost < bestCost) {
+            bestCost = cost;
+            three[0] = pair[0];
+            three[1] = pair[1];
+            three[2] = static_cast<int>(notes);
+        }
+    }
+    return bestCost;
+}
+
+// Depth-first search over the counts of the notes above the three smallest,
+// most first, with those solved in closed form at the bottom (the two
+// smallest when there are only two). A branch
+// is dropped once even the cheapest note per won left (cheapest[level])
+// cannot beat the best plan found.
+struct ChainSearch {
+    const int* values;
+    const int* inventory;
+    const long long* costs;
+    const int* cheapest;
+    int* current;
+    int* best;
+    int count;
+    long long bestCost;
+
+    void Search(long long remaining, int level, long long spent) {
+        if (level <= 2) {
+            long long cost = level == 2 ? PlanSmallestThree(remaining, values, inventory, costs, current)
+                                        : PlanSmallestPair(remaining, values, inventory, costs, current);
+            if (cost != NO_PLAN && spent + cost < bestCost) {
+                bestCost = spent + cost;
+                std::copy(current, current + count, best);
+            }
+            return;
+        }
+        const long long value = values[level];
+        long long most = remaining / value;
+        if (inventory[level] < most) {
+            most = inventory[level] > 0 ? inventory[level] : 0;
+        }
+        for (long long notes = most; notes >= 0; --notes) {
+            const long long left = remaining - notes * value;
+            const long long cost = spent + notes * costs[level];
+            const int rate = cheapest[level - 1];
+            // cost + left * costs[rate] / values[rate] >= bestCost
+            if (bestCost != NO_PLAN && (bestCost - cost) * values[rate] <= left * costs[rate]) {
+                continue;
+            }
+            current[level] = static_cast<int>(notes);
+            Search(left, level - 1, cost);
+        }
+    }
+};
+
+// Exact plan for a divisibility chain of two or more notes. The search
+// visits at most the product of the counts that fit of each note above the
+// three smallest (for 1k/5k/10k/50k and 500,000 won, 11), against the DP's
+// count * amount / unit steps. When that product is larger anyway, returns
+// false with searched unset.
+bool PlanChain(long long amount, const int* values, const int* inventory, int count,
+               const long long* costs, int* bundle, bool& searched) {
+    searched = false;
+    const long long dpSteps = static_cast<long long>(count) * (amount / values[0]);
+    long long combinations = 1;
+    for (int i = 3; i < count && combinations <= dpSteps; ++i) {
+        long long fit = amount / values[i];
+        if (inventory[i] < fit) {
+            fit = inventory[i] > 0 ? inventory[i] : 0;
+        }
+        combinations *= fit + 1;
+    }
+    if (combinations > dpSteps) {
+        return false;
+    }
+    searched = true;
+
+    thread_local std::vector<int> cheapest;
+    thread_local std::vector<int> current;
+    cheapest.resize(static_cast<std::size_t>(count));
+    current.assign(static_cast<std::size_t>(count), 0);
+    for (int i = 0; i < count; ++i) {
+        int pick = i;
+        if (i > 0) {
+            const int previous = cheapest[static_cast<std::size_t>(i - 1)];
+            if (costs[previous] * values[i] < costs[i] * values[previous]) {
+                pick = previous;
+            }
+        }
+        cheapest[static_cast<std::size_t>(i)] = pick;
+    }
+
+    ChainSearch search;
+    search.values = values;
+    search.inventory = inventory;
+    search.costs = costs;
+    search.cheapest = cheapest.data();
+    search.current = current.data();
+    search.best = bundle;
+    search.count = count;
+    search.bestCost = NO_PLAN;
+    search.Search(amount, count - 1, 0);
+    return search.bestCost != NO_PLAN;
+}
+
+// Bounded knapsack over amount / unit, minimizing the total note cost. Each
+// denomination is folded in with a sliding-window minimum per residue class,
+// so a plan takes O(count * amount / unit) steps.
+bool PlanExact(long long amount, const int* values, const int* inventory, int count,
+               const long long* costs, int* bundle) {
+    long long unit = 0;
+    for (int i = 0; i < count; ++i) {
+        unit = Gcd(unit, values[i]);
+    }
+    if (amount % unit != 0) {
+        return false;
+    }
+    const std::size_t target = static_cast<std::size_t>(amount / unit);
+    const std::size_t width = target + 1;
+
+    // Scratch reused across calls on the same thread.
+    thread_local std::vector<long long> best;
+    thread_local std::vector<long long> next;
+    thread_local std::vector<int> taken;
+    thread_local std::vector<std::size_t> window;
+    thread_local std::vector<long long> windowCost;
+    best.resize(width);
+    next.resize(width);
+    taken.resize(static_cast<std::size_t>(count) * width);
+    window.resize(width);
+    windowCost.resize(width);
+
+    for (int i = 0; i < count; ++i) {
+        const std::size_t step = static_cast<std::size_t>(values[i] / unit);
+        std::size_t limit = 0;
+        if (inventory[i] > 0) {
+            limit = static_cast<std::size_t>(inventory[i]);
+            if (limit > target / step) {
+                limit = target / step;
+            }
+        }
+        const long long cost = costs[i];
+        int* takenRow = &taken[static_cast<std::size_t>(i) * width];
+
+        if (i == 0) {
+            // Only the empty bundle exists before the first denomination.
+            for (std::size_t v = 0; v <= target; ++v) {
+                std::size_t count = v / step;
+                bool reachable = v % step == 0 && count <= limit;
+                best[v] = reachable ? static_cast<long long>(count) * cost : NO_PLAN;
+                takenRow[v] = reachable ? static_cast<int>(count) : 0;
+            }
+            continue;
+        }
+
+        for (std::size_t residue = 0; residue < step && residue <= target; ++residue) {
+            // window holds indices k (amount residue + k * step) whose
+            // windowCost, best[...] - k * cost, increases from head to tail.
+            std::size_t head = 0;
+            std::size_t tail = 0;
+            for (std::size_t j = 0, v = residue; v <= target; ++j, v += step) {
+                if (best[v] != NO_PLAN) {
+                    long long g = best[v] - static_cast<long long>(j) * cost;
+                    while (tail > head && windowCost[tail - 1] >= g) {
+                        --tail;
+                    }
+                    window[tail] = j;
+                    windowCost[tail] = g;
+                    ++tail;
+                }
+                while (tail > head && window[head] + limit < j) {
+                    ++head;
+                }
+                if (tail == head) {
+                    next[v] = NO_PLAN;
+                    takenRow[v] = 0;
+                    continue;
+                }
+                next[v] = windowCost[head] + static_cast<long long>(j) * cost;
+                takenRow[v] = static_cast<int>(j - window[head]);
+            }
+        }
+        best.swap(next);
+    }
+
+    if (best[target] == NO_PLAN) {
+        return false;
+    }
+    std::size_t v = target;
+    for (int i = count - 1; i >= 0; --i) {
+        int notes = taken[static_cast<std::size_t>(i) * width + v];
+        bundle[i] = notes;
+        v -= static_cast<std::size_t>(notes) * static_cast<std::size_t>(values[i] / unit);
+    }
+    return true;
+}
+
+} // namespace
+
+bool PlanDispenseNotes(long long amount, const int* values, const int* inventory,
+                       int count, DispenseObjective objective, int* bundle) {
+    for (int i = 0; i < count; ++i) {
+        bundle[i] = 0;
+    }
+    if (amount < 0 || count <= 0) {
+        return false;
+    }
+    if (amount == 0) {
+        return true;
+    }
+    bool planned = false;
+    const bool chain = IsDivisibilityChain(values, count);
+    if (chain && (objective == DispenseObjective_FewestNotes || count == 1)) {
+        planned = PlanGreedy(amount, values, inventory, count, bundle);
+    } else {
+        thread_local std::vector<long long> costs;
+        costs.resize(static_cast<std::size_t>(count));
+        NoteCosts(inventory, count, objective, costs.data());
+        bool searched = false;
+        if (chain) {
+            planned = PlanChain(amount, values, inventory, count, costs.data(), bundle, searched);
+        }
+        if (!searched) {
+            planned = PlanExact(amount, values, inventory, count, costs.data(), bundle);
+        }
+    }
+    if (!planned) {
+        for (int i = 0; i < count; ++i) {
+            bundle[i] = 0;
+        }
+    }
+    return planned;
+}
+
+bool PlanDispense(long long amount, const DynamicCashDrawer& inventory,
+                  DispenseObjective objective, DynamicCashDrawer& bundle) {
+    bundle = DynamicCashDrawer(inventory.noteValues);
+    return PlanDispenseNotes(amount, inventory.noteValues.data(), inventory.noteCounts.data(),
+                             inventory.Count(), objective, bundle.noteCounts.data());
+}
+
+bool BuildWithdrawalBundle(long long amount, const CashDrawer& inventory, CashDrawer& bundle) {
+    return PlanDispense(amount, inventory, DispenseObjective_FewestNotes, bundle);
+}
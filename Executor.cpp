@@ -0,0 +1,225 @@
+#include "Executor.hpp"
+
+#include <utility>
+
+namespace {
+
+// Tasks run by a strand before it yields its worker.
+const int STRAND_BATCH = 32;
+
+// Identifies the executor and deque of the current worker thread, so tasks
+// posted from a task go to the local deque.
+thread_local const void* t_executor = nullptr;
+thread_local std::size_t t_workerIndex = 0;
+
+} // namespace
+
+Executor::Executor(std::size_t workerCount)
+    : workers_(),
+      threads_(),
+      stateMutex_(),
+      workAvailable_(),
+      allDone_(),
+      queued_(0),
+      unfinished_(0),
+      sleepers_(0),
+      stopping_(false),
+      nextWorker_(0),
+      stolen_(0) {
+    if (workerCount == 0) {
+        workerCount = std::thread::hardware_concurrency();
+        if (workerCount == 0) {
+            workerCount = 1;
+        }
+    }
+    for (std::size_t i = 0; i < workerCount; ++i) {
+        workers_.emplace_back(new Worker());
+    }
+    threads_.reserve(workerCount);
+    for (std::size_t i = 0; i < workerCount; ++i) {
+        threads_.emplace_back(&Executor::WorkerLoop, this, i);
+    }
+}
+
+Executor::~Executor() {
+    Wait();
+    {
+        std::lock_guard<std::mutex> lock(stateMutex_);
+        stopping_ = true;
+    }
+    workAvailable_.notify_all();
+    for (std::thread& thread : threads_) {
+        thread.join();
+    }
+}
+
+void Executor::Post(std::function<void()> task) {
+    std::size_t index = 0;
+    if (t_executor == this) {
+        index = t_workerIndex;
+    } else {
+        index = nextWorker_.fetch_add(1, std::memory_order_relaxed) % workers_.size();
+    }
+    unfinished_.fetch_add(1);
+    {
+        // Counted under the deque's lock, so no worker can take the task
+        // and lower queued_ before it was raised.
+        std::lock_guard<std::mutex> lock(workers_[index]->mutex);
+        queued_.fetch_add(1);
+        workers_[index]->tasks.push_back(std::move(task));
+    }
+    if (sleepers_.load() > 0) {
+        // The sleeper either has yet to check queued_ or is waiting, so
+        // taking the lock first keeps the wakeup from slipping between.
+        std::lock_guard<std::mutex> lock(stateMutex_);
+        workAvailable_.notify_one();
+    }
+}
+
+void Executor::Wait() {
+    std::unique_lock<std::mutex> lock(stateMutex_);
+    allDone_.wait(lock, [this] { return unfinished_.load() == 0; });
+}
+
+std::size_t Executor::WorkerCount() const {
+    return workers_.size();
+}
+
+long long Executor::StolenTasks() const {
+    return stolen_.load(std::memory_order_relaxed);
+}
+
+void Executor::WorkerLoop(std::size_t index) {
+    t_executor = this;
+    t_workerIndex = index;
+    while (true) {
+        std::function<void()> task;
+        if (TakeTask(index, task)) {
+            task();
+            if (unfinished_.fetch_sub(1) == 1) {
+                std::lock_guard<std::mutex> lock(stateMutex_);
+                allDone_.notify_all();
+            }
+            continue;
+        }
+
+        // Nothing to take. queued_ can still be above zero for a moment
+        // after another worker took the last task, in which case this loops
+        // back and looks again.
+        std::unique_lock<std::mutex> lock(stateMutex_);
+        sleepers_.fetch_add(1);
+        workAvailable_.wait(lock, [this] { return stopping_ || queued_.load() > 0; });
+        sleepers_.fetch_sub(1);
+        if (stopping_ && queued_.load() == 0) {
+            return;
+        }
+    }
+}
+
+bool Executor::TakeTask(std::size_t index, std::function<void()>& task) {
+    {
+        Worker& own = *workers_[index];
+        std::lock_guard<std::mutex> lock(own.mutex);
+        if (!own.tasks.empty()) {
+            task = std::move(own.tasks.back());
+            own.tasks.pop_back();
+            queued_.fetch_sub(1);
+            return true;
+        }
+    }
+    for (std::size_t offset = 1; offset < workers_.size(); ++offset) {
+        Worker& victim = *workers_[(index + offset) % workers_.size()];
+        std::lock_guard<std::mutex> lock(victim.mutex);
+        if (!victim.tasks.empty()) {
+            task = std::move(victim.tasks.front());
+            victim.tasks.pop_front();
+            queued_.fetch_sub(1);
+            stolen_.fetch_add(1, std::memory_order_relaxed);
+            return true;
+        }
+    }
+    return false;
+}
+
+Strand::Strand(Executor* executor)
+    : executor_(executor),
+      mutex_(),
+      tasks_(),
+      scheduled_(false) {
+}
+
+void Strand::Post(std::function<void()> task) {
+    bool schedule = false;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        tasks_.push_back(std::move(task));
+        if (!scheduled_) {
+            scheduled_ = true;
+            schedule = true;
+        }
+    }
+    if (schedule) {
+        executor_->Post([this] { Drain(); });
+    }
+}
+
+void Strand::Drain() {
+    for (int i = 0; i < STRAND_BATCH; ++i) {
+        std::function<void()> task;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (tasks_.empty()) {
+                scheduled_ = false;
+                return;
+            }
+            task = std::move(tasks_.front());
+            tasks_.pop_front();
+        }
+        task();
+    }
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (tasks_.empty()) {
+        scheduled_ = false;
+        return;
+    }
+    executor_->Post([this] { Drain(); });
+}
+
+AtmStrands::AtmStrands(Executor* executor)
+    : executor_(executor),
+      mutex_(),
+      strands_() {
+}
+
+void AtmStrands::Post(ATM* atm, std::function<void()> task) {
+    StrandFor(atm).Post(std::move(task));
+}
+
+void AtmStrands::PostDeposit(ATM* atm, const CashDrawer& cash, long long checkAmount,
+                             const CashDrawer& feeCash, int checkCount) {
+    Post(atm, [atm, cash, checkAmount, feeCash, checkCount] {
+        atm->RequestDeposit(cash, checkAmount, feeCash, checkCount);
+    });
+}
+
+void AtmStrands::PostWithdrawal(ATM* atm, long long amount) {
+    Post(atm, [atm, amount] { atm->RequestWithdrawal(amount); });
+}
+
+void AtmStrands::PostAccountTransfer(ATM* atm, Account* destination, long long amount) {
+    Post(atm, [atm, destination, amount] { atm->RequestAccountTransfer(destination, amount); });
+}
+
+void AtmStrands::PostCashTransfer(ATM* atm, Account* destination, const CashDrawer& cash) {
+    Post(atm, [atm, destination, cash] { atm->RequestCashTransfer(destination, cash); });
+}
+
+Strand& AtmStrands::StrandFor(const ATM* atm) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::unique_ptr<Strand>& strand = strands_[atm];
+    if (!strand) {
+        strand.reset(new Strand(executor_));
+    }
+    return *strand;
+}
@@ -0,0 +1,116 @@
+#ifndef EXECUTOR_HPP
+#define EXECUTOR_HPP
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "Atm.hpp"
+
+class Account;
+
+// Fixed pool of worker threads, each with its own task deque. A worker runs
+// its newest task first and, when its deque is empty, steals the oldest task
+// of another worker, so a few busy ATMs cannot leave the other cores idle.
+class Executor {
+public:
+    // A workerCount of 0 starts one worker per hardware thread.
+    explicit Executor(std::size_t workerCount = 0);
+    // Runs every remaining task, then joins the workers.
+    ~Executor();
+
+    void Post(std::function<void()> task);
+    // Blocks until every posted task, including tasks posted by tasks, has run.
+    // Must not be called from a worker.
+    void Wait();
+    std::size_t WorkerCount() const;
+    long long StolenTasks() const;
+
+private:
+    Executor(const Executor&) = delete;
+    Executor& operator=(const Executor&) = delete;
+
+    struct Worker {
+        std::mutex mutex;
+        std::deque<std::function<void()>> tasks;
+    };
+
+    void WorkerLoop(std::size_t index);
+    bool TakeTask(std::size_t index, std::function<void()>& task);
+
+    std::vector<std::unique_ptr<Worker>> workers_;
+    std::vector<std::thread> threads_;
+    // Taken only to park an idle worker, to wake one, and to tell Wait()
+    // that the last task finished; posting and running a task touch just
+    // the counters below and one deque's mutex.
+    std::mutex stateMutex_;
+    std::condition_variable workAvailable_;
+    std::condition_variable allDone_;
+    // queued_ counts tasks sitting in a deque; unfinished_ counts tasks that
+    // have not completed; sleepers_ counts parked workers. A poster raises
+    // queued_ before reading sleepers_ and a worker raises sleepers_ before
+    // reading queued_, so one of them always sees the other.
+    std::atomic<std::size_t> queued_;
+    std::atomic<std::size_t> unfinished_;
+    std::atomic<std::size_t> sleepers_;
+    // Guarded by stateMutex_.
+    bool stopping_;
+    std::atomic<std::size_t> nextWorker_;
+    std::atomic<long long> stolen_;
+};
+
+// Runs its tasks one at a time, in posting order, on an executor. A strand
+// gives up its worker after a short batch so one busy strand cannot starve
+// the others. The strand must outlive the tasks posted to it.
+class Strand {
+public:
+    explicit Strand(Executor* executor);
+
+    void Post(std::function<void()> task);
+
+private:
+    Strand(const Strand&) = delete;
+    Strand& operator=(const Strand&) = delete;
+
+    void Drain();
+
+    Executor* executor_;
+    std::mutex mutex_;
+    std::deque<std::function<void()>> tasks_;
+    bool scheduled_;
+};
+
+// Routes ATM work through the executor with one strand per ATM: requests for
+// the same ATM stay serialized while different ATMs proceed in parallel.
+// Call Executor::Wait() before destroying this object.
+class AtmStrands {
+public:
+    explicit AtmStrands(Executor* executor);
+
+    void Post(ATM* atm, std::function<void()> task);
+
+    void PostDeposit(ATM* atm, const CashDrawer& cash, long long checkAmount,
+                     const CashDrawer& feeCash, int checkCount);
+    void PostWithdrawal(ATM* atm, long long amount);
+    void PostAccountTransfer(ATM* atm, Account* destination, long long amount);
+    void PostCashTransfer(ATM* atm, Account* destination, const CashDrawer& cash);
+
+private:
+    AtmStrands(const AtmStrands&) = delete;
+    AtmStrands& operator=(const AtmStrands&) = delete;
+
+    Strand& StrandFor(const ATM* atm);
+
+    Executor* executor_;
+    std::mutex mutex_;
+    std::unordered_map<const ATM*, std::unique_ptr<Strand>> strands_;
+};
+
+#endif // EXECUTOR_HPP
@@ -0,0 +1,426 @@
+#include "Export.hpp"
+
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <vector>
+
+#include "Receipt.hpp"
+#include "Transaction.hpp"
+
+namespace {
+
+const std::size_t EXPORT_CHUNK_BYTES = 1 << 20;
+const char EXPORT_MAGIC[9] = {'A', 'T', 'M', 'X', 'P', 'R', 'T', '1', '\n'};
+const char EXPORT_STRING = 'S';
+const char EXPORT_RECORD = 'R';
+const std::uint32_t EXPORT_NO_STRING = 0xFFFFFFFFu;
+
+// Characters that force a CSV field into quotes.
+const char* const CSV_SPECIAL = ",\"\r\n";
+
+const char* const CSV_HEADER =
+    "id,time_us,type,atm,card,source_bank,source_account,target_bank,target_account,amount,fee,note\n";
+
+const char* KindName(TransactionKind kind) {
+    switch (kind) {
+    case TransactionKind_Deposit:
+        return "Deposit";
+    case TransactionKind_Withdrawal:
+        return "Withdrawal";
+    case TransactionKind_AccountTransfer:
+        return "AccountTransfer";
+    default:
+        return "CashTransfer";
+    }
+}
+
+// Collects output and hands it to the stream a chunk at a time. Appends
+// copy straight into the chunk, which is written out whenever the next
+// piece would not fit.
+class ExportBuffer {
+public:
+    explicit ExportBuffer(std::ostream& out)
+        : out_(&out),
+          chunk_(EXPORT_CHUNK_BYTES),
+          used_(0),
+          written_(0) {
+    }
+
+    void Append(const char* data, std::size_t size) {
+        if (size > chunk_.size() - used_) {
+            Flush();
+            if (size > chunk_.size()) {
+                Write(data, size);
+                return;
+            }
+        }
+        std::memcpy(chunk_.data() + used_, data, size);
+        used_ += size;
+    }
+
+    void Append(const char* text) {
+        Append(text, std::strlen(text));
+    }
+
+    void Append(const std::string& text) {
+        Append(text.data(), text.size());
+    }
+
+    void Append(char c) {
+        if (used_ == chunk_.size()) {
+            Flush();
+        }
+        chunk_[used_++] = c;
+    }
+
+    void AppendInteger(long long value) {
+        char digits[INTEGER_TEXT_BYTES];
+        char* end = digits + sizeof(digits);
+        char* begin = FormatInteger(value, end);
+        Append(begin, static_cast<std::size_t>(end - begin));
+    }
+
+    // Fixed-width little-endian integer.
+    template<typename Value>
+    void AppendRaw(Value value) {
+        char bytes[sizeof(Value)];
+        std::uint64_t bits = static_cast<std::uint64_t>(value);
+        for (std::size_t i = 0; i < sizeof(Value); ++i) {
+            bytes[i] = static_cast<char>((bits >> (8 * i)) & 0xFF);
+        }
+        Append(bytes, sizeof(Value));
+    }
+
+    void Flush() {
+        Write(chunk_.data(), used_);
+        used_ = 0;
+    }
+
+    long long Written() const {
+        return written_;
+    }
+
+private:
+    void Write(const char* data, std::size_t size) {
+        if (size != 0) {
+            out_->write(data, static_cast<std::streamsize>(size));
+            written_ += static_cast<long long>(size);
+        }
+    }
+
+    std::ostream* out_;
+    std::vector<char> chunk_;
+    std::size_t used_;
+    long long written_;
+};
+
+void AppendCsvField(ExportBuffer& buffer, const std::string& text) {
+    // strcspn stops at an embedded NUL too; such a field just gets quoted.
+    if (std::strcspn(text.c_str(), CSV_SPECIAL) == text.size()) {
+        buffer.Append(text);
+        return;
+    }
+    buffer.Append('"');
+    for (char c : text) {
+        if (c == '"') {
+            buffer.Append('"');
+        }
+        buffer.Append(c);
+    }
+    buffer.Append('"');
+}
+
+void AppendJsonString(ExportBuffer& buffer, const std::string& text) {
+    static const char HEX[] = "0123456789abcdef";
+    buffer.Append('"');
+    std::size_t clean = 0;
+    const std::size_t size = text.size();
+    for (std::size_t i = 0; i < size; ++i) {
+        unsigned char c = static_cast<unsigned char>(text[i]);
+        if (c >= 0x20 && c != '"' && c != '\\') {
+            continue;
+        }
+        buffer.Append(text.data() + clean, i - clean);
+        clean = i + 1;
+        buffer.Append('\\');
+        if (c == '"' || c == '\\') {
+            buffer.Append(static_cast<char>(c));
+        } else if (c == '\n') {
+            buffer.Append('n');
+        } else if (c == '\r') {
+            buffer.Append('r');
+        } else if (c == '\t') {
+            buffer.Append('t');
+        } else {
+            buffer.Append("u00", 3);
+            buffer.Append(HEX[c >> 4]);
+            buffer.Append(HEX[c & 0xF]);
+        }
+    }
+    buffer.Append(text.data() + clean, size - clean);
+    buffer.Append('"');
+}
+
+void WriteCsv(ExportBuffer& buffer, const Transaction* transaction) {
+    const TransferTarget* target = transaction->getTarget();
+    buffer.AppendInteger(transaction->getId());
+    buffer.Append(',');
+    buffer.AppendInteger(transaction->getTime().wallMicros);
+    buffer.Append(',');
+    buffer.Append(KindName(transaction->getKind()));
+    buffer.Append(',');
+    AppendCsvField(buffer, transaction->getAtmSerial());
+    buffer.Append(',');
+    AppendCsvField(buffer, transaction->getCardNumber());
+    buffer.Append(',');
+    AppendCsvField(buffer, transaction->getSourceBankName());
+    buffer.Append(',');
+    AppendCsvField(buffer, transaction->getSourceAccountNumber());
+    buffer.Append(',');
+    if (target != nullptr) {
+        AppendCsvField(buffer, target->bankName);
+    }
+    buffer.Append(',');
+    if (target != nullptr) {
+        AppendCsvField(buffer, target->accountNumber);
+    }
+    buffer.Append(',');
+    buffer.AppendInteger(transaction->getAmount());
+    buffer.Append(',');
+    buffer.AppendInteger(transaction->getFee());
+    buffer.Append(',');
+    AppendCsvField(buffer, transaction->getNote());
+    buffer.Append('\n');
+}
+
+void WriteNdjson(ExportBuffer& buffer, const Transaction* transaction) {
+    const TransferTarget* target = transaction->getTarget();
+    buffer.Append("{\"id\":", 6);
+    buffer.AppendInteger(transaction->getId());
+    buffer.Append(",\"time_us\":", 11);
+    buffer.AppendInteger(transaction->getTime().wallMicros);
+    buffer.Append(",\"type\":\"", 9);
+    buffer.Append(KindName(transaction->getKind()));
+    buffer.Append("\",\"atm\":", 8);
+    AppendJsonString(buffer, transaction->getAtmSerial());
+    buffer.Append(",\"card\":", 8);
+    AppendJsonString(buffer, transaction->getCardNumber());
+    buffer.Append(",\"source_bank\":", 15);
+    AppendJsonString(buffer, transaction->getSourceBankName());
+    buffer.Append(",\"source_account\":", 18);
+    AppendJsonString(buffer, transaction->getSourceAccountNumber());
+    if (target != nullptr) {
+        buffer.Append(",\"target_bank\":", 15);
+        AppendJsonString(buffer, target->bankName);
+        buffer.Append(",\"target_account\":", 18);
+        AppendJsonString(buffer, target->accountNumber);
+    }
+    buffer.Append(",\"amount\":", 10);
+    buffer.AppendInteger(transaction->getAmount());
+    buffer.Append(",\"fee\":", 7);
+    buffer.AppendInteger(transaction->getFee());
+    buffer.Append(",\"note\":", 8);
+    AppendJsonString(buffer, transaction->getNote());
+    buffer.Append("}\n", 2);
+}
+
+std::uint64_t HashText(const std::string& text) {
+    // Eight bytes at a time; the strings are short serials, cards and names.
+    const std::uint64_t MULTIPLIER = 0x9E3779B97F4A7C15ULL;
+    std::uint64_t hash = text.size() * MULTIPLIER;
+    const char* data = text.data();
+    std::size_t size = text.size();
+    while (size >= 8) {
+        std::uint64_t word;
+        std::memcpy(&word, data, 8);
+        hash = (hash ^ word) * MULTIPLIER;
+        hash ^= hash >> 29;
+        data += 8;
+        size -= 8;
+    }
+    if (size > 0) {
+        std::uint64_t word = 0;
+        std::memcpy(&word, data, size);
+        hash = (hash ^ word) * MULTIPLIER;
+        hash ^= hash >> 29;
+    }
+    return hash;
+}
+
+// String table of one binary export. Serials, cards, banks and accounts
+// repeat across records, so each is written once and then referenced. The
+// table points at the transactions' own strings, which outlive the export,
+// and probes linearly in a power-of-two array kept at most half full.
+class BinaryStrings {
+public:
+    explicit BinaryStrings(ExportBuffer* buffer)
+        : buffer_(buffer),
+          slots_(1024),
+          count_(0) {
+    }
+
+    std::uint32_t Intern(const std::string* text) {
+        if (text == nullptr) {
+            return EXPORT_NO_STRING;
+        }
+        const std::uint64_t hash = HashText(*text);
+        std::size_t mask = slots_.size() - 1;
+        std::size_t index = static_cast<std::size_t>(hash) & mask;
+        while (slots_[index].text != nullptr) {
+            const Slot& slot = slots_[index];
+            if (slot.hash == hash && *slot.text == *text) {
+                return slot.id;
+            }
+            index = (index + 1) & mask;
+        }
+
+        Slot& slot = slots_[index];
+        slot.text = text;
+        slot.hash = hash;
+        slot.id = count_++;
+        buffer_->Append(EXPORT_STRING);
+        buffer_->AppendRaw(static_cast<std::uint32_t>(text->size()));
+        buffer_->Append(*text);
+        std::uint32_t id = slot.id;
+        if (static_cast<std::size_t>(count_) * 2 > slots_.size()) {
+            Grow();
+        }
+        return id;
+    }
+
+private:
+    struct Slot {
+        const std::string* text;
+        std::uint64_t hash;
+        std::uint32_t id;
+
+        Slot() : text(nullptr), hash(0), id(0) {}
+    };
+
+    void Grow() {
+        std::vector<Slot> old(slots_.size() * 2);
+        old.swap(slots_);
+        const std::size_t mask = slots_.size() - 1;
+        for (const Slot& slot : old) {
+            if (slot.text == nullptr) {
+                continue;
+            }
+            std::size_t index = static_cast<std::size_t>(slot.hash) & mask;
+            while (slots_[index].text != nullptr) {
+                index = (index + 1) & mask;
+            }
+            slots_[index] = slot;
+        }
+    }
+
+    ExportBuffer* buffer_;
+    std::vector<Slot> slots_;
+    std::uint32_t count_;
+};
+
+void WriteBinary(ExportBuffer& buffer, BinaryStrings& strings, const Transaction* transaction) {
+    const TransferTarget* target = transaction->getTarget();
+    // Strings go out first so the record that uses them stays contiguous.
+    std::uint32_t ids[6] = {
+        strings.Intern(&transaction->getAtmSerial()),
+        strings.Intern(&transaction->getCardNumber()),
+        strings.Intern(&transaction->getSourceBankName()),
+        strings.Intern(&transaction->getSourceAccountNumber()),
+        strings.Intern(target != nullptr ? &target->bankName : nullptr),
+        strings.Intern(target != nullptr ? &target->accountNumber : nullptr),
+    };
+    buffer.Append(EXPORT_RECORD);
+    buffer.AppendRaw(static_cast<std::int64_t>(transaction->getId()));
+    buffer.AppendRaw(static_cast<std::int64_t>(transaction->getTime().wallMicros));
+    buffer.AppendRaw(static_cast<std::int64_t>(transaction->getAmount()));
+    buffer.AppendRaw(static_cast<std::int64_t>(transaction->getFee()));
+    buffer.AppendRaw(static_cast<std::uint8_t>(transaction->getKind()));
+    for (std::uint32_t id : ids) {
+        buffer.AppendRaw(id);
+    }
+}
+
+} // namespace
+
+bool ParseExportFormat(const std::string& name, ExportFormat& format) {
+    if (name == "csv") {
+        format = ExportFormat_Csv;
+    } else if (name == "ndjson" || name == "jsonl") {
+        format = ExportFormat_Ndjson;
+    } else if (name == "bin" || name == "binary") {
+        format = ExportFormat_Binary;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+bool ExportFormatForFile(const std::string& filename, ExportFormat& format) {
+    std::string::size_type dot = filename.rfind('.');
+    if (dot == std::string::npos || filename.find('/', dot) != std::string::npos) {
+        return false;
+    }
+    return ParseExportFormat(filename.substr(dot + 1), format);
+}
+
+ExportResult::ExportResult()
+    : records(0),
+      bytes(0),
+      lastId(0) {
+}
+
+ExportResult ExportTransactions(const std::vector<Transaction*>& transactions,
+                                ExportFormat format,
+                                long long afterId,
+                                std::ostream& out,
+                                bool continued) {
+    ExportResult result;
+    result.lastId = afterId;
+    ExportBuffer buffer(out);
+    BinaryStrings strings(&buffer);
+    if (format == ExportFormat_Csv && afterId == 0 && !continued) {
+        buffer.Append(CSV_HEADER);
+    } else if (format == ExportFormat_Binary) {
+        buffer.Append(EXPORT_MAGIC, sizeof(EXPORT_MAGIC));
+    }
+
+    for (const Transaction* transaction : transactions) {
+        if (transaction == nullptr || transaction->getId() <= afterId) {
+            continue;
+        }
+        switch (format) {
+        case ExportFormat_Csv:
+            WriteCsv(buffer, transaction);
+            break;
+        case ExportFormat_Ndjson:
+            WriteNdjson(buffer, transaction);
+            break;
+        case ExportFormat_Binary:
+            WriteBinary(buffer, strings, transaction);
+            break;
+        }
+        ++result.records;
+        if (transaction->getId() > result.lastId) {
+            result.lastId = transaction->getId();
+        }
+    }
+    buffer.Flush();
+    result.bytes = buffer.Written();
+    return result;
+}
+
+bool ExportTransactionsToFile(const std::string& filename,
+                              const std::vector<Transaction*>& transactions,
+                              ExportFormat format,
+                              long long afterId,
+                              ExportResult& result) {
+    std::ofstream fout(filename, std::ios::binary | (afterId > 0 ? std::ios::app : std::ios::trunc));
+    if (!fout) {
+        std::cerr << "Error opening file: " << filename << "\n";
+        return false;
+    }
+    result = ExportTransactions(transactions, format, afterId, fout);
+    fout.flush();
+    return static_cast<bool>(fout);
+}
@@ -0,0 +1,57 @@
+#ifndef EXPORT_HPP
+#define EXPORT_HPP
+
+#include <cstddef>
+#include <iostream>
+#include <string>
+#include <vector>
+
+class Transaction;
+
+enum ExportFormat {
+    // One header line, then one comma-separated line per transaction.
+    ExportFormat_Csv,
+    // One JSON object per line.
+    ExportFormat_Ndjson,
+    // "ATMXPRT1\n", then tagged little-endian entries: 'S' <u32 length>
+    // <bytes> adds the next string to the table (ids count from 0), and 'R'
+    // starts a 57-byte transaction record: i64 id, i64 wall-clock time in
+    // microseconds since the epoch, i64 amount, i64 fee, u8 kind, then u32
+    // string ids for ATM, card, source bank, source account, target bank and
+    // target account (0xFFFFFFFF when absent).
+    // Every export starts a new magic and table, so resumed exports can be
+    // appended to the same file.
+    ExportFormat_Binary
+};
+
+// "csv", "ndjson" (or "jsonl") and "bin" (or "binary").
+bool ParseExportFormat(const std::string& name, ExportFormat& format);
+// Picks the format from the file extension; false if it names none.
+bool ExportFormatForFile(const std::string& filename, ExportFormat& format);
+
+struct ExportResult {
+    long long records;
+    long long bytes;
+    // Highest ID written; pass it back as afterId to continue the export.
+    long long lastId;
+
+    ExportResult();
+};
+
+// Streams every transaction with an ID above afterId, in the order given,
+// through a chunk buffer so the stream sees a few large writes. The CSV
+// header is written only by a fresh export (afterId 0), and not by a
+// continued one: a later batch of an export written batch by batch.
+ExportResult ExportTransactions(const std::vector<Transaction*>& transactions,
+                                ExportFormat format,
+                                long long afterId,
+                                std::ostream& out,
+                                bool continued = false);
+// Truncates the file for a fresh export and appends to it when resuming.
+bool ExportTransactionsToFile(const std::string& filename,
+                              const std::vector<Transaction*>& transactions,
+                              ExportFormat format,
+                              long long afterId,
+                              ExportResult& result);
+
+#endif // EXPORT_HPP
@@ -0,0 +1,186 @@
+#include "Fees.hpp"
+
+#include "Bank.hpp"
+
+namespace {
+
+// Class of the ATM's primary bank when it has one; 0 is every bank no rule
+// singles out.
+const int PRIMARY_CLASS = 1;
+
+long long BaseFee(const ATMFees& fees, int kind, bool sourceIsPrimary, bool destinationIsPrimary) {
+    switch (kind) {
+    case ATMTransaction_Deposit:
+        return sourceIsPrimary ? fees.depositPrimary : fees.depositNonPrimary;
+    case ATMTransaction_Withdrawal:
+        return sourceIsPrimary ? fees.withdrawalPrimary : fees.withdrawalNonPrimary;
+    case ATMTransaction_AccountTransfer:
+        if (sourceIsPrimary && destinationIsPrimary) {
+            return fees.transferPrimaryToPrimary;
+        }
+        if (sourceIsPrimary || destinationIsPrimary) {
+            return fees.transferPrimaryToOther;
+        }
+        return fees.transferNonPrimaryToNonPrimary;
+    default:
+        return fees.cashTransferAny;
+    }
+}
+
+} // namespace
+
+ATMFees ATMFees::CreateDefault() {
+    ATMFees fees;
+    fees.depositPrimary = 0;
+    fees.depositNonPrimary = 1000;
+    fees.withdrawalPrimary = 1000;
+    fees.withdrawalNonPrimary = 2000;
+    fees.transferPrimaryToPrimary = 1000;
+    fees.transferPrimaryToOther = 2000;
+    fees.transferNonPrimaryToNonPrimary = 4000;
+    fees.cashTransferAny = 2000;
+    return fees;
+}
+
+FeeOverride::FeeOverride()
+    : kind(ATMTransaction_Deposit),
+      sourceBank(nullptr),
+      destinationBank(nullptr),
+      band(-1),
+      fee(0) {
+}
+
+FeeSchedule::FeeSchedule()
+    : base(ATMFees::CreateDefault()),
+      bandLimits(),
+      overrides() {
+}
+
+int FeeSchedule::BandCount() const {
+    return static_cast<int>(bandLimits.size()) + 1;
+}
+
+FeeTable::FeeTable()
+    : schedule_(),
+      primaryBank_(nullptr),
+      classOf_(),
+      classCount_(0),
+      fees_() {
+    Compile();
+}
+
+FeeTable::FeeTable(const FeeSchedule& schedule, const Bank* primaryBank)
+    : schedule_(schedule),
+      primaryBank_(primaryBank),
+      classOf_(),
+      classCount_(0),
+      fees_() {
+    Compile();
+}
+
+const FeeSchedule& FeeTable::GetSchedule() const {
+    return schedule_;
+}
+
+const Bank* FeeTable::GetPrimaryBank() const {
+    return primaryBank_;
+}
+
+long long FeeTable::Fee(ATMTransactionKind kind,
+                        const Bank* sourceBank,
+                        const Bank* destinationBank,
+                        long long amount) const {
+    return fees_[Slot(kind, BandOf(amount), ClassOf(sourceBank), ClassOf(destinationBank))];
+}
+
+void FeeTable::Evaluate(const FeeQuery* queries, std::size_t count, long long* fees) const {
+    for (std::size_t i = 0; i < count; ++i) {
+        const FeeQuery& query = queries[i];
+        fees[i] = fees_[Slot(query.kind, BandOf(query.amount),
+                             ClassOf(query.sourceBank), ClassOf(query.destinationBank))];
+    }
+}
+
+int FeeTable::ClassOf(const Bank* bank) const {
+    if (bank == nullptr) {
+        return 0;
+    }
+    std::size_t index = bank->getIndex();
+    return index < classOf_.size() ? classOf_[index] : 0;
+}
+
+int FeeTable::BandOf(long long amount) const {
+    // Schedules have a handful of bands, so a scan beats a binary search.
+    int band = 0;
+    const int limits = static_cast<int>(schedule_.bandLimits.size());
+    while (band < limits && amount >= schedule_.bandLimits[band]) {
+        ++band;
+    }
+    return band;
+}
+
+std::size_t FeeTable::Slot(int kind, int band, int sourceClass, int destinationClass) const {
+    const std::size_t classes = static_cast<std::size_t>(classCount_);
+    std::size_t row = static_cast<std::size_t>(kind) * static_cast<std::size_t>(schedule_.BandCount()) +
+                      static_cast<std::size_t>(band);
+    return (row * classes + static_cast<std::size_t>(sourceClass)) * classes +
+           static_cast<std::size_t>(destinationClass);
+}
+
+void FeeTable::Compile() {
+    // Give the primary bank and every bank an override names a class of its
+    // own; all other banks share class 0.
+    classOf_.clear();
+    classCount_ = 1;
+    auto assign = [this](const Bank* bank) {
+        if (bank == nullptr) {
+            return;
+        }
+        std::size_t index = bank->getIndex();
+        if (index >= classOf_.size()) {
+            classOf_.resize(index + 1, 0);
+        }
+        if (classOf_[index] == 0) {
+            classOf_[index] = static_cast<unsigned short>(classCount_++);
+        }
+    };
+    assign(primaryBank_);
+    for (const FeeOverride& feeOverride : schedule_.overrides) {
+        assign(feeOverride.sourceBank);
+        assign(feeOverride.destinationBank);
+    }
+
+    const int bands = schedule_.BandCount();
+    fees_.assign(static_cast<std::size_t>(TRANSACTION_KIND_COUNT) * static_cast<std::size_t>(bands) *
+                     static_cast<std::size_t>(classCount_) * static_cast<std::size_t>(classCount_),
+                 0);
+    const bool hasPrimary = primaryBank_ != nullptr;
+    for (int kind = 0; kind < TRANSACTION_KIND_COUNT; ++kind) {
+        for (int band = 0; band < bands; ++band) {
+            for (int source = 0; source < classCount_; ++source) {
+                for (int destination = 0; destination < classCount_; ++destination) {
+                    fees_[Slot(kind, band, source, destination)] =
+                        BaseFee(schedule_.base, kind,
+                                hasPrimary && source == PRIMARY_CLASS,
+                                hasPrimary && destination == PRIMARY_CLASS);
+                }
+            }
+        }
+    }
+
+    for (const FeeOverride& feeOverride : schedule_.overrides) {
+        int firstBand = feeOverride.band < 0 ? 0 : feeOverride.band;
+        int lastBand = feeOverride.band < 0 ? bands - 1 : feeOverride.band;
+        int firstSource = feeOverride.sourceBank ? ClassOf(feeOverride.sourceBank) : 0;
+        int lastSource = feeOverride.sourceBank ? firstSource : classCount_ - 1;
+        int firstDestination = feeOverride.destinationBank ? ClassOf(feeOverride.destinationBank) : 0;
+        int lastDestination = feeOverride.destinationBank ? firstDestination : classCount_ - 1;
+        for (int band = firstBand; band <= lastBand && band < bands; ++band) {
+            for (int source = firstSource; source <= lastSource; ++source) {
+                for (int destination = firstDestination; destination <= lastDestination; ++destination) {
+                    fees_[Slot(feeOverride.kind, band, source, destination)] = feeOverride.fee;
+                }
+            }
+        }
+    }
+}
@@ -0,0 +1,101 @@
+#ifndef FEES_HPP
+#define FEES_HPP
+
+#include <cstddef>
+#include <vector>
+
+class Bank;
+
+enum ATMTransactionKind {
+    ATMTransaction_Deposit,
+    ATMTransaction_Withdrawal,
+    ATMTransaction_AccountTransfer,
+    ATMTransaction_CashTransfer
+};
+
+const int TRANSACTION_KIND_COUNT = 4;
+
+struct ATMFees {
+    long long depositPrimary;
+    long long depositNonPrimary;
+    long long withdrawalPrimary;
+    long long withdrawalNonPrimary;
+    long long transferPrimaryToPrimary;
+    long long transferPrimaryToOther;
+    long long transferNonPrimaryToNonPrimary;
+    long long cashTransferAny;
+
+    static ATMFees CreateDefault();
+};
+
+// Replaces the base fee of the matching transactions. A null bank or a band
+// of -1 matches any. The source bank is the customer's bank; only transfers
+// and cash transfers have a destination bank.
+struct FeeOverride {
+    ATMTransactionKind kind;
+    const Bank* sourceBank;
+    const Bank* destinationBank;
+    int band;
+    long long fee;
+
+    FeeOverride();
+};
+
+// Everything that decides one ATM's fees. Overrides apply in order, so a
+// later one wins where two match.
+struct FeeSchedule {
+    ATMFees base;
+    // Ascending; band i holds amounts below bandLimits[i] and the last band
+    // holds the rest. Empty means one band for every amount.
+    std::vector<long long> bandLimits;
+    std::vector<FeeOverride> overrides;
+
+    FeeSchedule();
+
+    int BandCount() const;
+};
+
+struct FeeQuery {
+    ATMTransactionKind kind;
+    const Bank* sourceBank;
+    const Bank* destinationBank;
+    long long amount;
+};
+
+// A FeeSchedule compiled for one ATM into a dense table indexed by kind,
+// amount band and the fee classes of the source and destination banks.
+// Banks that no rule tells apart (every non-primary bank without an
+// override) share class 0, so the table stays small however many banks
+// exist. A lookup is two class loads, a band search over a few limits and
+// one table load.
+class FeeTable {
+public:
+    // Default fees for an ATM with no primary bank.
+    FeeTable();
+    FeeTable(const FeeSchedule& schedule, const Bank* primaryBank);
+
+    const FeeSchedule& GetSchedule() const;
+    const Bank* GetPrimaryBank() const;
+
+    long long Fee(ATMTransactionKind kind,
+                  const Bank* sourceBank,
+                  const Bank* destinationBank,
+                  long long amount) const;
+    // fees[i] receives the fee for queries[i].
+    void Evaluate(const FeeQuery* queries, std::size_t count, long long* fees) const;
+
+private:
+    int ClassOf(const Bank* bank) const;
+    int BandOf(long long amount) const;
+    std::size_t Slot(int kind, int band, int sourceClass, int destinationClass) const;
+    void Compile();
+
+    FeeSchedule schedule_;
+    const Bank* primaryBank_;
+    // Fee class by Bank::getIndex(); banks past the end are class 0.
+    std::vector<unsigned short> classOf_;
+    int classCount_;
+    std::vector<long long> fees_;
+};
+
+#endif // FEES_HPP
@@ -0,0 +1,140 @@
+#include "Forecast.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+#include "Atm.hpp"
+
+namespace {
+
+// Weight of the newest session once the tracker has warmed up; roughly the
+// last 20 sessions dominate the rate.
+const double RATE_SMOOTHING = 0.05;
+
+bool MoreUrgent(const ReplenishmentOrder& a, const ReplenishmentOrder& b) {
+    return a.sessionsUntilShort < b.sessionsUntilShort;
+}
+
+} // namespace
+
+DispenseRateTracker::DispenseRateTracker()
+    : sessionsObserved_(0) {
+    for (int i = 0; i < CASH_TYPE_COUNT; ++i) {
+        notesPerSession_[i] = 0.0;
+        pendingNotes_[i] = 0;
+    }
+}
+
+void DispenseRateTracker::RecordDispense(const CashDrawer& bundle) {
+    for (int i = 0; i < CASH_TYPE_COUNT; ++i) {
+        pendingNotes_[i] += bundle.noteCounts[i];
+    }
+}
+
+void DispenseRateTracker::EndSession() {
+    ++sessionsObserved_;
+    // Until enough sessions are seen this is the plain mean, so the first
+    // sessions are not discounted against a made-up starting rate of zero.
+    double weight = 1.0 / static_cast<double>(sessionsObserved_);
+    if (weight < RATE_SMOOTHING) {
+        weight = RATE_SMOOTHING;
+    }
+    for (int i = 0; i < CASH_TYPE_COUNT; ++i) {
+        notesPerSession_[i] += weight * (pendingNotes_[i] - notesPerSession_[i]);
+        pendingNotes_[i] = 0;
+    }
+}
+
+double DispenseRateTracker::GetNotesPerSession(int slot) const {
+    return notesPerSession_[slot];
+}
+
+long long DispenseRateTracker::GetSessionsObserved() const {
+    return sessionsObserved_;
+}
+
+CashForecast::CashForecast()
+    : sessionsUntilShort(-1.0),
+      limitingSlot(-1) {
+    for (int i = 0; i < CASH_TYPE_COUNT; ++i) {
+        sessionsToEmpty[i] = -1.0;
+    }
+}
+
+CashForecast ForecastCash(const ATM& atm) {
+    CashForecast forecast;
+    const DispenseRateTracker& rates = atm.GetDispenseRates();
+    const CashDrawer& inventory = atm.GetCashInventory();
+    for (int i = 0; i < CASH_TYPE_COUNT; ++i) {
+        double rate = rates.GetNotesPerSession(i);
+        if (rate <= 0.0) {
+            continue;
+        }
+        double sessions = inventory.noteCounts[i] / rate;
+        forecast.sessionsToEmpty[i] = sessions;
+        if (forecast.limitingSlot < 0 || sessions < forecast.sessionsUntilShort) {
+            forecast.sessionsUntilShort = sessions;
+            forecast.limitingSlot = i;
+        }
+    }
+    return forecast;
+}
+
+ReplenishmentPolicy::ReplenishmentPolicy()
+    : horizonSessions(200.0),
+      triggerSessions(50.0),
+      cassetteCapacity(2000),
+      vault(nullptr) {
+}
+
+std::vector<ReplenishmentOrder> PlanReplenishment(const std::vector<ATM*>& atms,
+                                                  const ReplenishmentPolicy& policy) {
+    std::vector<ReplenishmentOrder> orders;
+    for (ATM* atm : atms) {
+        if (atm == nullptr) {
+            continue;
+        }
+        CashForecast forecast = ForecastCash(*atm);
+        if (forecast.limitingSlot < 0 || forecast.sessionsUntilShort >= policy.triggerSessions) {
+            continue;
+        }
+        ReplenishmentOrder order;
+        order.atm = atm;
+        order.sessionsUntilShort = forecast.sessionsUntilShort;
+        order.limitingSlot = forecast.limitingSlot;
+        orders.push_back(order);
+    }
+    std::sort(orders.begin(), orders.end(), MoreUrgent);
+
+    CashDrawer remaining;
+    if (policy.vault != nullptr) {
+        remaining = *policy.vault;
+    }
+    std::size_t kept = 0;
+    for (ReplenishmentOrder& order : orders) {
+        const DispenseRateTracker& rates = order.atm->GetDispenseRates();
+        const CashDrawer& inventory = order.atm->GetCashInventory();
+        bool loads = false;
+        for (int i = 0; i < CASH_TYPE_COUNT; ++i) {
+            double wanted = std::ceil(rates.GetNotesPerSession(i) * policy.horizonSessions);
+            long long target = std::min(static_cast<long long>(wanted),
+                                        static_cast<long long>(policy.cassetteCapacity));
+            long long notes = target - inventory.noteCounts[i];
+            if (policy.vault != nullptr) {
+                notes = std::min(notes, static_cast<long long>(remaining.noteCounts[i]));
+                if (notes > 0) {
+                    remaining.noteCounts[i] -= static_cast<int>(notes);
+                }
+            }
+            if (notes > 0) {
+                order.load.noteCounts[i] = static_cast<int>(notes);
+                loads = true;
+            }
+        }
+        if (loads) {
+            orders[kept++] = order;
+        }
+    }
+    orders.resize(kept);
+    return orders;
+}
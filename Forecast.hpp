@@ -0,0 +1,74 @@
+#ifndef FORECAST_HPP
+#define FORECAST_HPP
+
+#include <cstddef>
+#include <vector>
+
+#include "CashDrawer.hpp"
+
+class ATM;
+
+// Exponentially weighted notes dispensed per customer session, per
+// denomination. Time is counted in customer sessions at the ATM, so rates
+// and forecasts are the same on every run of the same input.
+class DispenseRateTracker {
+public:
+    DispenseRateTracker();
+
+    // Adds a dispensed bundle to the current session. O(1).
+    void RecordDispense(const CashDrawer& bundle);
+    // Folds the current session into the averages; sessions without a
+    // withdrawal pull the rates down.
+    void EndSession();
+
+    double GetNotesPerSession(int slot) const;
+    long long GetSessionsObserved() const;
+
+private:
+    double notesPerSession_[ActiveDenominations::Count];
+    int pendingNotes_[ActiveDenominations::Count];
+    long long sessionsObserved_;
+};
+
+struct CashForecast {
+    // Customer sessions until each cassette runs out at the current rate;
+    // negative when nothing is being drawn from it.
+    double sessionsToEmpty[ActiveDenominations::Count];
+    // The earliest of those, or negative if no cassette is running down.
+    double sessionsUntilShort;
+    // Cassette that runs out first, or -1.
+    int limitingSlot;
+
+    CashForecast();
+};
+
+CashForecast ForecastCash(const ATM& atm);
+
+struct ReplenishmentPolicy {
+    // Load enough notes to cover this many more customer sessions.
+    double horizonSessions;
+    // Only ATMs forecast to run short within this many sessions get a load.
+    double triggerSessions;
+    // Most notes a cassette holds.
+    int cassetteCapacity;
+    // Notes on hand to distribute; nullptr means unlimited. When notes run
+    // short, the ATMs closest to running out are served first.
+    const CashDrawer* vault;
+
+    ReplenishmentPolicy();
+};
+
+struct ReplenishmentOrder {
+    ATM* atm;
+    // Notes to add with ATM::LoadCash.
+    CashDrawer load;
+    double sessionsUntilShort;
+    int limitingSlot;
+};
+
+// Proposes cash loads across the fleet, most urgent ATM first. Runs in
+// O(n log n) for n ATMs; only ATMs under the trigger are sorted.
+std::vector<ReplenishmentOrder> PlanReplenishment(const std::vector<ATM*>& atms,
+                                                  const ReplenishmentPolicy& policy);
+
+#endif // FORECAST_HPP
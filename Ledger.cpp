@@ -0,0 +1,1201 @@
+#include "Ledger.hpp"
+
+#include <algorithm>
+#include <climits>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <initializer_list>
+#include <iostream>
+#include <iterator>
+#include <memory>
+#include <sstream>
+
+namespace {
+
+// Unix seconds that still fit in microseconds.
+const long long MAX_QUERY_SECONDS = LLONG_MAX / 1000000;
+
+bool ParseNumber(const std::string& text, long long& value) {
+    if (text.empty() || text.size() > 18) {
+        return false;
+    }
+    char* end = nullptr;
+    value = std::strtoll(text.c_str(), &end, 10);
+    return end != text.c_str() && *end == '\0';
+}
+
+bool ParseKind(const std::string& text, TransactionKind& kind) {
+    std::string name;
+    for (char c : text) {
+        name.push_back((c >= 'A' && c <= 'Z') ? static_cast<char>(c - 'A' + 'a') : c);
+    }
+    if (name == "deposit") {
+        kind = TransactionKind_Deposit;
+    } else if (name == "withdrawal") {
+        kind = TransactionKind_Withdrawal;
+    } else if (name == "accounttransfer") {
+        kind = TransactionKind_AccountTransfer;
+    } else if (name == "cashtransfer") {
+        kind = TransactionKind_CashTransfer;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+// First index at or after `from` whose position is not below target.
+// Probes 1, 2, 4, ... ahead before a binary search, so walking a long list
+// in step with a short one skips most of it.
+std::size_t Gallop(const std::vector<std::uint32_t>& list, std::size_t from, std::uint32_t target) {
+    std::size_t low = from;
+    std::size_t high = from;
+    std::size_t step = 1;
+    while (high < list.size() && list[high] < target) {
+        low = high + 1;
+        high += step;
+        step *= 2;
+    }
+    std::size_t end = std::min(high, list.size());
+    return static_cast<std::size_t>(std::lower_bound(list.begin() + low, list.begin() + end, target) -
+                                    list.begin());
+}
+
+// Keeps the candidates that also appear in list.
+void Intersect(std::vector<std::uint32_t>& candidates, const std::vector<std::uint32_t>& list) {
+    std::size_t kept = 0;
+    std::size_t at = 0;
+    for (std::uint32_t candidate : candidates) {
+        at = Gallop(list, at, candidate);
+        if (at == list.size()) {
+            break;
+        }
+        if (list[at] == candidate) {
+            candidates[kept++] = candidate;
+        }
+    }
+    candidates.resize(kept);
+}
+
+// The filters no posting list answers.
+bool MatchesRanges(const TransactionQuery& query, const Transaction* transaction) {
+    long long amount = transaction->getAmount();
+    long long time = transaction->getTime().wallMicros;
+    return (!query.hasMinAmount || amount >= query.minAmount) &&
+           (!query.hasMaxAmount || amount <= query.maxAmount) &&
+           (!query.hasFrom || time >= query.fromMicros) &&
+           (!query.hasTo || time < query.toMicros);
+}
+
+bool HasLowerId(const Transaction* a, const Transaction* b) {
+    return a->getId() < b->getId();
+}
+
+bool HasHigherId(const Transaction* a, const Transaction* b) {
+    return a->getId() > b->getId();
+}
+
+// Swaps out[first, end) for copies owned by loaded. A segmented ledger
+// frees what it seals, so matches found in memory are copied before its
+// lock is dropped.
+void CopyMatches(std::vector<Transaction*>& out, std::size_t first, LoadedTransactions& loaded) {
+    for (std::size_t i = first; i < out.size(); ++i) {
+        loaded.push_back(out[i]->clone());
+        out[i] = loaded.back().get();
+    }
+}
+
+// Marks a position whose transaction was sealed.
+const std::uint32_t SEALED_POSITION = UINT32_MAX;
+
+// Renumbers list's positions by moved, dropping the sealed ones. Positions
+// keep their order, so the list stays sorted.
+void MovePostings(std::vector<std::uint32_t>& list, const std::vector<std::uint32_t>& moved) {
+    std::size_t kept = 0;
+    for (std::uint32_t position : list) {
+        if (moved[position] != SEALED_POSITION) {
+            list[kept++] = moved[position];
+        }
+    }
+    list.resize(kept);
+}
+
+// Where id sits in list, whose entries are in ID order give or take slack
+// places, or list.size() when it is not there. A binary search lands within
+// slack of the entry, so only that window is scanned.
+template <typename Entry, typename IdOf>
+std::size_t FindNearlySorted(const std::vector<Entry>& list, long long id, std::size_t slack, IdOf idOf) {
+    const std::size_t at = static_cast<std::size_t>(
+        std::partition_point(list.begin(), list.end(), [id, &idOf](const Entry& entry) { return idOf(entry) < id; }) -
+        list.begin());
+    const std::size_t end = std::min(list.size(), at + slack + 1);
+    for (std::size_t i = at > slack ? at - slack : 0; i < end; ++i) {
+        if (idOf(list[i]) == id) {
+            return i;
+        }
+    }
+    return list.size();
+}
+
+const char BLOCK_TREE_MAGIC[8] = {'A', 'T', 'M', 'T', 'R', 'E', 'E', '1'};
+
+// A closed block's tree, laid out the same in memory and in its file, in the
+// machine's byte order: this header; each leaf's time and ID in AuditOrder;
+// the leaves' positions sorted by ID, padded to 8 bytes; then every level
+// of the block's Merkle tree as MerkleLevels lays them out.
+struct BlockTreeHeader {
+    char magic[8];
+    std::uint64_t count;
+};
+
+struct BlockTreeEntry {
+    std::int64_t wallMicros;
+    std::int64_t id;
+};
+
+static_assert(sizeof(BlockTreeHeader) == 16, "block tree header layout");
+static_assert(sizeof(BlockTreeEntry) == 16, "block tree entry layout");
+static_assert(sizeof(Sha256Digest) == 32, "block tree node layout");
+
+std::uint64_t BlockTreeLevelsOffset(std::uint64_t count) {
+    return sizeof(BlockTreeHeader) + count * sizeof(BlockTreeEntry) + (count * sizeof(std::uint32_t) + 7) / 8 * 8;
+}
+
+template <typename Value>
+void AppendBytes(std::string& out, const Value* values, std::size_t count) {
+    out.append(reinterpret_cast<const char*>(values), count * sizeof(Value));
+}
+
+// Lays out the tree over leaves, which are in AuditOrder, and hands back
+// its root.
+std::string BuildBlockTree(const std::vector<AuditLeaf>& leaves, Sha256Digest& root) {
+    std::vector<Sha256Digest> hashes;
+    std::vector<BlockTreeEntry> entries;
+    hashes.reserve(leaves.size());
+    entries.reserve(leaves.size());
+    for (const AuditLeaf& leaf : leaves) {
+        hashes.push_back(leaf.hash);
+        entries.push_back(BlockTreeEntry{leaf.wallMicros, leaf.id});
+    }
+    std::vector<std::uint32_t> byId(leaves.size());
+    for (std::size_t i = 0; i < byId.size(); ++i) {
+        byId[i] = static_cast<std::uint32_t>(i);
+    }
+    std::sort(byId.begin(), byId.end(), [&leaves](std::uint32_t a, std::uint32_t b) {
+        return leaves[a].id < leaves[b].id;
+    });
+    const std::vector<Sha256Digest> levels = MerkleLevels(hashes);
+    root = levels.empty() ? MerkleRoot(hashes) : levels.back();
+
+    BlockTreeHeader header;
+    std::memcpy(header.magic, BLOCK_TREE_MAGIC, sizeof(header.magic));
+    header.count = leaves.size();
+    std::string tree;
+    tree.reserve(static_cast<std::size_t>(BlockTreeLevelsOffset(header.count)) + levels.size() * sizeof(Sha256Digest));
+    AppendBytes(tree, &header, 1);
+    AppendBytes(tree, entries.data(), entries.size());
+    AppendBytes(tree, byId.data(), byId.size());
+    tree.resize(static_cast<std::size_t>(BlockTreeLevelsOffset(header.count)), '\0');
+    AppendBytes(tree, levels.data(), levels.size());
+    return tree;
+}
+
+// Reads a block's tree from memory or from its file. A proof touches a
+// path's worth of entries and nodes, so the file is read piece by piece
+// rather than loaded.
+class BlockTreeReader {
+public:
+    BlockTreeReader(const std::shared_ptr<const std::string>& tree, const std::string& path)
+        : tree_(tree),
+          file_(),
+          size_(0),
+          count_(0),
+          byIdOffset_(0),
+          levelsOffset_(0),
+          valid_(false) {
+        if (tree_) {
+            size_ = tree_->size();
+        } else {
+            file_.open(path.c_str(), std::ios::binary | std::ios::ate);
+            if (!file_) {
+                return;
+            }
+            size_ = static_cast<std::uint64_t>(file_.tellg());
+        }
+        BlockTreeHeader header;
+        if (!Read(0, &header, sizeof(header)) ||
+            std::memcmp(header.magic, BLOCK_TREE_MAGIC, sizeof(header.magic)) != 0 || header.count == 0 ||
+            header.count > size_ / sizeof(BlockTreeEntry)) {
+            return;
+        }
+        count_ = static_cast<std::size_t>(header.count);
+        byIdOffset_ = sizeof(BlockTreeHeader) + header.count * sizeof(BlockTreeEntry);
+        levelsOffset_ = BlockTreeLevelsOffset(header.count);
+        valid_ = levelsOffset_ + MerkleLevelOffset(count_, MerkleLevelCount(count_)) * sizeof(Sha256Digest) == size_;
+    }
+
+    // The header and layout add up; the contents are checked by the proofs.
+    bool Valid() const { return valid_; }
+    std::size_t Count() const { return count_; }
+
+    bool Entry(std::size_t leaf, BlockTreeEntry& entry) {
+        return leaf < count_ && Read(sizeof(BlockTreeHeader) + leaf * sizeof(entry), &entry, sizeof(entry));
+    }
+
+    bool Entries(std::size_t begin, std::size_t end, std::vector<BlockTreeEntry>& entries) {
+        if (begin > end || end > count_) {
+            return false;
+        }
+        entries.resize(end - begin);
+        return Read(sizeof(BlockTreeHeader) + begin * sizeof(BlockTreeEntry), entries.data(),
+                    entries.size() * sizeof(BlockTreeEntry));
+    }
+
+    // Binary-searches the leaves by ID.
+    AuditStatus FindId(long long id, std::size_t& leaf) {
+        std::size_t low = 0;
+        std::size_t high = count_;
+        while (low < high) {
+            const std::size_t middle = low + (high - low) / 2;
+            std::uint32_t position = 0;
+            BlockTreeEntry entry;
+            if (!Read(byIdOffset_ + middle * sizeof(position), &position, sizeof(position)) ||
+                !Entry(position, entry)) {
+                return AuditStatus_Unreadable;
+            }
+            if (entry.id == id) {
+                leaf = position;
+                return AuditStatus_Proved;
+            }
+            if (entry.id < id) {
+                low = middle + 1;
+            } else {
+                high = middle;
+            }
+        }
+        return AuditStatus_NotFound;
+    }
+
+    // The first leaf whose time is not before micros, or Count().
+    bool LowerBound(long long micros, std::size_t& leaf) {
+        std::size_t low = 0;
+        std::size_t high = count_;
+        while (low < high) {
+            const std::size_t middle = low + (high - low) / 2;
+            BlockTreeEntry entry;
+            if (!Entry(middle, entry)) {
+                return false;
+            }
+            if (entry.wallMicros < micros) {
+                low = middle + 1;
+            } else {
+                high = middle;
+            }
+        }
+        leaf = low;
+        return true;
+    }
+
+    bool Node(std::size_t level, std::size_t index, Sha256Digest& node) {
+        if (level >= MerkleLevelCount(count_)) {
+            return false;
+        }
+        const std::size_t first = MerkleLevelOffset(count_, level);
+        if (index >= MerkleLevelOffset(count_, level + 1) - first) {
+            return false;
+        }
+        return Read(levelsOffset_ + (first + index) * sizeof(Sha256Digest), &node, sizeof(node));
+    }
+
+    MerkleNodeReader Nodes() {
+        return [this](std::size_t level, std::size_t index, Sha256Digest& node) { return Node(level, index, node); };
+    }
+
+    bool ReadAll(std::string& tree) {
+        tree.resize(static_cast<std::size_t>(size_));
+        return Read(0, &tree[0], tree.size());
+    }
+
+private:
+    bool Read(std::uint64_t offset, void* out, std::size_t bytes) {
+        if (offset > size_ || bytes > size_ - offset) {
+            return false;
+        }
+        if (tree_) {
+            std::memcpy(out, tree_->data() + offset, bytes);
+            return true;
+        }
+        file_.seekg(static_cast<std::streamoff>(offset));
+        file_.read(static_cast<char*>(out), static_cast<std::streamsize>(bytes));
+        return static_cast<bool>(file_);
+    }
+
+    std::shared_ptr<const std::string> tree_;
+    std::ifstream file_;
+    std::uint64_t size_;
+    std::size_t count_;
+    std::uint64_t byIdOffset_;
+    std::uint64_t levelsOffset_;
+    bool valid_;
+};
+
+bool WriteBlockTree(const std::string& path, const std::string& tree) {
+    std::ofstream out(path.c_str(), std::ios::binary | std::ios::trunc);
+    out.write(tree.data(), static_cast<std::streamsize>(tree.size()));
+    out.close();
+    if (!out) {
+        std::cerr << "Could not write " << path << "; keeping its block's tree in memory.\n";
+        return false;
+    }
+    return true;
+}
+
+// Reads the transactions with the given IDs through find and checks each
+// against its leaf. They must make up leaves [begin, begin + ids.size()),
+// whose entries are given; found comes back in AuditOrder.
+template <typename Find>
+AuditStatus CheckLeaves(BlockTreeReader& tree,
+                        std::size_t begin,
+                        const std::vector<BlockTreeEntry>& entries,
+                        const Find& find,
+                        std::vector<Transaction*>& found) {
+    std::vector<long long> ids;
+    ids.reserve(entries.size());
+    for (const BlockTreeEntry& entry : entries) {
+        ids.push_back(entry.id);
+    }
+    std::sort(ids.begin(), ids.end());
+    if (!find(ids, found)) {
+        return AuditStatus_Unreadable;
+    }
+    if (found.size() != entries.size()) {
+        return AuditStatus_Tampered;
+    }
+    std::sort(found.begin(), found.end(), [](const Transaction* a, const Transaction* b) { return AuditOrder(a, b); });
+    for (std::size_t i = 0; i < found.size(); ++i) {
+        Sha256Digest kept;
+        if (!tree.Node(0, begin + i, kept)) {
+            return AuditStatus_Unreadable;
+        }
+        if (HashTransaction(*found[i]) != kept) {
+            return AuditStatus_Tampered;
+        }
+    }
+    return AuditStatus_Proved;
+}
+
+} // namespace
+
+TransactionQuery::TransactionQuery()
+    : cardNumber(),
+      accountNumber(),
+      bankName(),
+      atmSerial(),
+      hasKind(false),
+      kind(TransactionKind_Deposit),
+      hasMinAmount(false),
+      minAmount(0),
+      hasMaxAmount(false),
+      maxAmount(0),
+      hasFrom(false),
+      fromMicros(0),
+      hasTo(false),
+      toMicros(0),
+      limit(0) {
+}
+
+bool ParseTransactionQuery(const std::string& text, TransactionQuery& query) {
+    std::stringstream stream(text);
+    std::string item;
+    while (std::getline(stream, item, ',')) {
+        if (item.empty()) {
+            continue;
+        }
+        std::size_t equals = item.find('=');
+        if (equals == std::string::npos) {
+            return false;
+        }
+        std::string key = item.substr(0, equals);
+        std::string value = item.substr(equals + 1);
+        if (key == "card") {
+            query.cardNumber = value;
+            continue;
+        }
+        if (key == "account") {
+            query.accountNumber = value;
+            continue;
+        }
+        if (key == "bank") {
+            query.bankName = value;
+            continue;
+        }
+        if (key == "atm") {
+            query.atmSerial = value;
+            continue;
+        }
+        if (key == "kind") {
+            if (!ParseKind(value, query.kind)) {
+                return false;
+            }
+            query.hasKind = true;
+            continue;
+        }
+        long long number = 0;
+        if (!ParseNumber(value, number)) {
+            return false;
+        }
+        if (key == "min") {
+            query.hasMinAmount = true;
+            query.minAmount = number;
+        } else if (key == "max") {
+            query.hasMaxAmount = true;
+            query.maxAmount = number;
+        } else if (key == "from" && number >= 0 && number <= MAX_QUERY_SECONDS) {
+            query.hasFrom = true;
+            query.fromMicros = number * 1000000;
+        } else if (key == "to" && number >= 0 && number <= MAX_QUERY_SECONDS) {
+            query.hasTo = true;
+            query.toMicros = number * 1000000;
+        } else if (key == "limit" && number >= 0) {
+            query.limit = static_cast<std::size_t>(number);
+        } else {
+            return false;
+        }
+    }
+    return true;
+}
+
+TransactionLedger::TransactionLedger()
+    : mutex_(),
+      records_(),
+      byCard_(),
+      byAccount_(),
+      byBank_(),
+      byAtm_(),
+      byKind_(),
+      byTime_(),
+      highestId_(0),
+      maxLag_(0),
+      timeHighWater_(),
+      timeSkew_(0),
+      open_(),
+      closingIds_(),
+      blocks_(),
+      auditTree_(),
+      segmentDirectory_(),
+      segmentRecords_(SEGMENT_RECORDS),
+      segmentFormat_(SegmentFormat_Raw),
+      sealFailed_(false),
+      segments_(),
+      segmentsEnabled_(false),
+      maintaining_(false),
+      maintained_() {
+}
+
+TransactionLedger::~TransactionLedger() {
+    if (!HasSegments()) {
+        return;
+    }
+    for (Transaction* transaction : records_) {
+        delete transaction;
+    }
+}
+
+void TransactionLedger::EnableSegments(const std::string& directory,
+                                       std::size_t segmentRecords,
+                                       SegmentFormat format) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    segmentDirectory_ = directory;
+    if (!segmentDirectory_.empty() && segmentDirectory_.back() != '/' && segmentDirectory_.back() != '\\') {
+        segmentDirectory_ += '/';
+    }
+    segmentRecords_ = segmentRecords > 0 ? segmentRecords : SEGMENT_RECORDS;
+    segmentFormat_ = format;
+    segmentsEnabled_.store(true, std::memory_order_release);
+}
+
+bool TransactionLedger::HasSegments() const {
+    return segmentsEnabled_.load(std::memory_order_acquire);
+}
+
+std::size_t TransactionLedger::SegmentCount() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return segments_.size();
+}
+
+void TransactionLedger::Add(Transaction* transaction) {
+    if (transaction == nullptr) {
+        return;
+    }
+    // Hashed before taking the lock; closing a block only combines leaves.
+    const AuditLeaf open = {transaction->getTime().wallMicros, transaction->getId(), HashTransaction(*transaction)};
+    std::unique_lock<std::mutex> lock(mutex_);
+    if (transaction->getId() < highestId_) {
+        maxLag_ = std::max(maxLag_, highestId_ - transaction->getId());
+    } else {
+        highestId_ = transaction->getId();
+    }
+    const std::uint32_t position = static_cast<std::uint32_t>(records_.size());
+    const long long micros = transaction->getTime().wallMicros;
+    const long long highWater = timeHighWater_.empty() ? micros : std::max(timeHighWater_.back(), micros);
+    timeSkew_ = std::max(timeSkew_, highWater - micros);
+    timeHighWater_.push_back(highWater);
+    records_.push_back(transaction);
+    IndexLocked(transaction, position);
+    // Late arrivals are rare and only a few places late, so open_ stays
+    // sorted for the price of a short walk back.
+    auto at = open_.end();
+    while (at != open_.begin() && (at - 1)->id > open.id) {
+        --at;
+    }
+    open_.insert(at, open);
+    if (maintaining_) {
+        return;
+    }
+    const std::size_t count = open_.size() >= 2 * segmentRecords_ ? segmentRecords_ : 0;
+    if (count > 0 || SealDueLocked()) {
+        Maintain(lock, count);
+    }
+}
+
+void TransactionLedger::IndexLocked(Transaction* transaction, std::uint32_t position) {
+    PostLocked(byCard_, transaction->getCardNumber(), position);
+    PostLocked(byAccount_, transaction->getSourceAccountNumber(), position);
+    PostLocked(byBank_, transaction->getSourceBankName(), position);
+    PostLocked(byAtm_, transaction->getAtmSerial(), position);
+    if (const TransferTarget* target = transaction->getTarget()) {
+        PostLocked(byAccount_, target->accountNumber, position);
+        PostLocked(byBank_, target->bankName, position);
+    }
+    byKind_[transaction->getKind()].push_back(position);
+    byTime_.Add(transaction);
+}
+
+void TransactionLedger::Find(const TransactionQuery& query,
+                             std::vector<Transaction*>& out,
+                             LoadedTransactions& loaded) const {
+    const std::size_t first = out.size();
+    std::vector<TransactionSegment> segments;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        segments = segments_;
+        FindLocked(query, out);
+        if (HasSegments()) {
+            CopyMatches(out, first, loaded);
+        }
+    }
+    // Segment files never change, so they are read without the lock.
+    for (const TransactionSegment& segment : segments) {
+        segment.Find(query, out, loaded);
+    }
+
+    // Positions follow the order of Add, which threads can make differ
+    // slightly from ID order.
+    std::sort(out.begin() + static_cast<std::ptrdiff_t>(first), out.end(), HasLowerId);
+    if (query.limit > 0 && out.size() - first > query.limit) {
+        out.resize(first + query.limit);
+    }
+}
+
+void TransactionLedger::FindLocked(const TransactionQuery& query, std::vector<Transaction*>& out) const {
+    std::vector<const PostingList*> lists;
+    const std::pair<const PostingIndex*, const std::string*> filters[] = {
+        {&byCard_, &query.cardNumber},
+        {&byAccount_, &query.accountNumber},
+        {&byBank_, &query.bankName},
+        {&byAtm_, &query.atmSerial},
+    };
+    for (const auto& filter : filters) {
+        if (filter.second->empty()) {
+            continue;
+        }
+        auto found = filter.first->find(*filter.second);
+        if (found == filter.first->end()) {
+            return;
+        }
+        lists.push_back(&found->second);
+    }
+    if (query.hasKind) {
+        lists.push_back(&byKind_[query.kind]);
+    }
+
+    if (!lists.empty()) {
+        // Start from the list with the fewest entries in the time range;
+        // without one, that is the whole of each list.
+        std::size_t shortest = 0;
+        std::size_t begin = 0;
+        std::size_t end = lists[0]->size();
+        for (std::size_t i = 0; i < lists.size(); ++i) {
+            std::size_t first = 0;
+            std::size_t last = lists[i]->size();
+            TimeWindowLocked(query, *lists[i], first, last);
+            if (i == 0 || last - first < end - begin) {
+                shortest = i;
+                begin = first;
+                end = last;
+            }
+        }
+        PostingList candidates(lists[shortest]->begin() + static_cast<std::ptrdiff_t>(begin),
+                               lists[shortest]->begin() + static_cast<std::ptrdiff_t>(end));
+        for (std::size_t i = 0; i < lists.size() && !candidates.empty(); ++i) {
+            if (i != shortest) {
+                Intersect(candidates, *lists[i]);
+            }
+        }
+        for (std::uint32_t position : candidates) {
+            if (MatchesRanges(query, records_[position])) {
+                out.push_back(records_[position]);
+            }
+        }
+    } else if (query.hasFrom || query.hasTo) {
+        std::size_t start = out.size();
+        byTime_.Find(query.hasFrom ? query.fromMicros : LLONG_MIN,
+                     query.hasTo ? query.toMicros : LLONG_MAX, out);
+        std::size_t kept = start;
+        for (std::size_t i = start; i < out.size(); ++i) {
+            if (MatchesRanges(query, out[i])) {
+                out[kept++] = out[i];
+            }
+        }
+        out.resize(kept);
+    } else {
+        for (Transaction* transaction : records_) {
+            if (MatchesRanges(query, transaction)) {
+                out.push_back(transaction);
+            }
+        }
+    }
+}
+
+void TransactionLedger::TimeWindowLocked(const TransactionQuery& query,
+                                         const PostingList& list,
+                                         std::size_t& begin,
+                                         std::size_t& end) const {
+    const auto highWaterBelow = [this](std::uint32_t position, long long micros) {
+        return timeHighWater_[position] < micros;
+    };
+    if (query.hasFrom) {
+        begin = static_cast<std::size_t>(
+            std::lower_bound(list.begin(), list.end(), query.fromMicros, highWaterBelow) - list.begin());
+    }
+    if (query.hasTo && query.toMicros <= LLONG_MAX - timeSkew_) {
+        end = static_cast<std::size_t>(
+            std::lower_bound(list.begin() + static_cast<std::ptrdiff_t>(begin), list.end(),
+                             query.toMicros + timeSkew_, highWaterBelow) -
+            list.begin());
+    }
+}
+
+void TransactionLedger::FindAccountHistory(const std::string& accountNumber,
+                                           long long beforeId,
+                                           std::size_t count,
+                                           std::vector<Transaction*>& out,
+                                           LoadedTransactions& loaded) const {
+    if (count == 0) {
+        return;
+    }
+    std::vector<Transaction*> page;
+    std::vector<TransactionSegment> segments;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        FindAccountHistoryLocked(accountNumber, beforeId, count, page);
+        if (HasSegments()) {
+            CopyMatches(page, 0, loaded);
+        }
+        segments = segments_;
+    }
+    // Newest segment first. Once the page is full, a segment can only
+    // improve it if it holds an ID above the page's lowest.
+    for (auto segment = segments.rbegin(); segment != segments.rend(); ++segment) {
+        if (page.size() >= count && segment->LastId() < page.back()->getId()) {
+            continue;
+        }
+        segment->FindAccountHistory(accountNumber, beforeId, count, page, loaded);
+        std::sort(page.begin(), page.end(), HasHigherId);
+        if (page.size() > count) {
+            page.resize(count);
+        }
+    }
+    out.insert(out.end(), page.begin(), page.end());
+}
+
+void TransactionLedger::FindAccountHistoryLocked(const std::string& accountNumber,
+                                                 long long beforeId,
+                                                 std::size_t count,
+                                                 std::vector<Transaction*>& out) const {
+    auto found = byAccount_.find(accountNumber);
+    if (found == byAccount_.end()) {
+        return;
+    }
+    const PostingList& list = found->second;
+    // Find where IDs cross beforeId as if positions were in ID order, then
+    // widen by the lag so late arrivals on either side are not missed.
+    const std::size_t slack = static_cast<std::size_t>(2 * maxLag_);
+    std::size_t end = static_cast<std::size_t>(
+        std::partition_point(list.begin(), list.end(),
+                             [this, beforeId](std::uint32_t position) {
+                                 return records_[position]->getId() < beforeId;
+                             }) -
+        list.begin());
+    end = std::min(list.size(), end + slack);
+
+    const std::size_t first = out.size();
+    std::size_t extra = 0;
+    for (std::size_t i = end; i > 0; --i) {
+        Transaction* transaction = records_[list[i - 1]];
+        if (transaction->getId() >= beforeId) {
+            continue;
+        }
+        if (out.size() - first >= count && extra++ >= slack) {
+            break;
+        }
+        out.push_back(transaction);
+    }
+    std::sort(out.begin() + static_cast<std::ptrdiff_t>(first), out.end(), HasHigherId);
+    if (out.size() - first > count) {
+        out.resize(first + count);
+    }
+}
+
+void TransactionLedger::ForEachBatch(const std::function<void(const std::vector<Transaction*>&)>& visit) const {
+    for (const TransactionSegment& segment : Segments()) {
+        LoadedTransactions loaded;
+        std::vector<Transaction*> batch;
+        segment.ReadAll(batch, loaded);
+        visit(batch);
+    }
+    ForEachInMemory([&visit](const std::vector<Transaction*>& records) {
+        std::vector<Transaction*> batch(records);
+        std::sort(batch.begin(), batch.end(), HasLowerId);
+        visit(batch);
+    });
+}
+
+std::vector<TransactionSegment> TransactionLedger::Segments() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return segments_;
+}
+
+void TransactionLedger::ForEachInMemory(const std::function<void(const std::vector<Transaction*>&)>& visit) const {
+    // Held through the visit so no seal frees the batch under it.
+    std::lock_guard<std::mutex> lock(mutex_);
+    visit(records_);
+}
+
+std::size_t TransactionLedger::Size() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::size_t size = records_.size();
+    for (const TransactionSegment& segment : segments_) {
+        size += segment.Size();
+    }
+    return size;
+}
+
+bool TransactionLedger::CloseBlock() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    maintained_.wait(lock, [this] { return !maintaining_; });
+    if (open_.empty()) {
+        return false;
+    }
+    Maintain(lock, open_.size());
+    return true;
+}
+
+std::size_t TransactionLedger::BlockCount() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return blocks_.size();
+}
+
+Sha256Digest TransactionLedger::AuditRoot() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return auditTree_.Root();
+}
+
+AuditStatus TransactionLedger::ProveTransaction(long long id,
+                                                TransactionProof& proof,
+                                                Sha256Digest& root,
+                                                Transaction*& transaction,
+                                                LoadedTransactions& loaded) const {
+    transaction = nullptr;
+    std::vector<ClosedBlock> candidates;
+    std::vector<Sha256Digest> blockHashes;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        const auto open = std::lower_bound(open_.begin(), open_.end(), id,
+                                           [](const AuditLeaf& leaf, long long value) { return leaf.id < value; });
+        if ((open != open_.end() && open->id == id) ||
+            std::binary_search(closingIds_.begin(), closingIds_.end(), id)) {
+            return AuditStatus_Open;
+        }
+        blockHashes.reserve(blocks_.size());
+        for (const ClosedBlock& block : blocks_) {
+            blockHashes.push_back(block.header.hash);
+            // Late arrivals can make the ID ranges of blocks overlap.
+            if (block.header.firstId <= id && id <= block.header.lastId) {
+                candidates.push_back(block);
+            }
+        }
+    }
+
+    for (const ClosedBlock& block : candidates) {
+        BlockTreeReader tree(block.tree, block.treePath);
+        if (!tree.Valid() || tree.Count() != block.header.count) {
+            return AuditStatus_Unreadable;
+        }
+        std::size_t leaf = 0;
+        AuditStatus status = tree.FindId(id, leaf);
+        if (status == AuditStatus_NotFound) {
+            continue;
+        }
+        std::vector<BlockTreeEntry> entries;
+        if (status != AuditStatus_Proved || !tree.Entries(leaf, leaf + 1, entries)) {
+            return AuditStatus_Unreadable;
+        }
+        // Only the proved transaction is read back and re-hashed.
+        std::vector<Transaction*> found;
+        LoadedTransactions owned;
+        status = CheckLeaves(tree, leaf, entries,
+                             [this, &owned](const std::vector<long long>& ids, std::vector<Transaction*>& out) {
+                                 return FindIds(ids, out, owned);
+                             },
+                             found);
+        if (status != AuditStatus_Proved) {
+            return status;
+        }
+        Sha256Digest blockRoot;
+        if (!MerkleRangeProofFromLevels(tree.Count(), leaf, leaf + 1, tree.Nodes(), proof.blockPath, blockRoot)) {
+            return AuditStatus_Unreadable;
+        }
+        if (blockRoot != block.header.root) {
+            return AuditStatus_Tampered;
+        }
+        const std::size_t number = static_cast<std::size_t>(block.header.number);
+        proof.block = block.header;
+        proof.leaf = leaf;
+        proof.blockCount = blockHashes.size();
+        proof.ledgerPath = MerkleRangeProof(blockHashes, number, number + 1, root);
+        transaction = found.front();
+        for (std::unique_ptr<Transaction>& copy : owned) {
+            loaded.push_back(std::move(copy));
+        }
+        return AuditStatus_Proved;
+    }
+    return AuditStatus_NotFound;
+}
+
+AuditStatus TransactionLedger::ProveTimeRange(long long fromMicros,
+                                              long long toMicros,
+                                              TimeRangeProof& proof,
+                                              Sha256Digest& root) const {
+    proof.fromMicros = fromMicros;
+    proof.toMicros = toMicros;
+    proof.blocks.clear();
+    proof.ranges.clear();
+    std::vector<ClosedBlock> overlapping;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        proof.blocks.reserve(blocks_.size());
+        for (const ClosedBlock& block : blocks_) {
+            proof.blocks.push_back(block.header);
+            if (BlockOverlaps(block.header, fromMicros, toMicros)) {
+                overlapping.push_back(block);
+            }
+        }
+        root = auditTree_.Root();
+    }
+
+    for (const ClosedBlock& block : overlapping) {
+        BlockTreeReader tree(block.tree, block.treePath);
+        if (!tree.Valid() || tree.Count() != block.header.count) {
+            return AuditStatus_Unreadable;
+        }
+        // The run in range plus one neighbour on each side that has one,
+        // which shows the run is complete.
+        std::size_t begin = 0;
+        std::size_t end = 0;
+        if (!tree.LowerBound(fromMicros, begin) || !tree.LowerBound(toMicros, end)) {
+            return AuditStatus_Unreadable;
+        }
+        begin = begin > 0 ? begin - 1 : 0;
+        end = std::min(tree.Count(), end + 1);
+        std::vector<BlockTreeEntry> entries;
+        if (!tree.Entries(begin, end, entries)) {
+            return AuditStatus_Unreadable;
+        }
+
+        BlockRangeProof range;
+        range.block = block.header.number;
+        range.begin = begin;
+        AuditStatus status = CheckLeaves(tree, begin, entries,
+                                         [this, &proof](const std::vector<long long>& ids,
+                                                        std::vector<Transaction*>& out) {
+                                             return FindIds(ids, out, proof.loaded);
+                                         },
+                                         range.transactions);
+        if (status != AuditStatus_Proved) {
+            return status;
+        }
+        Sha256Digest blockRoot;
+        if (!MerkleRangeProofFromLevels(tree.Count(), begin, end, tree.Nodes(), range.path, blockRoot)) {
+            return AuditStatus_Unreadable;
+        }
+        if (blockRoot != block.header.root) {
+            return AuditStatus_Tampered;
+        }
+        proof.ranges.push_back(std::move(range));
+    }
+    return AuditStatus_Proved;
+}
+
+AuditStatus TransactionLedger::VerifyBlock(std::uint64_t number) const {
+    ClosedBlock block;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (number >= blocks_.size()) {
+            return AuditStatus_NotFound;
+        }
+        block = blocks_[static_cast<std::size_t>(number)];
+    }
+    BlockTreeReader tree(block.tree, block.treePath);
+    std::vector<BlockTreeEntry> entries;
+    std::string kept;
+    if (!tree.Valid() || tree.Count() != block.header.count || !tree.Entries(0, tree.Count(), entries) ||
+        !tree.ReadAll(kept)) {
+        return AuditStatus_Unreadable;
+    }
+    std::vector<Transaction*> found;
+    LoadedTransactions owned;
+    AuditStatus status = CheckLeaves(tree, 0, entries,
+                                     [this, &owned](const std::vector<long long>& ids, std::vector<Transaction*>& out) {
+                                         return FindIds(ids, out, owned);
+                                     },
+                                     found);
+    if (status != AuditStatus_Proved) {
+        return status;
+    }
+    // Rebuilding the whole tree from the transactions checks the kept nodes
+    // as well as the root.
+    std::vector<AuditLeaf> leaves;
+    leaves.reserve(found.size());
+    for (const Transaction* transaction : found) {
+        leaves.push_back(AuditLeaf{transaction->getTime().wallMicros, transaction->getId(), HashTransaction(*transaction)});
+    }
+    Sha256Digest rebuiltRoot;
+    const std::string rebuilt = BuildBlockTree(leaves, rebuiltRoot);
+    return rebuiltRoot == block.header.root && rebuilt == kept ? AuditStatus_Proved : AuditStatus_Tampered;
+}
+
+bool TransactionLedger::FindIds(const std::vector<long long>& ids,
+                                std::vector<Transaction*>& out,
+                                LoadedTransactions& loaded) const {
+    const std::size_t first = out.size();
+    std::vector<long long> missing;
+    std::vector<TransactionSegment> segments;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        FindIdsLocked(ids, out, missing);
+        if (HasSegments()) {
+            CopyMatches(out, first, loaded);
+        }
+        if (!missing.empty()) {
+            segments = segments_;
+        }
+    }
+    bool readable = true;
+    for (const TransactionSegment& segment : segments) {
+        readable = segment.FindIds(missing, out, loaded) && readable;
+    }
+    std::sort(out.begin() + static_cast<std::ptrdiff_t>(first), out.end(), HasLowerId);
+    return readable;
+}
+
+void TransactionLedger::FindIdsLocked(const std::vector<long long>& ids,
+                                      std::vector<Transaction*>& out,
+                                      std::vector<long long>& missing) const {
+    const std::size_t slack = static_cast<std::size_t>(2 * maxLag_ + 1);
+    for (long long id : ids) {
+        const std::size_t at =
+            FindNearlySorted(records_, id, slack, [](const Transaction* transaction) { return transaction->getId(); });
+        if (at < records_.size()) {
+            out.push_back(records_[at]);
+        } else {
+            missing.push_back(id);
+        }
+    }
+}
+
+bool TransactionLedger::SealDueLocked() const {
+    return HasSegments() && !sealFailed_ && records_.size() >= 2 * segmentRecords_;
+}
+
+void TransactionLedger::Maintain(std::unique_lock<std::mutex>& lock, std::size_t count) {
+    maintaining_ = true;
+    std::vector<Transaction*> freed;
+    bool seal = SealDueLocked();
+    while (count > 0 || seal) {
+        Maintenance work;
+        TakeLocked(count, seal, work);
+        lock.unlock();
+        for (Transaction* transaction : freed) {
+            delete transaction;
+        }
+        freed.clear();
+        Prepare(work);
+        lock.lock();
+        CommitLocked(work);
+        if (work.sealed) {
+            freed.swap(work.sealing);
+        }
+        // Adds carried on meanwhile, so more may be due already.
+        count = open_.size() >= 2 * segmentRecords_ ? segmentRecords_ : 0;
+        seal = SealDueLocked();
+    }
+    maintaining_ = false;
+    lock.unlock();
+    maintained_.notify_all();
+    // Readers copy what they take while holding the lock, so nothing
+    // outside it still points at these.
+    for (Transaction* transaction : freed) {
+        delete transaction;
+    }
+}
+
+void TransactionLedger::TakeLocked(std::size_t count, bool seal, Maintenance& work) {
+    work.hasPrevious = !blocks_.empty();
+    work.sealCount = 0;
+    work.sealedThroughId = 0;
+    work.format = segmentFormat_;
+    work.sealed = false;
+    if (count > 0) {
+        const auto end = open_.begin() + static_cast<std::ptrdiff_t>(count);
+        work.closing.assign(open_.begin(), end);
+        open_.erase(open_.begin(), end);
+        closingIds_.reserve(count);
+        for (const AuditLeaf& leaf : work.closing) {
+            closingIds_.push_back(leaf.id);
+        }
+        if (work.hasPrevious) {
+            work.previous = blocks_.back().header;
+        }
+        if (HasSegments()) {
+            char name[32];
+            std::snprintf(name, sizeof(name), "block-%06u.atmtree", static_cast<unsigned>(blocks_.size() + 1));
+            work.treePath = segmentDirectory_ + name;
+        }
+    }
+    if (seal) {
+        // Only this thread removes from records_, so these stay alive and
+        // in memory until CommitLocked.
+        work.sealing = records_;
+        work.sealCount = segmentRecords_;
+        char name[32];
+        std::snprintf(name, sizeof(name), "segment-%06u.atmseg", static_cast<unsigned>(segments_.size() + 1));
+        work.segmentPath = segmentDirectory_ + name;
+    }
+}
+
+void TransactionLedger::Prepare(Maintenance& work) {
+    if (!work.closing.empty()) {
+        std::sort(work.closing.begin(), work.closing.end(),
+                  [](const AuditLeaf& a, const AuditLeaf& b) { return AuditOrder(a, b); });
+        Sha256Digest root;
+        work.block.tree = std::make_shared<const std::string>(BuildBlockTree(work.closing, root));
+        work.block.header = MakeAuditBlock(work.closing, root, work.hasPrevious ? &work.previous : nullptr);
+        if (!work.treePath.empty() && WriteBlockTree(work.treePath, *work.block.tree)) {
+            work.block.treePath = work.treePath;
+            work.block.tree.reset();
+        }
+    }
+    if (work.sealCount > 0) {
+        std::vector<long long> ids;
+        ids.reserve(work.sealing.size());
+        for (const Transaction* transaction : work.sealing) {
+            ids.push_back(transaction->getId());
+        }
+        std::vector<long long> lowest(ids);
+        std::nth_element(lowest.begin(), lowest.begin() + static_cast<std::ptrdiff_t>(work.sealCount - 1),
+                         lowest.end());
+        work.sealedThroughId = lowest[work.sealCount - 1];
+        work.moved.assign(ids.size(), SEALED_POSITION);
+        std::size_t kept = 0;
+        std::size_t sealed = 0;
+        for (std::size_t i = 0; i < ids.size(); ++i) {
+            if (ids[i] <= work.sealedThroughId) {
+                work.sealing[sealed++] = work.sealing[i];
+            } else {
+                work.moved[i] = static_cast<std::uint32_t>(kept++);
+            }
+        }
+        work.sealing.resize(sealed);
+        std::sort(work.sealing.begin(), work.sealing.end(), HasLowerId);
+        work.sealed = TransactionSegment::Write(work.segmentPath, work.sealing, work.format, work.segment);
+    }
+}
+
+void TransactionLedger::CommitLocked(Maintenance& work) {
+    if (!work.closing.empty()) {
+        auditTree_.Append(work.block.header.hash);
+        blocks_.push_back(std::move(work.block));
+        closingIds_.clear();
+    }
+    if (work.sealCount == 0) {
+        return;
+    }
+    if (!work.sealed) {
+        std::cerr << "Keeping transactions in memory from now on.\n";
+        sealFailed_ = true;
+        return;
+    }
+    segments_.push_back(work.segment);
+    RemoveSealedLocked(work);
+}
+
+void TransactionLedger::RemoveSealedLocked(Maintenance& work) {
+    // Positions past the ones Prepare saw were added since and all stay,
+    // including any late arrival with an ID among the sealed ones.
+    std::vector<std::uint32_t>& moved = work.moved;
+    std::uint32_t next = static_cast<std::uint32_t>(moved.size() - work.sealing.size());
+    std::vector<long long> late;
+    for (std::size_t i = moved.size(); i < records_.size(); ++i) {
+        moved.push_back(next++);
+        if (records_[i]->getId() <= work.sealedThroughId) {
+            late.push_back(records_[i]->getId());
+        }
+    }
+    std::sort(late.begin(), late.end());
+    for (std::size_t i = 0; i < records_.size(); ++i) {
+        if (moved[i] != SEALED_POSITION) {
+            records_[moved[i]] = records_[i];
+        }
+    }
+    records_.resize(next);
+    for (std::size_t i = 0; i < moved.size(); ++i) {
+        if (moved[i] != SEALED_POSITION) {
+            timeHighWater_[moved[i]] = timeHighWater_[i];
+        }
+    }
+    timeHighWater_.resize(next);
+    for (PostingIndex* index : {&byCard_, &byAccount_, &byBank_, &byAtm_}) {
+        for (auto entry = index->begin(); entry != index->end();) {
+            MovePostings(entry->second, moved);
+            entry = entry->second.empty() ? index->erase(entry) : std::next(entry);
+        }
+    }
+    for (PostingList& list : byKind_) {
+        MovePostings(list, moved);
+    }
+    const long long sealedThroughId = work.sealedThroughId;
+    byTime_.RemoveIf([sealedThroughId, &late](const Transaction* transaction) {
+        return transaction->getId() <= sealedThroughId &&
+               !std::binary_search(late.begin(), late.end(), transaction->getId());
+    });
+}
+
+void TransactionLedger::PostLocked(PostingIndex& index, const std::string& key, std::uint32_t position) {
+    PostingList& list = index[key];
+    // A transfer within one bank posts the bank once.
+    if (list.empty() || list.back() != position) {
+        list.push_back(position);
+    }
+}
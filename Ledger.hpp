@@ -0,0 +1,258 @@
+#ifndef LEDGER_HPP
+#define LEDGER_HPP
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "Audit.hpp"
+#include "Segment.hpp"
+#include "TimeIndex.hpp"
+#include "Transaction.hpp"
+
+// Transactions per sealed segment, and per audit block the ledger closes
+// by itself, unless it is told otherwise.
+const std::size_t SEGMENT_RECORDS = 65536;
+
+// Narrows a transaction search. Empty strings and unset bounds match every
+// transaction; the filters that are set must all match.
+struct TransactionQuery {
+    std::string cardNumber;
+    // Account and bank match either side of a transfer.
+    std::string accountNumber;
+    std::string bankName;
+    std::string atmSerial;
+    bool hasKind;
+    TransactionKind kind;
+    bool hasMinAmount;
+    long long minAmount;
+    bool hasMaxAmount;
+    long long maxAmount;
+    // Wall-clock microseconds; from is inclusive, to exclusive.
+    bool hasFrom;
+    long long fromMicros;
+    bool hasTo;
+    long long toMicros;
+    // When non-zero, only the first `limit` matches.
+    std::size_t limit;
+
+    TransactionQuery();
+};
+
+// Parses "card=C,account=A,bank=B,atm=S,kind=withdrawal,min=N,max=N,
+// from=T,to=T,limit=N" (any subset, any order). Kinds are deposit,
+// withdrawal, accounttransfer and cashtransfer; from and to are Unix times
+// in seconds. Returns false on an unknown key or a malformed value.
+bool ParseTransactionQuery(const std::string& text, TransactionQuery& query);
+
+// Every transaction of the run with inverted indexes on card, account,
+// bank, ATM and kind. Each index maps a value to the positions (order of
+// Add) of its transactions, so a query intersects the posting lists of its
+// filters, smallest first, instead of scanning the history. Time ranges go
+// through the per-minute index when nothing narrower is given; amounts are
+// checked on the survivors. Add may come from any ATM's strand.
+//
+// With segments enabled the ledger owns the transactions given to Add and
+// keeps only the newest in memory: once it holds twice segmentRecords, the
+// segmentRecords with the lowest IDs are sealed into a segment file, dropped
+// from the in-memory indexes, and freed. Searches read the segments as well, and copy their in-memory
+// matches before dropping the lock, so every match comes back owned by
+// LoadedTransactions and stays good however many seals follow.
+//
+// Every transaction is also hashed as it is added (see Audit.hpp). Once
+// twice segmentRecords are open, the lowest segmentRecords IDs are closed
+// into an audit block chained to the one before, and the block's hash is
+// appended to the Merkle tree behind AuditRoot. Closing and sealing are
+// separate, so CloseBlock can close a small block without writing a small
+// segment. Each block keeps its tree: every leaf's time and ID, the leaves
+// by ID, and every level of nodes, in memory or, with segments, in a
+// block-NNNNNN.atmtree file beside them. A proof reads a path's worth of it
+// and re-hashes only the transactions it proves, so an edited record it
+// reads shows up as AuditStatus_Tampered; VerifyBlock re-hashes a whole
+// block.
+//
+// Closing and sealing run one at a time, on the thread whose Add made them
+// due. That thread takes what it needs under the lock, builds the tree and
+// writes the files without it, then takes the lock again to publish the
+// block and segment, so other threads keep adding and searching meanwhile.
+class TransactionLedger {
+public:
+    TransactionLedger();
+    ~TransactionLedger();
+
+    // Seals into files of the given format under directory from now on.
+    // Call before the first Add; the directory must exist.
+    void EnableSegments(const std::string& directory,
+                        std::size_t segmentRecords = SEGMENT_RECORDS,
+                        SegmentFormat format = SegmentFormat_Raw);
+    bool HasSegments() const;
+    std::size_t SegmentCount() const;
+
+    void Add(Transaction* transaction);
+    // Appends the matching transactions in ID order. With segments every
+    // match is owned by loaded.
+    void Find(const TransactionQuery& query, std::vector<Transaction*>& out, LoadedTransactions& loaded) const;
+    // Appends up to count of the account's transactions with an ID below
+    // beforeId, newest first; for paging account history.
+    void FindAccountHistory(const std::string& accountNumber,
+                            long long beforeId,
+                            std::size_t count,
+                            std::vector<Transaction*>& out,
+                            LoadedTransactions& loaded) const;
+    // Hands every transaction to visit in batches: each segment in turn,
+    // then the in-memory ones, each batch in ID order. Only one segment is
+    // loaded at a time.
+    void ForEachBatch(const std::function<void(const std::vector<Transaction*>&)>& visit) const;
+    // The two halves of ForEachBatch, for callers that read the segments
+    // on threads of their own: the sealed segments, oldest first, and the
+    // in-memory transactions in one batch in the order they were added,
+    // which skips ForEachBatch's sort. The ledger is locked during visit.
+    std::vector<TransactionSegment> Segments() const;
+    void ForEachInMemory(const std::function<void(const std::vector<Transaction*>&)>& visit) const;
+    // In memory and sealed.
+    std::size_t Size() const;
+
+    // Closes every open transaction into a block now, so AuditRoot covers
+    // them; nothing is sealed. False when none were open.
+    bool CloseBlock();
+    std::size_t BlockCount() const;
+    // Merkle root over the hashes of the closed blocks.
+    Sha256Digest AuditRoot() const;
+    // Proves the transaction with the given ID against root, the ledger's
+    // root at the time, from its block's kept tree. The transaction itself
+    // goes to transaction, owned by loaded with segments.
+    AuditStatus ProveTransaction(long long id,
+                                 TransactionProof& proof,
+                                 Sha256Digest& root,
+                                 Transaction*& transaction,
+                                 LoadedTransactions& loaded) const;
+    // Proves every closed transaction with a wall-clock time in
+    // [fromMicros, toMicros) against root.
+    AuditStatus ProveTimeRange(long long fromMicros,
+                               long long toMicros,
+                               TimeRangeProof& proof,
+                               Sha256Digest& root) const;
+    // Reads back every transaction of block number, re-hashes it and
+    // rebuilds the block's tree, which must match the kept one and the
+    // block's root. Costs the whole block where a proof reads one path;
+    // AuditStatus_NotFound when no such block has closed.
+    AuditStatus VerifyBlock(std::uint64_t number) const;
+
+private:
+    TransactionLedger(const TransactionLedger&) = delete;
+    TransactionLedger& operator=(const TransactionLedger&) = delete;
+
+    typedef std::vector<std::uint32_t> PostingList;
+    typedef std::unordered_map<std::string, PostingList> PostingIndex;
+
+    static void PostLocked(PostingIndex& index, const std::string& key, std::uint32_t position);
+    void IndexLocked(Transaction* transaction, std::uint32_t position);
+    void FindLocked(const TransactionQuery& query, std::vector<Transaction*>& out) const;
+    // Narrows list[begin, end) to the positions that can fall in the
+    // query's time range; leaves them be when it has none.
+    void TimeWindowLocked(const TransactionQuery& query,
+                          const PostingList& list,
+                          std::size_t& begin,
+                          std::size_t& end) const;
+    void FindAccountHistoryLocked(const std::string& accountNumber,
+                                  long long beforeId,
+                                  std::size_t count,
+                                  std::vector<Transaction*>& out) const;
+    // The transactions with the given IDs, which must be ascending, from
+    // memory or the segments, in ID order; with segments they are owned by
+    // loaded. False when a segment could not be read.
+    bool FindIds(const std::vector<long long>& ids, std::vector<Transaction*>& out, LoadedTransactions& loaded) const;
+    void FindIdsLocked(const std::vector<long long>& ids,
+                       std::vector<Transaction*>& out,
+                       std::vector<long long>& missing) const;
+
+    struct ClosedBlock {
+        AuditBlock header;
+        // The block's tree (see Ledger.cpp), in memory until it is written
+        // to treePath.
+        std::shared_ptr<const std::string> tree;
+        std::string treePath;
+    };
+
+    // What one round of closing and sealing takes out from under the lock.
+    struct Maintenance {
+        // The leaves to close, and what the new block's header needs.
+        std::vector<AuditLeaf> closing;
+        bool hasPrevious;
+        AuditBlock previous;
+        std::string treePath;
+        ClosedBlock block;
+        // The in-memory transactions, of which the sealCount with the
+        // lowest IDs are sealed: those with IDs up to sealedThroughId.
+        // Prepare leaves only the sealed ones, in ID order, and where each
+        // position of records_ moves once they are gone.
+        std::vector<Transaction*> sealing;
+        std::size_t sealCount;
+        long long sealedThroughId;
+        std::vector<std::uint32_t> moved;
+        std::string segmentPath;
+        SegmentFormat format;
+        TransactionSegment segment;
+        bool sealed;
+    };
+
+    bool SealDueLocked() const;
+    // Closes the count open transactions with the lowest IDs, then keeps
+    // closing and sealing while either is due. Called with lock held;
+    // returns with it released.
+    void Maintain(std::unique_lock<std::mutex>& lock, std::size_t count);
+    void TakeLocked(std::size_t count, bool seal, Maintenance& work);
+    // The slow part, run without the lock.
+    static void Prepare(Maintenance& work);
+    void CommitLocked(Maintenance& work);
+    void RemoveSealedLocked(Maintenance& work);
+
+    mutable std::mutex mutex_;
+    std::vector<Transaction*> records_;
+    PostingIndex byCard_;
+    PostingIndex byAccount_;
+    PostingIndex byBank_;
+    PostingIndex byAtm_;
+    PostingList byKind_[TransactionKind_CashTransfer + 1];
+    TransactionTimeIndex byTime_;
+    long long highestId_;
+    // How far below highestId_ the latest late transaction was. Fewer than
+    // this many IDs fall between any two transactions added out of order, so
+    // position order is ID order give or take that many entries.
+    long long maxLag_;
+    // The latest wall-clock time among records_[0..i], for each i; it never
+    // falls, so a posting list can be binary-searched by it. No transaction
+    // is more than timeSkew_ earlier than its entry, so those with times in
+    // [from, to) have entries in [from, to + timeSkew_).
+    std::vector<long long> timeHighWater_;
+    long long timeSkew_;
+
+    // Added but not yet in a block, in ID order.
+    std::vector<AuditLeaf> open_;
+    // The IDs being closed into a block right now, in order.
+    std::vector<long long> closingIds_;
+    std::vector<ClosedBlock> blocks_;
+    MerkleFrontier auditTree_;
+
+    std::string segmentDirectory_;
+    std::size_t segmentRecords_;
+    SegmentFormat segmentFormat_;
+    // Set when a segment could not be written; everything then stays in
+    // memory rather than retrying on every Add.
+    bool sealFailed_;
+    std::vector<TransactionSegment> segments_;
+    std::atomic<bool> segmentsEnabled_;
+    // Set while a thread is closing or sealing; CloseBlock waits for it to
+    // clear so blocks stay in order.
+    bool maintaining_;
+    std::condition_variable maintained_;
+};
+
+#endif // LEDGER_HPP
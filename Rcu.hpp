@@ -0,0 +1,67 @@
+#ifndef RCU_HPP
+#define RCU_HPP
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+// Read-copy-update cell holding an immutable value. Read() is one acquire
+// load; Publish() swaps in a new version from any thread without waiting
+// for readers. A replaced version stays alive until the owner calls
+// Reclaim() at a quiescent point, i.e. when none of its readers can still
+// hold a reference from before that call.
+template <typename Value>
+class RcuCell {
+public:
+    explicit RcuCell(const Value& initial) : current_(new Value(initial)), mutex_(), retired_() {}
+
+    ~RcuCell() {
+        delete current_.load(std::memory_order_relaxed);
+        for (const Value* value : retired_) {
+            delete value;
+        }
+    }
+
+    const Value& Read() const {
+        return *current_.load(std::memory_order_acquire);
+    }
+
+    void Publish(const Value& value) {
+        const Value* next = new Value(value);
+        std::lock_guard<std::mutex> lock(mutex_);
+        retired_.push_back(current_.exchange(next, std::memory_order_acq_rel));
+    }
+
+    // Copies the current version, lets update edit the copy and publishes
+    // it. Updates are serialized, so concurrent updaters never lose edits.
+    template <typename Update>
+    void Modify(Update update) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        std::unique_ptr<Value> next(new Value(*current_.load(std::memory_order_relaxed)));
+        update(*next);
+        retired_.push_back(current_.exchange(next.release(), std::memory_order_acq_rel));
+    }
+
+    void Reclaim() {
+        std::vector<const Value*> freed;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            freed.swap(retired_);
+        }
+        for (const Value* value : freed) {
+            delete value;
+        }
+    }
+
+private:
+    RcuCell(const RcuCell&) = delete;
+    RcuCell& operator=(const RcuCell&) = delete;
+
+    std::atomic<const Value*> current_;
+    // Guards retired_ and serializes publishers.
+    std::mutex mutex_;
+    std::vector<const Value*> retired_;
+};
+
+#endif // RCU_HPP
@@ -0,0 +1,133 @@
+#include "Receipt.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+namespace {
+
+// Room for a typical session's receipt, so the first one does not regrow.
+const std::size_t INITIAL_RECEIPT_CAPACITY = 2048;
+
+} // namespace
+
+ReceiptSink::~ReceiptSink() {
+}
+
+StreamReceiptSink::StreamReceiptSink(std::ostream& out)
+    : out_(&out) {
+}
+
+void StreamReceiptSink::Write(const char* data, std::size_t size) {
+    out_->write(data, static_cast<std::streamsize>(size));
+}
+
+FileReceiptSink::FileReceiptSink(const std::string& filename)
+    : mutex_(),
+      out_(filename, std::ios::app) {
+}
+
+bool FileReceiptSink::IsOpen() const {
+    return out_.is_open();
+}
+
+void FileReceiptSink::Write(const char* data, std::size_t size) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    out_.write(data, static_cast<std::streamsize>(size));
+    out_.flush();
+}
+
+PrinterReceiptSink::PrinterReceiptSink(long long paperLines)
+    : paperLeft_(paperLines),
+      receipts_(0),
+      lines_(0) {
+}
+
+void PrinterReceiptSink::Write(const char* data, std::size_t size) {
+    if (paperLeft_ <= 0) {
+        return;
+    }
+    long long lines = 0;
+    const char* end = data + size;
+    for (const char* at = data; (at = static_cast<const char*>(std::memchr(at, '\n', end - at))) != nullptr; ++at) {
+        ++lines;
+    }
+    lines = std::min(lines, paperLeft_);
+    paperLeft_ -= lines;
+    lines_ += lines;
+    ++receipts_;
+}
+
+void PrinterReceiptSink::Reload(long long paperLines) {
+    paperLeft_ = paperLines;
+}
+
+long long PrinterReceiptSink::GetReceiptsPrinted() const {
+    return receipts_;
+}
+
+long long PrinterReceiptSink::GetLinesPrinted() const {
+    return lines_;
+}
+
+long long PrinterReceiptSink::GetPaperLeft() const {
+    return paperLeft_;
+}
+
+bool PrinterReceiptSink::IsOutOfPaper() const {
+    return paperLeft_ <= 0;
+}
+
+char* FormatInteger(long long value, char* end) {
+    char* begin = end;
+    // Negate through unsigned so the most negative value does not overflow.
+    unsigned long long magnitude = value < 0 ? 0ULL - static_cast<unsigned long long>(value)
+                                             : static_cast<unsigned long long>(value);
+    do {
+        *--begin = static_cast<char>('0' + magnitude % 10);
+        magnitude /= 10;
+    } while (magnitude != 0);
+    if (value < 0) {
+        *--begin = '-';
+    }
+    return begin;
+}
+
+ReceiptWriter::ReceiptWriter()
+    : buffer_() {
+    buffer_.reserve(INITIAL_RECEIPT_CAPACITY);
+}
+
+void ReceiptWriter::Clear() {
+    buffer_.clear();
+}
+
+ReceiptWriter& ReceiptWriter::Append(const char* text) {
+    buffer_.append(text, std::strlen(text));
+    return *this;
+}
+
+ReceiptWriter& ReceiptWriter::Append(const char* text, std::size_t size) {
+    buffer_.append(text, size);
+    return *this;
+}
+
+ReceiptWriter& ReceiptWriter::Append(const std::string& text) {
+    buffer_.append(text);
+    return *this;
+}
+
+ReceiptWriter& ReceiptWriter::AppendInteger(long long value) {
+    char digits[INTEGER_TEXT_BYTES];
+    char* end = digits + sizeof(digits);
+    char* begin = FormatInteger(value, end);
+    buffer_.append(begin, static_cast<std::size_t>(end - begin));
+    return *this;
+}
+
+const char* ReceiptWriter::Data() const {
+    return buffer_.data();
+}
+
+std::size_t ReceiptWriter::Size() const {
+    return buffer_.size();
+}
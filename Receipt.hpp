@@ -0,0 +1,92 @@
+#ifndef RECEIPT_HPP
+#define RECEIPT_HPP
+
+#include <cstddef>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+#include <string>
+
+// Where rendered receipts go. Each Write carries one whole receipt.
+class ReceiptSink {
+public:
+    virtual ~ReceiptSink();
+
+    virtual void Write(const char* data, std::size_t size) = 0;
+};
+
+// Writes receipts to a stream, such as the terminal's console.
+class StreamReceiptSink : public ReceiptSink {
+public:
+    explicit StreamReceiptSink(std::ostream& out);
+
+    void Write(const char* data, std::size_t size) override;
+
+private:
+    std::ostream* out_;
+};
+
+// Appends receipts to a file. Safe to share between ATMs on different
+// threads; each receipt is written whole.
+class FileReceiptSink : public ReceiptSink {
+public:
+    explicit FileReceiptSink(const std::string& filename);
+
+    bool IsOpen() const;
+    void Write(const char* data, std::size_t size) override;
+
+private:
+    std::mutex mutex_;
+    std::ofstream out_;
+};
+
+// A receipt printer with a finite paper roll. Receipts are counted but not
+// kept; a receipt longer than the paper left prints up to the end of the
+// roll and the rest is lost until Reload().
+class PrinterReceiptSink : public ReceiptSink {
+public:
+    explicit PrinterReceiptSink(long long paperLines);
+
+    void Write(const char* data, std::size_t size) override;
+    void Reload(long long paperLines);
+
+    long long GetReceiptsPrinted() const;
+    long long GetLinesPrinted() const;
+    long long GetPaperLeft() const;
+    bool IsOutOfPaper() const;
+
+private:
+    long long paperLeft_;
+    long long receipts_;
+    long long lines_;
+};
+
+// Room for any long long in decimal, sign included.
+const std::size_t INTEGER_TEXT_BYTES = 20;
+
+// Writes value's decimal digits into the INTEGER_TEXT_BYTES bytes before
+// end, without going through a stream or std::to_string, and returns where
+// they begin.
+char* FormatInteger(long long value, char* end);
+
+// Formats text into a reusable byte buffer. Clear() keeps the capacity, so
+// once warmed up a receipt is rendered without allocating.
+class ReceiptWriter {
+public:
+    ReceiptWriter();
+
+    void Clear();
+    ReceiptWriter& Append(const char* text);
+    ReceiptWriter& Append(const char* text, std::size_t size);
+    ReceiptWriter& Append(const std::string& text);
+    // Decimal digits, through FormatInteger.
+    ReceiptWriter& AppendInteger(long long value);
+
+    const char* Data() const;
+    std::size_t Size() const;
+
+private:
+    std::string buffer_;
+};
+
+#endif // RECEIPT_HPP
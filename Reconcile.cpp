@@ -0,0 +1,323 @@
+#include "Reconcile.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+#include "Account.hpp"
+#include "Atm.hpp"
+#include "Executor.hpp"
+#include "Ledger.hpp"
+#include "Segment.hpp"
+#include "Transaction.hpp"
+
+namespace {
+
+// In-memory transactions are read in slices the size of a segment.
+const std::size_t RECONCILE_SLICE = SEGMENT_RECORDS;
+
+// Moves one account's expected balance.
+struct Posting {
+    std::uint32_t account;
+    long long amount;
+};
+
+// What one task read from one batch.
+struct BatchPostings {
+    // By account shard.
+    std::vector<std::vector<Posting>> shards;
+    // Cash in less cash out, by ATM.
+    std::vector<long long> drawers;
+    long long transactions;
+    long long unknownAccounts;
+    long long unknownAtms;
+    bool unreadable;
+};
+
+// How far one RunAll has got. Shared with its helper tasks, which may only
+// start after RunAll has returned.
+struct RunAllProgress {
+    std::atomic<std::size_t> next;
+    std::mutex mutex;
+    std::condition_variable finished;
+    std::size_t done;
+
+    RunAllProgress() : next(0), mutex(), finished(), done(0) {}
+};
+
+// Runs task(0) to task(count - 1) and waits for all of them. The calling
+// thread takes indices alongside helper tasks on the executor, and waits
+// only for the indices already taken: not for the executor's other work,
+// and not for helpers that never got a worker, as when it is called from a
+// task with every worker busy. A helper that starts late finds nothing left
+// and does not touch task.
+void RunAll(Executor* executor, std::size_t count, const std::function<void(std::size_t)>& task) {
+    std::shared_ptr<RunAllProgress> progress = std::make_shared<RunAllProgress>();
+    const auto work = [progress, count, &task] {
+        for (std::size_t i = progress->next.fetch_add(1); i < count; i = progress->next.fetch_add(1)) {
+            task(i);
+            std::lock_guard<std::mutex> lock(progress->mutex);
+            if (++progress->done == count) {
+                progress->finished.notify_all();
+            }
+        }
+    };
+    if (executor != nullptr) {
+        const std::size_t helpers = std::min(count, executor->WorkerCount());
+        for (std::size_t i = 0; i < helpers; ++i) {
+            executor->Post(work);
+        }
+    }
+    work();
+    std::unique_lock<std::mutex> lock(progress->mutex);
+    progress->finished.wait(lock, [&progress, count] { return progress->done == count; });
+}
+
+// Account i belongs to shard i / accountsPerShard_, so each shard owns one
+// contiguous run of expected_ and shards do not share cache lines but at
+// their edges.
+class ReconcileJob {
+public:
+    ReconcileJob(const std::vector<Account*>& accounts, const std::vector<ATM*>& atms, Executor* executor);
+
+    void ReadSegments(const std::vector<TransactionSegment>& segments);
+    void ReadInMemory(const std::vector<Transaction*>& batch);
+    void Finish(ReconcileReport& report);
+
+private:
+    void Reset(BatchPostings& out) const;
+    void Read(const std::vector<Transaction*>& batch, std::size_t begin, std::size_t end, BatchPostings& out) const;
+    void Post(const std::string& accountNumber, long long amount, BatchPostings& out) const;
+    // Adds the first count entries of wave_ into the totals.
+    void Apply(std::size_t count);
+
+    const std::vector<Account*>& accounts_;
+    const std::vector<ATM*>& atms_;
+    Executor* executor_;
+    std::unordered_map<std::string, std::uint32_t> accountIndex_;
+    std::unordered_map<std::string, std::size_t> atmIndex_;
+    std::size_t accountsPerShard_;
+    std::size_t shardCount_;
+    // Reused from wave to wave so the buckets keep their capacity.
+    std::vector<BatchPostings> wave_;
+    std::vector<long long> expected_;
+    std::vector<long long> drawers_;
+    long long transactions_;
+    long long unknownAccounts_;
+    long long unknownAtms_;
+    std::size_t unreadableSegments_;
+};
+
+ReconcileJob::ReconcileJob(const std::vector<Account*>& accounts,
+                           const std::vector<ATM*>& atms,
+                           Executor* executor)
+    : accounts_(accounts),
+      atms_(atms),
+      executor_(executor),
+      accountIndex_(),
+      atmIndex_(),
+      accountsPerShard_(1),
+      shardCount_(1),
+      wave_(executor != nullptr ? executor->WorkerCount() : 1),
+      expected_(accounts.size(), 0),
+      drawers_(atms.size(), 0),
+      transactions_(0),
+      unknownAccounts_(0),
+      unknownAtms_(0),
+      unreadableSegments_(0) {
+    accountIndex_.reserve(accounts.size());
+    for (std::size_t i = 0; i < accounts.size(); ++i) {
+        accountIndex_.emplace(accounts[i]->getAccountNumber(), static_cast<std::uint32_t>(i));
+    }
+    for (std::size_t i = 0; i < atms.size(); ++i) {
+        atmIndex_.emplace(atms[i]->GetSerialNumber(), i);
+    }
+    if (!accounts.empty()) {
+        accountsPerShard_ = (accounts.size() + wave_.size() - 1) / wave_.size();
+        shardCount_ = (accounts.size() + accountsPerShard_ - 1) / accountsPerShard_;
+    }
+}
+
+void ReconcileJob::ReadSegments(const std::vector<TransactionSegment>& segments) {
+    for (std::size_t start = 0; start < segments.size(); start += wave_.size()) {
+        const std::size_t count = std::min(wave_.size(), segments.size() - start);
+        RunAll(executor_, count, [this, &segments, start](std::size_t i) {
+            BatchPostings& out = wave_[i];
+            Reset(out);
+            LoadedTransactions loaded;
+            std::vector<Transaction*> batch;
+            if (!segments[start + i].ReadAll(batch, loaded)) {
+                out.unreadable = true;
+                return;
+            }
+            Read(batch, 0, batch.size(), out);
+        });
+        Apply(count);
+    }
+}
+
+void ReconcileJob::ReadInMemory(const std::vector<Transaction*>& batch) {
+    const std::size_t slices = (batch.size() + RECONCILE_SLICE - 1) / RECONCILE_SLICE;
+    for (std::size_t start = 0; start < slices; start += wave_.size()) {
+        const std::size_t count = std::min(wave_.size(), slices - start);
+        RunAll(executor_, count, [this, &batch, start](std::size_t i) {
+            const std::size_t begin = (start + i) * RECONCILE_SLICE;
+            BatchPostings& out = wave_[i];
+            Reset(out);
+            Read(batch, begin, std::min(batch.size(), begin + RECONCILE_SLICE), out);
+        });
+        Apply(count);
+    }
+}
+
+void ReconcileJob::Finish(ReconcileReport& report) {
+    std::vector<std::vector<BalanceMismatch>> found(shardCount_);
+    RunAll(executor_, shardCount_, [this, &found](std::size_t shard) {
+        const std::size_t end = std::min(accounts_.size(), (shard + 1) * accountsPerShard_);
+        for (std::size_t i = shard * accountsPerShard_; i < end; ++i) {
+            const Account* account = accounts_[i];
+            const long long expected = account->getInitialFunds() + expected_[i];
+            const long long actual = account->getBalance();
+            if (expected != actual) {
+                found[shard].push_back(BalanceMismatch{account, expected, actual});
+            }
+        }
+    });
+    for (const std::vector<BalanceMismatch>& shard : found) {
+        report.balances.insert(report.balances.end(), shard.begin(), shard.end());
+    }
+    for (std::size_t i = 0; i < atms_.size(); ++i) {
+        const ATM* atm = atms_[i];
+        const long long expected = atm->GetCashLoaded() - atm->GetChecksDeposited() + drawers_[i];
+        const long long actual = atm->GetCashInventory().TotalValue();
+        if (expected != actual) {
+            report.drawers.push_back(DrawerMismatch{atm, expected, actual});
+        }
+    }
+    report.transactions = transactions_;
+    report.accounts = accounts_.size();
+    report.atms = atms_.size();
+    report.unknownAccounts = unknownAccounts_;
+    report.unknownAtms = unknownAtms_;
+    report.unreadableSegments = unreadableSegments_;
+}
+
+void ReconcileJob::Reset(BatchPostings& out) const {
+    out.shards.resize(shardCount_);
+    for (std::vector<Posting>& shard : out.shards) {
+        shard.clear();
+    }
+    out.drawers.assign(atms_.size(), 0);
+    out.transactions = 0;
+    out.unknownAccounts = 0;
+    out.unknownAtms = 0;
+    out.unreadable = false;
+}
+
+void ReconcileJob::Read(const std::vector<Transaction*>& batch,
+                        std::size_t begin,
+                        std::size_t end,
+                        BatchPostings& out) const {
+    for (std::size_t i = begin; i < end; ++i) {
+        const Transaction* transaction = batch[i];
+        const long long amount = transaction->getAmount();
+        const long long fee = transaction->getFee();
+        // The fee of a deposit or a cash transfer is paid in cash; those of
+        // withdrawals and account transfers come out of the account.
+        long long cash = 0;
+        switch (transaction->getKind()) {
+        case TransactionKind_Deposit:
+            Post(transaction->getSourceAccountNumber(), amount, out);
+            cash = amount + fee;
+            break;
+        case TransactionKind_Withdrawal:
+            Post(transaction->getSourceAccountNumber(), -(amount + fee), out);
+            cash = -amount;
+            break;
+        case TransactionKind_AccountTransfer:
+            Post(transaction->getSourceAccountNumber(), -(amount + fee), out);
+            Post(transaction->getTarget()->accountNumber, amount, out);
+            break;
+        case TransactionKind_CashTransfer:
+            // The inserting customer's own account is not charged.
+            Post(transaction->getTarget()->accountNumber, amount, out);
+            cash = amount + fee;
+            break;
+        }
+        std::unordered_map<std::string, std::size_t>::const_iterator atm =
+            atmIndex_.find(transaction->getAtmSerial());
+        if (atm == atmIndex_.end()) {
+            ++out.unknownAtms;
+        } else {
+            out.drawers[atm->second] += cash;
+        }
+    }
+    out.transactions += static_cast<long long>(end - begin);
+}
+
+void ReconcileJob::Post(const std::string& accountNumber, long long amount, BatchPostings& out) const {
+    std::unordered_map<std::string, std::uint32_t>::const_iterator account = accountIndex_.find(accountNumber);
+    if (account == accountIndex_.end()) {
+        ++out.unknownAccounts;
+        return;
+    }
+    out.shards[account->second / accountsPerShard_].push_back(Posting{account->second, amount});
+}
+
+void ReconcileJob::Apply(std::size_t count) {
+    RunAll(executor_, shardCount_, [this, count](std::size_t shard) {
+        for (std::size_t i = 0; i < count; ++i) {
+            for (const Posting& posting : wave_[i].shards[shard]) {
+                expected_[posting.account] += posting.amount;
+            }
+        }
+    });
+    for (std::size_t i = 0; i < count; ++i) {
+        const BatchPostings& read = wave_[i];
+        for (std::size_t atm = 0; atm < drawers_.size(); ++atm) {
+            drawers_[atm] += read.drawers[atm];
+        }
+        transactions_ += read.transactions;
+        unknownAccounts_ += read.unknownAccounts;
+        unknownAtms_ += read.unknownAtms;
+        if (read.unreadable) {
+            ++unreadableSegments_;
+        }
+    }
+}
+
+} // namespace
+
+ReconcileReport::ReconcileReport()
+    : transactions(0),
+      accounts(0),
+      atms(0),
+      balances(),
+      drawers(),
+      unknownAccounts(0),
+      unknownAtms(0),
+      unreadableSegments(0) {
+}
+
+bool ReconcileReport::Balanced() const {
+    return balances.empty() && drawers.empty() && unknownAccounts == 0 && unknownAtms == 0 &&
+           unreadableSegments == 0;
+}
+
+ReconcileReport ReconcileLedger(const TransactionLedger& ledger,
+                                const std::vector<Account*>& accounts,
+                                const std::vector<ATM*>& atms,
+                                Executor* executor) {
+    ReconcileJob job(accounts, atms, executor);
+    job.ReadSegments(ledger.Segments());
+    ledger.ForEachInMemory([&job](const std::vector<Transaction*>& batch) { job.ReadInMemory(batch); });
+    ReconcileReport report;
+    job.Finish(report);
+    return report;
+}
@@ -0,0 +1,67 @@
+#ifndef RECONCILE_HPP
+#define RECONCILE_HPP
+
+#include <cstddef>
+#include <vector>
+
+class Account;
+class ATM;
+class Executor;
+class TransactionLedger;
+
+// Checks the live balances and cash drawers against what the ledger says
+// they should be. An account should hold its initial funds plus its
+// postings: deposits and incoming transfers in, withdrawals and outgoing
+// transfers out with their fees. A drawer should hold the cash loaded into
+// it, plus the cash customers put in (deposits and their fees, less the
+// checks, and cash transfers with their fees), less the cash withdrawn.
+// The ledger keeps amounts rather than notes, so drawers are compared by
+// value.
+
+struct BalanceMismatch {
+    const Account* account;
+    long long expected;
+    long long actual;
+};
+
+struct DrawerMismatch {
+    const ATM* atm;
+    long long expected;
+    long long actual;
+};
+
+struct ReconcileReport {
+    long long transactions;
+    std::size_t accounts;
+    std::size_t atms;
+    // In the order the accounts and ATMs were given.
+    std::vector<BalanceMismatch> balances;
+    std::vector<DrawerMismatch> drawers;
+    // Postings to an account, and transactions at an ATM, that were not
+    // given to the job.
+    long long unknownAccounts;
+    long long unknownAtms;
+    std::size_t unreadableSegments;
+
+    ReconcileReport();
+
+    // Nothing above is out of place.
+    bool Balanced() const;
+};
+
+// Reads the ledger a wave of batches at a time, one segment (or one slice
+// of the in-memory transactions) per executor task. Each task resolves its
+// transactions into postings bucketed by account shard; one task per shard
+// then adds its buckets into the expected balances it owns, so no two
+// threads touch the same total and nothing is locked. Memory stays at a
+// wave of batches whatever the ledger's size. The calling thread works
+// alongside the executor and waits only for the job's own tasks, so the
+// executor may be shared, and this may be called from one of its tasks. A
+// null executor runs everything on the calling thread. Call while no ATM is
+// serving customers.
+ReconcileReport ReconcileLedger(const TransactionLedger& ledger,
+                                const std::vector<Account*>& accounts,
+                                const std::vector<ATM*>& atms,
+                                Executor* executor);
+
+#endif // RECONCILE_HPP
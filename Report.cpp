@@ -0,0 +1,317 @@
+#include "Report.hpp"
+
+#include <iostream>
+#include <string>
+
+#include "Account.hpp"
+#include "Atm.hpp"
+#include "Bank.hpp"
+#include "Snapshot.hpp"
+#include "Transaction.hpp"
+
+namespace {
+
+std::string T(ATMLanguage lang, const std::string& en, const std::string& kr) {
+    return (lang == ATMLanguage_Korean) ? kr : en;
+}
+
+std::string LocalizedNoteForTransaction(ATMLanguage lang, const Transaction* t) {
+    if (t == nullptr) {
+        return "";
+    }
+    long long fee = t->getFee();
+    TransactionKind kind = t->getKind();
+
+    if (kind == TransactionKind_Deposit) {
+        if (fee > 0) {
+            return T(lang,
+                     "Deposit completed (fee " + std::to_string(fee) + " paid in cash and not added to balance)",
+                     "입금 완료 (수수료 " + std::to_string(fee) + "가 현금으로 지불되었으며 잔액에 추가되지 않음)");
+        }
+        return T(lang, "Deposit completed", "입금 완료");
+    }
+
+    if (kind == TransactionKind_Withdrawal) {
+        if (fee > 0) {
+            return T(lang,
+                     "Withdrawal completed (fee deducted from account)",
+                     "출금 완료 (수수료가 계좌에서 차감됨)");
+        }
+        return T(lang, "Withdrawal completed", "출금 완료");
+    }
+
+    if (kind == TransactionKind_AccountTransfer) {
+        if (fee > 0) {
+            return T(lang,
+                     "Account transfer completed (fee deducted from source account)",
+                     "계좌 이체 완료 (수수료가 출금 계좌에서 차감됨)");
+        }
+        return T(lang, "Account transfer completed", "계좌 이체 완료");
+    }
+
+    if (kind == TransactionKind_CashTransfer) {
+        if (fee > 0) {
+            return T(lang,
+                     "Cash transfer completed (fee paid in cash and not deposited to the destination account)",
+                     "현금 이체 완료 (수수료가 현금으로 지불되었으며 입금 계좌에 추가되지 않음)");
+        }
+        return T(lang, "Cash transfer completed", "현금 이체 완료");
+    }
+
+    return t->getNote();
+}
+
+} // namespace
+
+void PrintSnapshot(const std::vector<Bank*>& banks, const std::vector<ATM*>& atms, ATMLanguage lang) {
+    FleetSnapshot snapshot;
+    snapshot.Print(banks, atms, lang, std::cout);
+}
+
+void PrintTransactions(const std::vector<Transaction*>& transactions,
+                       std::ostream& out,
+                       ATMLanguage lang) {
+    out << "========================================\n";
+    out << T(lang, "        TRANSACTION HISTORY            ",
+             "              거래 내역                ")
+        << "\n";
+    out << "========================================\n";
+    if (transactions.empty()) {
+        out << "  " << T(lang, "No transactions recorded yet.", "기록된 거래가 없습니다.") << "\n";
+        out << "========================================\n";
+        return;
+    }
+    for (const Transaction* transaction : transactions) {
+        if (transaction == nullptr) {
+            continue;
+        }
+        out << "ID: " << transaction->getId() << "\n";
+        out << "  " << T(lang, "ATM", "ATM") << ": " << transaction->getAtmSerial() << "\n";
+        out << "  " << T(lang, "Card", "카드") << ": " << transaction->getCardNumber() << "\n";
+        out << "  " << T(lang, "Type", "유형") << ": " << transaction->getTypeName() << "\n";
+        out << "  " << T(lang, "Amount", "금액") << ": " << transaction->getAmount() << "\n";
+        out << "  " << T(lang, "Fee", "수수료") << ": " << transaction->getFee() << "\n";
+        out << "  " << T(lang, "From", "출금 계좌") << ": " << transaction->getSourceBankName()
+            << " / " << transaction->getSourceAccountNumber() << "\n";
+        if (const TransferTarget* target = transaction->getTarget()) {
+            out << "  " << T(lang, "To", "입금 계좌") << ": " << target->bankName
+                << " / " << target->accountNumber << "\n";
+        }
+        std::string localizedNote = LocalizedNoteForTransaction(lang, transaction);
+        if (!localizedNote.empty()) {
+            out << "  " << T(lang, "Note", "비고") << ": " << localizedNote << "\n";
+        }
+        out << "----------------------------------------\n";
+    }
+    out << "========================================\n";
+}
+
+void PrintQueryResults(const std::vector<Transaction*>& transactions,
+                       std::ostream& out,
+                       ATMLanguage lang) {
+    for (const Transaction* transaction : transactions) {
+        transaction->logToStream(out);
+        out << "\n";
+    }
+    out << transactions.size() << T(lang, " matching transactions\n", "건의 거래가 검색되었습니다\n");
+}
+
+void PrintHistoryPage(const HistoryPage& page,
+                      std::ostream& out,
+                      ATMLanguage lang) {
+    for (const Transaction* transaction : page.transactions) {
+        transaction->logToStream(out);
+        out << "\n";
+    }
+    if (page.nextCursor > 0) {
+        out << T(lang, "More: next cursor ", "다음 페이지 커서: ") << page.nextCursor << "\n";
+    } else {
+        out << T(lang, "End of history\n", "내역의 끝입니다\n");
+    }
+}
+
+void PrintAuditRoot(std::size_t blocks,
+                    const Sha256Digest& root,
+                    std::ostream& out,
+                    ATMLanguage lang) {
+    out << T(lang, "Audit root over ", "감사 루트 (블록 ") << blocks << T(lang, " blocks: ", "개): ") << ToHex(root)
+        << "\n";
+}
+
+void PrintBlocksVerified(std::size_t blocks,
+                         std::ostream& out,
+                         ATMLanguage lang) {
+    out << T(lang, "Verified ", "블록 ") << blocks
+        << T(lang, " blocks: every transaction still hashes to its block's root\n",
+             "개 검증: 모든 거래가 블록 루트와 일치합니다\n");
+}
+
+void PrintTransactionProof(const Transaction& transaction,
+                           const TransactionProof& proof,
+                           const Sha256Digest& root,
+                           bool verified,
+                           std::ostream& out,
+                           ATMLanguage lang) {
+    transaction.logToStream(out);
+    out << "\n";
+    out << T(lang, "Block ", "블록 ") << proof.block.number << T(lang, ", leaf ", ", 리프 ") << proof.leaf
+        << " / " << proof.block.count << " (" << proof.blockPath.size() << T(lang, " hashes), ledger ", "개 해시), 원장 ")
+        << proof.block.number << " / " << proof.blockCount << " (" << proof.ledgerPath.size()
+        << T(lang, " hashes)\n", "개 해시)\n");
+    out << T(lang, "Root ", "루트 ") << ToHex(root) << ": "
+        << (verified ? T(lang, "verified", "검증됨") : T(lang, "NOT verified", "검증 실패")) << "\n";
+}
+
+void PrintTimeRangeProof(const std::vector<const Transaction*>& inRange,
+                         const TimeRangeProof& proof,
+                         const Sha256Digest& root,
+                         bool verified,
+                         std::ostream& out,
+                         ATMLanguage lang) {
+    std::size_t hashes = 0;
+    for (const BlockRangeProof& range : proof.ranges) {
+        hashes += range.path.size();
+    }
+    for (const Transaction* transaction : inRange) {
+        transaction->logToStream(out);
+        out << "\n";
+    }
+    out << inRange.size() << T(lang, " transactions in range from ", "건의 거래, 범위 블록 ") << proof.ranges.size()
+        << T(lang, " of ", " / ") << proof.blocks.size() << T(lang, " blocks (", "개 (") << hashes
+        << T(lang, " path hashes)\n", "개 경로 해시)\n");
+    out << T(lang, "Root ", "루트 ") << ToHex(root) << ": "
+        << (verified ? T(lang, "verified", "검증됨") : T(lang, "NOT verified", "검증 실패")) << "\n";
+}
+
+void PrintReconciliation(const ReconcileReport& report,
+                         std::ostream& out,
+                         ATMLanguage lang) {
+    out << "\n=== " << T(lang, "Reconciliation", "원장 대사") << " ===\n";
+    for (const BalanceMismatch& mismatch : report.balances) {
+        out << T(lang, "Account", "계좌") << " [" << T(lang, "Bank", "은행") << ": "
+            << mismatch.account->getBankName() << ", " << T(lang, "No.", "번호") << " "
+            << mismatch.account->getAccountNumber() << "] " << T(lang, "Expected ", "예상 잔액 ")
+            << mismatch.expected << T(lang, " | Balance ", " | 실제 잔액 ") << mismatch.actual << "\n";
+    }
+    for (const DrawerMismatch& mismatch : report.drawers) {
+        out << "ATM [SN:" << mismatch.atm->GetSerialNumber() << "] " << T(lang, "Expected cash ", "예상 현금 ")
+            << mismatch.expected << T(lang, " | Drawer ", " | 보유 현금 ") << mismatch.actual << "\n";
+    }
+    if (report.unknownAccounts > 0) {
+        out << report.unknownAccounts << T(lang, " postings to unknown accounts\n", "건의 기록이 알 수 없는 계좌를 가리킵니다\n");
+    }
+    if (report.unknownAtms > 0) {
+        out << report.unknownAtms << T(lang, " transactions at unknown ATMs\n", "건의 거래가 알 수 없는 ATM에서 발생했습니다\n");
+    }
+    if (report.unreadableSegments > 0) {
+        out << report.unreadableSegments << T(lang, " segments could not be read\n", "개의 세그먼트를 읽을 수 없습니다\n");
+    }
+    out << T(lang, "Checked ", "확인: 거래 ") << report.transactions << T(lang, " transactions, ", "건, 계좌 ")
+        << report.accounts << T(lang, " accounts and ", "개, ATM ") << report.atms << T(lang, " ATMs: ", "대: ");
+    if (report.Balanced()) {
+        out << T(lang, "balanced", "모두 일치") << "\n";
+    } else {
+        out << report.balances.size() + report.drawers.size() << T(lang, " mismatches", "건 불일치") << "\n";
+    }
+}
+
+void PrintReplenishmentPlan(const std::vector<ReplenishmentOrder>& orders,
+                            std::ostream& out,
+                            ATMLanguage lang) {
+    out << "\n=== " << T(lang, "Replenishment plan", "현금 보충 계획") << " ===\n";
+    if (orders.empty()) {
+        out << T(lang, "No ATM is forecast to run short.", "현금 부족이 예상되는 ATM이 없습니다.") << "\n";
+    }
+    long long fleetTotal = 0;
+    for (const ReplenishmentOrder& order : orders) {
+        long long sessions = static_cast<long long>(order.sessionsUntilShort);
+        out << "ATM [SN:" << order.atm->GetSerialNumber() << "] "
+            << FormatNoteValue(CASH_BILL_VALUES[order.limitingSlot])
+            << T(lang, " notes run out in ~", " 지폐 소진까지 약 ") << sessions
+            << T(lang, " sessions | Load: ", "회 세션 | 보충: ");
+        for (int i = 0; i < CASH_TYPE_COUNT; ++i) {
+            std::string value = FormatNoteValue(CASH_BILL_VALUES[i]);
+            out << (i > 0 ? ", " : "") << order.load.noteCounts[i]
+                << T(lang, " x " + value + " won", " x " + value + "원");
+        }
+        out << " (" << order.load.TotalValue() << ")\n";
+        fleetTotal += order.load.TotalValue();
+    }
+    out << T(lang, "ATMs to visit: ", "방문할 ATM: ") << orders.size()
+        << T(lang, " | Cash to load: ", " | 보충 현금: ") << fleetTotal << "\n";
+}
+
+void PrintFeeTable(const ATM& atm,
+                   const std::vector<Bank*>& banks,
+                   std::ostream& out,
+                   ATMLanguage lang) {
+    const FeeTable& table = atm.GetFeeTable();
+    const std::vector<long long>& limits = table.GetSchedule().bandLimits;
+    const int bands = table.GetSchedule().BandCount();
+    std::vector<const Bank*> listed;
+    for (const Bank* bank : banks) {
+        if (bank != nullptr) {
+            listed.push_back(bank);
+        }
+    }
+
+    // Deposits and withdrawals are priced per customer bank, transfers per
+    // (customer bank, destination bank) pair; each band is priced at its
+    // lowest amount.
+    std::vector<FeeQuery> queries;
+    for (int band = 0; band < bands; ++band) {
+        long long amount = band > 0 ? limits[band - 1] : 0;
+        for (int kind = 0; kind < TRANSACTION_KIND_COUNT; ++kind) {
+            bool paired = kind == ATMTransaction_AccountTransfer || kind == ATMTransaction_CashTransfer;
+            for (const Bank* source : listed) {
+                for (std::size_t j = 0; j < (paired ? listed.size() : 1); ++j) {
+                    FeeQuery query;
+                    query.kind = static_cast<ATMTransactionKind>(kind);
+                    query.sourceBank = source;
+                    query.destinationBank = paired ? listed[j] : nullptr;
+                    query.amount = amount;
+                    queries.push_back(query);
+                }
+            }
+        }
+    }
+    std::vector<long long> fees(queries.size());
+    table.Evaluate(queries.data(), queries.size(), fees.data());
+
+    const char* kindNames[][2] = {
+        {"Deposit", "입금"},
+        {"Withdrawal", "출금"},
+        {"Account transfer", "계좌 이체"},
+        {"Cash transfer", "현금 이체"},
+    };
+    out << "\n=== " << T(lang, "Fee table", "수수료 표") << " ATM [SN:" << atm.GetSerialNumber() << "] ===\n";
+    std::size_t next = 0;
+    for (int band = 0; band < bands; ++band) {
+        out << T(lang, "Amount ", "금액 ") << (band > 0 ? limits[band - 1] : 0);
+        if (band + 1 < bands) {
+            out << " - " << limits[band] - 1 << "\n";
+        } else {
+            out << T(lang, " and up\n", " 이상\n");
+        }
+        for (int kind = 0; kind < TRANSACTION_KIND_COUNT; ++kind) {
+            bool paired = kind == ATMTransaction_AccountTransfer || kind == ATMTransaction_CashTransfer;
+            if (!paired) {
+                out << "  " << T(lang, kindNames[kind][0], kindNames[kind][1]) << ":";
+                for (const Bank* source : listed) {
+                    out << (source == listed.front() ? " " : ", ") << source->getBankName() << " " << fees[next++];
+                }
+                out << "\n";
+                continue;
+            }
+            for (const Bank* source : listed) {
+                out << "  " << T(lang, kindNames[kind][0], kindNames[kind][1]) << " "
+                    << source->getBankName() << " ->";
+                for (const Bank* destination : listed) {
+                    out << (destination == listed.front() ? " " : ", ") << destination->getBankName() << " "
+                        << fees[next++];
+                }
+                out << "\n";
+            }
+        }
+    }
+}
@@ -0,0 +1,86 @@
+#ifndef REPORT_HPP
+#define REPORT_HPP
+
+#include <iostream>
+#include <vector>
+
+#include "Account.hpp"
+#include "Atm.hpp"
+#include "Audit.hpp"
+#include "Forecast.hpp"
+#include "Reconcile.hpp"
+
+class Bank;
+class Transaction;
+
+// Prints every ATM's remaining cash and every account balance. One-off;
+// repeated snapshots should go through a FleetSnapshot, which keeps the
+// balances and their index between calls.
+void PrintSnapshot(const std::vector<Bank*>& banks,
+                   const std::vector<ATM*>& atms,
+                   ATMLanguage lang = ATMLanguage_English);
+
+// Writes the admin transaction history layout for the given transactions.
+void PrintTransactions(const std::vector<Transaction*>& transactions,
+                       std::ostream& out,
+                       ATMLanguage lang = ATMLanguage_English);
+
+// Search results, one "ID=... ATM=... Card=..." line each, then a count.
+void PrintQueryResults(const std::vector<Transaction*>& transactions,
+                       std::ostream& out,
+                       ATMLanguage lang = ATMLanguage_English);
+
+// One page of an account's history, one line per transaction, then the
+// cursor for the next page when there is one.
+void PrintHistoryPage(const HistoryPage& page,
+                      std::ostream& out,
+                      ATMLanguage lang = ATMLanguage_English);
+
+// The ledger's audit root and how many blocks it covers.
+void PrintAuditRoot(std::size_t blocks,
+                    const Sha256Digest& root,
+                    std::ostream& out,
+                    ATMLanguage lang = ATMLanguage_English);
+
+// That VerifyBlock held for every one of blocks.
+void PrintBlocksVerified(std::size_t blocks,
+                         std::ostream& out,
+                         ATMLanguage lang = ATMLanguage_English);
+
+// A proved transaction, where it sits in its block and the ledger, the
+// length of both paths, and whether the proof held against root.
+void PrintTransactionProof(const Transaction& transaction,
+                           const TransactionProof& proof,
+                           const Sha256Digest& root,
+                           bool verified,
+                           std::ostream& out,
+                           ATMLanguage lang = ATMLanguage_English);
+
+// The transactions a time-range proof vouches for, then the blocks it
+// covered and whether it held against root.
+void PrintTimeRangeProof(const std::vector<const Transaction*>& inRange,
+                         const TimeRangeProof& proof,
+                         const Sha256Digest& root,
+                         bool verified,
+                         std::ostream& out,
+                         ATMLanguage lang = ATMLanguage_English);
+
+// Every account and drawer that does not match the ledger, anything the
+// job could not account for, then the totals checked.
+void PrintReconciliation(const ReconcileReport& report,
+                         std::ostream& out,
+                         ATMLanguage lang = ATMLanguage_English);
+
+// Lists proposed cash loads with each ATM's forecast.
+void PrintReplenishmentPlan(const std::vector<ReplenishmentOrder>& orders,
+                            std::ostream& out,
+                            ATMLanguage lang = ATMLanguage_English);
+
+// Lists every fee the ATM would charge, by amount band, transaction kind
+// and bank pair. The whole table is priced in one FeeTable::Evaluate call.
+void PrintFeeTable(const ATM& atm,
+                   const std::vector<Bank*>& banks,
+                   std::ostream& out,
+                   ATMLanguage lang = ATMLanguage_English);
+
+#endif // REPORT_HPP
@@ -0,0 +1,1263 @@
+#include "Segment.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <unordered_map>
+#include <utility>
+
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "Ledger.hpp"
+
+namespace {
+
+const char SEGMENT_MAGIC[8] = {'A', 'T', 'M', 'S', 'E', 'G', '0', '1'};
+const std::uint32_t NO_STRING = 0xFFFFFFFFu;
+
+enum SegmentIndex {
+    SegmentIndex_Card,
+    SegmentIndex_Account,
+    SegmentIndex_Bank,
+    SegmentIndex_Atm,
+    SegmentIndex_Count
+};
+
+enum RecordString {
+    RecordString_Atm,
+    RecordString_Card,
+    RecordString_SourceBank,
+    RecordString_SourceAccount,
+    RecordString_TargetBank,
+    RecordString_TargetAccount,
+    RecordString_Note,
+    RecordString_Count
+};
+
+struct SegmentHeader {
+    char magic[8];
+    std::uint64_t recordCount;
+    std::uint64_t stringCount;
+    std::int64_t firstId;
+    std::int64_t lastId;
+    std::int64_t minTime;
+    std::int64_t maxTime;
+    // Byte offsets into the file, each a multiple of 8. The string table is
+    // stringCount + 1 u32 offsets into the string bytes that follow them.
+    std::uint64_t strings;
+    std::uint64_t records;
+    std::uint64_t index[SegmentIndex_Count];
+    std::uint64_t indexEntries[SegmentIndex_Count];
+};
+
+struct SegmentRecord {
+    std::int64_t id;
+    std::int64_t wallMicros;
+    std::int64_t monotonicNanos;
+    std::int64_t amount;
+    std::int64_t fee;
+    // String table ids, NO_STRING when absent.
+    std::uint32_t strings[RecordString_Count];
+    std::uint32_t kind;
+};
+
+static_assert(sizeof(SegmentHeader) == 136, "segment header layout");
+static_assert(sizeof(SegmentRecord) == 72, "segment record layout");
+
+const char PACKED_MAGIC[8] = {'A', 'T', 'M', 'S', 'E', 'G', 'P', '1'};
+// Records per packed block; a read decodes whole blocks.
+const std::size_t PACKED_BLOCK_RECORDS = 32;
+
+struct PackedHeader {
+    char magic[8];
+    std::uint64_t recordCount;
+    std::uint64_t stringCount;
+    std::int64_t firstId;
+    std::int64_t lastId;
+    std::int64_t minTime;
+    std::int64_t maxTime;
+    // Byte offsets into the file, each a multiple of 8. The string table is
+    // laid out as in a raw segment.
+    std::uint64_t strings;
+    // blockCount + 1 u64 offsets; block b is the bytes between the b-th and
+    // the next. A block holds up to PACKED_BLOCK_RECORDS records as columns
+    // of varints, in this order: ID deltas, zigzag wall-clock deltas, zigzag
+    // deltas of the monotonic clock's skew from the wall clock, zigzag
+    // amounts, zigzag fees, kinds, then one column per RecordString of
+    // dictionary positions plus one (0 when absent). Each block starts its
+    // deltas from 0.
+    std::uint64_t blocks;
+    std::uint64_t blockCount;
+    // Per RecordString, the u32 string ids the column uses, most frequent
+    // first.
+    std::uint64_t dictionaries[RecordString_Count];
+    std::uint64_t dictionarySizes[RecordString_Count];
+    // indexEntries + 1 PostingHeads, sorted by string and closed by a
+    // sentinel, then the posting bytes: each string's record numbers as
+    // varint deltas from 0.
+    std::uint64_t index[SegmentIndex_Count];
+    std::uint64_t indexEntries[SegmentIndex_Count];
+};
+
+// Where one string's postings start in the posting bytes of its index.
+struct PostingHead {
+    std::uint32_t string;
+    std::uint32_t offset;
+};
+
+static_assert(sizeof(PackedHeader) == 256, "packed segment header layout");
+static_assert(sizeof(PostingHead) == 8, "posting head layout");
+
+// Sorted by string, then record, so one string's records are a run in ID
+// order.
+struct IndexEntry {
+    std::uint32_t string;
+    std::uint32_t record;
+};
+
+bool operator<(const IndexEntry& a, const IndexEntry& b) {
+    return a.string < b.string || (a.string == b.string && a.record < b.record);
+}
+
+// Groups entries by string in one counting pass. Entries arrive in record
+// order, so each string's run stays in record order.
+void GroupByString(std::vector<IndexEntry>& entries, std::size_t stringCount) {
+    std::vector<std::size_t> starts(stringCount + 1, 0);
+    for (const IndexEntry& entry : entries) {
+        ++starts[entry.string + 1];
+    }
+    for (std::size_t i = 1; i <= stringCount; ++i) {
+        starts[i] += starts[i - 1];
+    }
+    std::vector<IndexEntry> grouped(entries.size());
+    for (const IndexEntry& entry : entries) {
+        grouped[starts[entry.string]++] = entry;
+    }
+    entries.swap(grouped);
+}
+
+std::uint64_t PadTo8(std::uint64_t size) {
+    return (size + 7) & ~static_cast<std::uint64_t>(7);
+}
+
+void PutVarint(std::string& out, std::uint64_t value) {
+    while (value >= 0x80) {
+        out.push_back(static_cast<char>(value | 0x80));
+        value >>= 7;
+    }
+    out.push_back(static_cast<char>(value));
+}
+
+// Deltas wrap in unsigned arithmetic, so any two values round-trip.
+std::uint64_t Delta(std::int64_t value, std::int64_t previous) {
+    return static_cast<std::uint64_t>(value) - static_cast<std::uint64_t>(previous);
+}
+
+std::int64_t Undelta(std::uint64_t delta, std::int64_t previous) {
+    return static_cast<std::int64_t>(static_cast<std::uint64_t>(previous) + delta);
+}
+
+// 0, -1, 1, -2, ... to 0, 1, 2, 3, ..., so small negatives stay short.
+std::uint64_t ZigZag(std::uint64_t value) {
+    return (value << 1) ^ (0 - (value >> 63));
+}
+
+std::uint64_t UnZigZag(std::uint64_t value) {
+    return (value >> 1) ^ (0 - (value & 1));
+}
+
+// Both clocks are read together, so the skew barely moves between records
+// while the monotonic clock itself does.
+std::int64_t ClockSkew(const SegmentRecord& record) {
+    return static_cast<std::int64_t>(static_cast<std::uint64_t>(record.monotonicNanos) -
+                                     static_cast<std::uint64_t>(record.wallMicros) * 1000);
+}
+
+// Reads varints from a byte range; Ok() turns false on a truncated or
+// overlong one, after which every read returns 0.
+class VarintReader {
+public:
+    VarintReader(const char* begin, const char* end) : at_(begin), end_(end), ok_(true) {}
+
+    std::uint64_t Next() {
+        if (ok_ && at_ != end_ && static_cast<std::uint8_t>(*at_) < 0x80) {
+            return static_cast<std::uint8_t>(*at_++);
+        }
+        std::uint64_t value = 0;
+        for (int shift = 0; ok_ && shift < 64 && at_ != end_; shift += 7) {
+            const std::uint8_t byte = static_cast<std::uint8_t>(*at_++);
+            value |= static_cast<std::uint64_t>(byte & 0x7F) << shift;
+            if ((byte & 0x80) == 0) {
+                return value;
+            }
+        }
+        ok_ = false;
+        return 0;
+    }
+
+    bool AtEnd() const { return at_ == end_; }
+    bool Ok() const { return ok_; }
+
+private:
+    const char* at_;
+    const char* end_;
+    bool ok_;
+};
+
+// The whole file mapped read-only, unmapped on destruction. Data() is null
+// when the file could not be mapped.
+class MappedFile {
+public:
+    explicit MappedFile(const std::string& path);
+    ~MappedFile();
+
+    const char* Data() const { return data_; }
+    std::size_t Size() const { return size_; }
+
+private:
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    const char* data_;
+    std::size_t size_;
+#ifdef _WIN32
+    HANDLE file_;
+    HANDLE mapping_;
+#endif
+};
+
+#ifdef _WIN32
+
+MappedFile::MappedFile(const std::string& path)
+    : data_(nullptr),
+      size_(0),
+      file_(INVALID_HANDLE_VALUE),
+      mapping_(nullptr) {
+    file_ = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+                        FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file_ == INVALID_HANDLE_VALUE) {
+        return;
+    }
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(file_, &size) || size.QuadPart == 0) {
+        return;
+    }
+    mapping_ = CreateFileMappingA(file_, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (mapping_ == nullptr) {
+        return;
+    }
+    data_ = static_cast<const char*>(MapViewOfFile(mapping_, FILE_MAP_READ, 0, 0, 0));
+    if (data_ != nullptr) {
+        size_ = static_cast<std::size_t>(size.QuadPart);
+    }
+}
+
+MappedFile::~MappedFile() {
+    if (data_ != nullptr) {
+        UnmapViewOfFile(data_);
+    }
+    if (mapping_ != nullptr) {
+        CloseHandle(mapping_);
+    }
+    if (file_ != INVALID_HANDLE_VALUE) {
+        CloseHandle(file_);
+    }
+}
+
+#else
+
+MappedFile::MappedFile(const std::string& path)
+    : data_(nullptr),
+      size_(0) {
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        return;
+    }
+    struct stat info;
+    if (fstat(fd, &info) == 0 && info.st_size > 0) {
+        void* data = mmap(nullptr, static_cast<std::size_t>(info.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+        if (data != MAP_FAILED) {
+            data_ = static_cast<const char*>(data);
+            size_ = static_cast<std::size_t>(info.st_size);
+        }
+    }
+    close(fd);
+}
+
+MappedFile::~MappedFile() {
+    if (data_ != nullptr) {
+        munmap(const_cast<char*>(data_), size_);
+    }
+}
+
+#endif
+
+// Bounds-checked reads of a mapped segment in either format.
+class SegmentView {
+public:
+    explicit SegmentView(const MappedFile& file)
+        : data_(file.Data()),
+          size_(file.Size()),
+          packed_(false),
+          recordCount_(0),
+          stringCount_(0),
+          stringOffsets_(nullptr),
+          stringBytes_(nullptr),
+          stringBytesSize_(0),
+          records_(nullptr),
+          entries_(),
+          entryCounts_(),
+          blockOffsets_(nullptr),
+          dictionaries_(),
+          dictionarySizes_(),
+          heads_(),
+          headCounts_(),
+          postingBytes_(),
+          postingBytesSizes_(),
+          cachedBlock_(static_cast<std::size_t>(-1)),
+          blockRecords_(),
+          valid_(false),
+          intact_(true) {
+        if (data_ == nullptr || size_ < sizeof(SegmentHeader)) {
+            return;
+        }
+        if (std::memcmp(data_, SEGMENT_MAGIC, sizeof(SEGMENT_MAGIC)) == 0) {
+            valid_ = OpenRaw();
+        } else if (std::memcmp(data_, PACKED_MAGIC, sizeof(PACKED_MAGIC)) == 0) {
+            valid_ = OpenPacked();
+        }
+    }
+
+    bool Valid() const { return valid_; }
+    // False once a block or posting list turned out to be damaged; its
+    // records were skipped.
+    bool Intact() const { return intact_; }
+    std::size_t RecordCount() const { return recordCount_; }
+
+    // Raw records are read in place. Packed ones come from a decoded copy of
+    // their block, kept until a record of another block is asked for.
+    const SegmentRecord& Record(std::size_t index) {
+        if (!packed_) {
+            return records_[index];
+        }
+        const std::size_t block = index / PACKED_BLOCK_RECORDS;
+        if (block != cachedBlock_) {
+            DecodeBlock(block);
+            cachedBlock_ = block;
+        }
+        return blockRecords_[index % PACKED_BLOCK_RECORDS];
+    }
+
+    std::string String(std::uint32_t id) const {
+        const char* text = nullptr;
+        std::size_t length = 0;
+        if (!StringAt(id, text, length)) {
+            return std::string();
+        }
+        return std::string(text, length);
+    }
+
+    // The table is sorted, so a lookup is a binary search over the mapping.
+    std::uint32_t FindString(const std::string& text) const {
+        std::size_t low = 0;
+        std::size_t high = stringCount_;
+        while (low < high) {
+            std::size_t middle = low + (high - low) / 2;
+            int order = Compare(static_cast<std::uint32_t>(middle), text);
+            if (order == 0) {
+                return static_cast<std::uint32_t>(middle);
+            }
+            if (order < 0) {
+                low = middle + 1;
+            } else {
+                high = middle;
+            }
+        }
+        return NO_STRING;
+    }
+
+    // How long one string's posting list is: entries in a raw segment,
+    // bytes in a packed one. 0 when the string has none.
+    std::size_t PostingWeight(SegmentIndex index, std::uint32_t string) const {
+        if (!packed_) {
+            Run run = RawRun(index, string);
+            return static_cast<std::size_t>(run.second - run.first);
+        }
+        const char* begin = nullptr;
+        const char* end = nullptr;
+        return PackedRun(index, string, begin, end) ? static_cast<std::size_t>(end - begin) : 0;
+    }
+
+    // Appends one string's record numbers in ascending order. A number past
+    // the last record marks the segment damaged and ends the list.
+    void Postings(SegmentIndex index, std::uint32_t string, std::vector<std::uint32_t>& records) {
+        if (!packed_) {
+            Run run = RawRun(index, string);
+            for (const IndexEntry* entry = run.first; entry != run.second; ++entry) {
+                if (entry->record >= recordCount_) {
+                    intact_ = false;
+                    return;
+                }
+                records.push_back(entry->record);
+            }
+            return;
+        }
+        const char* begin = nullptr;
+        const char* end = nullptr;
+        if (!PackedRun(index, string, begin, end)) {
+            return;
+        }
+        VarintReader reader(begin, end);
+        std::uint64_t record = 0;
+        while (!reader.AtEnd()) {
+            record += reader.Next();
+            if (!reader.Ok() || record >= recordCount_) {
+                intact_ = false;
+                return;
+            }
+            records.push_back(static_cast<std::uint32_t>(record));
+        }
+    }
+
+    // Rebuilds a record as a Transaction owned by loaded.
+    Transaction* Decode(const SegmentRecord& record, LoadedTransactions& loaded) const {
+        const std::uint32_t* ids = record.strings;
+        std::unique_ptr<Transaction> transaction;
+        switch (record.kind) {
+        case TransactionKind_Deposit:
+            transaction.reset(new DepositTransaction(String(ids[RecordString_Atm]), String(ids[RecordString_Card]),
+                                                     String(ids[RecordString_SourceBank]),
+                                                     String(ids[RecordString_SourceAccount]), record.amount,
+                                                     record.fee, String(ids[RecordString_Note]), record.id));
+            break;
+        case TransactionKind_Withdrawal:
+            transaction.reset(new WithdrawalTransaction(String(ids[RecordString_Atm]), String(ids[RecordString_Card]),
+                                                        String(ids[RecordString_SourceBank]),
+                                                        String(ids[RecordString_SourceAccount]), record.amount,
+                                                        record.fee, String(ids[RecordString_Note]), record.id));
+            break;
+        case TransactionKind_AccountTransfer:
+            transaction.reset(new AccountTransferTransaction(
+                String(ids[RecordString_Atm]), String(ids[RecordString_Card]), String(ids[RecordString_SourceBank]),
+                String(ids[RecordString_SourceAccount]), String(ids[RecordString_TargetBank]),
+                String(ids[RecordString_TargetAccount]), record.amount, record.fee, String(ids[RecordString_Note]),
+                record.id));
+            break;
+        case TransactionKind_CashTransfer:
+            transaction.reset(new CashTransferTransaction(
+                String(ids[RecordString_Atm]), String(ids[RecordString_Card]), String(ids[RecordString_SourceBank]),
+                String(ids[RecordString_SourceAccount]), String(ids[RecordString_TargetBank]),
+                String(ids[RecordString_TargetAccount]), record.amount, record.fee, String(ids[RecordString_Note]),
+                record.id));
+            break;
+        default:
+            return nullptr;
+        }
+        Timestamp time;
+        time.wallMicros = record.wallMicros;
+        time.monotonicNanos = record.monotonicNanos;
+        transaction->setTime(time);
+        loaded.push_back(std::move(transaction));
+        return loaded.back().get();
+    }
+
+private:
+    typedef std::pair<const IndexEntry*, const IndexEntry*> Run;
+
+    bool Fits(std::uint64_t offset, std::uint64_t bytes) const {
+        return offset % 8 == 0 && offset <= size_ && bytes <= size_ - offset;
+    }
+
+    bool OpenStrings(std::uint64_t stringCount, std::uint64_t offset) {
+        if (stringCount >= size_ / sizeof(std::uint32_t) ||
+            !Fits(offset, (stringCount + 1) * sizeof(std::uint32_t))) {
+            return false;
+        }
+        stringCount_ = static_cast<std::size_t>(stringCount);
+        stringOffsets_ = reinterpret_cast<const std::uint32_t*>(data_ + offset);
+        const std::uint64_t bytesStart = offset + (stringCount + 1) * sizeof(std::uint32_t);
+        stringBytes_ = data_ + bytesStart;
+        stringBytesSize_ = size_ - static_cast<std::size_t>(bytesStart);
+        return true;
+    }
+
+    bool OpenRaw() {
+        SegmentHeader header;
+        std::memcpy(&header, data_, sizeof(SegmentHeader));
+        if (!OpenStrings(header.stringCount, header.strings) ||
+            header.recordCount > size_ / sizeof(SegmentRecord) ||
+            !Fits(header.records, header.recordCount * sizeof(SegmentRecord))) {
+            return false;
+        }
+        for (int i = 0; i < SegmentIndex_Count; ++i) {
+            if (header.indexEntries[i] > size_ / sizeof(IndexEntry) ||
+                !Fits(header.index[i], header.indexEntries[i] * sizeof(IndexEntry))) {
+                return false;
+            }
+            entries_[i] = reinterpret_cast<const IndexEntry*>(data_ + header.index[i]);
+            entryCounts_[i] = static_cast<std::size_t>(header.indexEntries[i]);
+        }
+        recordCount_ = static_cast<std::size_t>(header.recordCount);
+        records_ = reinterpret_cast<const SegmentRecord*>(data_ + header.records);
+        return true;
+    }
+
+    bool OpenPacked() {
+        if (size_ < sizeof(PackedHeader)) {
+            return false;
+        }
+        PackedHeader header;
+        std::memcpy(&header, data_, sizeof(PackedHeader));
+        const std::uint64_t blockCount = header.recordCount / PACKED_BLOCK_RECORDS +
+                                         (header.recordCount % PACKED_BLOCK_RECORDS != 0 ? 1 : 0);
+        if (!OpenStrings(header.stringCount, header.strings) || header.blockCount != blockCount ||
+            blockCount >= size_ / sizeof(std::uint64_t) ||
+            !Fits(header.blocks, (blockCount + 1) * sizeof(std::uint64_t))) {
+            return false;
+        }
+        for (int i = 0; i < RecordString_Count; ++i) {
+            if (header.dictionarySizes[i] > size_ / sizeof(std::uint32_t) ||
+                !Fits(header.dictionaries[i], header.dictionarySizes[i] * sizeof(std::uint32_t))) {
+                return false;
+            }
+            dictionaries_[i] = reinterpret_cast<const std::uint32_t*>(data_ + header.dictionaries[i]);
+            dictionarySizes_[i] = static_cast<std::size_t>(header.dictionarySizes[i]);
+        }
+        for (int i = 0; i < SegmentIndex_Count; ++i) {
+            if (header.indexEntries[i] >= size_ / sizeof(PostingHead) ||
+                !Fits(header.index[i], (header.indexEntries[i] + 1) * sizeof(PostingHead))) {
+                return false;
+            }
+            heads_[i] = reinterpret_cast<const PostingHead*>(data_ + header.index[i]);
+            headCounts_[i] = static_cast<std::size_t>(header.indexEntries[i]);
+            const std::uint64_t bytesStart = header.index[i] + (header.indexEntries[i] + 1) * sizeof(PostingHead);
+            const std::uint64_t bytes = heads_[i][headCounts_[i]].offset;
+            if (bytes > size_ - bytesStart) {
+                return false;
+            }
+            postingBytes_[i] = data_ + bytesStart;
+            postingBytesSizes_[i] = static_cast<std::size_t>(bytes);
+        }
+        packed_ = true;
+        recordCount_ = static_cast<std::size_t>(header.recordCount);
+        blockOffsets_ = reinterpret_cast<const std::uint64_t*>(data_ + header.blocks);
+        return true;
+    }
+
+    Run RawRun(SegmentIndex index, std::uint32_t string) const {
+        const IndexEntry* begin = entries_[index];
+        const IndexEntry* end = begin + entryCounts_[index];
+        IndexEntry low = {string, 0};
+        IndexEntry high = {string, NO_STRING};
+        return std::make_pair(std::lower_bound(begin, end, low), std::upper_bound(begin, end, high));
+    }
+
+    bool PackedRun(SegmentIndex index, std::uint32_t string, const char*& begin, const char*& end) const {
+        const PostingHead* heads = heads_[index];
+        const PostingHead* head = std::lower_bound(
+            heads, heads + headCounts_[index], string,
+            [](const PostingHead& entry, std::uint32_t value) { return entry.string < value; });
+        if (head == heads + headCounts_[index] || head->string != string) {
+            return false;
+        }
+        const std::uint32_t from = head->offset;
+        const std::uint32_t to = (head + 1)->offset;
+        if (from > to || to > postingBytesSizes_[index]) {
+            return false;
+        }
+        begin = postingBytes_[index] + from;
+        end = postingBytes_[index] + to;
+        return true;
+    }
+
+    std::uint32_t DictionaryString(int field, std::uint64_t position, bool& ok) const {
+        if (position == 0) {
+            return NO_STRING;
+        }
+        if (position > dictionarySizes_[field]) {
+            ok = false;
+            return NO_STRING;
+        }
+        return dictionaries_[field][position - 1];
+    }
+
+    void DecodeBlock(std::size_t block) {
+        const std::size_t first = block * PACKED_BLOCK_RECORDS;
+        // Every field of every record is overwritten below.
+        blockRecords_.resize(std::min(PACKED_BLOCK_RECORDS, recordCount_ - first));
+        const std::uint64_t begin = blockOffsets_[block];
+        const std::uint64_t end = blockOffsets_[block + 1];
+        if (begin > end || end > size_) {
+            FailBlock();
+            return;
+        }
+        VarintReader reader(data_ + begin, data_ + end);
+        std::int64_t previous = 0;
+        for (SegmentRecord& record : blockRecords_) {
+            record.id = previous = Undelta(reader.Next(), previous);
+        }
+        previous = 0;
+        for (SegmentRecord& record : blockRecords_) {
+            record.wallMicros = previous = Undelta(UnZigZag(reader.Next()), previous);
+        }
+        previous = 0;
+        for (SegmentRecord& record : blockRecords_) {
+            previous = Undelta(UnZigZag(reader.Next()), previous);
+            record.monotonicNanos = Undelta(static_cast<std::uint64_t>(record.wallMicros) * 1000, previous);
+        }
+        for (SegmentRecord& record : blockRecords_) {
+            record.amount = static_cast<std::int64_t>(UnZigZag(reader.Next()));
+        }
+        for (SegmentRecord& record : blockRecords_) {
+            record.fee = static_cast<std::int64_t>(UnZigZag(reader.Next()));
+        }
+        for (SegmentRecord& record : blockRecords_) {
+            record.kind = static_cast<std::uint32_t>(reader.Next());
+        }
+        bool ok = true;
+        for (int field = 0; field < RecordString_Count; ++field) {
+            for (SegmentRecord& record : blockRecords_) {
+                record.strings[field] = DictionaryString(field, reader.Next(), ok);
+            }
+        }
+        if (!ok || !reader.Ok() || !reader.AtEnd()) {
+            FailBlock();
+        }
+    }
+
+    // Leaves the block's records with no kind, so Decode skips them.
+    void FailBlock() {
+        intact_ = false;
+        for (SegmentRecord& record : blockRecords_) {
+            record = SegmentRecord();
+            record.kind = NO_STRING;
+            std::fill(record.strings, record.strings + RecordString_Count, NO_STRING);
+        }
+    }
+
+    bool StringAt(std::uint32_t id, const char*& text, std::size_t& length) const {
+        if (id >= stringCount_) {
+            return false;
+        }
+        std::uint32_t begin = stringOffsets_[id];
+        std::uint32_t end = stringOffsets_[id + 1];
+        if (begin > end || end > stringBytesSize_) {
+            return false;
+        }
+        text = stringBytes_ + begin;
+        length = end - begin;
+        return true;
+    }
+
+    // An unreadable string sorts as empty. memcmp is never given its null
+    // pointer, even for zero bytes.
+    int Compare(std::uint32_t id, const std::string& text) const {
+        const char* stored = nullptr;
+        std::size_t length = 0;
+        if (!StringAt(id, stored, length)) {
+            length = 0;
+        }
+        int order = length == 0 ? 0 : std::memcmp(stored, text.data(), std::min(length, text.size()));
+        if (order != 0) {
+            return order;
+        }
+        return length < text.size() ? -1 : (length > text.size() ? 1 : 0);
+    }
+
+    const char* data_;
+    std::size_t size_;
+    bool packed_;
+    std::size_t recordCount_;
+    std::size_t stringCount_;
+    const std::uint32_t* stringOffsets_;
+    const char* stringBytes_;
+    std::size_t stringBytesSize_;
+    // Raw segments.
+    const SegmentRecord* records_;
+    const IndexEntry* entries_[SegmentIndex_Count];
+    std::size_t entryCounts_[SegmentIndex_Count];
+    // Packed segments.
+    const std::uint64_t* blockOffsets_;
+    const std::uint32_t* dictionaries_[RecordString_Count];
+    std::size_t dictionarySizes_[RecordString_Count];
+    const PostingHead* heads_[SegmentIndex_Count];
+    std::size_t headCounts_[SegmentIndex_Count];
+    const char* postingBytes_[SegmentIndex_Count];
+    std::size_t postingBytesSizes_[SegmentIndex_Count];
+    std::size_t cachedBlock_;
+    std::vector<SegmentRecord> blockRecords_;
+    bool valid_;
+    bool intact_;
+};
+
+// The query's string filters, resolved to string ids; NO_STRING where the
+// query has none.
+struct WantedStrings {
+    std::uint32_t ids[SegmentIndex_Count];
+};
+
+// Matches what the indexes would: account and bank on either side of a
+// transfer.
+bool MatchesStrings(const WantedStrings& wanted, const SegmentRecord& record) {
+    const std::uint32_t* ids = record.strings;
+    const std::uint32_t card = wanted.ids[SegmentIndex_Card];
+    const std::uint32_t account = wanted.ids[SegmentIndex_Account];
+    const std::uint32_t bank = wanted.ids[SegmentIndex_Bank];
+    const std::uint32_t atm = wanted.ids[SegmentIndex_Atm];
+    return (card == NO_STRING || ids[RecordString_Card] == card) &&
+           (account == NO_STRING || ids[RecordString_SourceAccount] == account ||
+            ids[RecordString_TargetAccount] == account) &&
+           (bank == NO_STRING || ids[RecordString_SourceBank] == bank || ids[RecordString_TargetBank] == bank) &&
+           (atm == NO_STRING || ids[RecordString_Atm] == atm);
+}
+
+// The query filters no index answers.
+bool MatchesRecord(const TransactionQuery& query, const SegmentRecord& record) {
+    return (!query.hasKind || record.kind == static_cast<std::uint32_t>(query.kind)) &&
+           (!query.hasMinAmount || record.amount >= query.minAmount) &&
+           (!query.hasMaxAmount || record.amount <= query.maxAmount) &&
+           (!query.hasFrom || record.wallMicros >= query.fromMicros) &&
+           (!query.hasTo || record.wallMicros < query.toMicros);
+}
+
+bool ReportUnreadable(const std::string& path) {
+    std::cerr << "Cannot read transaction segment " << path << ".\n";
+    return false;
+}
+
+// A segment's contents before they are laid out in either format: strings
+// sorted and numbered, records with string ids, index entries grouped by
+// string.
+struct SegmentContents {
+    std::uint64_t recordCount;
+    std::int64_t firstId;
+    std::int64_t lastId;
+    std::int64_t minTime;
+    std::int64_t maxTime;
+    std::vector<const std::string*> texts;
+    std::vector<std::uint32_t> stringOffsets;
+    std::uint64_t stringsSize;
+    std::vector<SegmentRecord> records;
+    std::vector<IndexEntry> index[SegmentIndex_Count];
+};
+
+const char PADDING[8] = {};
+
+void WritePadded(std::ostream& out, const char* data, std::uint64_t size) {
+    out.write(data, static_cast<std::streamsize>(size));
+    out.write(PADDING, static_cast<std::streamsize>(PadTo8(size) - size));
+}
+
+void WriteStrings(std::ostream& out, const SegmentContents& contents) {
+    out.write(reinterpret_cast<const char*>(contents.stringOffsets.data()),
+              static_cast<std::streamsize>(contents.stringOffsets.size() * sizeof(std::uint32_t)));
+    for (const std::string* text : contents.texts) {
+        out.write(text->data(), static_cast<std::streamsize>(text->size()));
+    }
+    out.write(PADDING, static_cast<std::streamsize>(PadTo8(contents.stringsSize) - contents.stringsSize));
+}
+
+// Returns the bytes written.
+std::uint64_t WriteRaw(std::ostream& out, const SegmentContents& contents) {
+    SegmentHeader header;
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.magic, SEGMENT_MAGIC, sizeof(SEGMENT_MAGIC));
+    header.recordCount = contents.recordCount;
+    header.stringCount = contents.texts.size();
+    header.firstId = contents.firstId;
+    header.lastId = contents.lastId;
+    header.minTime = contents.minTime;
+    header.maxTime = contents.maxTime;
+
+    std::uint64_t position = sizeof(SegmentHeader);
+    header.strings = position;
+    position += PadTo8(contents.stringsSize);
+    header.records = position;
+    position += contents.records.size() * sizeof(SegmentRecord);
+    for (int i = 0; i < SegmentIndex_Count; ++i) {
+        header.index[i] = position;
+        header.indexEntries[i] = contents.index[i].size();
+        position += contents.index[i].size() * sizeof(IndexEntry);
+    }
+
+    out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    WriteStrings(out, contents);
+    out.write(reinterpret_cast<const char*>(contents.records.data()),
+              static_cast<std::streamsize>(contents.records.size() * sizeof(SegmentRecord)));
+    for (int i = 0; i < SegmentIndex_Count; ++i) {
+        out.write(reinterpret_cast<const char*>(contents.index[i].data()),
+                  static_cast<std::streamsize>(contents.index[i].size() * sizeof(IndexEntry)));
+    }
+    return position;
+}
+
+// Returns the bytes written.
+std::uint64_t WritePacked(std::ostream& out, const SegmentContents& contents) {
+    const std::vector<SegmentRecord>& records = contents.records;
+    const std::size_t stringCount = contents.texts.size();
+    PackedHeader header;
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.magic, PACKED_MAGIC, sizeof(PACKED_MAGIC));
+    header.recordCount = contents.recordCount;
+    header.stringCount = stringCount;
+    header.firstId = contents.firstId;
+    header.lastId = contents.lastId;
+    header.minTime = contents.minTime;
+    header.maxTime = contents.maxTime;
+
+    // Most frequent first, so the common ATMs, banks and notes take a byte.
+    std::vector<std::uint32_t> dictionaries[RecordString_Count];
+    std::vector<std::uint32_t> positions[RecordString_Count];
+    for (int field = 0; field < RecordString_Count; ++field) {
+        std::vector<std::uint32_t> counts(stringCount, 0);
+        for (const SegmentRecord& record : records) {
+            if (record.strings[field] != NO_STRING) {
+                ++counts[record.strings[field]];
+            }
+        }
+        std::vector<std::uint32_t>& dictionary = dictionaries[field];
+        for (std::uint32_t id = 0; id < stringCount; ++id) {
+            if (counts[id] > 0) {
+                dictionary.push_back(id);
+            }
+        }
+        std::stable_sort(dictionary.begin(), dictionary.end(),
+                         [&counts](std::uint32_t a, std::uint32_t b) { return counts[a] > counts[b]; });
+        positions[field].assign(stringCount, 0);
+        for (std::size_t i = 0; i < dictionary.size(); ++i) {
+            positions[field][dictionary[i]] = static_cast<std::uint32_t>(i + 1);
+        }
+    }
+
+    std::string blocks;
+    std::vector<std::uint64_t> blockOffsets;
+    for (std::size_t first = 0; first < records.size(); first += PACKED_BLOCK_RECORDS) {
+        const std::size_t end = std::min(records.size(), first + PACKED_BLOCK_RECORDS);
+        blockOffsets.push_back(blocks.size());
+        std::int64_t previous = 0;
+        for (std::size_t i = first; i < end; ++i) {
+            PutVarint(blocks, Delta(records[i].id, previous));
+            previous = records[i].id;
+        }
+        previous = 0;
+        for (std::size_t i = first; i < end; ++i) {
+            PutVarint(blocks, ZigZag(Delta(records[i].wallMicros, previous)));
+            previous = records[i].wallMicros;
+        }
+        previous = 0;
+        for (std::size_t i = first; i < end; ++i) {
+            const std::int64_t skew = ClockSkew(records[i]);
+            PutVarint(blocks, ZigZag(Delta(skew, previous)));
+            previous = skew;
+        }
+        for (std::size_t i = first; i < end; ++i) {
+            PutVarint(blocks, ZigZag(static_cast<std::uint64_t>(records[i].amount)));
+        }
+        for (std::size_t i = first; i < end; ++i) {
+            PutVarint(blocks, ZigZag(static_cast<std::uint64_t>(records[i].fee)));
+        }
+        for (std::size_t i = first; i < end; ++i) {
+            PutVarint(blocks, records[i].kind);
+        }
+        for (int field = 0; field < RecordString_Count; ++field) {
+            for (std::size_t i = first; i < end; ++i) {
+                const std::uint32_t id = records[i].strings[field];
+                PutVarint(blocks, id == NO_STRING ? 0 : positions[field][id]);
+            }
+        }
+    }
+    blockOffsets.push_back(blocks.size());
+
+    std::vector<PostingHead> heads[SegmentIndex_Count];
+    std::string postings[SegmentIndex_Count];
+    for (int i = 0; i < SegmentIndex_Count; ++i) {
+        std::uint32_t previous = 0;
+        for (std::size_t j = 0; j < contents.index[i].size(); ++j) {
+            const IndexEntry& entry = contents.index[i][j];
+            if (j == 0 || entry.string != contents.index[i][j - 1].string) {
+                heads[i].push_back({entry.string, static_cast<std::uint32_t>(postings[i].size())});
+                previous = 0;
+            }
+            PutVarint(postings[i], entry.record - previous);
+            previous = entry.record;
+        }
+        heads[i].push_back({NO_STRING, static_cast<std::uint32_t>(postings[i].size())});
+    }
+
+    std::uint64_t position = sizeof(PackedHeader);
+    header.strings = position;
+    position += PadTo8(contents.stringsSize);
+    header.blocks = position;
+    header.blockCount = blockOffsets.size() - 1;
+    position += blockOffsets.size() * sizeof(std::uint64_t);
+    for (int field = 0; field < RecordString_Count; ++field) {
+        header.dictionaries[field] = position;
+        header.dictionarySizes[field] = dictionaries[field].size();
+        position += PadTo8(dictionaries[field].size() * sizeof(std::uint32_t));
+    }
+    for (int i = 0; i < SegmentIndex_Count; ++i) {
+        header.index[i] = position;
+        header.indexEntries[i] = heads[i].size() - 1;
+        position += PadTo8(heads[i].size() * sizeof(PostingHead) + postings[i].size());
+    }
+    for (std::uint64_t& offset : blockOffsets) {
+        offset += position;
+    }
+    position += blocks.size();
+
+    out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    WriteStrings(out, contents);
+    out.write(reinterpret_cast<const char*>(blockOffsets.data()),
+              static_cast<std::streamsize>(blockOffsets.size() * sizeof(std::uint64_t)));
+    for (int field = 0; field < RecordString_Count; ++field) {
+        WritePadded(out, reinterpret_cast<const char*>(dictionaries[field].data()),
+                    dictionaries[field].size() * sizeof(std::uint32_t));
+    }
+    for (int i = 0; i < SegmentIndex_Count; ++i) {
+        out.write(reinterpret_cast<const char*>(heads[i].data()),
+                  static_cast<std::streamsize>(heads[i].size() * sizeof(PostingHead)));
+        WritePadded(out, postings[i].data(), postings[i].size());
+    }
+    out.write(blocks.data(), static_cast<std::streamsize>(blocks.size()));
+    return position;
+}
+
+} // namespace
+
+bool ParseSegmentFormat(const std::string& name, SegmentFormat& format) {
+    if (name == "raw") {
+        format = SegmentFormat_Raw;
+    } else if (name == "packed") {
+        format = SegmentFormat_Packed;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+TransactionSegment::TransactionSegment()
+    : path_(),
+      size_(0),
+      fileBytes_(0),
+      firstId_(0),
+      lastId_(0),
+      minTime_(0),
+      maxTime_(0) {
+}
+
+bool TransactionSegment::Write(const std::string& path,
+                               const std::vector<Transaction*>& transactions,
+                               SegmentFormat format,
+                               TransactionSegment& segment) {
+    // Every distinct string once, sorted so readers can binary-search it.
+    // Strings are hashed to temporary ids first, so only distinct ones are
+    // sorted; ids are then renumbered in sorted order.
+    std::unordered_map<std::string, std::uint32_t> firstSeen;
+    std::vector<const std::string*> texts;
+    std::vector<std::uint32_t> raw(transactions.size() * RecordString_Count, NO_STRING);
+    for (std::size_t i = 0; i < transactions.size(); ++i) {
+        const Transaction* transaction = transactions[i];
+        const std::string* fields[RecordString_Count];
+        fields[RecordString_Atm] = &transaction->getAtmSerial();
+        fields[RecordString_Card] = &transaction->getCardNumber();
+        fields[RecordString_SourceBank] = &transaction->getSourceBankName();
+        fields[RecordString_SourceAccount] = &transaction->getSourceAccountNumber();
+        const TransferTarget* target = transaction->getTarget();
+        fields[RecordString_TargetBank] = target != nullptr ? &target->bankName : nullptr;
+        fields[RecordString_TargetAccount] = target != nullptr ? &target->accountNumber : nullptr;
+        fields[RecordString_Note] = &transaction->getNote();
+        for (int field = 0; field < RecordString_Count; ++field) {
+            if (fields[field] == nullptr) {
+                continue;
+            }
+            auto seen = firstSeen.find(*fields[field]);
+            if (seen == firstSeen.end()) {
+                seen = firstSeen.emplace(*fields[field], static_cast<std::uint32_t>(texts.size())).first;
+                texts.push_back(&seen->first);
+            }
+            raw[i * RecordString_Count + field] = seen->second;
+        }
+    }
+    std::vector<std::uint32_t> order(texts.size());
+    for (std::size_t i = 0; i < order.size(); ++i) {
+        order[i] = static_cast<std::uint32_t>(i);
+    }
+    std::sort(order.begin(), order.end(),
+              [&texts](std::uint32_t a, std::uint32_t b) { return *texts[a] < *texts[b]; });
+    std::vector<std::uint32_t> renumber(texts.size());
+    SegmentContents contents;
+    contents.texts.resize(texts.size());
+    for (std::size_t i = 0; i < order.size(); ++i) {
+        renumber[order[i]] = static_cast<std::uint32_t>(i);
+        contents.texts[i] = texts[order[i]];
+    }
+
+    contents.recordCount = transactions.size();
+    contents.firstId = 0;
+    contents.lastId = 0;
+    contents.minTime = 0;
+    contents.maxTime = 0;
+    contents.records.resize(transactions.size());
+    for (std::size_t i = 0; i < transactions.size(); ++i) {
+        const Transaction* transaction = transactions[i];
+        SegmentRecord& record = contents.records[i];
+        record.id = transaction->getId();
+        record.wallMicros = transaction->getTime().wallMicros;
+        record.monotonicNanos = transaction->getTime().monotonicNanos;
+        record.amount = transaction->getAmount();
+        record.fee = transaction->getFee();
+        for (int field = 0; field < RecordString_Count; ++field) {
+            std::uint32_t id = raw[i * RecordString_Count + field];
+            record.strings[field] = id == NO_STRING ? NO_STRING : renumber[id];
+        }
+        record.kind = static_cast<std::uint32_t>(transaction->getKind());
+
+        std::vector<IndexEntry>* index = contents.index;
+        const std::uint32_t position = static_cast<std::uint32_t>(i);
+        index[SegmentIndex_Card].push_back({record.strings[RecordString_Card], position});
+        index[SegmentIndex_Atm].push_back({record.strings[RecordString_Atm], position});
+        index[SegmentIndex_Account].push_back({record.strings[RecordString_SourceAccount], position});
+        index[SegmentIndex_Bank].push_back({record.strings[RecordString_SourceBank], position});
+        // Account and bank match either side of a transfer, once each.
+        if (record.strings[RecordString_TargetAccount] != NO_STRING) {
+            if (record.strings[RecordString_TargetAccount] != record.strings[RecordString_SourceAccount]) {
+                index[SegmentIndex_Account].push_back({record.strings[RecordString_TargetAccount], position});
+            }
+            if (record.strings[RecordString_TargetBank] != record.strings[RecordString_SourceBank]) {
+                index[SegmentIndex_Bank].push_back({record.strings[RecordString_TargetBank], position});
+            }
+        }
+
+        if (i == 0 || record.wallMicros < contents.minTime) {
+            contents.minTime = record.wallMicros;
+        }
+        if (i == 0 || record.wallMicros > contents.maxTime) {
+            contents.maxTime = record.wallMicros;
+        }
+    }
+    if (!contents.records.empty()) {
+        contents.firstId = contents.records.front().id;
+        contents.lastId = contents.records.back().id;
+    }
+    for (int i = 0; i < SegmentIndex_Count; ++i) {
+        GroupByString(contents.index[i], contents.texts.size());
+    }
+
+    contents.stringOffsets.reserve(contents.texts.size() + 1);
+    std::uint64_t textBytes = 0;
+    for (const std::string* text : contents.texts) {
+        contents.stringOffsets.push_back(static_cast<std::uint32_t>(textBytes));
+        textBytes += text->size();
+    }
+    contents.stringOffsets.push_back(static_cast<std::uint32_t>(textBytes));
+    contents.stringsSize = contents.stringOffsets.size() * sizeof(std::uint32_t) + textBytes;
+
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    if (!out) {
+        std::cerr << "Error opening file: " << path << "\n";
+        return false;
+    }
+    const std::uint64_t bytes = format == SegmentFormat_Packed ? WritePacked(out, contents) : WriteRaw(out, contents);
+    out.flush();
+    if (!out) {
+        std::cerr << "Error writing file: " << path << "\n";
+        return false;
+    }
+
+    segment.path_ = path;
+    segment.size_ = contents.records.size();
+    segment.fileBytes_ = bytes;
+    segment.firstId_ = contents.firstId;
+    segment.lastId_ = contents.lastId;
+    segment.minTime_ = contents.minTime;
+    segment.maxTime_ = contents.maxTime;
+    return true;
+}
+
+bool TransactionSegment::Find(const TransactionQuery& query,
+                              std::vector<Transaction*>& out,
+                              LoadedTransactions& loaded) const {
+    if (size_ == 0 || (query.hasFrom && maxTime_ < query.fromMicros) ||
+        (query.hasTo && minTime_ >= query.toMicros)) {
+        return true;
+    }
+    MappedFile file(path_);
+    SegmentView view(file);
+    if (!view.Valid()) {
+        return ReportUnreadable(path_);
+    }
+
+    // The shortest posting list of the string filters names the candidates;
+    // the other filters are checked on each candidate's record, so the other
+    // lists are never read.
+    const std::pair<SegmentIndex, const std::string*> filters[] = {
+        {SegmentIndex_Card, &query.cardNumber},
+        {SegmentIndex_Account, &query.accountNumber},
+        {SegmentIndex_Bank, &query.bankName},
+        {SegmentIndex_Atm, &query.atmSerial},
+    };
+    WantedStrings wanted;
+    std::fill(wanted.ids, wanted.ids + SegmentIndex_Count, NO_STRING);
+    int shortest = -1;
+    std::size_t shortestWeight = 0;
+    for (const auto& filter : filters) {
+        if (filter.second->empty()) {
+            continue;
+        }
+        std::uint32_t string = view.FindString(*filter.second);
+        std::size_t weight = string == NO_STRING ? 0 : view.PostingWeight(filter.first, string);
+        if (weight == 0) {
+            return true;
+        }
+        wanted.ids[filter.first] = string;
+        if (shortest < 0 || weight < shortestWeight) {
+            shortest = filter.first;
+            shortestWeight = weight;
+        }
+    }
+
+    if (shortest < 0) {
+        for (std::size_t i = 0; i < view.RecordCount(); ++i) {
+            const SegmentRecord& record = view.Record(i);
+            Transaction* transaction = MatchesRecord(query, record) ? view.Decode(record, loaded) : nullptr;
+            if (transaction != nullptr) {
+                out.push_back(transaction);
+            }
+        }
+    } else {
+        std::vector<std::uint32_t> candidates;
+        view.Postings(static_cast<SegmentIndex>(shortest), wanted.ids[shortest], candidates);
+        for (std::uint32_t candidate : candidates) {
+            const SegmentRecord& record = view.Record(candidate);
+            if (!MatchesStrings(wanted, record) || !MatchesRecord(query, record)) {
+                continue;
+            }
+            Transaction* transaction = view.Decode(record, loaded);
+            if (transaction != nullptr) {
+                out.push_back(transaction);
+            }
+        }
+    }
+    return view.Intact() || ReportUnreadable(path_);
+}
+
+bool TransactionSegment::FindAccountHistory(const std::string& accountNumber,
+                                            long long beforeId,
+                                            std::size_t count,
+                                            std::vector<Transaction*>& out,
+                                            LoadedTransactions& loaded) const {
+    if (size_ == 0 || count == 0 || firstId_ >= beforeId) {
+        return true;
+    }
+    MappedFile file(path_);
+    SegmentView view(file);
+    if (!view.Valid()) {
+        return ReportUnreadable(path_);
+    }
+    std::uint32_t string = view.FindString(accountNumber);
+    if (string == NO_STRING) {
+        return true;
+    }
+    std::vector<std::uint32_t> positions;
+    view.Postings(SegmentIndex_Account, string, positions);
+    // Records are in ID order, so the ones below beforeId are a prefix.
+    auto end = std::partition_point(positions.begin(), positions.end(), [&view, beforeId](std::uint32_t position) {
+        return view.Record(position).id < beforeId;
+    });
+    std::size_t found = 0;
+    for (auto position = end; position != positions.begin() && found < count;) {
+        --position;
+        Transaction* transaction = view.Decode(view.Record(*position), loaded);
+        if (transaction != nullptr) {
+            out.push_back(transaction);
+            ++found;
+        }
+    }
+    return view.Intact() || ReportUnreadable(path_);
+}
+
+bool TransactionSegment::FindIds(const std::vector<long long>& ids,
+                                 std::vector<Transaction*>& out,
+                                 LoadedTransactions& loaded) const {
+    auto first = std::lower_bound(ids.begin(), ids.end(), firstId_);
+    auto last = std::upper_bound(first, ids.end(), lastId_);
+    if (size_ == 0 || first == last) {
+        return true;
+    }
+    MappedFile file(path_);
+    SegmentView view(file);
+    if (!view.Valid()) {
+        return ReportUnreadable(path_);
+    }
+    // The IDs ascend, so each search starts where the last one ended.
+    std::size_t low = 0;
+    for (auto id = first; id != last; ++id) {
+        std::size_t high = view.RecordCount();
+        while (low < high) {
+            const std::size_t middle = low + (high - low) / 2;
+            if (view.Record(middle).id < *id) {
+                low = middle + 1;
+            } else {
+                high = middle;
+            }
+        }
+        if (low == view.RecordCount()) {
+            break;
+        }
+        const SegmentRecord& record = view.Record(low);
+        Transaction* transaction = record.id == *id ? view.Decode(record, loaded) : nullptr;
+        if (transaction != nullptr) {
+            out.push_back(transaction);
+        }
+    }
+    return view.Intact() || ReportUnreadable(path_);
+}
+
+bool TransactionSegment::ReadAll(std::vector<Transaction*>& out, LoadedTransactions& loaded) const {
+    if (size_ == 0) {
+        return true;
+    }
+    MappedFile file(path_);
+    SegmentView view(file);
+    if (!view.Valid()) {
+        return ReportUnreadable(path_);
+    }
+    for (std::size_t i = 0; i < view.RecordCount(); ++i) {
+        Transaction* transaction = view.Decode(view.Record(i), loaded);
+        if (transaction != nullptr) {
+            out.push_back(transaction);
+        }
+    }
+    return view.Intact() || ReportUnreadable(path_);
+}
+
+const std::string& TransactionSegment::GetPath() const {
+    return path_;
+}
+
+std::size_t TransactionSegment::Size() const {
+    return size_;
+}
+
+long long TransactionSegment::FirstId() const {
+    return firstId_;
+}
+
+long long TransactionSegment::LastId() const {
+    return lastId_;
+}
+
+std::uint64_t TransactionSegment::FileBytes() const {
+    return fileBytes_;
+}
@@ -0,0 +1,81 @@
+#ifndef SEGMENT_HPP
+#define SEGMENT_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "Transaction.hpp"
+
+struct TransactionQuery;
+
+enum SegmentFormat {
+    // Fixed 72-byte records and 8-byte (string, record) index entries; any
+    // record is one array access away.
+    SegmentFormat_Raw,
+    // Records in blocks of 32, stored column by column: IDs and timestamps
+    // as varint deltas, amounts and fees as varints, and string fields as
+    // positions in a per-column dictionary, most frequent value first.
+    // Index postings are varint deltas too. A read decodes only the blocks
+    // holding its candidates. About a quarter of the raw size.
+    SegmentFormat_Packed
+};
+
+// "raw" and "packed".
+bool ParseSegmentFormat(const std::string& name, SegmentFormat& format);
+
+// A sealed run of transactions in an immutable file: records in ID order, a
+// sorted string table, and an index from string to records each for card,
+// account, bank and ATM. Only the summary below stays in memory; a read maps
+// the file, answers from the indexes and unmaps it again, so cold
+// transactions cost page cache rather than heap. Readers tell the formats
+// apart by their magic.
+// Records are in the writing machine's byte order: segments are working
+// files of the ledger, not an interchange format (see Export.hpp).
+class TransactionSegment {
+public:
+    TransactionSegment();
+
+    // Writes transactions, which must be in ID order, to path and fills in
+    // segment to read them back.
+    static bool Write(const std::string& path,
+                      const std::vector<Transaction*>& transactions,
+                      SegmentFormat format,
+                      TransactionSegment& segment);
+
+    // Appends the matches in ID order, decoded into loaded. The query's
+    // limit is left to the caller.
+    bool Find(const TransactionQuery& query, std::vector<Transaction*>& out, LoadedTransactions& loaded) const;
+    // Appends up to count of the account's transactions with an ID below
+    // beforeId, newest first.
+    bool FindAccountHistory(const std::string& accountNumber,
+                            long long beforeId,
+                            std::size_t count,
+                            std::vector<Transaction*>& out,
+                            LoadedTransactions& loaded) const;
+    // Appends the transactions with the given IDs, which must be ascending,
+    // in ID order; IDs the segment lacks are skipped. Each is a binary
+    // search of the records.
+    bool FindIds(const std::vector<long long>& ids, std::vector<Transaction*>& out, LoadedTransactions& loaded) const;
+    // Appends every transaction in ID order.
+    bool ReadAll(std::vector<Transaction*>& out, LoadedTransactions& loaded) const;
+
+    const std::string& GetPath() const;
+    std::size_t Size() const;
+    long long FirstId() const;
+    long long LastId() const;
+    std::uint64_t FileBytes() const;
+
+private:
+    std::string path_;
+    std::size_t size_;
+    std::uint64_t fileBytes_;
+    long long firstId_;
+    long long lastId_;
+    // Wall-clock microseconds, for skipping the file on a time range.
+    long long minTime_;
+    long long maxTime_;
+};
+
+#endif // SEGMENT_HPP
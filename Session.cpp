@@ -0,0 +1,824 @@
+#include "Session.hpp"
+
+#include <cstdlib>
+#include <fstream>
+#include <unordered_map>
+
+#include "Account.hpp"
+#include "Bank.hpp"
+#include "Card.hpp"
+#include "Export.hpp"
+#include "Ledger.hpp"
+#include "Report.hpp"
+#include "System.hpp"
+#include "Trace.hpp"
+
+namespace {
+
+const int MAX_AUTH_ATTEMPTS = 3;
+const int MAX_CHECKS = 30;
+const long long MIN_CHECK_AMOUNT = 100000;
+const int MAX_BILLS_PER_PROMPT = 50;
+
+std::string T(ATMLanguage lang, const std::string& en, const std::string& kr) {
+    return (lang == ATMLanguage_Korean) ? kr : en;
+}
+
+// Bills are prompted from the largest denomination down; this maps the
+// prompt position to the note slot.
+int BillPromptSlot(int promptIndex) {
+    return CASH_TYPE_COUNT - 1 - promptIndex;
+}
+
+std::string BillPrompt(ATMLanguage lang, int promptIndex) {
+    std::string value = FormatNoteValue(CASH_BILL_VALUES[BillPromptSlot(promptIndex)]);
+    return T(lang, value + " KRW bills: ", value + "원 지폐 수: ");
+}
+
+// To the ATM's receipt sink when it has one, else to the session's output.
+void PrintSessionReceipt(const ATM* atm, std::ostream& out) {
+    ReceiptSink* sink = atm->GetReceiptSink();
+    if (sink != nullptr) {
+        atm->PrintReceipt(*sink);
+    } else {
+        atm->PrintReceipt(out);
+    }
+}
+
+std::string InvalidInput(ATMLanguage lang) {
+    return T(lang, "Invalid input. Try again.\n", "잘못된 입력입니다. 다시 시도하세요.\n");
+}
+
+// Accepts an optionally signed decimal integer that fills the whole token.
+bool ParseInteger(const std::string& token, long long& value) {
+    if (token.empty() || token.size() > 18) {
+        return false;
+    }
+    char* end = nullptr;
+    value = std::strtoll(token.c_str(), &end, 10);
+    return end != token.c_str() && *end == '\0';
+}
+
+// Menu choices are digits only, as typed at the menu prompts.
+bool ParseMenuChoice(const std::string& token, int& choice) {
+    if (token.empty() || token.size() > 9) {
+        return false;
+    }
+    for (char c : token) {
+        if (c < '0' || c > '9') {
+            return false;
+        }
+    }
+    choice = std::atoi(token.c_str());
+    return true;
+}
+
+void PrintSessionCounts(std::ostream& out, const ATM* atm, ATMLanguage lang) {
+    out << T(lang, "This ATM sessions: ", "이 ATM 세션 수: ")
+        << atm->GetTotalSessions()
+        << T(lang, " (customer ", " (고객 ")
+        << atm->GetCustomerSessions()
+        << T(lang, ", admin ", ", 관리자 ")
+        << atm->GetAdminSessions() << ")\n";
+    long long lookups = atm->GetPlanCacheLookups();
+    out << T(lang, "Dispense plan cache: ", "출금 계획 캐시: ")
+        << atm->GetPlanCacheHits() << " / " << lookups
+        << T(lang, " hits", " 적중");
+    if (lookups > 0) {
+        out << " (" << atm->GetPlanCacheHits() * 100 / lookups << "%)";
+    }
+    out << "\n";
+}
+
+} // namespace
+
+SessionContext::SessionContext(SystemState* systemState, TraceWriter* traceWriter)
+    : state(systemState),
+      trace(traceWriter) {
+}
+
+AtmSession::AtmSession(SessionContext* context, ATM* atm)
+    : context_(context),
+      atm_(atm),
+      account_(nullptr),
+      cash_(),
+      feeCash_(),
+      amount_(0),
+      adminCard_(),
+      step_(SessionStep_Idle),
+      billIndex_(0),
+      attempts_(0),
+      checkCount_(0) {
+}
+
+bool AtmSession::IsActive() const {
+    return step_ != SessionStep_Idle;
+}
+
+SessionStep AtmSession::GetStep() const {
+    return static_cast<SessionStep>(step_);
+}
+
+ATM* AtmSession::GetAtm() const {
+    return atm_;
+}
+
+void AtmSession::Begin(std::ostream& out) {
+    if (atm_ == nullptr || IsActive()) {
+        return;
+    }
+    std::ostream* savedConsole = &atm_->GetConsole();
+    atm_->SetConsole(&out);
+    if (!atm_->IsBilingual()) {
+        out << "English only ATM. Proceeding in English.\n";
+        atm_->SetLanguage(ATMLanguage_English);
+        Enter(SessionStep_SessionType, out);
+    } else {
+        Enter(SessionStep_Language, out);
+    }
+    atm_->SetConsole(savedConsole);
+}
+
+void AtmSession::Enter(SessionStep step, std::ostream& out) {
+    step_ = static_cast<unsigned char>(step);
+    ATMLanguage lang = atm_->GetActiveLanguage();
+    switch (step) {
+    case SessionStep_Language:
+        out << "\nSelect language / 언어를 선택하세요\n";
+        out << "  [1] English\n";
+        out << "  [2] 한국어\n";
+        break;
+    case SessionStep_SessionType:
+        out << T(lang, "1) Customer session\n", "1) 고객 세션\n");
+        out << T(lang, "2) Admin transaction history\n", "2) 관리자 거래 내역\n");
+        out << T(lang, "0) Cancel\n", "0) 취소\n");
+        break;
+    case SessionStep_AdminMenu:
+        out << "\n========================================\n";
+        out << "              ADMIN MENU                \n";
+        out << "========================================\n";
+        out << "  [1] " << T(lang, "Print all transactions", "모든 거래 출력") << "\n";
+        out << "  [2] " << T(lang, "Export transactions to file", "거래 내역 파일로 저장") << "\n";
+        out << "  [3] " << T(lang, "Search transactions", "거래 검색") << "\n";
+        out << "  [/] " << T(lang, "Snapshot", "스냅샷") << "\n";
+        out << "  [0] " << T(lang, "Exit admin menu", "관리자 메뉴 종료") << "\n";
+        out << "========================================\n";
+        break;
+    case SessionStep_CustomerMenu:
+        out << "\n========================================\n";
+        out << T(lang, "          ATM MENU - Serial ", "          ATM 메뉴 - 일련번호 ") << atm_->GetSerialNumber() << "         \n";
+        out << "========================================\n";
+        out << "  [1] " << T(lang, "Deposit", "입금") << "\n";
+        out << "  [2] " << T(lang, "Withdraw", "출금") << "\n";
+        out << "  [3] " << T(lang, "Account transfer", "계좌 이체") << "\n";
+        out << "  [4] " << T(lang, "Cash transfer", "현금 이체") << "\n";
+        out << "  [5] " << T(lang, "Print receipt", "영수증 출력") << "\n";
+        out << "  [/] " << T(lang, "Snapshot", "스냅샷") << "\n";
+        out << "  [0] " << T(lang, "End session", "세션 종료") << "\n";
+        out << "========================================\n";
+        break;
+    case SessionStep_DepositCheck:
+        if (checkCount_ >= MAX_CHECKS) {
+            out << T(lang,
+                     "Maximum of 30 checks reached.\n",
+                     "최대 30개의 수표만 가능합니다.\n");
+            FinishChecks(out);
+            return;
+        }
+        break;
+    default:
+        break;
+    }
+    Prompt(out);
+}
+
+void AtmSession::Prompt(std::ostream& out) {
+    ATMLanguage lang = atm_->GetActiveLanguage();
+    switch (static_cast<SessionStep>(step_)) {
+    case SessionStep_Idle:
+        break;
+    case SessionStep_Language:
+        out << "Choice / 선택: ";
+        break;
+    case SessionStep_SessionType:
+        out << T(lang, "Select session type: ", "세션 유형을 선택하세요: ");
+        break;
+    case SessionStep_AdminCard:
+        out << T(lang, "Enter admin card number: ", "관리자 카드 번호를 입력하세요: ");
+        break;
+    case SessionStep_AdminPassword:
+        out << T(lang, "Enter admin password: ", "관리자 비밀번호를 입력하세요: ");
+        break;
+    case SessionStep_AdminMenu:
+    case SessionStep_CustomerMenu:
+        out << T(lang, "Select an option: ", "옵션을 선택하세요: ");
+        break;
+    case SessionStep_AdminExportFile:
+        out << T(lang, "Enter output filename: ", "출력할 파일 이름을 입력하세요: ");
+        break;
+    case SessionStep_AdminQuery:
+        out << T(lang, "Enter search (e.g. card=1111-1111-1111,kind=withdrawal,min=10000): ",
+                 "검색 조건을 입력하세요 (예: card=1111-1111-1111,kind=withdrawal,min=10000): ");
+        break;
+    case SessionStep_CustomerCard:
+        out << T(lang, "Enter card number (or type /cancel): ",
+                 "카드 번호를 입력하세요 (/cancel 입력 시 취소): ");
+        break;
+    case SessionStep_CustomerPin:
+        out << T(lang, "Enter PIN/password: ", "PIN/비밀번호를 입력하세요: ");
+        break;
+    case SessionStep_DepositBills:
+    case SessionStep_DepositFeeBills:
+    case SessionStep_CashTransferBills:
+        out << BillPrompt(lang, billIndex_);
+        break;
+    case SessionStep_DepositCheck:
+        out << T(lang, "Enter check amount (0 to finish): ", "수표 금액을 입력하세요 (0 입력 시 종료): ");
+        break;
+    case SessionStep_WithdrawalAmount:
+        out << T(lang, "Enter withdrawal amount: ", "출금 금액을 입력하세요: ");
+        break;
+    case SessionStep_TransferAccount:
+    case SessionStep_CashTransferAccount:
+        out << T(lang, "Enter destination account number: ", "상대 계좌 번호를 입력하세요: ");
+        break;
+    case SessionStep_TransferAmount:
+        out << T(lang, "Enter transfer amount: ", "이체 금액을 입력하세요: ");
+        break;
+    }
+}
+
+SessionInput AtmSession::Feed(const std::string& token, std::ostream& out) {
+    if (!IsActive()) {
+        return SessionInput_Ignored;
+    }
+
+    std::ostream* savedConsole = &atm_->GetConsole();
+    atm_->SetConsole(&out);
+    SessionInput result = Handle(token, out);
+    atm_->SetConsole(savedConsole);
+    return result;
+}
+
+SessionInput AtmSession::Accept(const std::string& token, std::ostream& out) {
+    if (IsActive()) {
+        return Feed(token, out);
+    }
+    if (token != "start") {
+        out << "Terminal " << atm_->GetSerialNumber() << " is idle; send 'start' to begin.\n";
+        return SessionInput_Ignored;
+    }
+    Begin(out);
+    return SessionInput_Accepted;
+}
+
+SessionInput AtmSession::Handle(const std::string& token, std::ostream& out) {
+    ATMLanguage lang = atm_->GetActiveLanguage();
+    long long number = 0;
+
+    switch (static_cast<SessionStep>(step_)) {
+    case SessionStep_Idle:
+        return SessionInput_Ignored;
+
+    case SessionStep_Language:
+        if (!ParseInteger(token, number) || number < 1 || number > 2) {
+            out << "Invalid input. Try again. / 잘못된 입력입니다. 다시 시도하세요.\n";
+            Prompt(out);
+            return SessionInput_Rejected;
+        }
+        atm_->SetLanguage(number == 2 ? ATMLanguage_Korean : ATMLanguage_English);
+        Enter(SessionStep_SessionType, out);
+        return SessionInput_Accepted;
+
+    case SessionStep_SessionType:
+        if (!ParseInteger(token, number) || number < 0 || number > 2) {
+            out << InvalidInput(lang);
+            Prompt(out);
+            return SessionInput_Rejected;
+        }
+        if (number == 0) {
+            Finish();
+        } else if (number == 2) {
+            StartAdmin(out);
+        } else {
+            Enter(SessionStep_CustomerCard, out);
+        }
+        return SessionInput_Accepted;
+
+    case SessionStep_AdminCard:
+        adminCard_ = token;
+        Enter(SessionStep_AdminPassword, out);
+        return SessionInput_Accepted;
+
+    case SessionStep_AdminPassword: {
+        Bank* primaryBank = atm_->GetPrimaryBank();
+        bool authenticated = primaryBank->verifyAdminCredentials(adminCard_, token);
+        adminCard_.clear();
+        if (!authenticated) {
+            out << T(lang, "Wrong admin credentials.\n", "관리자 정보가 올바르지 않습니다.\n");
+            if (++attempts_ < MAX_AUTH_ATTEMPTS) {
+                Enter(SessionStep_AdminCard, out);
+                return SessionInput_Accepted;
+            }
+            out << T(lang, "Admin authentication failed. Returning to main menu.\n",
+                     "관리자 인증에 실패했습니다. 메인 메뉴로 돌아갑니다.\n");
+            atm_->EndSession();
+            Finish();
+            return SessionInput_Accepted;
+        }
+
+        ++context_->state->totalSessions;
+        ++context_->state->adminSessions;
+        atm_->IncrementAdminSession();
+        if (context_->trace != nullptr) {
+            TraceRecord record;
+            record.op = TraceOp_AdminSession;
+            record.atmSerial = atm_->GetSerialNumber();
+            record.language = lang;
+            context_->trace->Write(record);
+        }
+        Enter(SessionStep_AdminMenu, out);
+        return SessionInput_Accepted;
+    }
+
+    case SessionStep_AdminMenu:
+        SelectAdminOption(token, out);
+        return SessionInput_Accepted;
+
+    case SessionStep_AdminExportFile: {
+        std::vector<Transaction*> found;
+        LoadedTransactions loaded;
+        const std::vector<Transaction*>& transactions =
+            atm_->ReadTransactions(found, loaded);
+        // A .csv, .ndjson or .bin name selects a machine-readable export.
+        ExportFormat format;
+        if (ExportFormatForFile(token, format)) {
+            ExportResult result;
+            if (!ExportTransactionsToFile(token, transactions, format, 0, result)) {
+                out << T(lang, "Failed to open file.\n", "파일을 열 수 없습니다.\n");
+                Enter(SessionStep_AdminMenu, out);
+                return SessionInput_Accepted;
+            }
+            Record(TraceOp_ExportTransactions);
+            out << T(lang, "Transactions exported to ", "거래 내역을 파일로 저장했습니다: ") << token << "\n";
+            Enter(SessionStep_AdminMenu, out);
+            return SessionInput_Accepted;
+        }
+        std::ofstream fout(token);
+        if (!fout) {
+            out << T(lang, "Failed to open file.\n", "파일을 열 수 없습니다.\n");
+            Enter(SessionStep_AdminMenu, out);
+            return SessionInput_Accepted;
+        }
+        PrintSessionCounts(fout, atm_, lang);
+        Record(TraceOp_ExportTransactions);
+        PrintTransactions(transactions, fout, lang);
+        out << T(lang, "Transactions exported to ", "거래 내역을 파일로 저장했습니다: ") << token << "\n";
+        Enter(SessionStep_AdminMenu, out);
+        return SessionInput_Accepted;
+    }
+
+    case SessionStep_AdminQuery: {
+        // Admins search the history of the ATM they are signed in to.
+        TransactionQuery query;
+        if (!ParseTransactionQuery(token, query)) {
+            out << T(lang, "Invalid search.\n", "잘못된 검색 조건입니다.\n");
+            Enter(SessionStep_AdminMenu, out);
+            return SessionInput_Accepted;
+        }
+        query.atmSerial = atm_->GetSerialNumber();
+        std::vector<Transaction*> found;
+        LoadedTransactions loaded;
+        context_->state->ledger.Find(query, found, loaded);
+        PrintQueryResults(found, out, lang);
+        Enter(SessionStep_AdminMenu, out);
+        return SessionInput_Accepted;
+    }
+
+    case SessionStep_CustomerCard:
+        if (token == "/cancel") {
+            Finish();
+            return SessionInput_Accepted;
+        }
+        StartCustomer(token, out);
+        return SessionInput_Accepted;
+
+    case SessionStep_CustomerPin: {
+        Bank* bank = account_->getBank();
+        const std::string& cardNumber = account_->getLinkedCard()->getNumber();
+        Account* verifiedAccount = nullptr;
+        if (!bank->verifyUserCredentials(cardNumber, token, verifiedAccount)) {
+            out << T(lang, "Wrong password.\n", "비밀번호가 올바르지 않습니다.\n");
+            if (++attempts_ < MAX_AUTH_ATTEMPTS) {
+                Prompt(out);
+                return SessionInput_Accepted;
+            }
+            out << T(lang, "Too many wrong password attempts. Session aborted.\n",
+                     "비밀번호 오류가 많아 세션을 종료합니다.\n");
+            atm_->EndSession();
+            Finish();
+            return SessionInput_Accepted;
+        }
+
+        atm_->IncrementCustomerSession();
+        if (context_->trace != nullptr) {
+            TraceRecord record;
+            record.op = TraceOp_CustomerSession;
+            record.atmSerial = atm_->GetSerialNumber();
+            record.cardNumber = cardNumber;
+            record.language = lang;
+            context_->trace->Write(record);
+        }
+        account_ = nullptr;
+        Enter(SessionStep_CustomerMenu, out);
+        return SessionInput_Accepted;
+    }
+
+    case SessionStep_CustomerMenu:
+        SelectCustomerOption(token, out);
+        return SessionInput_Accepted;
+
+    case SessionStep_DepositBills:
+    case SessionStep_DepositFeeBills:
+    case SessionStep_CashTransferBills: {
+        bool feeBills = step_ == SessionStep_DepositFeeBills;
+        if (!ParseInteger(token, number) || number < 0 ||
+            (!feeBills && number > MAX_BILLS_PER_PROMPT) || number > 2147483647LL) {
+            out << InvalidInput(lang);
+            Prompt(out);
+            return SessionInput_Rejected;
+        }
+        CashDrawer& target = feeBills ? feeCash_ : cash_;
+        target.noteCounts[BillPromptSlot(billIndex_)] = static_cast<int>(number);
+        if (++billIndex_ < CASH_TYPE_COUNT) {
+            Prompt(out);
+            return SessionInput_Accepted;
+        }
+        billIndex_ = 0;
+        if (step_ == SessionStep_DepositBills) {
+            amount_ = 0;
+            checkCount_ = 0;
+            Enter(SessionStep_DepositCheck, out);
+        } else if (feeBills) {
+            SubmitDeposit(out);
+        } else {
+            RecordRequest(TraceOp_CashTransfer, account_->getAccountNumber(), 0);
+            atm_->RequestCashTransfer(account_, cash_);
+            AfterCustomerRequest(out);
+        }
+        return SessionInput_Accepted;
+    }
+
+    case SessionStep_DepositCheck:
+        if (!ParseInteger(token, number) || number < 0) {
+            out << InvalidInput(lang);
+            Prompt(out);
+            return SessionInput_Rejected;
+        }
+        if (number == 0) {
+            FinishChecks(out);
+            return SessionInput_Accepted;
+        }
+        if (number < MIN_CHECK_AMOUNT) {
+            out << T(lang,
+                     "Each check must be at least 100,000 KRW.\n",
+                     "각 수표는 최소 100,000원이어야 합니다.\n");
+        } else {
+            amount_ += number;
+            ++checkCount_;
+        }
+        Enter(SessionStep_DepositCheck, out);
+        return SessionInput_Accepted;
+
+    case SessionStep_WithdrawalAmount:
+        if (!ParseInteger(token, number) || number < 0) {
+            out << InvalidInput(lang);
+            Prompt(out);
+            return SessionInput_Rejected;
+        }
+        RecordRequest(TraceOp_Withdrawal, std::string(), number);
+        atm_->RequestWithdrawal(number);
+        AfterCustomerRequest(out);
+        return SessionInput_Accepted;
+
+    case SessionStep_TransferAccount:
+    case SessionStep_CashTransferAccount: {
+        Account* destination = FindAccountByNumber(context_->state->banks, token);
+        if (destination == nullptr) {
+            out << T(lang, "Account not found.\n", "계좌를 찾을 수 없습니다.\n");
+            AfterCustomerRequest(out);
+            return SessionInput_Accepted;
+        }
+        account_ = destination;
+        if (step_ == SessionStep_TransferAccount) {
+            Enter(SessionStep_TransferAmount, out);
+        } else {
+            cash_ = CashDrawer();
+            billIndex_ = 0;
+            std::string label = T(lang, "cash transfer", "현금 이체");
+            out << T(lang,
+                     "Enter bills for " + label + " (use non-negative integers).\n",
+                     label + "에 사용할 지폐 개수를 입력하세요 (음수가 아닌 정수).\n");
+            Enter(SessionStep_CashTransferBills, out);
+        }
+        return SessionInput_Accepted;
+    }
+
+    case SessionStep_TransferAmount:
+        if (!ParseInteger(token, number) || number < 1) {
+            out << InvalidInput(lang);
+            Prompt(out);
+            return SessionInput_Rejected;
+        }
+        RecordRequest(TraceOp_AccountTransfer, account_->getAccountNumber(), number);
+        atm_->RequestAccountTransfer(account_, number);
+        AfterCustomerRequest(out);
+        return SessionInput_Accepted;
+    }
+    return SessionInput_Ignored;
+}
+
+void AtmSession::Finish() {
+    step_ = SessionStep_Idle;
+    account_ = nullptr;
+    attempts_ = 0;
+    billIndex_ = 0;
+    checkCount_ = 0;
+    amount_ = 0;
+    adminCard_.clear();
+}
+
+void AtmSession::StartAdmin(std::ostream& out) {
+    if (atm_->GetPrimaryBank() == nullptr) {
+        out << "This ATM does not have a primary bank configured.\n";
+        Finish();
+        return;
+    }
+    atm_->StartAdminSession(nullptr);
+    attempts_ = 0;
+    Enter(SessionStep_AdminCard, out);
+}
+
+void AtmSession::StartCustomer(const std::string& cardNumber, std::ostream& out) {
+    ATMLanguage lang = atm_->GetActiveLanguage();
+    Account* initialAccount = FindAccountByCard(context_->state->banks, cardNumber);
+    if (initialAccount == nullptr) {
+        out << T(lang, "Card not recognized.\n", "인식되지 않는 카드입니다.\n");
+        atm_->StartCustomerSession(nullptr, nullptr, false);
+        Finish();
+        return;
+    }
+    Bank* bank = initialAccount->getBank();
+    if (bank == nullptr) {
+        atm_->StartCustomerSession(initialAccount->getLinkedCard(), initialAccount, false);
+        out << T(lang, "Account is not associated with a bank.\n", "계좌가 은행과 연결되어 있지 않습니다.\n");
+        atm_->EndSession();
+        Finish();
+        return;
+    }
+
+    if (!atm_->SupportsBank(bank)) {
+        atm_->StartCustomerSession(initialAccount->getLinkedCard(), initialAccount, false);
+        out << T(lang, "This ATM does not support the selected bank/card.\n",
+                 "이 ATM은 선택한 은행/카드를 지원하지 않습니다.\n");
+        atm_->EndSession();
+        Finish();
+        return;
+    }
+
+    bool isPrimary = (atm_->GetPrimaryBank() == bank);
+    atm_->StartCustomerSession(initialAccount->getLinkedCard(), initialAccount, isPrimary);
+    if (!atm_->HasActiveSession()) {
+        Finish();
+        return;
+    }
+
+    account_ = initialAccount;
+    attempts_ = 0;
+    Enter(SessionStep_CustomerPin, out);
+}
+
+void AtmSession::SelectAdminOption(const std::string& token, std::ostream& out) {
+    ATMLanguage lang = atm_->GetActiveLanguage();
+    if (token == "/") {
+        context_->state->snapshot.Print(context_->state->banks, context_->state->atms, lang, out);
+        Enter(SessionStep_AdminMenu, out);
+        return;
+    }
+    int choice = 0;
+    if (!ParseMenuChoice(token, choice)) {
+        out << InvalidInput(lang);
+        Enter(SessionStep_AdminMenu, out);
+        return;
+    }
+
+    switch (choice) {
+    case 0:
+        Record(TraceOp_EndSession);
+        atm_->EndSession();
+        Finish();
+        return;
+    case 1: {
+        PrintSessionCounts(out, atm_, lang);
+        Record(TraceOp_PrintTransactions);
+        std::vector<Transaction*> found;
+        LoadedTransactions loaded;
+        PrintTransactions(atm_->ReadTransactions(found, loaded), out, lang);
+        break;
+    }
+    case 2:
+        Enter(SessionStep_AdminExportFile, out);
+        return;
+    case 3:
+        Enter(SessionStep_AdminQuery, out);
+        return;
+    default:
+        out << T(lang, "Unknown choice.\n", "알 수 없는 선택입니다.\n");
+        break;
+    }
+    Enter(SessionStep_AdminMenu, out);
+}
+
+void AtmSession::SelectCustomerOption(const std::string& token, std::ostream& out) {
+    ATMLanguage lang = atm_->GetActiveLanguage();
+    if (token == "/") {
+        context_->state->snapshot.Print(context_->state->banks, context_->state->atms, lang, out);
+        Enter(SessionStep_CustomerMenu, out);
+        return;
+    }
+    int choice = 0;
+    if (!ParseMenuChoice(token, choice) || choice > 5) {
+        out << InvalidInput(lang);
+        Enter(SessionStep_CustomerMenu, out);
+        return;
+    }
+
+    switch (choice) {
+    case 0:
+        Record(TraceOp_EndSession);
+        PrintSessionReceipt(atm_, out);
+        out << T(lang, "Session ended.\n", "세션이 종료되었습니다.\n");
+        atm_->EndSession();
+        Finish();
+        return;
+    case 1: {
+        cash_ = CashDrawer();
+        feeCash_ = CashDrawer();
+        billIndex_ = 0;
+        std::string label = T(lang, "deposit", "입금");
+        out << T(lang,
+                 "Enter bills for " + label + " (use non-negative integers).\n",
+                 label + "에 사용할 지폐 개수를 입력하세요 (음수가 아닌 정수).\n");
+        Enter(SessionStep_DepositBills, out);
+        return;
+    }
+    case 2:
+        Enter(SessionStep_WithdrawalAmount, out);
+        return;
+    case 3:
+        Enter(SessionStep_TransferAccount, out);
+        return;
+    case 4:
+        Enter(SessionStep_CashTransferAccount, out);
+        return;
+    default:
+        Record(TraceOp_PrintReceipt);
+        PrintSessionReceipt(atm_, out);
+        AfterCustomerRequest(out);
+        return;
+    }
+}
+
+void AtmSession::FinishChecks(std::ostream& out) {
+    ATMLanguage lang = atm_->GetActiveLanguage();
+    if (cash_.TotalValue() + amount_ <= 0) {
+        out << T(lang,
+                 "Deposit amount must be positive.\n",
+                 "입금 금액은 0보다 커야 합니다.\n");
+        AfterCustomerRequest(out);
+        return;
+    }
+
+    long long depositFee = atm_->GetDepositFeeForCurrentSession(cash_.TotalValue() + amount_);
+    feeCash_ = CashDrawer();
+    if (depositFee == 0) {
+        out << T(lang,
+                 "No cash fee is required for this deposit.\n",
+                 "이 입금에는 현금 수수료가 필요하지 않습니다.\n");
+        SubmitDeposit(out);
+        return;
+    }
+
+    out << T(lang,
+             "Enter bills for fee (this cash will not be added to your account; it pays the fee).\n",
+             "수수료 지폐 개수를 입력하세요 (이 현금은 계좌에 추가되지 않고 수수료로 사용됩니다).\n");
+    out << T(lang, "Exact fee amount: ", "정확한 수수료 금액: ") << depositFee << "\n";
+    billIndex_ = 0;
+    Enter(SessionStep_DepositFeeBills, out);
+}
+
+void AtmSession::SubmitDeposit(std::ostream& out) {
+    if (context_->trace != nullptr) {
+        TraceRecord record;
+        record.op = TraceOp_Deposit;
+        record.atmSerial = atm_->GetSerialNumber();
+        record.cash = cash_;
+        record.amount = amount_;
+        record.count = checkCount_;
+        record.feeCash = feeCash_;
+        context_->trace->Write(record);
+    }
+    atm_->RequestDeposit(cash_, amount_, feeCash_, checkCount_);
+    AfterCustomerRequest(out);
+}
+
+void AtmSession::AfterCustomerRequest(std::ostream& out) {
+    account_ = nullptr;
+    if (!atm_->HasActiveSession()) {
+        ATMLanguage lang = atm_->GetActiveLanguage();
+        out << T(lang, "Session ended due to an error.\n", "오류로 인해 세션이 종료되었습니다.\n");
+        Finish();
+        return;
+    }
+    Enter(SessionStep_CustomerMenu, out);
+}
+
+void AtmSession::Record(TraceOp op) {
+    RecordRequest(op, std::string(), 0);
+}
+
+void AtmSession::RecordRequest(TraceOp op, const std::string& accountNumber, long long amount) {
+    if (context_->trace == nullptr) {
+        return;
+    }
+    TraceRecord record;
+    record.op = op;
+    record.atmSerial = atm_->GetSerialNumber();
+    record.accountNumber = accountNumber;
+    record.amount = amount;
+    if (op == TraceOp_CashTransfer) {
+        record.cash = cash_;
+    }
+    context_->trace->Write(record);
+}
+
+SessionMultiplexer::SessionMultiplexer(SessionContext* context)
+    : context_(context),
+      sessions_(),
+      atmIndex_() {
+    const std::vector<ATM*>& atms = context_->state->atms;
+    sessions_.resize(atms.size(), nullptr);
+    atmIndex_.reserve(atms.size());
+    for (std::size_t i = 0; i < atms.size(); ++i) {
+        if (atms[i] != nullptr) {
+            atmIndex_.emplace(atms[i]->GetSerialNumber(), i);
+        }
+    }
+}
+
+SessionMultiplexer::~SessionMultiplexer() {
+    for (AtmSession* session : sessions_) {
+        delete session;
+    }
+}
+
+bool SessionMultiplexer::Dispatch(const std::string& atmSerial, const std::string& token, std::ostream& out) {
+    AtmSession* session = FindOrCreate(atmSerial);
+    if (session == nullptr) {
+        return false;
+    }
+    session->Accept(token, out);
+    return true;
+}
+
+std::size_t SessionMultiplexer::ActiveSessions() const {
+    std::size_t active = 0;
+    for (const AtmSession* session : sessions_) {
+        if (session != nullptr && session->IsActive()) {
+            ++active;
+        }
+    }
+    return active;
+}
+
+std::size_t SessionMultiplexer::SessionCount() const {
+    std::size_t count = 0;
+    for (const AtmSession* session : sessions_) {
+        if (session != nullptr) {
+            ++count;
+        }
+    }
+    return count;
+}
+
+AtmSession* SessionMultiplexer::FindOrCreate(const std::string& atmSerial) {
+    auto it = atmIndex_.find(atmSerial);
+    if (it == atmIndex_.end()) {
+        return nullptr;
+    }
+    AtmSession*& session = sessions_[it->second];
+    if (session == nullptr) {
+        session = new AtmSession(context_, context_->state->atms[it->second]);
+    }
+    return session;
+}
@@ -0,0 +1,125 @@
+#ifndef SESSION_HPP
+#define SESSION_HPP
+
+#include <cstddef>
+#include <iostream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "Atm.hpp"
+#include "Trace.hpp"
+
+class Account;
+struct SystemState;
+
+enum SessionStep {
+    SessionStep_Idle,
+    SessionStep_Language,
+    SessionStep_SessionType,
+    SessionStep_AdminCard,
+    SessionStep_AdminPassword,
+    SessionStep_AdminMenu,
+    SessionStep_AdminExportFile,
+    SessionStep_AdminQuery,
+    SessionStep_CustomerCard,
+    SessionStep_CustomerPin,
+    SessionStep_CustomerMenu,
+    SessionStep_DepositBills,
+    SessionStep_DepositCheck,
+    SessionStep_DepositFeeBills,
+    SessionStep_WithdrawalAmount,
+    SessionStep_TransferAccount,
+    SessionStep_TransferAmount,
+    SessionStep_CashTransferAccount,
+    SessionStep_CashTransferBills
+};
+
+enum SessionInput {
+    SessionInput_Accepted,
+    // A numeric prompt rejected the token; console drivers discard the rest
+    // of the input line, as the blocking prompts did.
+    SessionInput_Rejected,
+    SessionInput_Ignored
+};
+
+// Shared by every session driven from one thread.
+struct SessionContext {
+    SystemState* state;
+    TraceWriter* trace;
+
+    SessionContext(SystemState* systemState, TraceWriter* traceWriter);
+};
+
+// One terminal's customer/admin dialogue as an explicit state machine.
+// Begin() starts a visit and prints the first prompt; each Feed() consumes
+// one input token, acts on it and prints the next prompt. Nothing blocks,
+// so a single thread can drive any number of sessions. All dialogue state
+// lives in this object; pending text is kept only for the admin card number.
+class AtmSession {
+public:
+    AtmSession(SessionContext* context, ATM* atm);
+
+    void Begin(std::ostream& out);
+    SessionInput Feed(const std::string& token, std::ostream& out);
+    // Begins a visit on the token "start" when idle, otherwise feeds the token.
+    SessionInput Accept(const std::string& token, std::ostream& out);
+    bool IsActive() const;
+    SessionStep GetStep() const;
+    ATM* GetAtm() const;
+
+private:
+    // Moves to a step, printing its menu (if any) and its prompt.
+    void Enter(SessionStep step, std::ostream& out);
+    void Prompt(std::ostream& out);
+    SessionInput Handle(const std::string& token, std::ostream& out);
+    void Finish();
+    void StartAdmin(std::ostream& out);
+    void StartCustomer(const std::string& cardNumber, std::ostream& out);
+    void SelectAdminOption(const std::string& token, std::ostream& out);
+    void SelectCustomerOption(const std::string& token, std::ostream& out);
+    void FinishChecks(std::ostream& out);
+    void SubmitDeposit(std::ostream& out);
+    void AfterCustomerRequest(std::ostream& out);
+    void Record(TraceOp op);
+    void RecordRequest(TraceOp op, const std::string& accountNumber, long long amount);
+
+    SessionContext* context_;
+    ATM* atm_;
+    // Card account while logging in, destination account during transfers.
+    Account* account_;
+    CashDrawer cash_;
+    CashDrawer feeCash_;
+    long long amount_;
+    std::string adminCard_;
+    unsigned char step_;
+    unsigned char billIndex_;
+    unsigned char attempts_;
+    unsigned char checkCount_;
+};
+
+// Routes input events from many terminals to their sessions on one thread.
+// Sessions are created lazily, one per ATM. An idle terminal starts a visit
+// when it receives the token "start".
+class SessionMultiplexer {
+public:
+    explicit SessionMultiplexer(SessionContext* context);
+    ~SessionMultiplexer();
+
+    // Returns false if no ATM has the given serial number.
+    bool Dispatch(const std::string& atmSerial, const std::string& token, std::ostream& out);
+    std::size_t ActiveSessions() const;
+    std::size_t SessionCount() const;
+    // Returns nullptr if no ATM has the given serial number.
+    AtmSession* FindOrCreate(const std::string& atmSerial);
+
+private:
+    SessionMultiplexer(const SessionMultiplexer&) = delete;
+    SessionMultiplexer& operator=(const SessionMultiplexer&) = delete;
+
+    SessionContext* context_;
+    std::vector<AtmSession*> sessions_;
+    std::unordered_map<std::string, std::size_t> atmIndex_;
+};
+
+#endif // SESSION_HPP
@@ -0,0 +1,140 @@
+#include "Settlement.hpp"
+
+#include <algorithm>
+#include <fstream>
+
+#include "Bank.hpp"
+
+namespace {
+
+bool SettlesBefore(const SettlementPosition& a, const SettlementPosition& b) {
+    if (a.payer != b.payer) {
+        return a.payer->getIndex() < b.payer->getIndex();
+    }
+    return a.payee->getIndex() < b.payee->getIndex();
+}
+
+} // namespace
+
+SettlementBatch::SettlementBatch()
+    : cycle(0),
+      postings(0),
+      positions() {
+}
+
+SettlementLedger::SettlementLedger()
+    : mutex_(),
+      cycle_(1),
+      cyclePostings_(0),
+      pairs_() {
+}
+
+void SettlementLedger::Post(const Obligation* obligations, std::size_t count) {
+    bool interbank = false;
+    for (std::size_t i = 0; i < count && !interbank; ++i) {
+        interbank = obligations[i].debtor != nullptr && obligations[i].creditor != nullptr &&
+                    obligations[i].debtor != obligations[i].creditor && obligations[i].amount != 0;
+    }
+    if (!interbank) {
+        return;
+    }
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (std::size_t i = 0; i < count; ++i) {
+        PostLocked(obligations[i]);
+    }
+    ++cyclePostings_;
+}
+
+void SettlementLedger::Post(const Bank* debtor, const Bank* creditor, long long amount) {
+    Obligation obligation;
+    obligation.debtor = debtor;
+    obligation.creditor = creditor;
+    obligation.amount = amount;
+    Post(&obligation, 1);
+}
+
+SettlementBatch SettlementLedger::CloseCycle() {
+    std::unordered_map<unsigned long long, PairPosition> closed;
+    SettlementBatch batch;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        closed.swap(pairs_);
+        batch.cycle = cycle_++;
+        batch.postings = cyclePostings_;
+        cyclePostings_ = 0;
+    }
+
+    batch.positions.reserve(closed.size());
+    for (const auto& entry : closed) {
+        const PairPosition& pair = entry.second;
+        if (pair.net == 0) {
+            continue;
+        }
+        SettlementPosition position;
+        bool lowerPays = pair.net > 0;
+        position.payer = lowerPays ? pair.lower : pair.higher;
+        position.payee = lowerPays ? pair.higher : pair.lower;
+        position.amount = lowerPays ? pair.net : -pair.net;
+        position.postings = pair.postings;
+        position.grossFromPayer = lowerPays ? pair.grossFromLower : pair.grossFromHigher;
+        position.grossFromPayee = lowerPays ? pair.grossFromHigher : pair.grossFromLower;
+        batch.positions.push_back(position);
+    }
+    std::sort(batch.positions.begin(), batch.positions.end(), SettlesBefore);
+    return batch;
+}
+
+std::size_t SettlementLedger::OpenPairs() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return pairs_.size();
+}
+
+void SettlementLedger::PostLocked(const Obligation& obligation) {
+    if (obligation.debtor == nullptr || obligation.creditor == nullptr ||
+        obligation.debtor == obligation.creditor || obligation.amount == 0) {
+        return;
+    }
+    bool debtorIsLower = obligation.debtor->getIndex() < obligation.creditor->getIndex();
+    const Bank* lower = debtorIsLower ? obligation.debtor : obligation.creditor;
+    const Bank* higher = debtorIsLower ? obligation.creditor : obligation.debtor;
+    unsigned long long key = (static_cast<unsigned long long>(lower->getIndex()) << 32) |
+                             static_cast<unsigned long long>(higher->getIndex());
+
+    auto inserted = pairs_.emplace(key, PairPosition());
+    PairPosition& pair = inserted.first->second;
+    if (inserted.second) {
+        pair.lower = lower;
+        pair.higher = higher;
+        pair.net = 0;
+        pair.postings = 0;
+        pair.grossFromLower = 0;
+        pair.grossFromHigher = 0;
+    }
+    ++pair.postings;
+    if (debtorIsLower) {
+        pair.net += obligation.amount;
+        pair.grossFromLower += obligation.amount;
+    } else {
+        pair.net -= obligation.amount;
+        pair.grossFromHigher += obligation.amount;
+    }
+}
+
+void WriteSettlementBatch(const SettlementBatch& batch, std::ostream& out) {
+    out << "# settlement cycle " << batch.cycle << ": " << batch.postings << " postings, "
+        << batch.positions.size() << " positions\n";
+    for (const SettlementPosition& position : batch.positions) {
+        out << position.payer->getBankName() << " " << position.payee->getBankName() << " "
+            << position.amount << " " << position.postings << "\n";
+    }
+}
+
+bool WriteSettlementFile(const std::string& filename, const SettlementBatch& batch) {
+    std::ofstream fout(filename);
+    if (!fout) {
+        std::cerr << "Error opening file: " << filename << "\n";
+        return false;
+    }
+    WriteSettlementBatch(batch, fout);
+    return static_cast<bool>(fout);
+}
@@ -0,0 +1,86 @@
+#ifndef SETTLEMENT_HPP
+#define SETTLEMENT_HPP
+
+#include <cstddef>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+class Bank;
+
+// Money one bank owes another because of one posting.
+struct Obligation {
+    const Bank* debtor;
+    const Bank* creditor;
+    long long amount;
+};
+
+// What one bank pays another at the end of a cycle.
+struct SettlementPosition {
+    const Bank* payer;
+    const Bank* payee;
+    long long amount;
+    // Obligations netted into this position, and their gross value in each
+    // direction.
+    long long postings;
+    long long grossFromPayer;
+    long long grossFromPayee;
+};
+
+// A closed settlement cycle; positions are ordered by payer, then payee.
+struct SettlementBatch {
+    long long cycle;
+    long long postings;
+    std::vector<SettlementPosition> positions;
+
+    SettlementBatch();
+};
+
+// Interbank obligations netted into bank-pair positions as they are posted,
+// so closing a cycle walks the open pairs instead of the ledger. Posting is
+// a hash update under one short lock and may come from any ATM's strand;
+// the obligations of one posting always land in the same cycle.
+class SettlementLedger {
+public:
+    SettlementLedger();
+
+    // Obligations of a bank to itself are dropped.
+    void Post(const Obligation* obligations, std::size_t count);
+    void Post(const Bank* debtor, const Bank* creditor, long long amount);
+
+    // Ends the current cycle and returns its non-zero net positions.
+    SettlementBatch CloseCycle();
+    // Bank pairs with postings in the current cycle.
+    std::size_t OpenPairs() const;
+
+private:
+    SettlementLedger(const SettlementLedger&) = delete;
+    SettlementLedger& operator=(const SettlementLedger&) = delete;
+
+    // Keyed by the two banks' indexes, lower first.
+    struct PairPosition {
+        const Bank* lower;
+        const Bank* higher;
+        // Positive when the lower-indexed bank owes the other.
+        long long net;
+        long long postings;
+        long long grossFromLower;
+        long long grossFromHigher;
+    };
+
+    void PostLocked(const Obligation& obligation);
+
+    mutable std::mutex mutex_;
+    long long cycle_;
+    long long cyclePostings_;
+    std::unordered_map<unsigned long long, PairPosition> pairs_;
+};
+
+// "# settlement cycle <n>: <postings> postings, <positions> positions"
+// followed by "<payer> <payee> <amount> <postings>" per position.
+void WriteSettlementBatch(const SettlementBatch& batch, std::ostream& out);
+bool WriteSettlementFile(const std::string& filename, const SettlementBatch& batch);
+
+#endif // SETTLEMENT_HPP
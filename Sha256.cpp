@@ -0,0 +1,145 @@
+#include "Sha256.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+namespace {
+
+const std::uint32_t ROUND_CONSTANTS[64] = {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+    0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+    0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+    0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+    0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+    0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2,
+};
+
+std::uint32_t RotateRight(std::uint32_t value, int bits) {
+    return (value >> bits) | (value << (32 - bits));
+}
+
+} // namespace
+
+bool operator==(const Sha256Digest& a, const Sha256Digest& b) {
+    return std::memcmp(a.bytes, b.bytes, sizeof(a.bytes)) == 0;
+}
+
+bool operator!=(const Sha256Digest& a, const Sha256Digest& b) {
+    return !(a == b);
+}
+
+std::string ToHex(const Sha256Digest& digest) {
+    static const char DIGITS[] = "0123456789abcdef";
+    std::string text;
+    text.reserve(2 * sizeof(digest.bytes));
+    for (unsigned char byte : digest.bytes) {
+        text.push_back(DIGITS[byte >> 4]);
+        text.push_back(DIGITS[byte & 0x0F]);
+    }
+    return text;
+}
+
+Sha256::Sha256()
+    : state_{0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19},
+      buffer_(),
+      buffered_(0),
+      length_(0) {
+}
+
+void Sha256::Update(const void* data, std::size_t size) {
+    const unsigned char* bytes = static_cast<const unsigned char*>(data);
+    length_ += size;
+    if (buffered_ > 0) {
+        std::size_t take = std::min(size, sizeof(buffer_) - buffered_);
+        std::memcpy(buffer_ + buffered_, bytes, take);
+        buffered_ += take;
+        bytes += take;
+        size -= take;
+        if (buffered_ < sizeof(buffer_)) {
+            return;
+        }
+        Compress(buffer_);
+        buffered_ = 0;
+    }
+    for (; size >= sizeof(buffer_); bytes += sizeof(buffer_), size -= sizeof(buffer_)) {
+        Compress(bytes);
+    }
+    std::memcpy(buffer_, bytes, size);
+    buffered_ = size;
+}
+
+Sha256Digest Sha256::Finish() {
+    const std::uint64_t bits = length_ * 8;
+    buffer_[buffered_++] = 0x80;
+    if (buffered_ > sizeof(buffer_) - 8) {
+        std::memset(buffer_ + buffered_, 0, sizeof(buffer_) - buffered_);
+        Compress(buffer_);
+        buffered_ = 0;
+    }
+    std::memset(buffer_ + buffered_, 0, sizeof(buffer_) - 8 - buffered_);
+    for (int i = 0; i < 8; ++i) {
+        buffer_[sizeof(buffer_) - 8 + i] = static_cast<unsigned char>(bits >> (56 - 8 * i));
+    }
+    Compress(buffer_);
+
+    Sha256Digest digest;
+    for (int i = 0; i < 8; ++i) {
+        digest.bytes[4 * i] = static_cast<unsigned char>(state_[i] >> 24);
+        digest.bytes[4 * i + 1] = static_cast<unsigned char>(state_[i] >> 16);
+        digest.bytes[4 * i + 2] = static_cast<unsigned char>(state_[i] >> 8);
+        digest.bytes[4 * i + 3] = static_cast<unsigned char>(state_[i]);
+    }
+    return digest;
+}
+
+void Sha256::Compress(const unsigned char* block) {
+    std::uint32_t schedule[64];
+    for (int i = 0; i < 16; ++i) {
+        schedule[i] = (static_cast<std::uint32_t>(block[4 * i]) << 24) |
+                      (static_cast<std::uint32_t>(block[4 * i + 1]) << 16) |
+                      (static_cast<std::uint32_t>(block[4 * i + 2]) << 8) |
+                      static_cast<std::uint32_t>(block[4 * i + 3]);
+    }
+    for (int i = 16; i < 64; ++i) {
+        std::uint32_t s0 = RotateRight(schedule[i - 15], 7) ^ RotateRight(schedule[i - 15], 18) ^
+                           (schedule[i - 15] >> 3);
+        std::uint32_t s1 = RotateRight(schedule[i - 2], 17) ^ RotateRight(schedule[i - 2], 19) ^
+                           (schedule[i - 2] >> 10);
+        schedule[i] = schedule[i - 16] + s0 + schedule[i - 7] + s1;
+    }
+
+    std::uint32_t a = state_[0];
+    std::uint32_t b = state_[1];
+    std::uint32_t c = state_[2];
+    std::uint32_t d = state_[3];
+    std::uint32_t e = state_[4];
+    std::uint32_t f = state_[5];
+    std::uint32_t g = state_[6];
+    std::uint32_t h = state_[7];
+    for (int i = 0; i < 64; ++i) {
+        std::uint32_t s1 = RotateRight(e, 6) ^ RotateRight(e, 11) ^ RotateRight(e, 25);
+        std::uint32_t choose = (e & f) ^ (~e & g);
+        std::uint32_t t1 = h + s1 + choose + ROUND_CONSTANTS[i] + schedule[i];
+        std::uint32_t s0 = RotateRight(a, 2) ^ RotateRight(a, 13) ^ RotateRight(a, 22);
+        std::uint32_t majority = (a & b) ^ (a & c) ^ (b & c);
+        std::uint32_t t2 = s0 + majority;
+        h = g;
+        g = f;
+        f = e;
+        e = d + t1;
+        d = c;
+        c = b;
+        b = a;
+        a = t1 + t2;
+    }
+    state_[0] += a;
+    state_[1] += b;
+    state_[2] += c;
+    state_[3] += d;
+    state_[4] += e;
+    state_[5] += f;
+    state_[6] += g;
+    state_[7] += h;
+}
@@ -0,0 +1,34 @@
+#ifndef SHA256_HPP
+#define SHA256_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+struct Sha256Digest {
+    unsigned char bytes[32];
+};
+
+bool operator==(const Sha256Digest& a, const Sha256Digest& b);
+bool operator!=(const Sha256Digest& a, const Sha256Digest& b);
+// Lowercase hex, 64 characters.
+std::string ToHex(const Sha256Digest& digest);
+
+// SHA-256 (FIPS 180-4), fed in pieces. Finish may be called once.
+class Sha256 {
+public:
+    Sha256();
+
+    void Update(const void* data, std::size_t size);
+    Sha256Digest Finish();
+
+private:
+    void Compress(const unsigned char* block);
+
+    std::uint32_t state_[8];
+    unsigned char buffer_[64];
+    std::size_t buffered_;
+    std::uint64_t length_;
+};
+
+#endif // SHA256_HPP
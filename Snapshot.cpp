@@ -0,0 +1,416 @@
+#include "Snapshot.hpp"
+
+#include <algorithm>
+#include <cstdlib>
+#include <sstream>
+
+#include "Account.hpp"
+#include "Bank.hpp"
+
+namespace {
+
+std::string T(ATMLanguage lang, const std::string& en, const std::string& kr) {
+    return (lang == ATMLanguage_Korean) ? kr : en;
+}
+
+bool ParseNumber(const std::string& text, long long& value) {
+    if (text.empty() || text.size() > 18) {
+        return false;
+    }
+    char* end = nullptr;
+    value = std::strtoll(text.c_str(), &end, 10);
+    return end != text.c_str() && *end == '\0';
+}
+
+const unsigned long long COOKIE_POSITION_BITS = 32;
+
+// An account's cookie names its bank and its position in that bank.
+unsigned long long MakeCookie(std::size_t bank, std::size_t position) {
+    return (static_cast<unsigned long long>(bank) << COOKIE_POSITION_BITS) | position;
+}
+
+std::size_t CookieBank(unsigned long long cookie) {
+    return static_cast<std::size_t>(cookie >> COOKIE_POSITION_BITS);
+}
+
+std::size_t CookiePosition(unsigned long long cookie) {
+    return static_cast<std::size_t>(cookie & ((1ULL << COOKIE_POSITION_BITS) - 1));
+}
+
+} // namespace
+
+SnapshotQuery::SnapshotQuery()
+    : bankName(),
+      hasMinBalance(false),
+      minBalance(0),
+      hasMaxBalance(false),
+      maxBalance(0),
+      topN(0),
+      page(0),
+      pageSize(0) {
+}
+
+bool SnapshotQuery::IsFiltered() const {
+    return !bankName.empty() || hasMinBalance || hasMaxBalance || topN > 0 || pageSize > 0;
+}
+
+bool ParseSnapshotQuery(const std::string& text, SnapshotQuery& query) {
+    std::stringstream stream(text);
+    std::string item;
+    while (std::getline(stream, item, ',')) {
+        if (item.empty()) {
+            continue;
+        }
+        std::size_t equals = item.find('=');
+        if (equals == std::string::npos) {
+            return false;
+        }
+        std::string key = item.substr(0, equals);
+        std::string value = item.substr(equals + 1);
+        if (key == "bank") {
+            query.bankName = value;
+            continue;
+        }
+        long long number = 0;
+        if (!ParseNumber(value, number)) {
+            return false;
+        }
+        if (key == "min") {
+            query.hasMinBalance = true;
+            query.minBalance = number;
+        } else if (key == "max") {
+            query.hasMaxBalance = true;
+            query.maxBalance = number;
+        } else if (key == "top" && number >= 0) {
+            query.topN = static_cast<std::size_t>(number);
+        } else if (key == "page" && number >= 0) {
+            query.page = static_cast<std::size_t>(number);
+        } else if (key == "size" && number >= 0) {
+            query.pageSize = static_cast<std::size_t>(number);
+        } else {
+            return false;
+        }
+    }
+    return true;
+}
+
+FleetSnapshot::FleetSnapshot()
+    : mutex_(),
+      bankSource_(),
+      bankSlots_(),
+      unread_(),
+      unwatched_(),
+      refreshed_(0),
+      dirtyMutex_(),
+      dirty_() {
+}
+
+FleetSnapshot::~FleetSnapshot() {
+    Clear();
+}
+
+void FleetSnapshot::Print(const std::vector<Bank*>& banks,
+                          const std::vector<ATM*>& atms,
+                          ATMLanguage lang,
+                          std::ostream& out) {
+    Print(banks, atms, SnapshotQuery(), lang, out);
+}
+
+void FleetSnapshot::Print(const std::vector<Bank*>& banks,
+                          const std::vector<ATM*>& atms,
+                          const SnapshotQuery& query,
+                          ATMLanguage lang,
+                          std::ostream& out) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    SyncLayout(banks);
+    std::vector<unsigned long long> changed;
+    {
+        std::lock_guard<std::mutex> dirtyLock(dirtyMutex_);
+        changed.swap(dirty_);
+    }
+    // Acknowledged before the view opens, so a commit the view misses is
+    // reported again.
+    for (unsigned long long cookie : changed) {
+        bankSlots_[CookieBank(cookie)].accounts[CookiePosition(cookie)].account->acknowledgeBalanceChange();
+    }
+
+    // Every balance read comes from one point in time, while ATMs keep running.
+    ReadView view;
+    refreshed_ = 0;
+    for (unsigned long long cookie : changed) {
+        Refresh(view, CookieBank(cookie), CookiePosition(cookie));
+    }
+    for (const SlotRef& slot : unread_) {
+        Refresh(view, slot.bank, slot.position);
+    }
+    unread_.clear();
+    for (const SlotRef& slot : unwatched_) {
+        Refresh(view, slot.bank, slot.position);
+    }
+
+    out << "\n=== " << T(lang, "Snapshot", "스냅샷") << " ===\n";
+    out << T(lang, "ATMs (remaining cash):", "ATM (잔여 현금):") << "\n";
+    const std::string remaining = T(lang, "Remaining cash: ", "잔여 현금: ");
+    const std::string left = T(lang, " | Left cash: ", " | 남은 지폐: ");
+    const std::string won = T(lang, " won", "원");
+    for (const ATM* atm : atms) {
+        if (atm == nullptr) {
+            continue;
+        }
+        const Bank* primaryBank = atm->GetPrimaryBank();
+        if (!query.bankName.empty() &&
+            (primaryBank == nullptr || primaryBank->getBankName() != query.bankName)) {
+            continue;
+        }
+        const CashDrawer& drawer = view.Read(atm->GetCashVersions());
+        out << (primaryBank ? primaryBank->getBankName() : "Unknown") << " ATM [SN:" << atm->GetSerialNumber()
+            << "] " << remaining << drawer.TotalValue() << left;
+        for (int i = 0; i < CASH_TYPE_COUNT; ++i) {
+            out << (i > 0 ? ", " : "") << drawer.noteCounts[i] << " x " << FormatNoteValue(CASH_BILL_VALUES[i])
+                << won;
+        }
+        out << "\n";
+    }
+
+    out << "\n" << T(lang, "Accounts (remaining balance):", "계좌 (잔액):") << "\n";
+    const std::size_t first = query.pageSize > 0 ? query.page * query.pageSize : 0;
+    const std::size_t count = query.pageSize > 0 ? query.pageSize : static_cast<std::size_t>(-1);
+    std::vector<SlotRef> shown;
+    const std::size_t matched = Collect(query, first, count, shown);
+
+    const std::string owner = ", " + T(lang, "Owner", "소유자") + ": ";
+    const std::string balance = "] " + T(lang, "Balance", "잔액") + " : ";
+    const std::string inUse = T(lang, " (in use)", " (사용 중)");
+    std::string prefix;
+    std::size_t prefixBank = bankSlots_.size();
+    for (const SlotRef& slot : shown) {
+        if (slot.bank != prefixBank) {
+            prefixBank = slot.bank;
+            prefix = T(lang, "Account", "계좌") + " [" + T(lang, "Bank", "은행") + ": " +
+                     bankSlots_[slot.bank].bank->getBankName() + ", " + T(lang, "No.", "번호") + " ";
+        }
+        const AccountSlot& account = bankSlots_[slot.bank].accounts[slot.position];
+        out << prefix << account.account->getAccountNumber() << owner << account.account->getOwnerName()
+            << balance << account.balance;
+        if (account.account->isInUse()) {
+            out << inUse;
+        }
+        out << "\n";
+    }
+    if (query.IsFiltered()) {
+        const std::size_t listed = query.topN > 0 ? std::min(query.topN, matched) : matched;
+        const std::size_t shownFirst = std::min(first, listed);
+        out << T(lang, "Showing ", "표시: ") << (shown.empty() ? 0 : shownFirst + 1) << "-"
+            << shownFirst + shown.size() << T(lang, " of ", " / ") << matched
+            << T(lang, " matching accounts", " 개 계좌") << "\n";
+    }
+
+    out << "================\n";
+}
+
+void FleetSnapshot::Clear() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    Unwatch();
+    bankSource_.clear();
+    bankSlots_.clear();
+    unread_.clear();
+    unwatched_.clear();
+}
+
+std::size_t FleetSnapshot::LastRefreshCount() const {
+    return refreshed_;
+}
+
+bool FleetSnapshot::RanksHigher::operator()(const RankKey& a, const RankKey& b) const {
+    if (a.balance != b.balance) {
+        return a.balance > b.balance;
+    }
+    return a.position < b.position;
+}
+
+void FleetSnapshot::BalanceChanged(unsigned long long cookie) {
+    std::lock_guard<std::mutex> lock(dirtyMutex_);
+    dirty_.push_back(cookie);
+}
+
+void FleetSnapshot::SyncLayout(const std::vector<Bank*>& banks) {
+    if (!std::equal(banks.begin(), banks.end(), bankSource_.begin(), bankSource_.end())) {
+        Unwatch();
+        bankSlots_.clear();
+        unread_.clear();
+        unwatched_.clear();
+        bankSource_.assign(banks.begin(), banks.end());
+        for (const Bank* bank : banks) {
+            if (bank == nullptr) {
+                continue;
+            }
+            bankSlots_.push_back(BankSlots());
+            bankSlots_.back().bank = bank;
+            bankSlots_.back().sourceSize = 0;
+            bankSlots_.back().indexed = false;
+        }
+    }
+    // Banks only ever append accounts, so each bank's account count finds
+    // its new accounts without walking the old ones.
+    for (std::size_t i = 0; i < bankSlots_.size(); ++i) {
+        BankSlots& bankSlots = bankSlots_[i];
+        const std::vector<Account*>& accounts = bankSlots.bank->getAccounts();
+        for (std::size_t k = bankSlots.sourceSize; k < accounts.size(); ++k) {
+            if (accounts[k] != nullptr) {
+                AddSlot(i, accounts[k]);
+            }
+        }
+        bankSlots.sourceSize = accounts.size();
+    }
+}
+
+void FleetSnapshot::AddSlot(std::size_t bank, Account* account) {
+    BankSlots& bankSlots = bankSlots_[bank];
+    const SlotRef ref{bank, bankSlots.accounts.size()};
+    AccountSlot slot;
+    slot.account = account;
+    slot.balance = 0;
+    slot.watched = account->watchBalance(this, MakeCookie(ref.bank, ref.position));
+    bankSlots.accounts.push_back(slot);
+    if (bankSlots.indexed) {
+        bankSlots.ranked.insert(RankKey{slot.balance, ref.position});
+    }
+    if (slot.watched) {
+        unread_.push_back(ref);
+    } else {
+        unwatched_.push_back(ref);
+    }
+}
+
+void FleetSnapshot::Unwatch() {
+    for (BankSlots& bankSlots : bankSlots_) {
+        for (AccountSlot& slot : bankSlots.accounts) {
+            if (slot.watched) {
+                slot.account->unwatchBalance(this);
+            }
+        }
+    }
+    // Nothing is reported once the accounts are unwatched.
+    std::lock_guard<std::mutex> lock(dirtyMutex_);
+    dirty_.clear();
+}
+
+void FleetSnapshot::Refresh(const ReadView& view, std::size_t bank, std::size_t position) {
+    BankSlots& bankSlots = bankSlots_[bank];
+    AccountSlot& slot = bankSlots.accounts[position];
+    const long long balance = view.Read(slot.account->getBalanceVersions());
+    ++refreshed_;
+    if (balance == slot.balance) {
+        return;
+    }
+    if (bankSlots.indexed) {
+        bankSlots.ranked.erase(RankKey{slot.balance, position});
+        bankSlots.ranked.insert(RankKey{balance, position});
+    }
+    slot.balance = balance;
+}
+
+void FleetSnapshot::BuildIndex(BankSlots& bankSlots) {
+    if (bankSlots.indexed) {
+        return;
+    }
+    for (std::size_t i = 0; i < bankSlots.accounts.size(); ++i) {
+        bankSlots.ranked.insert(bankSlots.ranked.end(), RankKey{bankSlots.accounts[i].balance, i});
+    }
+    bankSlots.indexed = true;
+}
+
+bool FleetSnapshot::InScope(const BankSlots& bankSlots, const SnapshotQuery& query) const {
+    return query.bankName.empty() || bankSlots.bank->getBankName() == query.bankName;
+}
+
+std::size_t FleetSnapshot::Collect(const SnapshotQuery& query,
+                                   std::size_t first,
+                                   std::size_t count,
+                                   std::vector<SlotRef>& shown) {
+    typedef std::set<RankKey, RanksHigher>::const_iterator RankIterator;
+    const bool byBalance = query.hasMinBalance || query.hasMaxBalance;
+    std::size_t matched = 0;
+
+    if (query.topN == 0 && !byBalance) {
+        // Every account in scope, in bank order; whole banks before the
+        // page are skipped by their size.
+        std::size_t skip = first;
+        for (std::size_t i = 0; i < bankSlots_.size(); ++i) {
+            if (!InScope(bankSlots_[i], query)) {
+                continue;
+            }
+            const std::size_t size = bankSlots_[i].accounts.size();
+            matched += size;
+            for (std::size_t k = std::min(skip, size); k < size && shown.size() < count; ++k) {
+                shown.push_back(SlotRef{i, k});
+            }
+            skip -= std::min(skip, size);
+        }
+        return matched;
+    }
+
+    // Each bank's matches, largest balance first.
+    std::vector<RankIterator> heads;
+    std::vector<std::size_t> headBanks;
+    for (std::size_t i = 0; i < bankSlots_.size(); ++i) {
+        if (!InScope(bankSlots_[i], query)) {
+            continue;
+        }
+        BuildIndex(bankSlots_[i]);
+        const std::set<RankKey, RanksHigher>& ranked = bankSlots_[i].ranked;
+        heads.push_back(query.hasMaxBalance ? ranked.lower_bound(RankKey{query.maxBalance, 0}) : ranked.begin());
+        headBanks.push_back(i);
+    }
+    const auto inRange = [this, &query, &headBanks](std::size_t head, RankIterator it) {
+        return it != bankSlots_[headBanks[head]].ranked.end() &&
+               (!query.hasMinBalance || it->balance >= query.minBalance);
+    };
+
+    if (query.topN == 0) {
+        // Listed in bank order, so each bank's matches are sorted back by
+        // position.
+        std::vector<std::size_t> positions;
+        for (std::size_t h = 0; h < heads.size(); ++h) {
+            positions.clear();
+            for (RankIterator it = heads[h]; inRange(h, it); ++it) {
+                positions.push_back(it->position);
+            }
+            std::sort(positions.begin(), positions.end());
+            for (std::size_t position : positions) {
+                if (matched >= first && shown.size() < count) {
+                    shown.push_back(SlotRef{headBanks[h], position});
+                }
+                ++matched;
+            }
+        }
+        return matched;
+    }
+
+    for (std::size_t h = 0; h < heads.size(); ++h) {
+        if (!byBalance) {
+            matched += bankSlots_[headBanks[h]].accounts.size();
+            continue;
+        }
+        for (RankIterator it = heads[h]; inRange(h, it); ++it) {
+            ++matched;
+        }
+    }
+    // Merges the banks' rankings until the page is full; banks are few,
+    // so the next entry is picked by comparing the heads.
+    const std::size_t listed = std::min(query.topN, matched);
+    const std::size_t wanted = first >= listed ? 0 : first + std::min(count, listed - first);
+    for (std::size_t rank = 0; rank < wanted; ++rank) {
+        std::size_t best = heads.size();
+        for (std::size_t h = 0; h < heads.size(); ++h) {
+            if (inRange(h, heads[h]) && (best == heads.size() || heads[h]->balance > heads[best]->balance)) {
+                best = h;
+            }
+        }
+        if (rank >= first) {
+            shown.push_back(SlotRef{headBanks[best], heads[best]->position});
+        }
+        ++heads[best];
+    }
+    return matched;
+}
@@ -0,0 +1,141 @@
+#ifndef SNAPSHOT_HPP
+#define SNAPSHOT_HPP
+
+#include <cstddef>
+#include <iostream>
+#include <mutex>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "Account.hpp"
+#include "Atm.hpp"
+#include "Versions.hpp"
+
+class Bank;
+
+// Narrows a snapshot. The default query lists every ATM and account.
+struct SnapshotQuery {
+    // Only this bank's accounts and the ATMs it operates; empty for all.
+    std::string bankName;
+    bool hasMinBalance;
+    long long minBalance;
+    bool hasMaxBalance;
+    long long maxBalance;
+    // When non-zero, only the topN largest balances, largest first.
+    std::size_t topN;
+    // Paging over the matching accounts; pageSize 0 shows them all.
+    std::size_t page;
+    std::size_t pageSize;
+
+    SnapshotQuery();
+
+    bool IsFiltered() const;
+};
+
+// Parses "bank=Kakao,min=1000,max=5000,top=10,page=0,size=50" (any subset,
+// any order). Returns false on an unknown key or a malformed number.
+bool ParseSnapshotQuery(const std::string& text, SnapshotQuery& query);
+
+// The snapshot printout, kept up to date incrementally. Each watched
+// account reports its first balance commit after a print into a dirty set,
+// and the next print re-reads only those balances, through one ReadView
+// opened after the set is drained. The balances are also kept in a
+// balance-ordered index per bank, built the first time a query filters or
+// ranks by balance, so a top-N or balance-range query walks only the
+// accounts it matches. Lines are formatted as they are printed, in the
+// language asked for, and only for the accounts on the page; ATM lines are
+// read through the same view. Whether an account is in use is read from the
+// account itself rather than by scanning the ATMs' sessions. An account
+// already watched by another snapshot is re-read on every print instead.
+// The banks, accounts and ATMs must outlive the snapshot or be dropped with
+// Clear() first.
+class FleetSnapshot : private BalanceObserver {
+public:
+    FleetSnapshot();
+    ~FleetSnapshot();
+
+    void Print(const std::vector<Bank*>& banks,
+               const std::vector<ATM*>& atms,
+               ATMLanguage lang,
+               std::ostream& out);
+    void Print(const std::vector<Bank*>& banks,
+               const std::vector<ATM*>& atms,
+               const SnapshotQuery& query,
+               ATMLanguage lang,
+               std::ostream& out);
+    void Clear();
+
+    // Balances re-read by the last Print.
+    std::size_t LastRefreshCount() const;
+
+private:
+    FleetSnapshot(const FleetSnapshot&) = delete;
+    FleetSnapshot& operator=(const FleetSnapshot&) = delete;
+
+    struct AccountSlot {
+        Account* account;
+        long long balance;
+        bool watched;
+    };
+
+    // An account's place in its bank's index: position in the bank's
+    // account list, and the balance it is filed under.
+    struct RankKey {
+        long long balance;
+        std::size_t position;
+    };
+
+    // Largest balance first, then the bank's own order.
+    struct RanksHigher {
+        bool operator()(const RankKey& a, const RankKey& b) const;
+    };
+
+    struct BankSlots {
+        const Bank* bank;
+        // Size of the bank's account list when the slots were laid out.
+        std::size_t sourceSize;
+        std::vector<AccountSlot> accounts;
+        bool indexed;
+        std::set<RankKey, RanksHigher> ranked;
+    };
+
+    // Where a match is printed from: a bank and a position in it.
+    struct SlotRef {
+        std::size_t bank;
+        std::size_t position;
+    };
+
+    void BalanceChanged(unsigned long long cookie) override;
+
+    // Lays out the accounts the banks gained since the last print and
+    // queues them for reading.
+    void SyncLayout(const std::vector<Bank*>& banks);
+    void AddSlot(std::size_t bank, Account* account);
+    void Unwatch();
+    void Refresh(const ReadView& view, std::size_t bank, std::size_t position);
+    void BuildIndex(BankSlots& bankSlots);
+    bool InScope(const BankSlots& bankSlots, const SnapshotQuery& query) const;
+    // The accounts the query lists from the first-th on, at most count of
+    // them. Returns how many accounts match before any top-N cut.
+    std::size_t Collect(const SnapshotQuery& query,
+                        std::size_t first,
+                        std::size_t count,
+                        std::vector<SlotRef>& shown);
+
+    std::mutex mutex_;
+    std::vector<const Bank*> bankSource_;
+    std::vector<BankSlots> bankSlots_;
+    // Slots laid out since the last print.
+    std::vector<SlotRef> unread_;
+    // Slots whose account another observer watches, read on every print.
+    std::vector<SlotRef> unwatched_;
+    std::size_t refreshed_;
+
+    // Cookies of watched accounts whose balance changed; taken by the
+    // committing threads, so never held while locking an account.
+    std::mutex dirtyMutex_;
+    std::vector<unsigned long long> dirty_;
+};
+
+#endif // SNAPSHOT_HPP
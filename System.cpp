@@ -0,0 +1,437 @@
+#include "System.hpp"
+
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <utility>
+
+#include "Account.hpp"
+#include "Atm.hpp"
+#include "Bank.hpp"
+#include "Card.hpp"
+#include "Transaction.hpp"
+#include "Versions.hpp"
+
+namespace {
+
+enum FeeTarget {
+    FeeTarget_All,
+    FeeTarget_Bank,
+    FeeTarget_Atm
+};
+
+enum FeeLine {
+    FeeLine_Base,
+    FeeLine_Bands,
+    FeeLine_Override
+};
+
+struct FeeRule {
+    FeeTarget target;
+    std::string name;
+    FeeLine line;
+    ATMFees fees;
+    std::vector<long long> bandLimits;
+    FeeOverride feeOverride;
+};
+
+bool ParseFeeKind(const std::string& text, ATMTransactionKind& kind) {
+    if (text == "deposit") {
+        kind = ATMTransaction_Deposit;
+    } else if (text == "withdrawal") {
+        kind = ATMTransaction_Withdrawal;
+    } else if (text == "transfer") {
+        kind = ATMTransaction_AccountTransfer;
+    } else if (text == "cash-transfer") {
+        kind = ATMTransaction_CashTransfer;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+// "*" leaves bank null (any bank).
+bool ParseFeeBank(const std::string& text, const SystemState& state, const Bank*& bank) {
+    bank = nullptr;
+    if (text == "*") {
+        return true;
+    }
+    bank = FindBank(state.banks, text);
+    return bank != nullptr;
+}
+
+bool ParseFeeValues(std::istringstream& fields, FeeRule& rule) {
+    rule.line = FeeLine_Base;
+    long long* values[] = {
+        &rule.fees.depositPrimary,
+        &rule.fees.depositNonPrimary,
+        &rule.fees.withdrawalPrimary,
+        &rule.fees.withdrawalNonPrimary,
+        &rule.fees.transferPrimaryToPrimary,
+        &rule.fees.transferPrimaryToOther,
+        &rule.fees.transferNonPrimaryToNonPrimary,
+        &rule.fees.cashTransferAny,
+    };
+    for (long long* value : values) {
+        if (!(fields >> *value) || *value < 0) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool ParseFeeBands(std::istringstream& fields, FeeRule& rule) {
+    rule.line = FeeLine_Bands;
+    long long limit = 0;
+    while (fields >> limit) {
+        if (limit <= 0 || (!rule.bandLimits.empty() && limit <= rule.bandLimits.back())) {
+            return false;
+        }
+        rule.bandLimits.push_back(limit);
+    }
+    return !rule.bandLimits.empty() && fields.eof();
+}
+
+bool ParseFeeOverride(std::istringstream& fields, const SystemState& state, FeeRule& rule) {
+    rule.line = FeeLine_Override;
+    FeeOverride& feeOverride = rule.feeOverride;
+    std::string kind;
+    std::string source;
+    std::string destination;
+    std::string band;
+    if (!(fields >> kind >> source >> destination >> band >> feeOverride.fee) || feeOverride.fee < 0 ||
+        !ParseFeeKind(kind, feeOverride.kind) ||
+        !ParseFeeBank(source, state, feeOverride.sourceBank) ||
+        !ParseFeeBank(destination, state, feeOverride.destinationBank)) {
+        return false;
+    }
+    // Deposits and withdrawals involve only the customer's bank.
+    if (feeOverride.destinationBank != nullptr &&
+        (feeOverride.kind == ATMTransaction_Deposit || feeOverride.kind == ATMTransaction_Withdrawal)) {
+        return false;
+    }
+    if (band == "*") {
+        feeOverride.band = -1;
+        return true;
+    }
+    std::istringstream bandField(band);
+    return (bandField >> feeOverride.band) && bandField.eof() && feeOverride.band >= 0;
+}
+
+bool ParseFeeRule(const std::string& line, const SystemState& state, FeeRule& rule) {
+    std::istringstream fields(line);
+    if (!(fields >> rule.name)) {
+        return false;
+    }
+    std::streampos afterTarget = fields.tellg();
+    std::string keyword;
+    fields >> keyword;
+    bool parsed = false;
+    if (keyword == "bands") {
+        parsed = ParseFeeBands(fields, rule);
+    } else if (keyword == "fee") {
+        parsed = ParseFeeOverride(fields, state, rule);
+    } else {
+        fields.clear();
+        fields.seekg(afterTarget);
+        parsed = ParseFeeValues(fields, rule);
+    }
+    if (!parsed) {
+        return false;
+    }
+    fields.clear();
+    std::string extra;
+    if (fields >> extra) {
+        return false;
+    }
+
+    if (rule.name == "*") {
+        rule.target = FeeTarget_All;
+        return true;
+    }
+    if (FindBank(state.banks, rule.name) != nullptr) {
+        rule.target = FeeTarget_Bank;
+        return true;
+    }
+    for (const ATM* atm : state.atms) {
+        if (atm != nullptr && atm->GetSerialNumber() == rule.name) {
+            rule.target = FeeTarget_Atm;
+            return true;
+        }
+    }
+    return false;
+}
+
+bool RuleMatches(const FeeRule& rule, const ATM& atm) {
+    switch (rule.target) {
+    case FeeTarget_All:
+        return true;
+    case FeeTarget_Bank:
+        return atm.GetPrimaryBank() != nullptr && atm.GetPrimaryBank()->getBankName() == rule.name;
+    case FeeTarget_Atm:
+        return atm.GetSerialNumber() == rule.name;
+    }
+    return false;
+}
+
+// Builds atm's schedule from the rules that name it. Returns false if none
+// does; fails through `valid` if an override names a band the ATM lacks.
+bool BuildFeeSchedule(const std::vector<FeeRule>& rules, const ATM& atm,
+                      FeeSchedule& schedule, bool& valid) {
+    schedule = atm.GetFeeTable().GetSchedule();
+    const FeeRule* base = nullptr;
+    const FeeRule* bands = nullptr;
+    std::vector<const FeeRule*> overrides;
+    for (const FeeRule& rule : rules) {
+        if (!RuleMatches(rule, atm)) {
+            continue;
+        }
+        if (rule.line == FeeLine_Base && (base == nullptr || rule.target >= base->target)) {
+            base = &rule;
+        } else if (rule.line == FeeLine_Bands && (bands == nullptr || rule.target >= bands->target)) {
+            bands = &rule;
+        } else if (rule.line == FeeLine_Override) {
+            overrides.push_back(&rule);
+        }
+    }
+    if (base == nullptr && bands == nullptr && overrides.empty()) {
+        return false;
+    }
+    if (base != nullptr) {
+        schedule.base = base->fees;
+    }
+    if (bands != nullptr) {
+        schedule.bandLimits = bands->bandLimits;
+    }
+    if (!overrides.empty()) {
+        // Overrides apply in order, so the more specific targets go last.
+        schedule.overrides.clear();
+        for (int target = FeeTarget_All; target <= FeeTarget_Atm; ++target) {
+            for (const FeeRule* rule : overrides) {
+                if (rule->target == target) {
+                    schedule.overrides.push_back(rule->feeOverride);
+                }
+            }
+        }
+    }
+    for (const FeeOverride& feeOverride : schedule.overrides) {
+        if (feeOverride.band >= schedule.BandCount()) {
+            valid = false;
+        }
+    }
+    return true;
+}
+
+} // namespace
+
+Bank* FindBank(const std::vector<Bank*>& banks, const std::string& name) {
+    for (Bank* bank : banks) {
+        if (bank != nullptr && bank->getBankName() == name) {
+            return bank;
+        }
+    }
+    return nullptr;
+}
+
+Account* FindAccountByCard(const std::vector<Bank*>& banks, const std::string& cardNumber) {
+    for (Bank* bank : banks) {
+        if (bank == nullptr) {
+            continue;
+        }
+        Account* account = bank->findAccountByCardNumber(cardNumber);
+        if (account != nullptr) {
+            return account;
+        }
+    }
+    return nullptr;
+}
+
+Account* FindAccountByNumber(const std::vector<Bank*>& banks, const std::string& accountNumber) {
+    for (Bank* bank : banks) {
+        if (bank == nullptr) {
+            continue;
+        }
+        Account* account = bank->findAccountByAccountNumber(accountNumber);
+        if (account != nullptr) {
+            return account;
+        }
+    }
+    return nullptr;
+}
+
+bool LoadInitialData(const std::string& filename, SystemState& state) {
+    std::ifstream fin(filename);
+    if (!fin) {
+        std::cerr << "Error opening file: " << filename << "\n";
+        return false;
+    }
+
+    int bankCount = 0;
+    int accountCount = 0;
+    int atmCount = 0;
+    fin >> bankCount >> accountCount >> atmCount;
+
+    state.banks.reserve(bankCount);
+    state.accounts.reserve(accountCount);
+    state.cards.reserve(accountCount);
+    state.atms.reserve(atmCount);
+    state.transactions.reserve(32);
+
+    for (int i = 0; i < bankCount; ++i) {
+        std::string bankName;
+        fin >> bankName;
+        // Registers itself in state.banks.
+        new Bank(bankName, bankName, &state.banks, &state.transactions);
+    }
+
+    for (int i = 0; i < accountCount; ++i) {
+        std::string bankName;
+        std::string userName;
+        std::string accountNumber;
+        long long availableFunds = 0;
+        std::string cardNumber;
+        std::string password;
+        fin >> bankName >> userName >> accountNumber >> availableFunds >> cardNumber >> password;
+
+        Bank* bank = FindBank(state.banks, bankName);
+        if (bank == nullptr) {
+            std::cerr << "Bank " << bankName << " not found for account " << accountNumber << ".\n";
+            return false;
+        }
+        auto* card = new Card(cardNumber, bankName, CardRole::User);
+        auto* account = new Account(bank, userName, accountNumber, availableFunds, card, password);
+
+        state.cards.push_back(card);
+        state.accounts.push_back(account);
+        bank->addAccount(account);
+    }
+
+    for (int i = 0; i < atmCount; ++i) {
+        std::string primaryBankName;
+        std::string serial;
+        std::string accessModeStr;
+        std::string languageStr;
+        fin >> primaryBankName >> serial >> accessModeStr >> languageStr;
+
+        Bank* primaryBank = FindBank(state.banks, primaryBankName);
+        if (primaryBank == nullptr) {
+            std::cerr << "Primary bank " << primaryBankName << " not found for ATM " << serial << ".\n";
+            return false;
+        }
+
+        ATMBankAccess accessMode =
+            (accessModeStr == "Single") ? ATMBankAccess_SingleBank : ATMBankAccess_MultiBank;
+        bool bilingual = (languageStr == "Bilingual");
+
+        auto* atm = new ATM(serial, primaryBank, accessMode, bilingual);
+
+        // Note counts are listed from the largest denomination down.
+        CashDrawer drawer;
+        for (int i = CASH_TYPE_COUNT - 1; i >= 0; --i) {
+            fin >> drawer.noteCounts[i];
+        }
+        atm->LoadCash(drawer);
+        atm->SetSettlement(&state.settlement);
+        atm->SetLedger(&state.ledger);
+
+        if (accessMode == ATMBankAccess_MultiBank) {
+            atm->AddAcceptedBanks(state.banks);
+        }
+
+        state.atms.push_back(atm);
+    }
+
+    return true;
+}
+
+void UseTransactionSegments(SystemState& state,
+                            const std::string& directory,
+                            std::size_t segmentRecords,
+                            SegmentFormat format) {
+    state.ledger.EnableSegments(directory, segmentRecords, format);
+    for (Bank* bank : state.banks) {
+        bank->setTransactionLog(nullptr);
+    }
+}
+
+bool ReloadFees(const std::string& filename, const SystemState& state) {
+    std::ifstream fin(filename);
+    if (!fin) {
+        std::cerr << "Error opening file: " << filename << "\n";
+        return false;
+    }
+
+    std::vector<FeeRule> rules;
+    std::string line;
+    for (int lineNumber = 1; std::getline(fin, line); ++lineNumber) {
+        std::size_t comment = line.find('#');
+        if (comment != std::string::npos) {
+            line.erase(comment);
+        }
+        if (line.find_first_not_of(" \t\r") == std::string::npos) {
+            continue;
+        }
+        FeeRule rule;
+        if (!ParseFeeRule(line, state, rule)) {
+            std::cerr << filename << ":" << lineNumber
+                      << ": expected \"<target> <8 fees>\", \"<target> bands <limits>\" or "
+                      << "\"<target> fee <kind> <source> <destination> <band> <fee>\".\n";
+            return false;
+        }
+        rules.push_back(rule);
+    }
+
+    std::vector<std::pair<ATM*, FeeSchedule> > schedules;
+    for (ATM* atm : state.atms) {
+        if (atm == nullptr) {
+            continue;
+        }
+        FeeSchedule schedule;
+        bool valid = true;
+        if (!BuildFeeSchedule(rules, *atm, schedule, valid)) {
+            continue;
+        }
+        if (!valid) {
+            std::cerr << filename << ": a fee override for ATM " << atm->GetSerialNumber()
+                      << " names a band it does not have.\n";
+            return false;
+        }
+        schedules.push_back(std::make_pair(atm, schedule));
+    }
+    for (const auto& entry : schedules) {
+        entry.first->SetFeeSchedule(entry.second);
+    }
+    return true;
+}
+
+void Cleanup(SystemState& state) {
+    state.snapshot.Clear();
+
+    for (Transaction* transaction : state.transactions) {
+        delete transaction;
+    }
+    state.transactions.clear();
+
+    for (ATM* atm : state.atms) {
+        delete atm;
+    }
+    state.atms.clear();
+
+    for (Account* account : state.accounts) {
+        delete account;
+    }
+    state.accounts.clear();
+
+    for (Card* card : state.cards) {
+        delete card;
+    }
+    state.cards.clear();
+
+    for (Bank* bank : state.banks) {
+        delete bank;
+    }
+    state.banks.clear();
+
+    // Frees the superseded balance and cash versions of everything above.
+    VersionStore::Instance().Reclaim();
+}
@@ -0,0 +1,62 @@
+#ifndef SYSTEM_HPP
+#define SYSTEM_HPP
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+#include "Ledger.hpp"
+#include "Settlement.hpp"
+#include "Snapshot.hpp"
+
+class Account;
+class ATM;
+class Bank;
+class Card;
+class Transaction;
+
+// Owns every bank, account, card, ATM and transaction created at startup or
+// during the run. Released with Cleanup().
+struct SystemState {
+    std::vector<Bank*> banks;
+    std::vector<Account*> accounts;
+    std::vector<Card*> cards;
+    std::vector<ATM*> atms;
+    std::vector<Transaction*> transactions;
+    // Cached snapshot printout over the banks and ATMs above.
+    FleetSnapshot snapshot;
+    // Interbank obligations of every ATM's transactions.
+    SettlementLedger settlement;
+    // Every ATM's transactions, indexed for searching.
+    TransactionLedger ledger;
+    int totalSessions = 0;
+    int customerSessions = 0;
+    int adminSessions = 0;
+};
+
+Bank* FindBank(const std::vector<Bank*>& banks, const std::string& name);
+Account* FindAccountByCard(const std::vector<Bank*>& banks, const std::string& cardNumber);
+Account* FindAccountByNumber(const std::vector<Bank*>& banks, const std::string& accountNumber);
+
+// Reads banks, accounts and ATMs in the initial_condition.txt format.
+bool LoadInitialData(const std::string& filename, SystemState& state);
+// Hands transaction ownership to the ledger, which seals older transactions
+// into segment files under directory. Banks stop logging to
+// state.transactions and ATMs stop keeping their own lists. Call after
+// loading and before the first transaction.
+void UseTransactionSegments(SystemState& state,
+                            const std::string& directory,
+                            std::size_t segmentRecords,
+                            SegmentFormat format);
+// Reads a fee file and publishes new fee schedules to the ATMs it names,
+// while they keep serving customers. Lines are "<target> <8 fees>" (base
+// fees in ATMFees field order), "<target> bands <limit>..." and "<target>
+// fee <kind> <source> <destination> <band> <fee>". The target is "*" for
+// every ATM, a bank name for the ATMs it operates, or an ATM serial. A
+// serial beats a bank, which beats "*". ATMs no line names keep their
+// schedule. "#" starts a comment. The whole file is checked first; on any
+// error nothing is published.
+bool ReloadFees(const std::string& filename, const SystemState& state);
+void Cleanup(SystemState& state);
+
+#endif // SYSTEM_HPP
@@ -0,0 +1,103 @@
+#include "TimeIndex.hpp"
+
+#include <algorithm>
+#include <chrono>
+
+#include "Transaction.hpp"
+
+namespace {
+
+long long MinuteOf(long long micros) {
+    // Floor, so times before the epoch fall into the right minute too.
+    long long minute = micros / MICROS_PER_MINUTE;
+    return (micros % MICROS_PER_MINUTE < 0) ? minute - 1 : minute;
+}
+
+} // namespace
+
+Timestamp::Timestamp()
+    : wallMicros(0),
+      monotonicNanos(0) {
+}
+
+Timestamp Timestamp::Now() {
+    Timestamp now;
+    now.wallMicros = std::chrono::duration_cast<std::chrono::microseconds>(
+                         std::chrono::system_clock::now().time_since_epoch())
+                         .count();
+    now.monotonicNanos = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                             std::chrono::steady_clock::now().time_since_epoch())
+                             .count();
+    return now;
+}
+
+TransactionTimeIndex::TransactionTimeIndex()
+    : buckets_(),
+      size_(0) {
+}
+
+void TransactionTimeIndex::Add(Transaction* transaction) {
+    if (transaction == nullptr) {
+        return;
+    }
+    const long long minute = MinuteOf(transaction->getTime().wallMicros);
+    ++size_;
+    if (buckets_.empty() || buckets_.back().minute < minute) {
+        buckets_.push_back(Bucket());
+        buckets_.back().minute = minute;
+        buckets_.back().transactions.push_back(transaction);
+        return;
+    }
+    if (buckets_.back().minute == minute) {
+        buckets_.back().transactions.push_back(transaction);
+        return;
+    }
+    auto bucket = std::lower_bound(buckets_.begin(), buckets_.end(), minute,
+                                   [](const Bucket& b, long long m) { return b.minute < m; });
+    if (bucket == buckets_.end() || bucket->minute != minute) {
+        bucket = buckets_.insert(bucket, Bucket());
+        bucket->minute = minute;
+    }
+    bucket->transactions.push_back(transaction);
+}
+
+void TransactionTimeIndex::Find(long long fromMicros,
+                                long long toMicros,
+                                std::vector<Transaction*>& out) const {
+    if (fromMicros >= toMicros) {
+        return;
+    }
+    const long long firstMinute = MinuteOf(fromMicros);
+    const long long lastMinute = MinuteOf(toMicros - 1);
+    auto bucket = std::lower_bound(buckets_.begin(), buckets_.end(), firstMinute,
+                                   [](const Bucket& b, long long m) { return b.minute < m; });
+    for (; bucket != buckets_.end() && bucket->minute <= lastMinute; ++bucket) {
+        // Only the two edge buckets can hold transactions outside the range.
+        const bool edge = bucket->minute == firstMinute || bucket->minute == lastMinute;
+        for (Transaction* transaction : bucket->transactions) {
+            long long time = transaction->getTime().wallMicros;
+            if (!edge || (time >= fromMicros && time < toMicros)) {
+                out.push_back(transaction);
+            }
+        }
+    }
+}
+
+void TransactionTimeIndex::RemoveIf(const std::function<bool(const Transaction*)>& removed) {
+    for (Bucket& bucket : buckets_) {
+        const auto kept = std::remove_if(bucket.transactions.begin(), bucket.transactions.end(), removed);
+        size_ -= static_cast<std::size_t>(bucket.transactions.end() - kept);
+        bucket.transactions.erase(kept, bucket.transactions.end());
+    }
+    buckets_.erase(std::remove_if(buckets_.begin(), buckets_.end(),
+                                  [](const Bucket& bucket) { return bucket.transactions.empty(); }),
+                   buckets_.end());
+}
+
+std::size_t TransactionTimeIndex::Size() const {
+    return size_;
+}
+
+std::size_t TransactionTimeIndex::BucketCount() const {
+    return buckets_.size();
+}
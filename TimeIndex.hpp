@@ -0,0 +1,57 @@
+#ifndef TIME_INDEX_HPP
+#define TIME_INDEX_HPP
+
+#include <cstddef>
+#include <functional>
+#include <vector>
+
+class Transaction;
+
+// When something happened, on both clocks: wall-clock time for people and
+// range queries, monotonic time for measuring intervals the wall clock may
+// jump across.
+struct Timestamp {
+    // Microseconds since the Unix epoch (system clock).
+    long long wallMicros;
+    // Nanoseconds on the steady clock, from an arbitrary origin.
+    long long monotonicNanos;
+
+    Timestamp();
+
+    static Timestamp Now();
+};
+
+const long long MICROS_PER_MINUTE = 60LL * 1000 * 1000;
+
+// Transactions grouped into one bucket per wall-clock minute, buckets in
+// time order. A range query binary-searches the first bucket and reads only
+// the buckets the range overlaps. Transactions normally arrive in time
+// order, so Add() appends to the newest bucket; a late one (another
+// thread's, or after the wall clock stepped back) is filed under its own
+// minute all the same.
+class TransactionTimeIndex {
+public:
+    TransactionTimeIndex();
+
+    void Add(Transaction* transaction);
+    // Appends the transactions with fromMicros <= wall-clock time < toMicros,
+    // bucket by bucket and in arrival order within a bucket.
+    void Find(long long fromMicros, long long toMicros, std::vector<Transaction*>& out) const;
+    // Drops every transaction removed picks, keeping the rest in order, and
+    // any bucket left empty.
+    void RemoveIf(const std::function<bool(const Transaction*)>& removed);
+
+    std::size_t Size() const;
+    std::size_t BucketCount() const;
+
+private:
+    struct Bucket {
+        long long minute;
+        std::vector<Transaction*> transactions;
+    };
+
+    std::vector<Bucket> buckets_;
+    std::size_t size_;
+};
+
+#endif // TIME_INDEX_HPP
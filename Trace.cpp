@@ -0,0 +1,495 @@
+#include "Trace.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <iterator>
+#include <streambuf>
+
+#include "Account.hpp"
+#include "Bank.hpp"
+#include "Card.hpp"
+#include "Report.hpp"
+#include "System.hpp"
+#include "Transaction.hpp"
+
+namespace {
+
+const char TRACE_MAGIC[8] = {'A', 'T', 'M', 'T', 'R', 'C', '1', '\n'};
+const std::size_t TRACE_FLUSH_BYTES = 1 << 16;
+
+// Bit 0 of a string reference marks a new table entry followed by its bytes.
+const std::uint64_t TRACE_NEW_STRING = 1;
+
+class NullBuffer : public std::streambuf {
+protected:
+    int overflow(int c) override { return traits_type::not_eof(c); }
+    std::streamsize xsputn(const char*, std::streamsize count) override { return count; }
+};
+
+const std::uint64_t FNV_OFFSET = 14695981039346656037ULL;
+const std::uint64_t FNV_PRIME = 1099511628211ULL;
+
+void HashBytes(std::uint64_t& hash, const void* data, std::size_t size) {
+    const unsigned char* bytes = static_cast<const unsigned char*>(data);
+    for (std::size_t i = 0; i < size; ++i) {
+        hash ^= bytes[i];
+        hash *= FNV_PRIME;
+    }
+}
+
+void HashValue(std::uint64_t& hash, long long value) {
+    HashBytes(hash, &value, sizeof(value));
+}
+
+void HashString(std::uint64_t& hash, const std::string& text) {
+    HashValue(hash, static_cast<long long>(text.size()));
+    HashBytes(hash, text.data(), text.size());
+}
+
+ATM* FindAtm(const std::vector<ATM*>& atms, const std::string& serial) {
+    for (ATM* atm : atms) {
+        if (atm != nullptr && atm->GetSerialNumber() == serial) {
+            return atm;
+        }
+    }
+    return nullptr;
+}
+
+} // namespace
+
+TraceRecord::TraceRecord()
+    : op(TraceOp_EndSession),
+      atmSerial(),
+      cardNumber(),
+      accountNumber(),
+      language(ATMLanguage_English),
+      amount(0),
+      count(0),
+      cash(),
+      feeCash(),
+      digest(0) {
+}
+
+TraceWriter::TraceWriter() {
+}
+
+TraceWriter::~TraceWriter() {
+    Flush();
+}
+
+bool TraceWriter::Open(const std::string& filename) {
+    out_.open(filename, std::ios::binary | std::ios::trunc);
+    if (!out_) {
+        return false;
+    }
+    buffer_.assign(TRACE_MAGIC, sizeof(TRACE_MAGIC));
+    strings_.clear();
+    return true;
+}
+
+bool TraceWriter::IsOpen() const {
+    return out_.is_open();
+}
+
+void TraceWriter::Write(const TraceRecord& record) {
+    if (!out_.is_open()) {
+        return;
+    }
+
+    PutVarint(static_cast<std::uint64_t>(record.op));
+    switch (record.op) {
+    case TraceOp_CustomerSession:
+        PutString(record.atmSerial);
+        PutString(record.cardNumber);
+        PutVarint(static_cast<std::uint64_t>(record.language));
+        break;
+    case TraceOp_AdminSession:
+        PutString(record.atmSerial);
+        PutVarint(static_cast<std::uint64_t>(record.language));
+        break;
+    case TraceOp_Deposit:
+        PutString(record.atmSerial);
+        PutCash(record.cash);
+        PutVarint(static_cast<std::uint64_t>(record.amount));
+        PutVarint(static_cast<std::uint64_t>(record.count));
+        PutCash(record.feeCash);
+        break;
+    case TraceOp_Withdrawal:
+        PutString(record.atmSerial);
+        PutVarint(static_cast<std::uint64_t>(record.amount));
+        break;
+    case TraceOp_AccountTransfer:
+        PutString(record.atmSerial);
+        PutString(record.accountNumber);
+        PutVarint(static_cast<std::uint64_t>(record.amount));
+        break;
+    case TraceOp_CashTransfer:
+        PutString(record.atmSerial);
+        PutString(record.accountNumber);
+        PutCash(record.cash);
+        break;
+    case TraceOp_PrintReceipt:
+    case TraceOp_PrintTransactions:
+    case TraceOp_ExportTransactions:
+    case TraceOp_EndSession:
+        PutString(record.atmSerial);
+        break;
+    case TraceOp_Finish:
+        PutVarint(record.digest);
+        break;
+    }
+
+    // Flushing at session boundaries keeps the trace useful if the process dies.
+    if (buffer_.size() >= TRACE_FLUSH_BYTES || record.op == TraceOp_EndSession) {
+        Flush();
+    }
+}
+
+void TraceWriter::Finish(std::uint64_t digest) {
+    if (!out_.is_open()) {
+        return;
+    }
+    TraceRecord record;
+    record.op = TraceOp_Finish;
+    record.digest = digest;
+    Write(record);
+    Flush();
+    out_.close();
+}
+
+void TraceWriter::PutVarint(std::uint64_t value) {
+    while (value >= 0x80) {
+        buffer_.push_back(static_cast<char>((value & 0x7F) | 0x80));
+        value >>= 7;
+    }
+    buffer_.push_back(static_cast<char>(value));
+}
+
+void TraceWriter::PutString(const std::string& text) {
+    auto it = strings_.find(text);
+    if (it != strings_.end()) {
+        PutVarint(it->second << 1);
+        return;
+    }
+    std::uint64_t index = static_cast<std::uint64_t>(strings_.size());
+    strings_.emplace(text, index);
+    PutVarint((index << 1) | TRACE_NEW_STRING);
+    PutVarint(static_cast<std::uint64_t>(text.size()));
+    buffer_.append(text);
+}
+
+void TraceWriter::PutCash(const CashDrawer& cash) {
+    for (int i = 0; i < CASH_TYPE_COUNT; ++i) {
+        PutVarint(static_cast<std::uint64_t>(cash.noteCounts[i]));
+    }
+}
+
+void TraceWriter::Flush() {
+    if (out_.is_open() && !buffer_.empty()) {
+        out_.write(buffer_.data(), static_cast<std::streamsize>(buffer_.size()));
+        out_.flush();
+        buffer_.clear();
+    }
+}
+
+TraceReader::TraceReader()
+    : data_(),
+      position_(0),
+      failed_(false),
+      strings_() {
+}
+
+bool TraceReader::Open(const std::string& filename) {
+    std::ifstream fin(filename, std::ios::binary);
+    if (!fin) {
+        return false;
+    }
+    data_.assign(std::istreambuf_iterator<char>(fin), std::istreambuf_iterator<char>());
+    strings_.clear();
+    failed_ = false;
+    if (data_.size() < sizeof(TRACE_MAGIC) ||
+        !std::equal(TRACE_MAGIC, TRACE_MAGIC + sizeof(TRACE_MAGIC), data_.begin())) {
+        failed_ = true;
+        return false;
+    }
+    position_ = sizeof(TRACE_MAGIC);
+    return true;
+}
+
+bool TraceReader::Next(TraceRecord& record) {
+    if (failed_ || position_ >= data_.size()) {
+        return false;
+    }
+
+    record = TraceRecord();
+    std::uint64_t op = 0;
+    std::uint64_t value = 0;
+    if (!GetVarint(op) || op > TraceOp_Finish) {
+        failed_ = true;
+        return false;
+    }
+    record.op = static_cast<TraceOp>(op);
+
+    bool ok = true;
+    switch (record.op) {
+    case TraceOp_CustomerSession:
+        ok = GetString(record.atmSerial) && GetString(record.cardNumber) && GetVarint(value);
+        record.language = static_cast<ATMLanguage>(value);
+        break;
+    case TraceOp_AdminSession:
+        ok = GetString(record.atmSerial) && GetVarint(value);
+        record.language = static_cast<ATMLanguage>(value);
+        break;
+    case TraceOp_Deposit: {
+        std::uint64_t checkCount = 0;
+        ok = GetString(record.atmSerial) && GetCash(record.cash) && GetVarint(value) &&
+             GetVarint(checkCount) && GetCash(record.feeCash);
+        record.amount = static_cast<long long>(value);
+        record.count = static_cast<int>(checkCount);
+        break;
+    }
+    case TraceOp_Withdrawal:
+        ok = GetString(record.atmSerial) && GetVarint(value);
+        record.amount = static_cast<long long>(value);
+        break;
+    case TraceOp_AccountTransfer:
+        ok = GetString(record.atmSerial) && GetString(record.accountNumber) && GetVarint(value);
+        record.amount = static_cast<long long>(value);
+        break;
+    case TraceOp_CashTransfer:
+        ok = GetString(record.atmSerial) && GetString(record.accountNumber) && GetCash(record.cash);
+        break;
+    case TraceOp_PrintReceipt:
+    case TraceOp_PrintTransactions:
+    case TraceOp_ExportTransactions:
+    case TraceOp_EndSession:
+        ok = GetString(record.atmSerial);
+        break;
+    case TraceOp_Finish:
+        ok = GetVarint(record.digest);
+        break;
+    }
+
+    if (!ok) {
+        failed_ = true;
+    }
+    return ok;
+}
+
+bool TraceReader::Failed() const {
+    return failed_;
+}
+
+bool TraceReader::GetVarint(std::uint64_t& value) {
+    value = 0;
+    for (int shift = 0; shift < 64; shift += 7) {
+        if (position_ >= data_.size()) {
+            return false;
+        }
+        unsigned char byte = static_cast<unsigned char>(data_[position_++]);
+        value |= static_cast<std::uint64_t>(byte & 0x7F) << shift;
+        if ((byte & 0x80) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool TraceReader::GetString(std::string& text) {
+    std::uint64_t reference = 0;
+    if (!GetVarint(reference)) {
+        return false;
+    }
+    std::uint64_t index = reference >> 1;
+    if ((reference & TRACE_NEW_STRING) == 0) {
+        if (index >= strings_.size()) {
+            return false;
+        }
+        text = strings_[static_cast<std::size_t>(index)];
+        return true;
+    }
+
+    std::uint64_t length = 0;
+    if (index != strings_.size() || !GetVarint(length) || length > data_.size() - position_) {
+        return false;
+    }
+    text.assign(data_.data() + position_, static_cast<std::size_t>(length));
+    position_ += static_cast<std::size_t>(length);
+    strings_.push_back(text);
+    return true;
+}
+
+bool TraceReader::GetCash(CashDrawer& cash) {
+    for (int i = 0; i < CASH_TYPE_COUNT; ++i) {
+        std::uint64_t count = 0;
+        if (!GetVarint(count)) {
+            return false;
+        }
+        cash.noteCounts[i] = static_cast<int>(count);
+    }
+    return true;
+}
+
+ReplayResult::ReplayResult()
+    : operations(0),
+      sessions(0),
+      seconds(0.0),
+      digestRecorded(false),
+      digestMatched(false),
+      expectedDigest(0),
+      actualDigest(0) {
+}
+
+std::uint64_t ComputeStateDigest(const SystemState& state) {
+    std::uint64_t hash = FNV_OFFSET;
+    for (const Bank* bank : state.banks) {
+        if (bank == nullptr) {
+            continue;
+        }
+        HashString(hash, bank->getBankName());
+        for (const Account* account : bank->getAccounts()) {
+            if (account == nullptr) {
+                continue;
+            }
+            HashString(hash, account->getAccountNumber());
+            HashValue(hash, account->getBalance());
+        }
+    }
+    for (const ATM* atm : state.atms) {
+        if (atm == nullptr) {
+            continue;
+        }
+        HashString(hash, atm->GetSerialNumber());
+        const CashDrawer& drawer = atm->GetCashInventory();
+        for (int i = 0; i < CASH_TYPE_COUNT; ++i) {
+            HashValue(hash, drawer.noteCounts[i]);
+        }
+        HashValue(hash, atm->GetCustomerSessions());
+        HashValue(hash, atm->GetAdminSessions());
+        HashValue(hash, static_cast<long long>(atm->GetTransactions().size()));
+    }
+    for (const Transaction* transaction : state.transactions) {
+        if (transaction == nullptr) {
+            continue;
+        }
+        HashValue(hash, transaction->getId());
+        HashString(hash, transaction->getTypeName());
+        HashString(hash, transaction->getSourceAccountNumber());
+        HashValue(hash, transaction->getAmount());
+        HashValue(hash, transaction->getFee());
+    }
+    return hash;
+}
+
+bool ReplayTrace(const std::string& filename, SystemState& state, ReplayResult& result) {
+    result = ReplayResult();
+    TraceReader reader;
+    if (!reader.Open(filename)) {
+        std::cerr << "Error opening trace: " << filename << "\n";
+        return false;
+    }
+
+    NullBuffer nullBuffer;
+    std::ostream nullStream(&nullBuffer);
+    std::streambuf* savedCout = std::cout.rdbuf(&nullBuffer);
+
+    // Consecutive records usually hit the same ATM, so remember the last one.
+    ATM* atm = nullptr;
+    std::string atmSerial;
+    bool ok = true;
+
+    auto start = std::chrono::steady_clock::now();
+    TraceRecord record;
+    while (reader.Next(record)) {
+        if (record.op == TraceOp_Finish) {
+            result.digestRecorded = true;
+            result.expectedDigest = record.digest;
+            break;
+        }
+
+        if (atm == nullptr || record.atmSerial != atmSerial) {
+            atm = FindAtm(state.atms, record.atmSerial);
+            atmSerial = record.atmSerial;
+        }
+        if (atm == nullptr) {
+            std::cerr << "Trace refers to unknown ATM " << record.atmSerial << ".\n";
+            ok = false;
+            break;
+        }
+        ++result.operations;
+
+        switch (record.op) {
+        case TraceOp_CustomerSession: {
+            Account* account = FindAccountByCard(state.banks, record.cardNumber);
+            if (account == nullptr || account->getBank() == nullptr) {
+                std::cerr << "Trace refers to unknown card " << record.cardNumber << ".\n";
+                ok = false;
+                break;
+            }
+            atm->SetLanguage(record.language);
+            atm->StartCustomerSession(account->getLinkedCard(), account,
+                                      atm->GetPrimaryBank() == account->getBank());
+            atm->IncrementCustomerSession();
+            ++state.totalSessions;
+            ++state.customerSessions;
+            ++result.sessions;
+            break;
+        }
+        case TraceOp_AdminSession:
+            atm->SetLanguage(record.language);
+            atm->StartAdminSession(nullptr);
+            atm->IncrementAdminSession();
+            ++state.totalSessions;
+            ++state.adminSessions;
+            ++result.sessions;
+            break;
+        case TraceOp_Deposit:
+            atm->RequestDeposit(record.cash, record.amount, record.feeCash, record.count);
+            break;
+        case TraceOp_Withdrawal:
+            atm->RequestWithdrawal(record.amount);
+            break;
+        case TraceOp_AccountTransfer:
+            atm->RequestAccountTransfer(FindAccountByNumber(state.banks, record.accountNumber), record.amount);
+            break;
+        case TraceOp_CashTransfer:
+            atm->RequestCashTransfer(FindAccountByNumber(state.banks, record.accountNumber), record.cash);
+            break;
+        case TraceOp_PrintReceipt:
+            if (atm->GetReceiptSink() != nullptr) {
+                atm->PrintReceipt(*atm->GetReceiptSink());
+            } else {
+                atm->PrintReceipt(nullStream);
+            }
+            break;
+        case TraceOp_PrintTransactions:
+        case TraceOp_ExportTransactions: {
+            std::vector<Transaction*> found;
+            LoadedTransactions loaded;
+            PrintTransactions(atm->ReadTransactions(found, loaded), nullStream, atm->GetActiveLanguage());
+            break;
+        }
+        case TraceOp_EndSession:
+            atm->EndSession();
+            break;
+        case TraceOp_Finish:
+            break;
+        }
+        if (!ok) {
+            break;
+        }
+    }
+    auto end = std::chrono::steady_clock::now();
+    std::cout.rdbuf(savedCout);
+
+    if (reader.Failed()) {
+        std::cerr << "Trace " << filename << " is truncated or malformed.\n";
+        ok = false;
+    }
+
+    result.seconds = std::chrono::duration<double>(end - start).count();
+    result.actualDigest = ComputeStateDigest(state);
+    result.digestMatched = result.digestRecorded && result.actualDigest == result.expectedDigest;
+    return ok;
+}
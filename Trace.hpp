@@ -0,0 +1,118 @@
+#ifndef TRACE_HPP
+#define TRACE_HPP
+
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "Atm.hpp"
+
+struct SystemState;
+
+enum TraceOp {
+    TraceOp_CustomerSession,
+    TraceOp_AdminSession,
+    TraceOp_Deposit,
+    TraceOp_Withdrawal,
+    TraceOp_AccountTransfer,
+    TraceOp_CashTransfer,
+    TraceOp_PrintReceipt,
+    TraceOp_PrintTransactions,
+    TraceOp_ExportTransactions,
+    TraceOp_EndSession,
+    TraceOp_Finish
+};
+
+// One session-level operation. Only the fields used by the op are set:
+//   CustomerSession   atmSerial, cardNumber, language
+//   AdminSession      atmSerial, language
+//   Deposit           atmSerial, cash, amount (check total), count (checks), feeCash
+//   Withdrawal        atmSerial, amount
+//   AccountTransfer   atmSerial, accountNumber (destination), amount
+//   CashTransfer      atmSerial, accountNumber (destination), cash
+//   Finish            digest of the system state when recording stopped
+struct TraceRecord {
+    TraceOp op;
+    std::string atmSerial;
+    std::string cardNumber;
+    std::string accountNumber;
+    ATMLanguage language;
+    long long amount;
+    int count;
+    CashDrawer cash;
+    CashDrawer feeCash;
+    std::uint64_t digest;
+
+    TraceRecord();
+};
+
+// Writes records in a compact binary form: varint integers and a string
+// table, so each repeated ATM serial, card or account costs one varint.
+class TraceWriter {
+public:
+    TraceWriter();
+    ~TraceWriter();
+
+    bool Open(const std::string& filename);
+    bool IsOpen() const;
+    void Write(const TraceRecord& record);
+    // Appends the Finish record carrying the state digest and closes the file.
+    void Finish(std::uint64_t digest);
+
+private:
+    TraceWriter(const TraceWriter&) = delete;
+    TraceWriter& operator=(const TraceWriter&) = delete;
+
+    void PutVarint(std::uint64_t value);
+    void PutString(const std::string& text);
+    void PutCash(const CashDrawer& cash);
+    void Flush();
+
+    std::ofstream out_;
+    std::string buffer_;
+    std::unordered_map<std::string, std::uint64_t> strings_;
+};
+
+class TraceReader {
+public:
+    TraceReader();
+
+    bool Open(const std::string& filename);
+    // Returns false at end of trace or on a malformed record.
+    bool Next(TraceRecord& record);
+    bool Failed() const;
+
+private:
+    bool GetVarint(std::uint64_t& value);
+    bool GetString(std::string& text);
+    bool GetCash(CashDrawer& cash);
+
+    std::vector<char> data_;
+    std::size_t position_;
+    bool failed_;
+    std::vector<std::string> strings_;
+};
+
+struct ReplayResult {
+    long long operations;
+    long long sessions;
+    double seconds;
+    bool digestRecorded;
+    bool digestMatched;
+    std::uint64_t expectedDigest;
+    std::uint64_t actualDigest;
+
+    ReplayResult();
+};
+
+// Hashes every account balance, ATM cash drawer and transaction so two runs
+// can be compared for identical outcomes.
+std::uint64_t ComputeStateDigest(const SystemState& state);
+
+// Feeds a recorded trace back through the ATM API as fast as possible, with
+// console output muted, then checks the resulting state digest.
+bool ReplayTrace(const std::string& filename, SystemState& state, ReplayResult& result);
+
+#endif // TRACE_HPP
@@ -1,6 +1,6 @@
 #include "Transaction.hpp"
 
-long long Transaction::nextId_ = 1;
+std::atomic<long long> Transaction::nextId_(1);
 
 Transaction::Transaction(const std::string& atmSerial,
                          const std::string& cardNumber,
@@ -8,15 +8,17 @@ Transaction::Transaction(const std::string& atmSerial,
                          const std::string& sourceAccountNumber,
                          long long amount,
                          long long fee,
-                         const std::string& note)
-    : id_(nextId_++),
+                         const std::string& note,
+                         long long id)
+    : id_(id > 0 ? id : nextId_++),
       atmSerial_(atmSerial),
       cardNumber_(cardNumber),
       sourceBankName_(sourceBankName),
       sourceAccountNumber_(sourceAccountNumber),
       amount_(amount),
       fee_(fee),
-      note_(note) {
+      note_(note),
+      time_(Timestamp::Now()) {
 }
 
 long long Transaction::getId() const {
@@ -51,6 +53,18 @@ const std::string& Transaction::getNote() const {
     return note_;
 }
 
+const Timestamp& Transaction::getTime() const {
+    return time_;
+}
+
+void Transaction::setTime(const Timestamp& time) {
+    time_ = time;
+}
+
+const TransferTarget* Transaction::getTarget() const {
+    return nullptr;
+}
+
 void Transaction::logToStream(std::ostream& out) const {
     out << "ID=" << id_
         << " ATM=" << atmSerial_
@@ -71,40 +85,60 @@ DepositTransaction::DepositTransaction(const std::string& atmSerial,
                                        const std::string& sourceAccountNumber,
                                        long long amount,
                                        long long fee,
-                                       const std::string& note)
+                                       const std::string& note,
+                                       long long id)
     : Transaction(atmSerial,
                   cardNumber,
                   sourceBankName,
                   sourceAccountNumber,
                   amount,
                   fee,
-                  note) {
+                  note,
+                  id) {
 }
 
 std::string DepositTransaction::getTypeName() const {
     return "Deposit";
 }
 
+TransactionKind DepositTransaction::getKind() const {
+    return TransactionKind_Deposit;
+}
+
+std::unique_ptr<Transaction> DepositTransaction::clone() const {
+    return std::unique_ptr<Transaction>(new DepositTransaction(*this));
+}
+
 WithdrawalTransaction::WithdrawalTransaction(const std::string& atmSerial,
                                              const std::string& cardNumber,
                                              const std::string& sourceBankName,
                                              const std::string& sourceAccountNumber,
                                              long long amount,
                                              long long fee,
-                                             const std::string& note)
+                                             const std::string& note,
+                                             long long id)
     : Transaction(atmSerial,
                   cardNumber,
                   sourceBankName,
                   sourceAccountNumber,
                   amount,
                   fee,
-                  note) {
+                  note,
+                  id) {
 }
 
 std::string WithdrawalTransaction::getTypeName() const {
     return "Withdrawal";
 }
 
+TransactionKind WithdrawalTransaction::getKind() const {
+    return TransactionKind_Withdrawal;
+}
+
+std::unique_ptr<Transaction> WithdrawalTransaction::clone() const {
+    return std::unique_ptr<Transaction>(new WithdrawalTransaction(*this));
+}
+
 AccountTransferTransaction::AccountTransferTransaction(const std::string& atmSerial,
                                                        const std::string& cardNumber,
                                                        const std::string& sourceBankName,
@@ -113,34 +147,47 @@ AccountTransferTransaction::AccountTransferTransaction(const std::string& atmSer
                                                        const std::string& targetAccountNumber,
                                                        long long amount,
                                                        long long fee,
-                                                       const std::string& note)
+                                                       const std::string& note,
+                                                       long long id)
     : Transaction(atmSerial,
                   cardNumber,
                   sourceBankName,
                   sourceAccountNumber,
                   amount,
                   fee,
-                  note),
-      targetBankName_(targetBankName),
-      targetAccountNumber_(targetAccountNumber) {
+                  note,
+                  id),
+      target_{targetBankName, targetAccountNumber} {
 }
 
 const std::string& AccountTransferTransaction::getTargetBankName() const {
-    return targetBankName_;
+    return target_.bankName;
 }
 
 const std::string& AccountTransferTransaction::getTargetAccountNumber() const {
-    return targetAccountNumber_;
+    return target_.accountNumber;
 }
 
 std::string AccountTransferTransaction::getTypeName() const {
     return "AccountTransfer";
 }
 
+TransactionKind AccountTransferTransaction::getKind() const {
+    return TransactionKind_AccountTransfer;
+}
+
+std::unique_ptr<Transaction> AccountTransferTransaction::clone() const {
+    return std::unique_ptr<Transaction>(new AccountTransferTransaction(*this));
+}
+
+const TransferTarget* AccountTransferTransaction::getTarget() const {
+    return &target_;
+}
+
 void AccountTransferTransaction::logToStream(std::ostream& out) const {
     Transaction::logToStream(out);
-    out << " TargetBank=" << targetBankName_
-        << " TargetAccount=" << targetAccountNumber_;
+    out << " TargetBank=" << target_.bankName
+        << " TargetAccount=" << target_.accountNumber;
 }
 
 CashTransferTransaction::CashTransferTransaction(const std::string& atmSerial,
@@ -151,32 +198,45 @@ CashTransferTransaction::CashTransferTransaction(const std::string& atmSerial,
                                                  const std::string& targetAccountNumber,
                                                  long long amount,
                                                  long long fee,
-                                                 const std::string& note)
+                                                 const std::string& note,
+                                                 long long id)
     : Transaction(atmSerial,
                   cardNumber,
                   sourceBankName,
                   sourceAccountNumber,
                   amount,
                   fee,
-                  note),
-      targetBankName_(targetBankName),
-      targetAccountNumber_(targetAccountNumber) {
+                  note,
+                  id),
+      target_{targetBankName, targetAccountNumber} {
 }
 
 const std::string& CashTransferTransaction::getTargetBankName() const {
-    return targetBankName_;
+    return target_.bankName;
 }
 
 const std::string& CashTransferTransaction::getTargetAccountNumber() const {
-    return targetAccountNumber_;
+    return target_.accountNumber;
 }
 
 std::string CashTransferTransaction::getTypeName() const {
     return "CashTransfer";
 }
 
+TransactionKind CashTransferTransaction::getKind() const {
+    return TransactionKind_CashTransfer;
+}
+
+std::unique_ptr<Transaction> CashTransferTransaction::clone() const {
+    return std::unique_ptr<Transaction>(new CashTransferTransaction(*this));
+}
+
+const TransferTarget* CashTransferTransaction::getTarget() const {
+    return &target_;
+}
+
 void CashTransferTransaction::logToStream(std::ostream& out) const {
     Transaction::logToStream(out);
-    out << " TargetBank=" << targetBankName_
-        << " TargetAccount=" << targetAccountNumber_;
+    out << " TargetBank=" << target_.bankName
+        << " TargetAccount=" << target_.accountNumber;
 }
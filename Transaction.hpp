@@ -1,10 +1,30 @@
 #ifndef TRANSACTION_HPP
 #define TRANSACTION_HPP
 
+#include <atomic>
 #include <iostream>
+#include <memory>
 #include <string>
+#include <vector>
+
+#include "TimeIndex.hpp"
+
+enum TransactionKind {
+    TransactionKind_Deposit,
+    TransactionKind_Withdrawal,
+    TransactionKind_AccountTransfer,
+    TransactionKind_CashTransfer
+};
+
+// The account a transfer credits.
+struct TransferTarget {
+    std::string bankName;
+    std::string accountNumber;
+};
 
 // Base class that records common transaction information.
+// Constructors take the next ID from a process-wide counter unless given
+// one, which only transactions read back from storage are.
 class Transaction {
 public:
     Transaction(const std::string& atmSerial,
@@ -13,7 +33,8 @@ public:
                 const std::string& sourceAccountNumber,
                 long long amount,
                 long long fee,
-                const std::string& note);
+                const std::string& note,
+                long long id = 0);
 
     virtual ~Transaction() = default;
 
@@ -25,9 +46,20 @@ public:
     long long getAmount() const;
     long long getFee() const;
     const std::string& getNote() const;
+    // Taken when the transaction is created.
+    const Timestamp& getTime() const;
+    // For transactions restored from storage or built by tools.
+    void setTime(const Timestamp& time);
 
     // Returns a concise string describing the transaction type (e.g., "Deposit").
     virtual std::string getTypeName() const = 0;
+    // The concrete type, for callers that would otherwise dynamic_cast.
+    virtual TransactionKind getKind() const = 0;
+    // The account a transfer credits; null for deposits and withdrawals.
+    virtual const TransferTarget* getTarget() const;
+    // A copy with the same ID and times, for readers that must not depend
+    // on the original staying alive.
+    virtual std::unique_ptr<Transaction> clone() const = 0;
 
     // Writes the transaction summary to the given stream.
     // Derived classes may append more information but should call this first.
@@ -42,9 +74,10 @@ protected:
     long long amount_;
     long long fee_;
     std::string note_;
+    Timestamp time_;
 
 private:
-    static long long nextId_;
+    static std::atomic<long long> nextId_;
 };
 
 class DepositTransaction : public Transaction {
@@ -55,9 +88,12 @@ public:
                        const std::string& sourceAccountNumber,
                        long long amount,
                        long long fee,
-                       const std::string& note);
+                       const std::string& note,
+                       long long id = 0);
 
     std::string getTypeName() const override;
+    TransactionKind getKind() const override;
+    std::unique_ptr<Transaction> clone() const override;
 };
 
 class WithdrawalTransaction : public Transaction {
@@ -68,9 +104,12 @@ public:
                           const std::string& sourceAccountNumber,
                           long long amount,
                           long long fee,
-                          const std::string& note);
+                          const std::string& note,
+                          long long id = 0);
 
     std::string getTypeName() const override;
+    TransactionKind getKind() const override;
+    std::unique_ptr<Transaction> clone() const override;
 };
 
 class AccountTransferTransaction : public Transaction {
@@ -83,17 +122,20 @@ public:
                                const std::string& targetAccountNumber,
                                long long amount,
                                long long fee,
-                               const std::string& note);
+                               const std::string& note,
+                               long long id = 0);
 
     const std::string& getTargetBankName() const;
     const std::string& getTargetAccountNumber() const;
 
     std::string getTypeName() const override;
+    TransactionKind getKind() const override;
+    std::unique_ptr<Transaction> clone() const override;
+    const TransferTarget* getTarget() const override;
     void logToStream(std::ostream& out) const override;
 
 private:
-    std::string targetBankName_;
-    std::string targetAccountNumber_;
+    TransferTarget target_;
 };
 
 class CashTransferTransaction : public Transaction {
@@ -106,17 +148,23 @@ public:
                             const std::string& targetAccountNumber,
                             long long amount,
                             long long fee,
-                            const std::string& note);
+                            const std::string& note,
+                            long long id = 0);
 
     const std::string& getTargetBankName() const;
     const std::string& getTargetAccountNumber() const;
 
     std::string getTypeName() const override;
+    TransactionKind getKind() const override;
+    std::unique_ptr<Transaction> clone() const override;
+    const TransferTarget* getTarget() const override;
     void logToStream(std::ostream& out) const override;
 
 private:
-    std::string targetBankName_;
-    std::string targetAccountNumber_;
+    TransferTarget target_;
 };
 
+// Transactions read back from storage, owned by whoever asked for them.
+typedef std::vector<std::unique_ptr<Transaction>> LoadedTransactions;
+
 #endif // TRANSACTION_HPP
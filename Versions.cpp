@@ -0,0 +1,120 @@
+#include "Versions.hpp"
+
+#include <vector>
+
+namespace {
+
+// Superseded versions allowed to pile up before a writer reclaims them.
+const std::size_t RECLAIM_THRESHOLD = 4096;
+
+} // namespace
+
+VersionNode::VersionNode()
+    : commit(0),
+      older(nullptr) {
+}
+
+VersionNode::~VersionNode() {
+}
+
+VersionStore& VersionStore::Instance() {
+    static VersionStore store;
+    return store;
+}
+
+VersionStore::VersionStore()
+    : commitMutex_(),
+      stable_(0),
+      retired_(),
+      retiredCount_(0),
+      readersMutex_(),
+      readers_() {
+}
+
+unsigned long long VersionStore::StableCommit() const {
+    return stable_.load(std::memory_order_acquire);
+}
+
+void VersionStore::Reclaim() {
+    Reclaim(true);
+}
+
+std::size_t VersionStore::RetiredVersions() const {
+    return retiredCount_.load(std::memory_order_relaxed);
+}
+
+void VersionStore::Push(std::atomic<VersionNode*>& head, VersionNode* node, unsigned long long commit) {
+    VersionNode* previous = head.load(std::memory_order_relaxed);
+    node->commit = commit;
+    node->older = previous;
+    head.store(node, std::memory_order_release);
+    Retired retired;
+    retired.node = previous;
+    retired.supersededAt = commit;
+    retired_.push_back(retired);
+    retiredCount_.fetch_add(1, std::memory_order_relaxed);
+}
+
+void VersionStore::AfterCommit() {
+    if (retiredCount_.load(std::memory_order_relaxed) >= RECLAIM_THRESHOLD) {
+        Reclaim(false);
+    }
+}
+
+void VersionStore::Reclaim(bool wait) {
+    // A view opened after this point starts at or past `bound`, so it
+    // cannot need anything superseded at or before it.
+    unsigned long long bound = 0;
+    {
+        std::unique_lock<std::mutex> lock(readersMutex_, std::defer_lock);
+        if (wait) {
+            lock.lock();
+        } else if (!lock.try_lock()) {
+            return;
+        }
+        bound = stable_.load(std::memory_order_acquire);
+        if (!readers_.empty() && readers_.begin()->first < bound) {
+            bound = readers_.begin()->first;
+        }
+    }
+
+    std::vector<VersionNode*> freed;
+    {
+        std::lock_guard<std::mutex> lock(commitMutex_);
+        while (!retired_.empty() && retired_.front().supersededAt <= bound) {
+            freed.push_back(retired_.front().node);
+            retired_.pop_front();
+        }
+        retiredCount_.fetch_sub(freed.size(), std::memory_order_relaxed);
+    }
+    for (VersionNode* node : freed) {
+        delete node;
+    }
+}
+
+unsigned long long VersionStore::Enter() {
+    std::lock_guard<std::mutex> lock(readersMutex_);
+    unsigned long long commit = stable_.load(std::memory_order_acquire);
+    ++readers_[commit];
+    return commit;
+}
+
+void VersionStore::Leave(unsigned long long commit) {
+    std::lock_guard<std::mutex> lock(readersMutex_);
+    std::map<unsigned long long, std::size_t>::iterator it = readers_.find(commit);
+    if (it != readers_.end() && --it->second == 0) {
+        readers_.erase(it);
+    }
+}
+
+ReadView::ReadView()
+    : commit_(VersionStore::Instance().Enter()) {
+}
+
+ReadView::~ReadView() {
+    VersionStore::Instance().Leave(commit_);
+}
+
+unsigned long long ReadView::Commit() const {
+    return commit_;
+}
@@ -0,0 +1,157 @@
+#ifndef VERSIONS_HPP
+#define VERSIONS_HPP
+
+#include <atomic>
+#include <cstddef>
+#include <deque>
+#include <map>
+#include <mutex>
+
+// One committed value in a version chain. Chains run newest first.
+struct VersionNode {
+    unsigned long long commit;
+    // Set before the node is published and never changed. Once this node is
+    // superseded and no reader can still need the older one, the older node
+    // is freed and this pointer is left dangling; readers never follow it,
+    // since they stop at the first node committed at or before their view.
+    VersionNode* older;
+
+    VersionNode();
+    virtual ~VersionNode();
+};
+
+template <typename Value>
+struct ValueVersion : VersionNode {
+    Value value;
+
+    explicit ValueVersion(const Value& initial) : VersionNode(), value(initial) {}
+};
+
+// Copy-on-write history of one value: every commit adds a node and readers
+// pick the newest node their view can see. Writers must be serialized by
+// the owner (the account lock, the ATM's strand); readers need no lock.
+template <typename Value>
+class VersionChain {
+public:
+    // The initial value is visible to every view.
+    explicit VersionChain(const Value& initial) : head_(new ValueVersion<Value>(initial)) {}
+    // Older nodes belong to the store's reclamation list.
+    ~VersionChain() { delete head_.load(std::memory_order_relaxed); }
+
+    // Newest value committed at or before `commit`. *version, when given,
+    // receives that value's commit number.
+    const Value& Read(unsigned long long commit, unsigned long long* version = nullptr) const {
+        const VersionNode* node = head_.load(std::memory_order_acquire);
+        while (node->commit > commit) {
+            node = node->older;
+        }
+        if (version != nullptr) {
+            *version = node->commit;
+        }
+        return static_cast<const ValueVersion<Value>*>(node)->value;
+    }
+
+private:
+    VersionChain(const VersionChain&) = delete;
+    VersionChain& operator=(const VersionChain&) = delete;
+
+    friend class VersionStore;
+
+    std::atomic<VersionNode*> head_;
+};
+
+// Hands out commit numbers and reclaims superseded versions. Commits are
+// numbered in order under one short lock; a commit of several chains (a
+// transfer's two balances) becomes visible all at once. A superseded node
+// is freed once every registered reader's view is at or past the commit
+// that superseded it.
+class VersionStore {
+public:
+    static VersionStore& Instance();
+
+    template <typename Value>
+    void Commit(VersionChain<Value>& chain, const Value& value) {
+        ValueVersion<Value>* node = new ValueVersion<Value>(value);
+        {
+            std::lock_guard<std::mutex> lock(commitMutex_);
+            unsigned long long commit = stable_.load(std::memory_order_relaxed) + 1;
+            Push(chain.head_, node, commit);
+            stable_.store(commit, std::memory_order_release);
+        }
+        AfterCommit();
+    }
+
+    template <typename First, typename Second>
+    void Commit(VersionChain<First>& first, const First& firstValue,
+                VersionChain<Second>& second, const Second& secondValue) {
+        ValueVersion<First>* firstNode = new ValueVersion<First>(firstValue);
+        ValueVersion<Second>* secondNode = new ValueVersion<Second>(secondValue);
+        {
+            std::lock_guard<std::mutex> lock(commitMutex_);
+            unsigned long long commit = stable_.load(std::memory_order_relaxed) + 1;
+            Push(first.head_, firstNode, commit);
+            Push(second.head_, secondNode, commit);
+            stable_.store(commit, std::memory_order_release);
+        }
+        AfterCommit();
+    }
+
+    // Latest commit number; every commit up to it is fully visible.
+    unsigned long long StableCommit() const;
+    // Frees every superseded version no open view can still read.
+    void Reclaim();
+    std::size_t RetiredVersions() const;
+
+private:
+    VersionStore();
+    VersionStore(const VersionStore&) = delete;
+    VersionStore& operator=(const VersionStore&) = delete;
+
+    friend class ReadView;
+
+    struct Retired {
+        VersionNode* node;
+        unsigned long long supersededAt;
+    };
+
+    // Called with commitMutex_ held.
+    void Push(std::atomic<VersionNode*>& head, VersionNode* node, unsigned long long commit);
+    // Reclaims once enough versions pile up, unless readers are registering.
+    void AfterCommit();
+    void Reclaim(bool wait);
+
+    unsigned long long Enter();
+    void Leave(unsigned long long commit);
+
+    std::mutex commitMutex_;
+    std::atomic<unsigned long long> stable_;
+    // Guarded by commitMutex_; in commit order.
+    std::deque<Retired> retired_;
+    std::atomic<std::size_t> retiredCount_;
+    std::mutex readersMutex_;
+    // Open views by commit number, with how many views share it.
+    std::map<unsigned long long, std::size_t> readers_;
+};
+
+// A consistent point-in-time view over every version chain. Open views
+// never block writers; they only keep the versions they can see alive.
+class ReadView {
+public:
+    ReadView();
+    ~ReadView();
+
+    unsigned long long Commit() const;
+
+    template <typename Value>
+    const Value& Read(const VersionChain<Value>& chain, unsigned long long* version = nullptr) const {
+        return chain.Read(commit_, version);
+    }
+
+private:
+    ReadView(const ReadView&) = delete;
+    ReadView& operator=(const ReadView&) = delete;
+
+    unsigned long long commit_;
+};
+
+#endif // VERSIONS_HPP
@@ -0,0 +1,1191 @@
+// Microbenchmarks for the banking and ATM hot paths.
+//
+// Build from the repository root:
+//   g++ -std=c++14 -O2 -I. bench/Bench.cpp Atm.cpp Bank.cpp Account.cpp Card.cpp Transaction.cpp System.cpp Report.cpp Trace.cpp Session.cpp Executor.cpp Dispense.cpp CashDrawer.cpp Forecast.cpp Snapshot.cpp Versions.cpp Fees.cpp Settlement.cpp Receipt.cpp Export.cpp TimeIndex.cpp Ledger.cpp Segment.cpp Sha256.cpp Audit.cpp Reconcile.cpp -pthread -o atm_bench
+//
+// Usage:
+//   atm_bench [--filter TEXT] [--sizes 100,1000,10000] [--min-time-ms 50]
+//             [--out results.json] [--baseline old.json] [--threshold 0.10]
+//
+// Results are written as JSON (one benchmark per line) to stdout or --out.
+// Benchmarks that measure memory as well add a "bytes" field.
+// With --baseline, every benchmark slower than the baseline by more than
+// the threshold is reported on stderr and the exit code is 2.
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <streambuf>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "Account.hpp"
+#include "Atm.hpp"
+#include "Audit.hpp"
+#include "Bank.hpp"
+#include "Card.hpp"
+#include "Executor.hpp"
+#include "Export.hpp"
+#include "Forecast.hpp"
+#include "Ledger.hpp"
+#include "Reconcile.hpp"
+#include "Report.hpp"
+#include "Segment.hpp"
+#include "Session.hpp"
+#include "Snapshot.hpp"
+#include "System.hpp"
+#include "TimeIndex.hpp"
+#include "Transaction.hpp"
+
+namespace {
+
+struct BenchOptions {
+    std::string filter;
+    std::vector<long long> sizes{100, 1000, 10000};
+    double minTimeMs = 50.0;
+    std::string outPath;
+    std::string baselinePath;
+    double threshold = 0.10;
+};
+
+struct BenchResult {
+    std::string name;
+    long long size = 0;
+    long long iterations = 0;
+    double nsPerOp = 0.0;
+    long long bytes = 0;
+};
+
+// Swallows everything written to it; used to mute the ATM's console messages.
+class NullBuffer : public std::streambuf {
+protected:
+    int overflow(int c) override { return traits_type::not_eof(c); }
+    std::streamsize xsputn(const char*, std::streamsize count) override { return count; }
+};
+
+NullBuffer g_nullBuffer;
+std::ostream g_nullStream(&g_nullBuffer);
+volatile long long g_sink = 0;
+
+class Bencher {
+public:
+    explicit Bencher(const BenchOptions& options) : options_(options) {}
+
+    bool Enabled(const std::string& name) const {
+        return options_.filter.empty() || name.find(options_.filter) != std::string::npos;
+    }
+
+    // Runs fn in doubling batches until one batch takes at least minTimeMs.
+    // opsPerCall is the number of operations one call of fn performs.
+    template <typename Fn>
+    void Run(const std::string& name, long long size, Fn&& fn, long long opsPerCall = 1) {
+        if (!Enabled(name)) {
+            return;
+        }
+        std::streambuf* saved = std::cout.rdbuf(&g_nullBuffer);
+        long long iterations = 1;
+        double elapsedNs = 0.0;
+        while (true) {
+            auto start = std::chrono::steady_clock::now();
+            for (long long i = 0; i < iterations; ++i) {
+                fn();
+            }
+            auto end = std::chrono::steady_clock::now();
+            elapsedNs = static_cast<double>(
+                std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count());
+            if (elapsedNs >= options_.minTimeMs * 1e6 || iterations >= (1LL << 32)) {
+                break;
+            }
+            iterations *= 2;
+        }
+        std::cout.rdbuf(saved);
+
+        BenchResult result;
+        result.name = name;
+        result.size = size;
+        result.iterations = iterations;
+        result.nsPerOp = elapsedNs / static_cast<double>(iterations * opsPerCall);
+        results_.push_back(result);
+        std::cerr << name << " [" << size << "] " << result.nsPerOp << " ns/op\n";
+    }
+
+    // Attaches a memory figure to the most recent result.
+    void SetBytes(long long bytes) {
+        if (!results_.empty()) {
+            results_.back().bytes = bytes;
+        }
+    }
+
+    const std::vector<BenchResult>& Results() const { return results_; }
+
+private:
+    const BenchOptions& options_;
+    std::vector<BenchResult> results_;
+};
+
+std::string CardNumberFor(long long index) {
+    char buffer[32];
+    std::snprintf(buffer, sizeof(buffer), "9%03lld-%04lld-%04lld",
+                  (index / 100000000) % 1000, (index / 10000) % 10000, index % 10000);
+    return buffer;
+}
+
+std::string AccountNumberFor(long long index) {
+    char buffer[32];
+    std::snprintf(buffer, sizeof(buffer), "%03lld-%03lld-%06lld",
+                  (index / 1000000000) % 1000, (index / 1000000) % 1000, index % 1000000);
+    return buffer;
+}
+
+// Two banks with accountCount accounts spread across them and one
+// multi-bank ATM whose primary bank is the first bank.
+void BuildFixture(SystemState& state, long long accountCount) {
+    const char* bankNames[] = {"Alpha", "Beta"};
+    // Each bank registers itself in state.banks.
+    for (const char* bankName : bankNames) {
+        new Bank(bankName, bankName, &state.banks, &state.transactions);
+    }
+    state.accounts.reserve(static_cast<std::size_t>(accountCount));
+    state.cards.reserve(static_cast<std::size_t>(accountCount));
+    for (long long i = 0; i < accountCount; ++i) {
+        Bank* bank = state.banks[static_cast<std::size_t>(i % 2)];
+        Card* card = new Card(CardNumberFor(i), bank->getBankName(), CardRole::User);
+        Account* account = new Account(bank, "Owner", AccountNumberFor(i), 1000000000000LL, card, "0000");
+        state.cards.push_back(card);
+        state.accounts.push_back(account);
+        bank->addAccount(account);
+    }
+
+    ATM* atm = new ATM("900001", state.banks[0], ATMBankAccess_MultiBank, true);
+    atm->AddAcceptedBanks(state.banks);
+    CashDrawer cash;
+    for (int i = 0; i < CASH_TYPE_COUNT; ++i) {
+        cash.noteCounts[i] = 1000000;
+    }
+    atm->LoadCash(cash);
+    state.atms.push_back(atm);
+}
+
+// Events per fixture session; sessions have no event cap, but restarting
+// keeps the receipt log from growing across millions of requests.
+const std::size_t EVENTS_PER_SESSION = 50;
+
+// Keeps a customer session open on the fixture ATM, restarting it before the
+// per-session withdrawal limit would end it or the log outgrows a session.
+void EnsureCustomerSession(ATM* atm, Account* account) {
+    const SessionState& session = atm->GetSessionState();
+    if (atm->HasActiveSession() &&
+        session.withdrawalCount < 3 &&
+        session.log.Size() < EVENTS_PER_SESSION) {
+        return;
+    }
+    atm->EndSession();
+    atm->StartCustomerSession(account->getLinkedCard(), account, true);
+}
+
+void RefillIfLow(ATM* atm) {
+    const CashDrawer& inventory = atm->GetCashInventory();
+    for (int i = 0; i < CASH_TYPE_COUNT; ++i) {
+        if (inventory.noteCounts[i] < 1000) {
+            CashDrawer cash;
+            cash.noteCounts[i] = 1000000;
+            atm->LoadCash(cash);
+        }
+    }
+}
+
+void BenchBank(Bencher& bencher, long long size) {
+    SystemState state;
+    BuildFixture(state, size);
+    Bank* bank = state.banks[0];
+
+    std::vector<std::string> cardNumbers;
+    for (long long i = 0; i < size; i += 2) {
+        cardNumbers.push_back(CardNumberFor(i));
+    }
+    std::size_t cursor = 0;
+    const std::size_t stride = 7919;
+
+    bencher.Run("bank.findAccountByCardNumber", size, [&] {
+        cursor = (cursor + stride) % cardNumbers.size();
+        g_sink += bank->findAccountByCardNumber(cardNumbers[cursor]) != nullptr;
+    });
+
+    bencher.Run("bank.verifyUserCredentials", size, [&] {
+        cursor = (cursor + stride) % cardNumbers.size();
+        Account* account = nullptr;
+        g_sink += bank->verifyUserCredentials(cardNumbers[cursor], "0000", account);
+    });
+
+    Cleanup(state);
+}
+
+void BenchCashDrawer(Bencher& bencher) {
+    CashDrawer inventory;
+    inventory.noteCounts[0] = 500;
+    inventory.noteCounts[1] = 100;
+    inventory.noteCounts[2] = 50;
+    inventory.noteCounts[3] = 10;
+
+    const long long amounts[] = {10000, 137000, 500000};
+    for (long long amount : amounts) {
+        bencher.Run("dispense.BuildWithdrawalBundle", amount, [&] {
+            CashDrawer bundle;
+            g_sink += BuildWithdrawalBundle(amount, inventory, bundle);
+        });
+        bencher.Run("dispense.PlanDispense.balanced", amount, [&] {
+            CashDrawer bundle;
+            g_sink += PlanDispense(amount, inventory, DispenseObjective_Balanced, bundle);
+        });
+    }
+
+    CashDrawer small;
+    small.noteCounts[0] = 3;
+    small.noteCounts[3] = 1;
+    CashDrawer drawer = inventory;
+
+    bencher.Run("cashdrawer.TotalValue", 1, [&] { g_sink += drawer.TotalValue(); });
+    bencher.Run("cashdrawer.ItemCount", 1, [&] { g_sink += drawer.ItemCount(); });
+    bencher.Run("cashdrawer.HasEnoughBills", 1, [&] { g_sink += drawer.HasEnoughBills(small); });
+    bencher.Run("cashdrawer.AddRemove", 1, [&] {
+        drawer.Add(small);
+        drawer.Remove(small);
+        g_sink += drawer.noteCounts[0];
+    });
+
+    // The same operations on a drawer whose note set is only known at run time.
+    std::vector<int> values(CASH_BILL_VALUES, CASH_BILL_VALUES + CASH_TYPE_COUNT);
+    DynamicCashDrawer dynamicDrawer(values);
+    DynamicCashDrawer dynamicSmall(values);
+    for (int i = 0; i < CASH_TYPE_COUNT; ++i) {
+        dynamicDrawer.noteCounts[i] = inventory.noteCounts[i];
+        dynamicSmall.noteCounts[i] = small.noteCounts[i];
+    }
+    bencher.Run("cashdrawer.dynamic.TotalValue", 1, [&] { g_sink += dynamicDrawer.TotalValue(); });
+    bencher.Run("cashdrawer.dynamic.HasEnoughBills", 1, [&] {
+        g_sink += dynamicDrawer.HasEnoughBills(dynamicSmall);
+    });
+    bencher.Run("cashdrawer.dynamic.AddRemove", 1, [&] {
+        dynamicDrawer.Add(dynamicSmall);
+        dynamicDrawer.Remove(dynamicSmall);
+        g_sink += dynamicDrawer.noteCounts[0];
+    });
+    bencher.Run("dispense.PlanDispense.dynamic", 137000, [&] {
+        DynamicCashDrawer bundle(values);
+        g_sink += PlanDispense(137000, dynamicDrawer, DispenseObjective_FewestNotes, bundle);
+    });
+}
+
+void BenchRequests(Bencher& bencher, long long size) {
+    SystemState state;
+    BuildFixture(state, size);
+    ATM* atm = state.atms[0];
+    Account* customer = state.accounts[0];
+    Account* destination = state.accounts[state.accounts.size() > 1 ? 1 : 0];
+
+    CashDrawer depositCash;
+    depositCash.noteCounts[2] = 2;
+    CashDrawer noFee;
+
+    bencher.Run("atm.RequestDeposit", size, [&] {
+        EnsureCustomerSession(atm, customer);
+        atm->RequestDeposit(depositCash, 0, noFee, 0);
+    });
+
+    bencher.Run("atm.RequestWithdrawal", size, [&] {
+        EnsureCustomerSession(atm, customer);
+        RefillIfLow(atm);
+        atm->RequestWithdrawal(67000);
+    });
+
+    bencher.Run("atm.RequestAccountTransfer", size, [&] {
+        EnsureCustomerSession(atm, customer);
+        atm->RequestAccountTransfer(destination, 1000);
+    });
+
+    CashDrawer transferCash;
+    transferCash.noteCounts[2] = 3;
+    bencher.Run("atm.RequestCashTransfer", size, [&] {
+        EnsureCustomerSession(atm, customer);
+        atm->RequestCashTransfer(destination, transferCash);
+    });
+
+    atm->EndSession();
+    Cleanup(state);
+}
+
+void BenchReceipt(Bencher& bencher) {
+    SystemState state;
+    BuildFixture(state, 2);
+    ATM* atm = state.atms[0];
+    Account* customer = state.accounts[0];
+
+    std::streambuf* saved = std::cout.rdbuf(&g_nullBuffer);
+    const int eventCounts[] = {1, 10, 50, 200};
+    PrinterReceiptSink printer(1LL << 62);
+    CashDrawer depositCash;
+    depositCash.noteCounts[2] = 1;
+    for (int events : eventCounts) {
+        atm->EndSession();
+        atm->StartCustomerSession(customer->getLinkedCard(), customer, true);
+        for (int i = 0; i < events; ++i) {
+            atm->RequestDeposit(depositCash, 0, CashDrawer(), 0);
+        }
+        std::cout.rdbuf(saved);
+        bencher.Run("atm.PrintReceipt", events, [&] { atm->PrintReceipt(g_nullStream); });
+        bencher.Run("atm.PrintReceipt.printer", events, [&] { atm->PrintReceipt(printer); });
+        saved = std::cout.rdbuf(&g_nullBuffer);
+    }
+    std::cout.rdbuf(saved);
+
+    atm->EndSession();
+    Cleanup(state);
+}
+
+void BenchPrintTransactions(Bencher& bencher, long long size) {
+    if (!bencher.Enabled("report.PrintTransactions")) {
+        return;
+    }
+    SystemState state;
+    BuildFixture(state, 2);
+    ATM* atm = state.atms[0];
+    Account* customer = state.accounts[0];
+    Account* destination = state.accounts[1];
+
+    std::streambuf* saved = std::cout.rdbuf(&g_nullBuffer);
+    CashDrawer depositCash;
+    depositCash.noteCounts[2] = 1;
+    CashDrawer transferCash;
+    transferCash.noteCounts[2] = 1;
+    for (long long i = 0; i < size; ++i) {
+        EnsureCustomerSession(atm, customer);
+        switch (i % 4) {
+        case 0:
+            atm->RequestDeposit(depositCash, 0, CashDrawer(), 0);
+            break;
+        case 1:
+            atm->RequestWithdrawal(10000);
+            break;
+        case 2:
+            atm->RequestAccountTransfer(destination, 1000);
+            break;
+        default:
+            atm->RequestCashTransfer(destination, transferCash);
+            break;
+        }
+    }
+    atm->EndSession();
+    std::cout.rdbuf(saved);
+
+    bencher.Run("report.PrintTransactions", size, [&] {
+        PrintTransactions(atm->GetTransactions(), g_nullStream);
+    });
+
+    Cleanup(state);
+}
+
+// Streams `size` transactions of all four kinds over 2,000 accounts, per
+// record; "bytes" is the size of one export.
+void BenchExport(Bencher& bencher, long long size) {
+    if (!bencher.Enabled("export.")) {
+        return;
+    }
+    SystemState state;
+    state.transactions.reserve(static_cast<std::size_t>(size));
+    for (long long i = 0; i < size; ++i) {
+        std::string card = CardNumberFor(i % 2000);
+        std::string account = "100-000-" + std::to_string(100000 + i % 2000);
+        std::string target = "100-000-" + std::to_string(100000 + (i * 7) % 2000);
+        std::string atm = std::to_string(100000 + i % 100);
+        Transaction* transaction = nullptr;
+        switch (i % 4) {
+        case 0:
+            transaction = new DepositTransaction(atm, card, "Kakao", account, 50000, 1000,
+                                                 "Deposit completed");
+            break;
+        case 1:
+            transaction = new WithdrawalTransaction(atm, card, "Kakao", account, 10000, 1000,
+                                                    "Withdrawal completed");
+            break;
+        case 2:
+            transaction = new AccountTransferTransaction(atm, card, "Kakao", account, "Daegu", target,
+                                                         25000, 2000, "Account transfer completed");
+            break;
+        default:
+            transaction = new CashTransferTransaction(atm, card, "Kakao", account, "Daegu", target,
+                                                      30000, 2000, "Cash transfer completed");
+            break;
+        }
+        state.transactions.push_back(transaction);
+    }
+
+    const ExportFormat formats[] = {ExportFormat_Csv, ExportFormat_Ndjson, ExportFormat_Binary};
+    const char* const names[] = {"export.csv", "export.ndjson", "export.binary"};
+    for (int i = 0; i < 3; ++i) {
+        long long bytes = 0;
+        bencher.Run(names[i], size, [&] {
+            bytes = ExportTransactions(state.transactions, formats[i], 0, g_nullStream).bytes;
+        }, size);
+        bencher.SetBytes(bytes);
+    }
+
+    Cleanup(state);
+}
+
+// One-hour range queries over `size` transactions, ten a second, through
+// the per-minute index and by scanning the whole list. timeindex.FindAtm
+// asks the ledger for one of 10 ATMs' transactions in the same hour.
+void BenchTimeIndex(Bencher& bencher, long long size) {
+    if (!bencher.Enabled("timeindex.")) {
+        return;
+    }
+    const long long start = 1700000000LL * 1000 * 1000;
+    const long long spacing = 100 * 1000;
+    std::vector<Transaction*> transactions;
+    TransactionTimeIndex index;
+    std::unique_ptr<TransactionLedger> ledger(new TransactionLedger());
+    for (long long i = 0; i < size; ++i) {
+        Transaction* transaction = new WithdrawalTransaction(std::to_string(100000 + i % 10), CardNumberFor(i % 2000),
+                                                             "Kakao", "100-000-100000", 10000, 1000, "");
+        Timestamp time;
+        time.wallMicros = start + i * spacing;
+        transaction->setTime(time);
+        transactions.push_back(transaction);
+        index.Add(transaction);
+        ledger->Add(transaction);
+    }
+
+    const long long span = size * spacing;
+    const long long window = 60 * MICROS_PER_MINUTE;
+    long long cursor = 0;
+    std::vector<Transaction*> found;
+    bencher.Run("timeindex.Find", size, [&] {
+        cursor = (cursor + 7919 * MICROS_PER_MINUTE / 60) % span;
+        found.clear();
+        index.Find(start + cursor, start + cursor + window, found);
+        g_sink += static_cast<long long>(found.size());
+    });
+    bencher.Run("timeindex.scan", size, [&] {
+        cursor = (cursor + 7919 * MICROS_PER_MINUTE / 60) % span;
+        found.clear();
+        for (Transaction* transaction : transactions) {
+            long long time = transaction->getTime().wallMicros;
+            if (time >= start + cursor && time < start + cursor + window) {
+                found.push_back(transaction);
+            }
+        }
+        g_sink += static_cast<long long>(found.size());
+    });
+    TransactionQuery query;
+    query.atmSerial = "100001";
+    query.hasFrom = true;
+    query.hasTo = true;
+    bencher.Run("timeindex.FindAtm", size, [&] {
+        cursor = (cursor + 7919 * MICROS_PER_MINUTE / 60) % span;
+        query.fromMicros = start + cursor;
+        query.toMicros = start + cursor + window;
+        found.clear();
+        LoadedTransactions loaded;
+        ledger->Find(query, found, loaded);
+        g_sink += static_cast<long long>(found.size());
+    });
+
+    ledger.reset();
+    for (Transaction* transaction : transactions) {
+        delete transaction;
+    }
+}
+
+// `size` transactions over 2,000 cards and accounts, 3 banks and 100 ATMs.
+// ledger.Find asks for one card's withdrawals of 20,000 or more, through
+// the posting lists; ledger.scan answers the same by reading every record.
+void BenchLedger(Bencher& bencher, long long size) {
+    if (!bencher.Enabled("ledger.")) {
+        return;
+    }
+    const char* const banks[] = {"Kakao", "Daegu", "Shinhan"};
+    std::vector<Transaction*> transactions;
+    transactions.reserve(static_cast<std::size_t>(size));
+    for (long long i = 0; i < size; ++i) {
+        std::string card = CardNumberFor(i % 2000);
+        std::string account = "100-000-" + std::to_string(100000 + i % 2000);
+        std::string atm = std::to_string(100000 + (i * 31) % 100);
+        const char* bank = banks[i % 3];
+        long long amount = 10000 * (1 + i % 7);
+        if (i % 2 == 0) {
+            transactions.push_back(new WithdrawalTransaction(atm, card, bank, account, amount, 1000, ""));
+        } else {
+            transactions.push_back(new AccountTransferTransaction(atm, card, bank, account, banks[(i + 1) % 3],
+                                                                  "100-000-" + std::to_string(100000 + (i * 7) % 2000),
+                                                                  amount, 2000, ""));
+        }
+    }
+
+    std::unique_ptr<TransactionLedger> ledger;
+    std::size_t next = 0;
+    bencher.Run("ledger.Add", size, [&] {
+        if (next == 0) {
+            ledger.reset(new TransactionLedger());
+        }
+        ledger->Add(transactions[next]);
+        next = (next + 1) % transactions.size();
+    });
+    ledger.reset(new TransactionLedger());
+    for (Transaction* transaction : transactions) {
+        ledger->Add(transaction);
+    }
+
+    TransactionQuery query;
+    query.hasKind = true;
+    query.kind = TransactionKind_Withdrawal;
+    query.hasMinAmount = true;
+    query.minAmount = 20000;
+    long long card = 0;
+    std::vector<Transaction*> found;
+    LoadedTransactions loaded;
+    bencher.Run("ledger.Find", size, [&] {
+        card = (card + 7) % 2000;
+        query.cardNumber = CardNumberFor(card);
+        found.clear();
+        ledger->Find(query, found, loaded);
+        g_sink += static_cast<long long>(found.size());
+    });
+    bencher.Run("ledger.scan", size, [&] {
+        card = (card + 7) % 2000;
+        query.cardNumber = CardNumberFor(card);
+        found.clear();
+        for (Transaction* transaction : transactions) {
+            if (transaction->getCardNumber() == query.cardNumber &&
+                transaction->getKind() == query.kind && transaction->getAmount() >= query.minAmount) {
+                found.push_back(transaction);
+            }
+        }
+        g_sink += static_cast<long long>(found.size());
+    });
+
+    // The same search against the same transactions sealed into one
+    // segment file of each format, mapped and decoded on every call. Write
+    // records the file size; ReadAll decodes every record.
+    const std::string path = "bench-segment.atmseg";
+    const std::pair<const char*, SegmentFormat> formats[] = {
+        {"ledger.segment.", SegmentFormat_Raw},
+        {"ledger.segment.packed.", SegmentFormat_Packed},
+    };
+    for (const auto& format : formats) {
+        const std::string prefix = format.first;
+        if (!bencher.Enabled(prefix + "Write") && !bencher.Enabled(prefix + "Find") &&
+            !bencher.Enabled(prefix + "ReadAll")) {
+            continue;
+        }
+        TransactionSegment segment;
+        bencher.Run(prefix + "Write", size, [&] {
+            TransactionSegment::Write(path, transactions, format.second, segment);
+        }, size);
+        bencher.SetBytes(static_cast<long long>(segment.FileBytes()));
+        if (segment.Size() == 0) {
+            TransactionSegment::Write(path, transactions, format.second, segment);
+        }
+        bencher.Run(prefix + "Find", size, [&] {
+            card = (card + 7) % 2000;
+            query.cardNumber = CardNumberFor(card);
+            found.clear();
+            loaded.clear();
+            segment.Find(query, found, loaded);
+            g_sink += static_cast<long long>(found.size());
+        });
+        bencher.Run(prefix + "ReadAll", size, [&] {
+            found.clear();
+            loaded.clear();
+            segment.ReadAll(found, loaded);
+            g_sink += static_cast<long long>(found.size());
+        }, size);
+        std::remove(path.c_str());
+    }
+
+    // Audit: the leaf hash every Add pays, then proving and checking one
+    // transaction once everything is closed into blocks. A proof reads one
+    // path of its block's kept tree; VerifyBlock re-hashes a whole block.
+    std::size_t hashed = 0;
+    bencher.Run("ledger.audit.HashTransaction", size, [&] {
+        Sha256Digest digest = HashTransaction(*transactions[hashed]);
+        g_sink += digest.bytes[0];
+        hashed = (hashed + 1) % transactions.size();
+    });
+    if (bencher.Enabled("ledger.audit.Prove") || bencher.Enabled("ledger.audit.Verify")) {
+        ledger->CloseBlock();
+        TransactionProof proof;
+        Sha256Digest root;
+        Transaction* proved = nullptr;
+        long long id = 0;
+        bencher.Run("ledger.audit.ProveTransaction", size, [&] {
+            id = id % size + 1;
+            LoadedTransactions owned;
+            ledger->ProveTransaction(transactions[static_cast<std::size_t>(id - 1)]->getId(), proof, root, proved,
+                                     owned);
+        });
+        bencher.Run("ledger.audit.VerifyTransactionProof", size, [&] {
+            g_sink += VerifyTransactionProof(*proved, proof, root) ? 1 : 0;
+        });
+        std::size_t block = 0;
+        bencher.Run("ledger.audit.VerifyBlock", size, [&] {
+            g_sink += ledger->VerifyBlock(block) == AuditStatus_Proved ? 1 : 0;
+            block = (block + 1) % ledger->BlockCount();
+        }, size / static_cast<long long>(ledger->BlockCount()));
+    }
+
+    ledger.reset();
+    for (Transaction* transaction : transactions) {
+        delete transaction;
+    }
+}
+
+// `size` deposits over up to 2,000 accounts. history.recent reads each account's
+// first page, which the in-memory ring answers; history.archive reads a
+// page from halfway down the history, which the ledger answers.
+void BenchHistory(Bencher& bencher, long long size) {
+    if (!bencher.Enabled("history.")) {
+        return;
+    }
+    const long long accountCount = std::max(1LL, std::min(size / 2, 2000LL));
+    std::vector<Account*> accounts;
+    for (long long i = 0; i < accountCount; ++i) {
+        accounts.push_back(new Account(nullptr, "Owner", "100-000-" + std::to_string(100000 + i), 0,
+                                       nullptr, "1234"));
+    }
+    TransactionLedger ledger;
+    std::vector<Transaction*> transactions;
+    transactions.reserve(static_cast<std::size_t>(size));
+    for (long long i = 0; i < size; ++i) {
+        Account* account = accounts[static_cast<std::size_t>(i % accountCount)];
+        Transaction* transaction = new DepositTransaction("100000", CardNumberFor(i % accountCount), "Kakao",
+                                                          account->getAccountNumber(), 10000, 0, "");
+        transactions.push_back(transaction);
+        ledger.Add(transaction);
+        account->recordTransaction(transaction);
+    }
+
+    long long next = 0;
+    bencher.Run("history.recent", size, [&] {
+        next = (next + 7) % accountCount;
+        HistoryPage page = accounts[static_cast<std::size_t>(next)]->getHistory(0, ACCOUNT_RECENT_TRANSACTIONS, &ledger);
+        g_sink += static_cast<long long>(page.transactions.size());
+    });
+    bencher.SetBytes(static_cast<long long>(sizeof(Account) + ACCOUNT_RECENT_TRANSACTIONS * sizeof(Transaction*)));
+    bencher.Run("history.archive", size, [&] {
+        next = (next + 7) % accountCount;
+        // IDs are global, so the account's middle transaction is near the middle one.
+        long long cursor = transactions[static_cast<std::size_t>(size / 2 + next)]->getId();
+        HistoryPage page = accounts[static_cast<std::size_t>(next)]->getHistory(cursor, ACCOUNT_RECENT_TRANSACTIONS, &ledger);
+        g_sink += static_cast<long long>(page.transactions.size());
+    });
+
+    for (Transaction* transaction : transactions) {
+        delete transaction;
+    }
+    for (Account* account : accounts) {
+        delete account;
+    }
+}
+
+// Snapshots over `size` accounts while one customer keeps withdrawing, so
+// each kept snapshot has a single changed balance to re-read.
+void BenchSnapshot(Bencher& bencher, long long size) {
+    if (!bencher.Enabled("snapshot.PrintSnapshot") && !bencher.Enabled("snapshot.FleetSnapshot.top10")) {
+        return;
+    }
+    SystemState state;
+    BuildFixture(state, size);
+    ATM* atm = state.atms[0];
+    Account* customer = state.accounts[0];
+    atm->SetConsole(&g_nullStream);
+
+    bencher.Run("snapshot.PrintSnapshot", size, [&] {
+        std::streambuf* saved = std::cout.rdbuf(&g_nullBuffer);
+        PrintSnapshot(state.banks, state.atms);
+        std::cout.rdbuf(saved);
+    });
+    bencher.Run("snapshot.FleetSnapshot", size, [&] {
+        EnsureCustomerSession(atm, customer);
+        atm->RequestWithdrawal(1000);
+        state.snapshot.Print(state.banks, state.atms, ATMLanguage_English, g_nullStream);
+    });
+    SnapshotQuery top;
+    top.topN = 10;
+    bencher.Run("snapshot.FleetSnapshot.top10", size, [&] {
+        EnsureCustomerSession(atm, customer);
+        atm->RequestWithdrawal(1000);
+        state.snapshot.Print(state.banks, state.atms, top, ATMLanguage_English, g_nullStream);
+    });
+
+    atm->EndSession();
+    atm->SetConsole(nullptr);
+    Cleanup(state);
+}
+
+// Adds count more multi-bank ATMs (serials from 800000) to a BuildFixture state.
+void AddAtms(SystemState& state, long long count) {
+    CashDrawer cash;
+    for (int i = 0; i < CASH_TYPE_COUNT; ++i) {
+        cash.noteCounts[i] = 100000;
+    }
+    for (long long i = 0; i < count; ++i) {
+        char serial[32];
+        std::snprintf(serial, sizeof(serial), "%06lld", 800000 + i);
+        ATM* atm = new ATM(serial, state.banks[0], ATMBankAccess_MultiBank, true);
+        atm->AddAcceptedBank(state.banks[1]);
+        atm->LoadCash(cash);
+        state.atms.push_back(atm);
+    }
+}
+
+// One event per op, round-robin over `size` terminals, each running a full
+// customer visit (language, login, receipt, end) through the multiplexer.
+void BenchSessions(Bencher& bencher, long long size) {
+    if (!bencher.Enabled("session.Dispatch")) {
+        return;
+    }
+    SystemState state;
+    BuildFixture(state, 2);
+    AddAtms(state, size);
+    std::vector<std::string> serials;
+    for (std::size_t i = 1; i < state.atms.size(); ++i) {
+        serials.push_back(state.atms[i]->GetSerialNumber());
+    }
+
+    const std::string script[] = {"start", "1", "1", state.accounts[0]->getLinkedCard()->getNumber(), "0000", "5", "0"};
+    const std::size_t scriptLength = sizeof(script) / sizeof(script[0]);
+    SessionContext context(&state, nullptr);
+    SessionMultiplexer sessions(&context);
+    long long terminal = 0;
+    std::size_t step = 0;
+    bencher.Run("session.Dispatch", size, [&] {
+        g_sink += sessions.Dispatch(serials[static_cast<std::size_t>(terminal)], script[step], g_nullStream);
+        if (++terminal == size) {
+            terminal = 0;
+            step = (step + 1) % scriptLength;
+        }
+    });
+    bencher.SetBytes(static_cast<long long>(sizeof(AtmSession) + sizeof(AtmSession*)));
+
+    Cleanup(state);
+}
+
+// Withdrawals spread round-robin over `size` ATMs, each ATM on its own strand
+// of a work-stealing executor with one worker per hardware thread.
+void BenchExecutor(Bencher& bencher, long long size) {
+    if (!bencher.Enabled("executor.RequestWithdrawal")) {
+        return;
+    }
+    SystemState state;
+    BuildFixture(state, 1000);
+    AddAtms(state, size);
+    // Each ATM writes to its own muted stream, since ATMs now run concurrently.
+    std::vector<std::unique_ptr<std::ostream>> consoles;
+    for (ATM* atm : state.atms) {
+        consoles.emplace_back(new std::ostream(&g_nullBuffer));
+        atm->SetConsole(consoles.back().get());
+    }
+
+    const long long batch = 1024;
+    Executor executor;
+    AtmStrands strands(&executor);
+    bencher.Run("executor.RequestWithdrawal", size, [&] {
+        for (long long i = 0; i < batch; ++i) {
+            ATM* atm = state.atms[1 + static_cast<std::size_t>(i % size)];
+            Account* customer = state.accounts[static_cast<std::size_t>(i % 1000)];
+            strands.Post(atm, [atm, customer] {
+                EnsureCustomerSession(atm, customer);
+                RefillIfLow(atm);
+                atm->RequestWithdrawal(67000);
+            });
+        }
+        executor.Wait();
+    }, batch);
+
+    for (ATM* atm : state.atms) {
+        atm->EndSession();
+        atm->SetConsole(nullptr);
+    }
+    Cleanup(state);
+}
+
+// Forecasts and plans loads for `size` ATMs that each served a few
+// withdrawal sessions. The trigger is wide open so every ATM gets an order.
+void BenchReplenishment(Bencher& bencher, long long size) {
+    if (!bencher.Enabled("forecast.PlanReplenishment")) {
+        return;
+    }
+    SystemState state;
+    BuildFixture(state, 1000);
+    AddAtms(state, size);
+    std::ostream muted(&g_nullBuffer);
+    const long long amounts[] = {10000, 67000, 137000, 300000};
+    for (std::size_t i = 1; i < state.atms.size(); ++i) {
+        ATM* atm = state.atms[i];
+        Account* customer = state.accounts[i % 1000];
+        atm->SetConsole(&muted);
+        for (int session = 0; session < 4; ++session) {
+            atm->StartCustomerSession(customer->getLinkedCard(), customer, true);
+            atm->RequestWithdrawal(amounts[(i + session) % 4]);
+            atm->EndSession();
+        }
+        atm->SetConsole(nullptr);
+    }
+
+    CashDrawer vault;
+    for (int i = 0; i < CASH_TYPE_COUNT; ++i) {
+        vault.noteCounts[i] = static_cast<int>(size * 50);
+    }
+    ReplenishmentPolicy policy;
+    policy.horizonSessions = 1000000.0;
+    policy.triggerSessions = 1.0e12;
+    policy.cassetteCapacity = 200000;
+    policy.vault = &vault;
+    bencher.Run("forecast.PlanReplenishment", size, [&] {
+        g_sink += static_cast<long long>(PlanReplenishment(state.atms, policy).size());
+    });
+
+    Cleanup(state);
+}
+
+// Reconciles 2,000 accounts and 100 ATMs against `size` deposits,
+// withdrawals and transfers, timed per transaction, on one worker per
+// hardware thread. reconcile.memory reads a ledger that keeps everything
+// in memory; reconcile.segments one that has sealed all but the newest
+// into 16 or so segment files in the working directory.
+void BenchReconcile(Bencher& bencher, long long size) {
+    if (!bencher.Enabled("reconcile.")) {
+        return;
+    }
+    SystemState state;
+    BuildFixture(state, 2000);
+    AddAtms(state, 100);
+    const std::size_t segmentRecords = static_cast<std::size_t>(std::max(1000LL, size / 16));
+    TransactionLedger memory;
+    TransactionLedger segmented;
+    segmented.EnableSegments(".", segmentRecords);
+    std::vector<Transaction*> transactions;
+    transactions.reserve(static_cast<std::size_t>(size));
+    for (int copy = 0; copy < 2; ++copy) {
+        for (long long i = 0; i < size; ++i) {
+            const Account* account = state.accounts[static_cast<std::size_t>(i % 2000)];
+            const Account* target = state.accounts[static_cast<std::size_t>((i * 7 + 1) % 2000)];
+            const std::string& atm = state.atms[static_cast<std::size_t>((i * 31) % 100)]->GetSerialNumber();
+            long long amount = 10000 * (1 + i % 7);
+            Transaction* transaction;
+            if (i % 3 == 0) {
+                transaction = new DepositTransaction(atm, "", account->getBankName(), account->getAccountNumber(),
+                                                     amount, 1000, "");
+            } else if (i % 3 == 1) {
+                transaction = new WithdrawalTransaction(atm, "", account->getBankName(),
+                                                        account->getAccountNumber(), amount, 1000, "");
+            } else {
+                transaction = new AccountTransferTransaction(atm, "", account->getBankName(),
+                                                             account->getAccountNumber(), target->getBankName(),
+                                                             target->getAccountNumber(), amount, 2000, "");
+            }
+            // The segmented ledger owns its copy.
+            if (copy == 0) {
+                transactions.push_back(transaction);
+                memory.Add(transaction);
+            } else {
+                segmented.Add(transaction);
+            }
+        }
+    }
+
+    Executor executor;
+    bencher.Run("reconcile.memory", size, [&] {
+        ReconcileReport report = ReconcileLedger(memory, state.accounts, state.atms, &executor);
+        g_sink += static_cast<long long>(report.balances.size());
+    }, size);
+    bencher.Run("reconcile.segments", size, [&] {
+        ReconcileReport report = ReconcileLedger(segmented, state.accounts, state.atms, &executor);
+        g_sink += static_cast<long long>(report.balances.size());
+    }, size);
+
+    for (const TransactionSegment& segment : segmented.Segments()) {
+        std::remove(segment.GetPath().c_str());
+    }
+    for (Transaction* transaction : transactions) {
+        delete transaction;
+    }
+    Cleanup(state);
+}
+
+// A multi-bank ATM accepting every other one of 1000 issuers; checks
+// alternate between accepted and refused banks.
+void BenchBankAcceptance(Bencher& bencher) {
+    if (!bencher.Enabled("atm.SupportsBank")) {
+        return;
+    }
+    SystemState state;
+    const long long bankCount = 1000;
+    for (long long i = 0; i < bankCount; ++i) {
+        char bankName[32];
+        std::snprintf(bankName, sizeof(bankName), "Issuer%04lld", i);
+        new Bank(bankName, bankName, &state.banks, &state.transactions);
+    }
+    ATM* atm = new ATM("700001", state.banks[0], ATMBankAccess_MultiBank, true);
+    for (std::size_t i = 0; i < state.banks.size(); i += 2) {
+        atm->AddAcceptedBank(state.banks[i]);
+    }
+    state.atms.push_back(atm);
+
+    std::size_t cursor = 0;
+    const std::size_t stride = 7919;
+    bencher.Run("atm.SupportsBank", bankCount, [&] {
+        cursor = (cursor + stride) % state.banks.size();
+        g_sink += atm->SupportsBank(state.banks[cursor]);
+    });
+
+    Cleanup(state);
+}
+
+// Fee lookups on a compiled table with three amount bands and per-pair
+// overrides among 100 banks; Evaluate prices the same queries in batches.
+void BenchFees(Bencher& bencher) {
+    if (!bencher.Enabled("fees.")) {
+        return;
+    }
+    SystemState state;
+    const long long bankCount = 100;
+    for (long long i = 0; i < bankCount; ++i) {
+        char bankName[32];
+        std::snprintf(bankName, sizeof(bankName), "Issuer%04lld", i);
+        new Bank(bankName, bankName, &state.banks, &state.transactions);
+    }
+    FeeSchedule schedule;
+    schedule.bandLimits.push_back(100000);
+    schedule.bandLimits.push_back(1000000);
+    for (long long i = 0; i < bankCount; i += 10) {
+        FeeOverride feeOverride;
+        feeOverride.kind = ATMTransaction_AccountTransfer;
+        feeOverride.sourceBank = state.banks[static_cast<std::size_t>(i)];
+        feeOverride.destinationBank = state.banks[static_cast<std::size_t>((i + 5) % bankCount)];
+        feeOverride.band = static_cast<int>(i % 3);
+        feeOverride.fee = 500;
+        schedule.overrides.push_back(feeOverride);
+    }
+    FeeTable table(schedule, state.banks[0]);
+
+    const std::size_t batch = 1024;
+    std::vector<FeeQuery> queries(batch);
+    for (std::size_t i = 0; i < batch; ++i) {
+        queries[i].kind = static_cast<ATMTransactionKind>(i % TRANSACTION_KIND_COUNT);
+        queries[i].sourceBank = state.banks[(i * 7919) % state.banks.size()];
+        queries[i].destinationBank = state.banks[(i * 104729) % state.banks.size()];
+        queries[i].amount = static_cast<long long>((i * 7919) % 2000) * 1000;
+    }
+    std::vector<long long> fees(batch);
+
+    std::size_t cursor = 0;
+    bencher.Run("fees.FeeTable.Fee", bankCount, [&] {
+        cursor = (cursor + 1) % batch;
+        const FeeQuery& query = queries[cursor];
+        g_sink += table.Fee(query.kind, query.sourceBank, query.destinationBank, query.amount);
+    });
+    bencher.Run("fees.FeeTable.Evaluate", bankCount, [&] {
+        table.Evaluate(queries.data(), batch, fees.data());
+        g_sink += fees[batch - 1];
+    }, static_cast<long long>(batch));
+
+    Cleanup(state);
+}
+
+// Obligations spread over the 10,000 pairs of 100 banks. CloseCycle posts
+// one obligation per pair and closes the cycle, per pair.
+void BenchSettlement(Bencher& bencher) {
+    if (!bencher.Enabled("settlement.")) {
+        return;
+    }
+    SystemState state;
+    const long long bankCount = 100;
+    for (long long i = 0; i < bankCount; ++i) {
+        char bankName[32];
+        std::snprintf(bankName, sizeof(bankName), "Issuer%04lld", i);
+        new Bank(bankName, bankName, &state.banks, &state.transactions);
+    }
+    const std::size_t pairCount = state.banks.size() * state.banks.size();
+
+    std::size_t cursor = 0;
+    bencher.Run("settlement.Post", bankCount, [&] {
+        cursor = (cursor + 7919) % pairCount;
+        state.settlement.Post(state.banks[cursor % state.banks.size()],
+                              state.banks[cursor / state.banks.size()], 1000);
+    });
+    state.settlement.CloseCycle();
+
+    bencher.Run("settlement.CloseCycle", bankCount, [&] {
+        for (std::size_t i = 0; i < pairCount; ++i) {
+            state.settlement.Post(state.banks[i % state.banks.size()],
+                                  state.banks[i / state.banks.size()], 1000);
+        }
+        g_sink += static_cast<long long>(state.settlement.CloseCycle().positions.size());
+    }, static_cast<long long>(pairCount));
+
+    Cleanup(state);
+}
+
+void WriteJson(const BenchOptions& options, const std::vector<BenchResult>& results, std::ostream& out) {
+    out << "{\n";
+    out << "  \"min_time_ms\": " << options.minTimeMs << ",\n";
+    out << "  \"benchmarks\": [\n";
+    for (std::size_t i = 0; i < results.size(); ++i) {
+        const BenchResult& result = results[i];
+        out << "    {\"name\": \"" << result.name << "\", \"size\": " << result.size
+            << ", \"iterations\": " << result.iterations
+            << ", \"ns_per_op\": " << result.nsPerOp;
+        if (result.bytes > 0) {
+            out << ", \"bytes\": " << result.bytes;
+        }
+        out << "}";
+        out << (i + 1 < results.size() ? ",\n" : "\n");
+    }
+    out << "  ]\n";
+    out << "}\n";
+}
+
+// Reads back the benchmark entries written by WriteJson.
+std::vector<BenchResult> ReadJson(std::istream& in) {
+    std::vector<BenchResult> results;
+    std::string line;
+    while (std::getline(in, line)) {
+        std::size_t namePos = line.find("\"name\": \"");
+        if (namePos == std::string::npos) {
+            continue;
+        }
+        namePos += 9;
+        std::size_t nameEnd = line.find('"', namePos);
+        std::size_t sizePos = line.find("\"size\": ");
+        std::size_t nsPos = line.find("\"ns_per_op\": ");
+        if (nameEnd == std::string::npos || sizePos == std::string::npos || nsPos == std::string::npos) {
+            continue;
+        }
+        BenchResult result;
+        result.name = line.substr(namePos, nameEnd - namePos);
+        result.size = std::atoll(line.c_str() + sizePos + 8);
+        result.nsPerOp = std::atof(line.c_str() + nsPos + 13);
+        results.push_back(result);
+    }
+    return results;
+}
+
+int CompareWithBaseline(const BenchOptions& options, const std::vector<BenchResult>& results) {
+    std::ifstream fin(options.baselinePath);
+    if (!fin) {
+        std::cerr << "Error opening baseline: " << options.baselinePath << "\n";
+        return 1;
+    }
+    std::vector<BenchResult> baseline = ReadJson(fin);
+    int regressions = 0;
+    for (const BenchResult& current : results) {
+        for (const BenchResult& previous : baseline) {
+            if (previous.name != current.name || previous.size != current.size || previous.nsPerOp <= 0.0) {
+                continue;
+            }
+            double change = current.nsPerOp / previous.nsPerOp - 1.0;
+            if (change > options.threshold) {
+                std::cerr << "REGRESSION " << current.name << " [" << current.size << "] "
+                          << previous.nsPerOp << " -> " << current.nsPerOp << " ns/op (+"
+                          << static_cast<int>(change * 100.0) << "%)\n";
+                ++regressions;
+            }
+            break;
+        }
+    }
+    return regressions > 0 ? 2 : 0;
+}
+
+std::vector<long long> ParseSizes(const std::string& text) {
+    std::vector<long long> sizes;
+    std::stringstream stream(text);
+    std::string item;
+    while (std::getline(stream, item, ',')) {
+        long long value = std::atoll(item.c_str());
+        if (value > 0) {
+            sizes.push_back(value);
+        }
+    }
+    return sizes;
+}
+
+bool ParseOptions(int argc, char** argv, BenchOptions& options) {
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (i + 1 >= argc) {
+            std::cerr << "Missing value for " << arg << "\n";
+            return false;
+        }
+        std::string value = argv[++i];
+        if (arg == "--filter") {
+            options.filter = value;
+        } else if (arg == "--sizes") {
+            options.sizes = ParseSizes(value);
+        } else if (arg == "--min-time-ms") {
+            options.minTimeMs = std::atof(value.c_str());
+        } else if (arg == "--out") {
+            options.outPath = value;
+        } else if (arg == "--baseline") {
+            options.baselinePath = value;
+        } else if (arg == "--threshold") {
+            options.threshold = std::atof(value.c_str());
+        } else {
+            std::cerr << "Unknown option: " << arg << "\n";
+            return false;
+        }
+    }
+    return !options.sizes.empty();
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    BenchOptions options;
+    if (!ParseOptions(argc, argv, options)) {
+        return 1;
+    }
+
+    Bencher bencher(options);
+    BenchCashDrawer(bencher);
+    BenchReceipt(bencher);
+    BenchBankAcceptance(bencher);
+    BenchFees(bencher);
+    BenchSettlement(bencher);
+    for (long long size : options.sizes) {
+        BenchBank(bencher, size);
+        BenchRequests(bencher, size);
+        BenchPrintTransactions(bencher, size);
+        BenchExport(bencher, size);
+        BenchTimeIndex(bencher, size);
+        BenchLedger(bencher, size);
+        BenchHistory(bencher, size);
+        BenchSnapshot(bencher, size);
+        BenchSessions(bencher, size);
+        BenchExecutor(bencher, size);
+        BenchReplenishment(bencher, size);
+        BenchReconcile(bencher, size);
+    }
+
+    if (options.outPath.empty()) {
+        WriteJson(options, bencher.Results(), std::cout);
+    } else {
+        std::ofstream fout(options.outPath);
+        if (!fout) {
+            std::cerr << "Error opening file: " << options.outPath << "\n";
+            return 1;
+        }
+        WriteJson(options, bencher.Results(), fout);
+    }
+
+    if (!options.baselinePath.empty()) {
+        return CompareWithBaseline(options, bencher.Results());
+    }
+    return 0;
+}
@@ -1,5 +1,11 @@
+#include <algorithm>
+#include <climits>
+#include <cstdlib>
 #include <fstream>
 #include <iostream>
+#include <memory>
+#include <mutex>
+#include <sstream>
 #include <string>
 #include <vector>
 
@@ -8,81 +14,29 @@
 #include "Card.hpp"
 #include "Transaction.hpp"
 #include "Atm.hpp"
-
-struct SystemState {
-    std::vector<Bank*> banks;
-    std::vector<Account*> accounts;
-    std::vector<Card*> cards;
-    std::vector<ATM*> atms;
-    std::vector<Transaction*> transactions;
-    int totalSessions = 0;
-    int customerSessions = 0;
-    int adminSessions = 0;
-};
+#include "Executor.hpp"
+#include "Export.hpp"
+#include "Forecast.hpp"
+#include "Ledger.hpp"
+#include "Receipt.hpp"
+#include "Reconcile.hpp"
+#include "Report.hpp"
+#include "Session.hpp"
+#include "Settlement.hpp"
+#include "Snapshot.hpp"
+#include "System.hpp"
+#include "Trace.hpp"
 
 namespace {
 
-std::string T(ATMLanguage lang, const std::string& en, const std::string& kr) {
-    return (lang == ATMLanguage_Korean) ? kr : en;
-}
+// Transactions per "!history" page.
+const std::size_t HEADLESS_HISTORY_PAGE = 10;
 
 void ClearInputLine() {
     std::cin.clear();
     std::cin.ignore(100000, '\n');
 }
 
-int PromptInt(const std::string& message, int minValue,
-              const std::string& errorMessage = "Invalid input. Try again.\n") {
-    int value = 0;
-    while (true) {
-        std::cout << message;
-        if (std::cin >> value && value >= minValue) {
-            return value;
-        }
-        std::cout << errorMessage;
-        ClearInputLine();
-    }
-}
-
-int PromptIntWithMax(const std::string& message, int minValue, int maxValue,
-                     const std::string& errorMessage = "Invalid input. Try again.\n") {
-    int value = 0;
-    while (true) {
-        std::cout << message;
-        if (std::cin >> value && value >= minValue && value <= maxValue) {
-            return value;
-        }
-        std::cout << errorMessage;
-        ClearInputLine();
-    }
-}
-
-long long PromptLongLong(const std::string& message, long long minValue,
-                         const std::string& errorMessage = "Invalid input. Try again.\n") {
-    long long value = 0;
-    while (true) {
-        std::cout << message;
-        if (std::cin >> value && value >= minValue) {
-            return value;
-        }
-        std::cout << errorMessage;
-        ClearInputLine();
-    }
-}
-
-long long PromptLongLongWithMax(const std::string& message, long long minValue, long long maxValue,
-                                const std::string& errorMessage = "Invalid input. Try again.\n") {
-    long long value = 0;
-    while (true) {
-        std::cout << message;
-        if (std::cin >> value && value >= minValue && value <= maxValue) {
-            return value;
-        }
-        std::cout << errorMessage;
-        ClearInputLine();
-    }
-}
-
 std::string PromptString(const std::string& message) {
     std::cout << message;
     std::string input;
@@ -110,392 +64,6 @@ void PrintMainMenu() {
     std::cout << "========================================\n";
 }
 
-Bank* FindBank(const std::vector<Bank*>& banks, const std::string& name) {
-    for (Bank* bank : banks) {
-        if (bank != nullptr && bank->getBankName() == name) {
-            return bank;
-        }
-    }
-    return nullptr;
-}
-
-Account* FindAccountByCard(const std::vector<Account*>& accounts, const std::string& cardNumber) {
-    for (std::size_t i = 0; i < accounts.size(); ++i) {
-        Account* account = accounts[i];
-        if (account == nullptr) {
-            continue;
-        }
-        Card* linkedCard = account->getLinkedCard();
-        if (linkedCard != nullptr && linkedCard->getNumber() == cardNumber) {
-            return account;
-        }
-    }
-    return nullptr;
-}
-
-Account* FindAccountByNumber(const std::vector<Account*>& accounts, const std::string& accountNumber) {
-    for (std::size_t i = 0; i < accounts.size(); ++i) {
-        Account* account = accounts[i];
-        if (account != nullptr && account->getAccountNumber() == accountNumber) {
-            return account;
-        }
-    }
-    return nullptr;
-}
-
-long long PromptCheckAmounts(ATMLanguage lang, int& checkCount) {
-    long long total = 0;
-    checkCount = 0;
-    const int maxChecks = 30;
-    while (true) {
-        if (checkCount >= maxChecks) {
-            std::cout << T(lang,
-                           "Maximum of 30 checks reached.\n",
-                           "최대 30개의 수표만 가능합니다.\n");
-            break;
-        }
-        long long amount = PromptLongLong(
-            T(lang, "Enter check amount (0 to finish): ", "수표 금액을 입력하세요 (0 입력 시 종료): "),
-            0,
-            T(lang, "Invalid input. Try again.\n", "잘못된 입력입니다. 다시 시도하세요.\n"));
-        if (amount == 0) {
-            break;
-        }
-        if (amount < 100000) {
-            std::cout << T(lang,
-                           "Each check must be at least 100,000 KRW.\n",
-                           "각 수표는 최소 100,000원이어야 합니다.\n");
-            continue;
-        }
-        total += amount;
-        ++checkCount;
-    }
-    return total;
-}
-
-CashDrawer PromptCashDrawer(ATMLanguage lang, const std::string& label) {
-    CashDrawer drawer;
-    for (int i = 0; i < CASH_TYPE_COUNT; ++i) {
-        drawer.noteCounts[i] = 0;
-    }
-
-    std::cout << T(lang,
-                   "Enter bills for " + label + " (use non-negative integers).\n",
-                   label + "에 사용할 지폐 개수를 입력하세요 (음수가 아닌 정수).\n");
-    std::string err = T(lang, "Invalid input. Try again.\n", "잘못된 입력입니다. 다시 시도하세요.\n");
-    int count50k = PromptIntWithMax(
-        T(lang, "50,000 KRW bills: ", "50,000원 지폐 수: "), 0, 50, err);
-    int count10k = PromptIntWithMax(
-        T(lang, "10,000 KRW bills: ", "10,000원 지폐 수: "), 0, 50, err);
-    int count5k = PromptIntWithMax(
-        T(lang, "5,000 KRW bills: ", "5,000원 지폐 수: "), 0, 50, err);
-    int count1k = PromptIntWithMax(
-        T(lang, "1,000 KRW bills: ", "1,000원 지폐 수: "), 0, 50, err);
-
-    drawer.noteCounts[0] = count1k;
-    drawer.noteCounts[1] = count5k;
-    drawer.noteCounts[2] = count10k;
-    drawer.noteCounts[3] = count50k;
-    return drawer;
-}
-
-void PrintSnapshot(const std::vector<Bank*>& banks, const std::vector<ATM*>& atms, ATMLanguage lang = ATMLanguage_English) {
-    std::cout << "\n=== " << T(lang, "Snapshot", "스냅샷") << " ===\n";
-    std::vector<Account*> activeAccounts;
-    for (const ATM* atm : atms) {
-        if (atm == nullptr) {
-            continue;
-        }
-        if (atm->HasActiveSession() && atm->GetActiveMode() == ATMMode_Customer) {
-            const SessionState& state = atm->GetSessionState();
-            if (state.primaryAccount != nullptr) {
-                activeAccounts.push_back(state.primaryAccount);
-            }
-        }
-    }
-
-    std::cout << T(lang, "ATMs (remaining cash):", "ATM (잔여 현금):") << "\n";
-    for (const ATM* atm : atms) {
-        if (atm == nullptr) {
-            continue;
-        }
-        const Bank* primaryBank = atm->GetPrimaryBank();
-        std::string bankName = primaryBank ? primaryBank->getBankName() : "Unknown";
-        const CashDrawer& drawer = atm->GetCashInventory();
-        long long totalCash = drawer.TotalValue();
-
-        int count1k = drawer.noteCounts[0];
-        int count5k = drawer.noteCounts[1];
-        int count10k = drawer.noteCounts[2];
-        int count50k = drawer.noteCounts[3];
-
-        std::cout << bankName << " ATM [SN:" << atm->GetSerialNumber() << "] "
-                  << T(lang, "Remaining cash: ", "잔여 현금: ") << totalCash
-                  << T(lang, " | Left cash: ", " | 남은 지폐: ")
-                  << count1k << T(lang, " x 1,000 won, ", " x 1,000원, ")
-                  << count5k << T(lang, " x 5,000 won, ", " x 5,000원, ")
-                  << count10k << T(lang, " x 10,000 won, ", " x 10,000원, ")
-                  << count50k << T(lang, " x 50,000 won", " x 50,000원") << "\n";
-    }
-
-    std::cout << "\n" << T(lang, "Accounts (remaining balance):", "계좌 (잔액):") << "\n";
-    for (const Bank* bank : banks) {
-        if (bank == nullptr) {
-            continue;
-        }
-        for (Account* account : bank->getAccounts()) {
-            if (account == nullptr) {
-                continue;
-            }
-            bool isActive = false;
-            for (Account* active : activeAccounts) {
-                if (active == account) {
-                    isActive = true;
-                    break;
-                }
-            }
-            std::cout << T(lang, "Account", "계좌") << " ["
-                      << T(lang, "Bank", "은행") << ": " << bank->getBankName()
-                      << ", " << T(lang, "No.", "번호") << " " << account->getAccountNumber()
-                      << ", " << T(lang, "Owner", "소유자") << ": " << account->getOwnerName()
-                      << "] " << T(lang, "Balance", "잔액") << " : " << account->getBalance();
-            if (isActive) {
-                std::cout << T(lang, " (in use)", " (사용 중)");
-            }
-            std::cout << "\n";
-        }
-    }
-
-    std::cout << "================\n";
-}
-
-CashDrawer PromptFeeCash(ATMLanguage lang, long long fee) {
-    CashDrawer drawer;
-    for (int i = 0; i < CASH_TYPE_COUNT; ++i) {
-        drawer.noteCounts[i] = 0;
-    }
-
-    std::cout << T(lang,
-                   "Enter bills for fee (this cash will not be added to your account; it pays the fee).\n",
-                   "수수료 지폐 개수를 입력하세요 (이 현금은 계좌에 추가되지 않고 수수료로 사용됩니다).\n");
-    std::cout << T(lang, "Exact fee amount: ", "정확한 수수료 금액: ") << fee << "\n";
-
-    std::string err = T(lang, "Invalid input. Try again.\n", "잘못된 입력입니다. 다시 시도하세요.\n");
-    int count50k = PromptInt(T(lang, "50,000 KRW bills: ", "50,000원 지폐 수: "), 0, err);
-    int count10k = PromptInt(T(lang, "10,000 KRW bills: ", "10,000원 지폐 수: "), 0, err);
-    int count5k = PromptInt(T(lang, "5,000 KRW bills: ", "5,000원 지폐 수: "), 0, err);
-    int count1k = PromptInt(T(lang, "1,000 KRW bills: ", "1,000원 지폐 수: "), 0, err);
-
-    drawer.noteCounts[0] = count1k;
-    drawer.noteCounts[1] = count5k;
-    drawer.noteCounts[2] = count10k;
-    drawer.noteCounts[3] = count50k;
-    return drawer;
-}
-
-std::string LocalizedNoteForTransaction(ATMLanguage lang, const Transaction* t) {
-    if (t == nullptr) {
-        return "";
-    }
-    long long fee = t->getFee();
-
-    if (dynamic_cast<const DepositTransaction*>(t) != nullptr) {
-        if (fee > 0) {
-            return T(lang,
-                     "Deposit completed (fee " + std::to_string(fee) + " paid in cash and not added to balance)",
-                     "입금 완료 (수수료 " + std::to_string(fee) + "가 현금으로 지불되었으며 잔액에 추가되지 않음)");
-        }
-        return T(lang, "Deposit completed", "입금 완료");
-    }
-
-    if (dynamic_cast<const WithdrawalTransaction*>(t) != nullptr) {
-        if (fee > 0) {
-            return T(lang,
-                     "Withdrawal completed (fee deducted from account)",
-                     "출금 완료 (수수료가 계좌에서 차감됨)");
-        }
-        return T(lang, "Withdrawal completed", "출금 완료");
-    }
-
-    if (dynamic_cast<const AccountTransferTransaction*>(t) != nullptr) {
-        if (fee > 0) {
-            return T(lang,
-                     "Account transfer completed (fee deducted from source account)",
-                     "계좌 이체 완료 (수수료가 출금 계좌에서 차감됨)");
-        }
-        return T(lang, "Account transfer completed", "계좌 이체 완료");
-    }
-
-    if (dynamic_cast<const CashTransferTransaction*>(t) != nullptr) {
-        if (fee > 0) {
-            return T(lang,
-                     "Cash transfer completed (fee paid in cash and not deposited to the destination account)",
-                     "현금 이체 완료 (수수료가 현금으로 지불되었으며 입금 계좌에 추가되지 않음)");
-        }
-        return T(lang, "Cash transfer completed", "현금 이체 완료");
-    }
-
-    return t->getNote();
-}
-ATMLanguage SelectLanguageForAtm(ATM* atm) {
-    if (atm == nullptr) {
-        return ATMLanguage_English;
-    }
-    if (!atm->IsBilingual()) {
-        std::cout << "English only ATM. Proceeding in English.\n";
-        atm->SetLanguage(ATMLanguage_English);
-        return ATMLanguage_English;
-    }
-    while (true) {
-        std::cout << "\nSelect language / 언어를 선택하세요\n";
-        std::cout << "  [1] English\n";
-        std::cout << "  [2] 한국어\n";
-        std::string langErr = "Invalid input. Try again. / 잘못된 입력입니다. 다시 시도하세요.\n";
-        int choice = PromptIntWithMax("Choice / 선택: ", 1, 2, langErr);
-        if (choice == 1) {
-            atm->SetLanguage(ATMLanguage_English);
-            return ATMLanguage_English;
-        }
-        if (choice == 2) {
-            atm->SetLanguage(ATMLanguage_Korean);
-            return ATMLanguage_Korean;
-        }
-    }
-}
-
-void PrintTransactions(const std::vector<Transaction*>& transactions,
-                       std::ostream& out,
-                       ATMLanguage lang = ATMLanguage_English) {
-    out << "========================================\n";
-    out << T(lang, "        TRANSACTION HISTORY            ",
-             "              거래 내역                ")
-        << "\n";
-    out << "========================================\n";
-    if (transactions.empty()) {
-        out << "  " << T(lang, "No transactions recorded yet.", "기록된 거래가 없습니다.") << "\n";
-        out << "========================================\n";
-        return;
-    }
-    for (const Transaction* transaction : transactions) {
-        if (transaction == nullptr) {
-            continue;
-        }
-        out << "ID: " << transaction->getId() << "\n";
-        out << "  " << T(lang, "ATM", "ATM") << ": " << transaction->getAtmSerial() << "\n";
-        out << "  " << T(lang, "Card", "카드") << ": " << transaction->getCardNumber() << "\n";
-        out << "  " << T(lang, "Type", "유형") << ": " << transaction->getTypeName() << "\n";
-        out << "  " << T(lang, "Amount", "금액") << ": " << transaction->getAmount() << "\n";
-        out << "  " << T(lang, "Fee", "수수료") << ": " << transaction->getFee() << "\n";
-        out << "  " << T(lang, "From", "출금 계좌") << ": " << transaction->getSourceBankName()
-            << " / " << transaction->getSourceAccountNumber() << "\n";
-        if (const AccountTransferTransaction* at =
-                dynamic_cast<const AccountTransferTransaction*>(transaction)) {
-            out << "  " << T(lang, "To", "입금 계좌") << ": " << at->getTargetBankName()
-                << " / " << at->getTargetAccountNumber() << "\n";
-        } else if (const CashTransferTransaction* ct =
-                       dynamic_cast<const CashTransferTransaction*>(transaction)) {
-            out << "  " << T(lang, "To", "입금 계좌") << ": " << ct->getTargetBankName()
-                << " / " << ct->getTargetAccountNumber() << "\n";
-        }
-        std::string localizedNote = LocalizedNoteForTransaction(lang, transaction);
-        if (!localizedNote.empty()) {
-            out << "  " << T(lang, "Note", "비고") << ": " << localizedNote << "\n";
-        }
-        out << "----------------------------------------\n";
-    }
-    out << "========================================\n";
-}
-
-bool LoadInitialData(const std::string& filename, SystemState& state) {
-    std::ifstream fin(filename);
-    if (!fin) {
-        std::cerr << "Error opening file: " << filename << "\n";
-        return false;
-    }
-
-    int bankCount = 0;
-    int accountCount = 0;
-    int atmCount = 0;
-    fin >> bankCount >> accountCount >> atmCount;
-
-    state.banks.reserve(bankCount);
-    state.accounts.reserve(accountCount);
-    state.cards.reserve(accountCount);
-    state.atms.reserve(atmCount);
-    state.transactions.reserve(32);
-
-    for (int i = 0; i < bankCount; ++i) {
-        std::string bankName;
-        fin >> bankName;
-        auto* bank = new Bank(bankName, bankName, &state.banks, &state.transactions);
-        state.banks.push_back(bank);
-    }
-
-    for (int i = 0; i < accountCount; ++i) {
-        std::string bankName;
-        std::string userName;
-        std::string accountNumber;
-        long long availableFunds = 0;
-        std::string cardNumber;
-        std::string password;
-        fin >> bankName >> userName >> accountNumber >> availableFunds >> cardNumber >> password;
-
-        Bank* bank = FindBank(state.banks, bankName);
-        if (bank == nullptr) {
-            std::cerr << "Bank " << bankName << " not found for account " << accountNumber << ".\n";
-            return false;
-        }
-        auto* card = new Card(cardNumber, bankName, CardRole::User);
-        auto* account = new Account(bank, userName, accountNumber, availableFunds, card, password);
-
-        state.cards.push_back(card);
-        state.accounts.push_back(account);
-        bank->addAccount(account);
-    }
-
-    for (int i = 0; i < atmCount; ++i) {
-        std::string primaryBankName;
-        std::string serial;
-        std::string accessModeStr;
-        std::string languageStr;
-        fin >> primaryBankName >> serial >> accessModeStr >> languageStr;
-
-        Bank* primaryBank = FindBank(state.banks, primaryBankName);
-        if (primaryBank == nullptr) {
-            std::cerr << "Primary bank " << primaryBankName << " not found for ATM " << serial << ".\n";
-            return false;
-        }
-
-        ATMBankAccess accessMode =
-            (accessModeStr == "Single") ? ATMBankAccess_SingleBank : ATMBankAccess_MultiBank;
-        bool bilingual = (languageStr == "Bilingual");
-
-        auto* atm = new ATM(serial, primaryBank, accessMode, bilingual);
-
-        int count50k = 0;
-        int count10k = 0;
-        int count5k = 0;
-        int count1k = 0;
-        fin >> count50k >> count10k >> count5k >> count1k;
-        CashDrawer drawer;
-        drawer.noteCounts[0] = count1k;
-        drawer.noteCounts[1] = count5k;
-        drawer.noteCounts[2] = count10k;
-        drawer.noteCounts[3] = count50k;
-        atm->LoadCash(drawer);
-
-        if (accessMode == ATMBankAccess_MultiBank) {
-            for (Bank* bank : state.banks) {
-                atm->AddAcceptedBank(bank);
-            }
-        }
-
-        state.atms.push_back(atm);
-    }
-
-    return true;
-}
-
 void ConfigureAdminCards(SystemState& state) {
     std::cout << "\n=== Admin Card Setup ===\n";
     std::vector<std::string> usedAdminCardNumbers;
@@ -515,13 +83,8 @@ void ConfigureAdminCards(SystemState& state) {
                     break;
                 }
             }
-            if (!conflict) {
-                for (Card* card : state.cards) {
-                    if (card != nullptr && card->getNumber() == adminCardNumber) {
-                        conflict = true;
-                        break;
-                    }
-                }
+            if (!conflict && FindAccountByCard(state.banks, adminCardNumber) != nullptr) {
+                conflict = true;
             }
 
             if (!conflict) {
@@ -537,218 +100,42 @@ void ConfigureAdminCards(SystemState& state) {
     std::cout << "========================\n";
 }
 
-void RunAdminMenu(ATM* atm,
-                  const std::vector<Bank*>& banks,
-                  const std::vector<ATM*>& atms,
-                  ATMLanguage lang) {
-    const std::vector<Transaction*>& transactions = atm->GetTransactions();
-    int totalSessions = atm->GetTotalSessions();
-    int customerSessions = atm->GetCustomerSessions();
-    int adminSessions = atm->GetAdminSessions();
+bool PromptAtmIndex(int atmCount, int& index) {
     while (true) {
-        std::cout << "\n========================================\n";
-        std::cout << "              ADMIN MENU                \n";
-        std::cout << "========================================\n";
-        std::cout << "  [1] " << T(lang, "Print all transactions", "모든 거래 출력") << "\n";
-        std::cout << "  [2] " << T(lang, "Export transactions to file", "거래 내역 파일로 저장") << "\n";
-        std::cout << "  [/] " << T(lang, "Snapshot", "스냅샷") << "\n";
-        std::cout << "  [0] " << T(lang, "Exit admin menu", "관리자 메뉴 종료") << "\n";
-        std::cout << "========================================\n";
-        std::string choiceInput = PromptString(T(lang, "Select an option: ", "옵션을 선택하세요: "));
-        if (choiceInput == "/") {
-            PrintSnapshot(banks, atms, lang);
-            continue;
-        }
-        int choice = 0;
-        {
-            bool parsed = false;
-            if (!choiceInput.empty()) {
-                bool isNumber = true;
-                for (std::size_t i = 0; i < choiceInput.size(); ++i) {
-                    if (choiceInput[i] < '0' || choiceInput[i] > '9') {
-                        isNumber = false;
-                        break;
-                    }
-                }
-                if (isNumber) {
-                    choice = static_cast<int>(std::stoi(choiceInput));
-                    parsed = true;
-                }
-            }
-            if (!parsed) {
-                std::cout << T(lang, "Invalid input. Try again.\n", "잘못된 입력입니다. 다시 시도하세요.\n");
-                continue;
-            }
-        }
-
-        if (choice == 0) {
-            break;
+        std::cout << "Select ATM index: ";
+        if (std::cin >> index && index >= 0 && index < atmCount) {
+            return true;
         }
-
-        switch (choice) {
-        case 1:
-            std::cout << T(lang, "This ATM sessions: ", "이 ATM 세션 수: ")
-                      << totalSessions
-                      << T(lang, " (customer ", " (고객 ")
-                      << customerSessions
-                      << T(lang, ", admin ", ", 관리자 ")
-                      << adminSessions << ")\n";
-            PrintTransactions(transactions, std::cout, lang);
-            break;
-        case 2: {
-            std::string filename = PromptString(T(lang, "Enter output filename: ", "출력할 파일 이름을 입력하세요: "));
-            std::ofstream fout(filename);
-            if (!fout) {
-                std::cout << T(lang, "Failed to open file.\n", "파일을 열 수 없습니다.\n");
-                break;
-            }
-            fout << T(lang, "This ATM sessions: ", "이 ATM 세션 수: ")
-                 << totalSessions
-                 << T(lang, " (customer ", " (고객 ")
-                 << customerSessions
-                 << T(lang, ", admin ", ", 관리자 ")
-                 << adminSessions << ")\n";
-            PrintTransactions(transactions, fout, lang);
-            std::cout << T(lang, "Transactions exported to ", "거래 내역을 파일로 저장했습니다: ") << filename << "\n";
-            break;
-        }
-        default:
-            std::cout << T(lang, "Unknown choice.\n", "알 수 없는 선택입니다.\n");
-            break;
+        if (std::cin.eof()) {
+            return false;
         }
+        std::cout << "Invalid ATM selection.\n";
+        ClearInputLine();
     }
 }
 
-void RunAtmMenu(ATM* atm,
-                const std::vector<Account*>& accounts,
-                const std::vector<Bank*>& banks,
-                const std::vector<ATM*>& atms) {
-    if (atm == nullptr) {
-        return;
-    }
-
-    while (true) {
-        ATMLanguage lang = atm->GetActiveLanguage();
-        std::cout << "\n========================================\n";
-        std::cout << T(lang, "          ATM MENU - Serial ", "          ATM 메뉴 - 일련번호 ") << atm->GetSerialNumber() << "         \n";
-        std::cout << "========================================\n";
-        std::cout << "  [1] " << T(lang, "Deposit", "입금") << "\n";
-        std::cout << "  [2] " << T(lang, "Withdraw", "출금") << "\n";
-        std::cout << "  [3] " << T(lang, "Account transfer", "계좌 이체") << "\n";
-        std::cout << "  [4] " << T(lang, "Cash transfer", "현금 이체") << "\n";
-        std::cout << "  [5] " << T(lang, "Print receipt", "영수증 출력") << "\n";
-        std::cout << "  [/] " << T(lang, "Snapshot", "스냅샷") << "\n";
-        std::cout << "  [0] " << T(lang, "End session", "세션 종료") << "\n";
-        std::cout << "========================================\n";
-
-        std::string choiceInput = PromptString(T(lang, "Select an option: ", "옵션을 선택하세요: "));
-        if (choiceInput == "/") {
-            PrintSnapshot(banks, atms, lang);
-            continue;
-        }
-
-        bool parsed = true;
-        if (choiceInput.empty()) {
-            parsed = false;
-        } else {
-            for (char c : choiceInput) {
-                if (c < '0' || c > '9') {
-                    parsed = false;
-                    break;
-                }
-            }
-        }
-        if (!parsed) {
-            std::cout << T(lang, "Invalid input. Try again.\n", "잘못된 입력입니다. 다시 시도하세요.\n");
-            continue;
-        }
-        int choice = std::stoi(choiceInput);
-        if (choice < 0 || choice > 5) {
-            std::cout << T(lang, "Invalid input. Try again.\n", "잘못된 입력입니다. 다시 시도하세요.\n");
-            continue;
-        }
-
-        if (choice == 0) {
-            atm->PrintReceipt(std::cout);
-            std::cout << T(lang, "Session ended.\n", "세션이 종료되었습니다.\n");
-            atm->EndSession();
-            break;
-        }
-
-        switch (choice) {
-        case 1: {
-            CashDrawer cash = PromptCashDrawer(lang, T(lang, "deposit", "입금"));
-            int checkCount = 0;
-            long long checkAmount = PromptCheckAmounts(lang, checkCount);
-            long long baseDepositAmount = cash.TotalValue() + checkAmount;
-            if (baseDepositAmount <= 0) {
-                std::cout << T(lang,
-                               "Deposit amount must be positive.\n",
-                               "입금 금액은 0보다 커야 합니다.\n");
-                break;
-            }
-            long long depositFee = atm->GetDepositFeeForCurrentSession();
-            CashDrawer feeCash;
-            if (depositFee == 0) {
-                std::cout << T(lang,
-                               "No cash fee is required for this deposit.\n",
-                               "이 입금에는 현금 수수료가 필요하지 않습니다.\n");
-                feeCash = CashDrawer();
-            } else {
-                feeCash = PromptFeeCash(lang, depositFee);
-            }
-            atm->RequestDeposit(cash, checkAmount, feeCash, checkCount);
-            break;
-        }
-        case 2: {
-            long long amount = PromptLongLong(
-                T(lang, "Enter withdrawal amount: ", "출금 금액을 입력하세요: "),
-                0,
-                T(lang, "Invalid input. Try again.\n", "잘못된 입력입니다. 다시 시도하세요.\n"));
-            atm->RequestWithdrawal(amount);
-            break;
-        }
-        case 3: {
-            std::string targetAccount = PromptString(T(lang, "Enter destination account number: ", "상대 계좌 번호를 입력하세요: "));
-            Account* destination = FindAccountByNumber(accounts, targetAccount);
-            if (destination == nullptr) {
-                std::cout << T(lang, "Account not found.\n", "계좌를 찾을 수 없습니다.\n");
-                break;
-            }
-            long long amount = PromptLongLong(
-                T(lang, "Enter transfer amount: ", "이체 금액을 입력하세요: "),
-                1,
-                T(lang, "Invalid input. Try again.\n", "잘못된 입력입니다. 다시 시도하세요.\n"));
-            atm->RequestAccountTransfer(destination, amount);
-            break;
-        }
-        case 4: {
-            std::string targetAccount = PromptString(T(lang, "Enter destination account number: ", "상대 계좌 번호를 입력하세요: "));
-            Account* destination = FindAccountByNumber(accounts, targetAccount);
-            if (destination == nullptr) {
-                std::cout << T(lang, "Account not found.\n", "계좌를 찾을 수 없습니다.\n");
-                break;
+// Drives one visit to an ATM from the console. Returns false if input ran
+// out before the visit finished.
+bool RunSession(SessionContext& context, ATM* atm) {
+    AtmSession session(&context, atm);
+    session.Begin(std::cout);
+    std::string token;
+    while (session.IsActive()) {
+        if (!(std::cin >> token)) {
+            if (atm->HasActiveSession()) {
+                atm->EndSession();
             }
-            CashDrawer cash = PromptCashDrawer(lang, T(lang, "cash transfer", "현금 이체"));
-            atm->RequestCashTransfer(destination, cash);
-            break;
-        }
-        case 5:
-            atm->PrintReceipt(std::cout);
-            break;
-        default:
-            std::cout << T(lang, "Unknown option.\n", "알 수 없는 선택입니다.\n");
-            break;
+            return false;
         }
-
-        if (!atm->HasActiveSession()) {
-            std::cout << T(lang, "Session ended due to an error.\n", "오류로 인해 세션이 종료되었습니다.\n");
-            break;
+        if (session.Feed(token, std::cout) == SessionInput_Rejected) {
+            ClearInputLine();
         }
     }
+    return true;
 }
 
-void RunConsole(SystemState& state) {
+void RunConsole(SystemState& state, TraceWriter* trace) {
+    SessionContext context(&state, trace);
     if (state.atms.empty()) {
         std::cout << "No ATMs are configured. Exiting.\n";
         return;
@@ -757,9 +144,12 @@ void RunConsole(SystemState& state) {
     while (true) {
         PrintMainMenu();
         std::string choiceInput = PromptString("Select an option: ");
+        if (!std::cin) {
+            break;
+        }
 
         if (choiceInput == "/") {
-            PrintSnapshot(state.banks, state.atms);
+            state.snapshot.Print(state.banks, state.atms, ATMLanguage_English, std::cout);
             continue;
         }
         bool parsed = true;
@@ -788,7 +178,7 @@ void RunConsole(SystemState& state) {
             break;
         }
         if (choice == 2) {
-            PrintSnapshot(state.banks, state.atms);
+            state.snapshot.Print(state.banks, state.atms, ATMLanguage_English, std::cout);
             continue;
         }
 
@@ -800,157 +190,460 @@ void RunConsole(SystemState& state) {
                       << (atm->GetPrimaryBank() ? atm->GetPrimaryBank()->getBankName() : "Unknown")
                       << ")\n";
         }
-        int atmIndex = PromptIntWithMax("Select ATM index: ", 0,
-                                        static_cast<int>(state.atms.size()) - 1,
-                                        "Invalid ATM selection.\n");
-
-        ATM* atm = state.atms[atmIndex];
-        ATMLanguage langChoice = SelectLanguageForAtm(atm);
-        std::cout << T(langChoice, "1) Customer session\n", "1) 고객 세션\n");
-        std::cout << T(langChoice, "2) Admin transaction history\n", "2) 관리자 거래 내역\n");
-        std::cout << T(langChoice, "0) Cancel\n", "0) 취소\n");
-        int sessionChoice = PromptIntWithMax(
-            T(langChoice, "Select session type: ", "세션 유형을 선택하세요: "),
-            0,
-            2,
-            T(langChoice, "Invalid input. Try again.\n", "잘못된 입력입니다. 다시 시도하세요.\n"));
-        if (sessionChoice == 0) {
-            continue;
+        int atmIndex = 0;
+        if (!PromptAtmIndex(static_cast<int>(state.atms.size()), atmIndex)) {
+            break;
         }
 
-        if (sessionChoice == 2) {
-            Bank* primaryBank = atm->GetPrimaryBank();
-            if (primaryBank == nullptr) {
-                std::cout << "This ATM does not have a primary bank configured.\n";
-                continue;
-            }
+        if (!RunSession(context, state.atms[atmIndex])) {
+            break;
+        }
+    }
+}
 
-            atm->StartAdminSession(nullptr);
-            bool authenticated = false;
-            int attempts = 0;
-            while (attempts < 3 && !authenticated) {
-                std::string adminCardNumber = PromptString(T(langChoice, "Enter admin card number: ", "관리자 카드 번호를 입력하세요: "));
-                std::string adminPassword = PromptString(T(langChoice, "Enter admin password: ", "관리자 비밀번호를 입력하세요: "));
-                if (primaryBank->verifyAdminCredentials(adminCardNumber, adminPassword)) {
-                    authenticated = true;
-                    break;
-                }
-                std::cout << T(langChoice, "Wrong admin credentials.\n", "관리자 정보가 올바르지 않습니다.\n");
-                ++attempts;
-            }
+// A segmented ledger's transactions, one batch at a time.
+bool ExportLedgerToFile(const std::string& filename,
+                        const TransactionLedger& ledger,
+                        ExportFormat format,
+                        long long afterId,
+                        ExportResult& result) {
+    std::ofstream fout(filename, std::ios::binary | (afterId > 0 ? std::ios::app : std::ios::trunc));
+    if (!fout) {
+        std::cerr << "Error opening file: " << filename << "\n";
+        return false;
+    }
+    result = ExportResult();
+    result.lastId = afterId;
+    bool continued = false;
+    ledger.ForEachBatch([&](const std::vector<Transaction*>& batch) {
+        ExportResult part = ExportTransactions(batch, format, afterId, fout, continued);
+        result.records += part.records;
+        result.bytes += part.bytes;
+        result.lastId = std::max(result.lastId, part.lastId);
+        continued = true;
+    });
+    fout.flush();
+    return static_cast<bool>(fout);
+}
 
-            if (!authenticated) {
-                std::cout << T(langChoice, "Admin authentication failed. Returning to main menu.\n",
-                               "관리자 인증에 실패했습니다. 메인 메뉴로 돌아갑니다.\n");
-                atm->EndSession();
-                continue;
-            }
+// Writes the transaction log to filename, resuming after afterId when it is
+// not 0, and reports the ID to resume from.
+bool ExportTransactionsByName(const std::string& filename, const SystemState& state, long long afterId) {
+    ExportFormat format;
+    if (!ExportFormatForFile(filename, format)) {
+        std::cerr << "Export file must end in .csv, .ndjson or .bin: " << filename << "\n";
+        return false;
+    }
+    ExportResult result;
+    bool written = state.ledger.HasSegments()
+                       ? ExportLedgerToFile(filename, state.ledger, format, afterId, result)
+                       : ExportTransactionsToFile(filename, state.transactions, format, afterId, result);
+    if (!written) {
+        return false;
+    }
+    std::cerr << "Exported " << result.records << " transactions (" << result.bytes << " bytes) to "
+              << filename << "; last ID " << result.lastId << ".\n";
+    return true;
+}
 
-            ++state.totalSessions;
-            ++state.adminSessions;
-            atm->IncrementAdminSession();
-            RunAdminMenu(atm, state.banks, state.atms, atm->GetActiveLanguage());
-            atm->EndSession();
+// "root" closes the open transactions into a block and prints the root; an
+// ID proves that transaction, and "from=T,to=T" (Unix seconds, either may
+// be left out) proves everything in the range. Proofs are checked before
+// they are printed. "verify" re-hashes every closed block.
+void RunAudit(const std::string& request, TransactionLedger& ledger) {
+    if (request == "root") {
+        ledger.CloseBlock();
+        PrintAuditRoot(ledger.BlockCount(), ledger.AuditRoot(), std::cout);
+        return;
+    }
+    Sha256Digest root;
+    AuditStatus status;
+    if (request == "verify") {
+        const std::size_t blocks = ledger.BlockCount();
+        status = AuditStatus_Proved;
+        for (std::size_t number = 0; number < blocks && status == AuditStatus_Proved; ++number) {
+            status = ledger.VerifyBlock(number);
+        }
+        if (status == AuditStatus_Proved) {
+            PrintBlocksVerified(blocks, std::cout);
+            return;
+        }
+    } else if (request.find('=') == std::string::npos) {
+        char* end = nullptr;
+        long long id = std::strtoll(request.c_str(), &end, 10);
+        if (end == request.c_str() || *end != '\0' || id <= 0) {
+            std::cerr << "Invalid audit request: " << request << "\n";
+            return;
+        }
+        TransactionProof proof;
+        Transaction* transaction = nullptr;
+        LoadedTransactions loaded;
+        status = ledger.ProveTransaction(id, proof, root, transaction, loaded);
+        if (status == AuditStatus_Proved) {
+            PrintTransactionProof(*transaction, proof, root, VerifyTransactionProof(*transaction, proof, root),
+                                  std::cout);
+            return;
+        }
+    } else {
+        TransactionQuery range;
+        if (!ParseTransactionQuery(request, range) || !range.cardNumber.empty() || !range.accountNumber.empty() ||
+            !range.bankName.empty() || !range.atmSerial.empty() || range.hasKind || range.hasMinAmount ||
+            range.hasMaxAmount || range.limit > 0) {
+            std::cerr << "Audit ranges take only from= and to=: " << request << "\n";
+            return;
+        }
+        TimeRangeProof proof;
+        status = ledger.ProveTimeRange(range.hasFrom ? range.fromMicros : LLONG_MIN,
+                                       range.hasTo ? range.toMicros : LLONG_MAX, proof, root);
+        if (status == AuditStatus_Proved) {
+            std::vector<const Transaction*> inRange;
+            bool verified = VerifyTimeRangeProof(proof, root, inRange);
+            PrintTimeRangeProof(inRange, proof, root, verified, std::cout);
+            return;
+        }
+    }
+    if (status == AuditStatus_NotFound) {
+        std::cerr << "No such transaction: " << request << "\n";
+    } else if (status == AuditStatus_Open) {
+        std::cerr << "Transaction " << request << " is not in a closed block yet; \"!audit root\" closes it.\n";
+    } else if (status == AuditStatus_Tampered) {
+        std::cerr << "Audit failed: a ledger block no longer matches its root.\n";
+    } else {
+        std::cerr << "Audit failed: a segment could not be read.\n";
+    }
+}
+
+// Checks every balance and cash drawer against the ledger on executor, or
+// on one worker per hardware thread when there is none.
+void RunReconcile(const SystemState& state, Executor* executor) {
+    std::unique_ptr<Executor> pool;
+    if (executor == nullptr) {
+        pool.reset(new Executor());
+        executor = pool.get();
+    }
+    PrintReconciliation(ReconcileLedger(state.ledger, state.accounts, state.atms, executor), std::cout);
+}
+
+// Reads "<atm serial> <token>" events, one per line, and hands each to that
+// terminal's session. With one worker, output of all terminals goes to stdout
+// in event order. With more, each event runs on its ATM's strand: a terminal's
+// output stays in order and is written whole, but terminals interleave.
+// A "!fees <file>" line reloads fees without pausing the strands, and a
+// "!settle <file>" line closes the settlement cycle into that file; with
+// several workers, events read just before either may land on either side.
+// A "!export <file> [after id]" line waits for queued events, then streams
+// the transaction log (format from the file extension) to the file, and a
+// "!query <search>" line waits likewise and prints the matching transactions.
+// "!history <account> [cursor]" prints one page of an account's history,
+// "!audit <root | verify | id | from=T,to=T>" waits too, then proves the request
+// against the ledger's audit root (see RunAudit), and "!reconcile" waits
+// and checks every balance and drawer against the ledger.
+void RunHeadless(SystemState& state, TraceWriter* trace, std::size_t workers) {
+    SessionContext context(&state, trace);
+    SessionMultiplexer sessions(&context);
+    std::unique_ptr<Executor> executor;
+    std::unique_ptr<AtmStrands> strands;
+    if (workers != 1) {
+        executor.reset(new Executor(workers));
+        strands.reset(new AtmStrands(executor.get()));
+    }
+    std::mutex outputMutex;
+
+    long long events = 0;
+    std::string line;
+    while (std::getline(std::cin, line)) {
+        std::istringstream fields(line);
+        std::string serial;
+        std::string token;
+        if (!(fields >> serial)) {
             continue;
         }
-
-        std::string cardNumber = PromptString(T(langChoice, "Enter card number (or type /cancel): ",
-                                                            "카드 번호를 입력하세요 (/cancel 입력 시 취소): "));
-        if (cardNumber == "/cancel") {
+        if (serial == "!reconcile") {
+            if (executor) {
+                executor->Wait();
+            }
+            RunReconcile(state, executor.get());
             continue;
         }
-
-        Account* initialAccount = FindAccountByCard(state.accounts, cardNumber);
-        if (initialAccount == nullptr) {
-            std::cout << T(langChoice, "Card not recognized.\n", "인식되지 않는 카드입니다.\n");
-            atm->StartCustomerSession(nullptr, nullptr, false);
+        if (!(fields >> token)) {
             continue;
         }
-        Bank* bank = initialAccount->getBank();
-        if (bank == nullptr) {
-            atm->StartCustomerSession(initialAccount->getLinkedCard(), initialAccount, false);
-            std::cout << T(langChoice, "Account is not associated with a bank.\n", "계좌가 은행과 연결되어 있지 않습니다.\n");
-            atm->EndSession();
+        if (serial == "!fees") {
+            if (trace != nullptr) {
+                std::cerr << "Fee reloads are not recorded; ignoring " << token << ".\n";
+            } else if (ReloadFees(token, state)) {
+                std::cerr << "Fees reloaded from " << token << ".\n";
+            }
             continue;
         }
-
-        if (!atm->SupportsBank(bank)) {
-            atm->StartCustomerSession(initialAccount->getLinkedCard(), initialAccount, false);
-            std::cout << T(langChoice, "This ATM does not support the selected bank/card.\n",
-                           "이 ATM은 선택한 은행/카드를 지원하지 않습니다.\n");
-            atm->EndSession();
+        if (serial == "!settle") {
+            SettlementBatch batch = state.settlement.CloseCycle();
+            if (WriteSettlementFile(token, batch)) {
+                std::cerr << "Settlement cycle " << batch.cycle << " written to " << token << ".\n";
+            }
             continue;
         }
-
-        bool isPrimary = (atm->GetPrimaryBank() == bank);
-        atm->StartCustomerSession(initialAccount->getLinkedCard(), initialAccount, isPrimary);
-        if (!atm->HasActiveSession()) {
+        if (serial == "!export") {
+            long long afterId = 0;
+            fields >> afterId;
+            if (executor) {
+                executor->Wait();
+            }
+            ExportTransactionsByName(token, state, afterId);
             continue;
         }
-
-        Account* verifiedAccount = nullptr;
-        int attempts = 0;
-        while (attempts < 3 && verifiedAccount == nullptr) {
-            std::string password = PromptString(T(langChoice, "Enter PIN/password: ", "PIN/비밀번호를 입력하세요: "));
-            Account* tempAccount = nullptr;
-            if (bank->verifyUserCredentials(cardNumber, password, tempAccount)) {
-                verifiedAccount = tempAccount;
-                break;
+        if (serial == "!query") {
+            TransactionQuery query;
+            if (!ParseTransactionQuery(token, query)) {
+                std::cerr << "Invalid query: " << token << "\n";
+                continue;
+            }
+            if (executor) {
+                executor->Wait();
             }
-            std::cout << T(langChoice, "Wrong password.\n", "비밀번호가 올바르지 않습니다.\n");
-            ++attempts;
+            std::vector<Transaction*> found;
+            LoadedTransactions loaded;
+            state.ledger.Find(query, found, loaded);
+            PrintQueryResults(found, std::cout);
+            continue;
         }
-
-        if (verifiedAccount == nullptr) {
-            std::cout << T(langChoice, "Too many wrong password attempts. Session aborted.\n",
-                           "비밀번호 오류가 많아 세션을 종료합니다.\n");
-            atm->EndSession();
+        if (serial == "!history") {
+            long long cursor = 0;
+            fields >> cursor;
+            Account* account = FindAccountByNumber(state.banks, token);
+            if (account == nullptr) {
+                std::cerr << "Unknown account: " << token << "\n";
+                continue;
+            }
+            if (executor) {
+                executor->Wait();
+            }
+            PrintHistoryPage(account->getHistory(cursor, HEADLESS_HISTORY_PAGE, &state.ledger), std::cout);
             continue;
         }
-
-        atm->IncrementCustomerSession();
-        RunAtmMenu(atm, state.accounts, state.banks, state.atms);
+        if (serial == "!audit") {
+            if (executor) {
+                executor->Wait();
+            }
+            RunAudit(token, state.ledger);
+            continue;
+        }
+        AtmSession* session = sessions.FindOrCreate(serial);
+        if (session == nullptr) {
+            std::cerr << "Unknown ATM serial: " << serial << "\n";
+            continue;
+        }
+        ++events;
+        if (!strands) {
+            session->Accept(token, std::cout);
+            continue;
+        }
+        strands->Post(session->GetAtm(), [session, token, &outputMutex] {
+            std::ostringstream out;
+            session->Accept(token, out);
+            std::lock_guard<std::mutex> lock(outputMutex);
+            std::cout << out.str();
+        });
+    }
+    if (executor) {
+        executor->Wait();
     }
+    std::cout << "Processed " << events << " events on " << sessions.SessionCount()
+              << " terminals (" << sessions.ActiveSessions() << " sessions still open).\n";
+}
+
 }
 
-void Cleanup(SystemState& state) {
-    for (Transaction* transaction : state.transactions) {
-        delete transaction;
+int main(int argc, char** argv) {
+    std::string dataPath = "initial_condition.txt";
+    std::string recordPath;
+    std::string replayPath;
+    bool headless = false;
+    std::size_t workers = 1;
+    std::string dispense = "fewest";
+    bool replenish = false;
+    bool reconcile = false;
+    std::string snapshotQuery;
+    bool snapshotOnly = false;
+    std::string feesPath;
+    std::string feeTableSerial;
+    std::string settlePath;
+    std::string receiptsPath;
+    std::string exportPath;
+    std::string segmentsPath;
+    std::size_t segmentRecords = SEGMENT_RECORDS;
+    SegmentFormat segmentFormat = SegmentFormat_Raw;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--data" && i + 1 < argc) {
+            dataPath = argv[++i];
+        } else if (arg == "--record" && i + 1 < argc) {
+            recordPath = argv[++i];
+        } else if (arg == "--replay" && i + 1 < argc) {
+            replayPath = argv[++i];
+        } else if (arg == "--headless") {
+            headless = true;
+        } else if (arg == "--dispense" && i + 1 < argc &&
+                   (std::string(argv[i + 1]) == "fewest" || std::string(argv[i + 1]) == "balanced")) {
+            dispense = argv[++i];
+        } else if (arg == "--snapshot" && i + 1 < argc) {
+            snapshotQuery = argv[++i];
+            snapshotOnly = true;
+        } else if (arg == "--fees" && i + 1 < argc) {
+            feesPath = argv[++i];
+        } else if (arg == "--fee-table" && i + 1 < argc) {
+            feeTableSerial = argv[++i];
+        } else if (arg == "--settle" && i + 1 < argc) {
+            settlePath = argv[++i];
+        } else if (arg == "--receipts" && i + 1 < argc) {
+            receiptsPath = argv[++i];
+        } else if (arg == "--export" && i + 1 < argc) {
+            exportPath = argv[++i];
+        } else if (arg == "--segments" && i + 1 < argc) {
+            segmentsPath = argv[++i];
+        } else if (arg == "--segment-records" && i + 1 < argc && std::atoi(argv[i + 1]) > 0) {
+            segmentRecords = static_cast<std::size_t>(std::atoi(argv[++i]));
+        } else if (arg == "--segment-format" && i + 1 < argc && ParseSegmentFormat(argv[i + 1], segmentFormat)) {
+            ++i;
+        } else if (arg == "--replenish") {
+            replenish = true;
+        } else if (arg == "--reconcile") {
+            reconcile = true;
+        } else if (arg == "--threads" && i + 1 < argc) {
+            workers = static_cast<std::size_t>(std::atoi(argv[++i]));
+        } else {
+            std::cerr << "Usage: " << argv[0]
+                      << " [--data initial_condition.txt] [--record trace.bin | --replay trace.bin] [--headless [--threads N]] [--dispense fewest|balanced] [--fees fees.txt] [--fee-table SERIAL] [--settle settlement.txt] [--receipts receipts.txt] [--export transactions.csv|.ndjson|.bin] [--segments DIR [--segment-records N] [--segment-format raw|packed]] [--replenish] [--reconcile] [--snapshot bank=NAME,min=N,max=N,top=N,page=N,size=N]\n";
+            return 1;
+        }
     }
-    state.transactions.clear();
 
-    for (ATM* atm : state.atms) {
-        delete atm;
+    if (workers != 1 && (!headless || !recordPath.empty())) {
+        std::cerr << "--threads needs --headless and cannot be combined with --record.\n";
+        return 1;
+    }
+    if (!feesPath.empty() && (!recordPath.empty() || !replayPath.empty())) {
+        std::cerr << "--fees cannot be combined with --record or --replay; traces assume default fees.\n";
+        return 1;
+    }
+    if (!segmentsPath.empty() && (!recordPath.empty() || !replayPath.empty())) {
+        std::cerr << "--segments cannot be combined with --record or --replay; traces check every ATM's list.\n";
+        return 1;
     }
-    state.atms.clear();
 
-    for (Account* account : state.accounts) {
-        delete account;
+    ExportFormat exportFormat;
+    if (!exportPath.empty() && !ExportFormatForFile(exportPath, exportFormat)) {
+        std::cerr << "Export file must end in .csv, .ndjson or .bin: " << exportPath << "\n";
+        return 1;
     }
-    state.accounts.clear();
 
-    for (Card* card : state.cards) {
-        delete card;
+    SystemState state;
+    if (!LoadInitialData(dataPath, state)) {
+        return 1;
+    }
+    if (!segmentsPath.empty()) {
+        UseTransactionSegments(state, segmentsPath, segmentRecords, segmentFormat);
+    }
+    if (dispense == "balanced") {
+        for (ATM* atm : state.atms) {
+            atm->SetDispenseObjective(DispenseObjective_Balanced);
+        }
+    }
+    if (!feesPath.empty() && !ReloadFees(feesPath, state)) {
+        Cleanup(state);
+        return 1;
+    }
+    std::unique_ptr<FileReceiptSink> receipts;
+    if (!receiptsPath.empty()) {
+        receipts.reset(new FileReceiptSink(receiptsPath));
+        if (!receipts->IsOpen()) {
+            std::cerr << "Error opening file: " << receiptsPath << "\n";
+            Cleanup(state);
+            return 1;
+        }
+        for (ATM* atm : state.atms) {
+            atm->SetReceiptSink(receipts.get());
+        }
     }
-    state.cards.clear();
 
-    for (Bank* bank : state.banks) {
-        delete bank;
+    if (!feeTableSerial.empty()) {
+        bool found = false;
+        for (const ATM* atm : state.atms) {
+            if (atm->GetSerialNumber() == feeTableSerial) {
+                PrintFeeTable(*atm, state.banks, std::cout);
+                found = true;
+            }
+        }
+        if (!found) {
+            std::cerr << "Unknown ATM serial: " << feeTableSerial << "\n";
+        }
+        Cleanup(state);
+        return found ? 0 : 1;
     }
-    state.banks.clear();
-}
 
-}
+    if (snapshotOnly) {
+        SnapshotQuery query;
+        if (!ParseSnapshotQuery(snapshotQuery, query)) {
+            std::cerr << "Invalid snapshot query: " << snapshotQuery << "\n";
+            Cleanup(state);
+            return 1;
+        }
+        state.snapshot.Print(state.banks, state.atms, query, ATMLanguage_English, std::cout);
+        Cleanup(state);
+        return 0;
+    }
 
-int main() {
-    SystemState state;
-    if (!LoadInitialData("initial_condition.txt", state)) {
+    if (!replayPath.empty()) {
+        ReplayResult result;
+        bool ok = ReplayTrace(replayPath, state, result);
+        std::cout << "Replayed " << result.operations << " operations in " << result.sessions
+                  << " sessions in " << result.seconds << " s";
+        if (result.seconds > 0.0) {
+            std::cout << " (" << static_cast<long long>(result.operations / result.seconds) << " ops/s)";
+        }
+        std::cout << "\n";
+        if (!result.digestRecorded) {
+            std::cout << "Trace has no final digest; result not checked.\n";
+        } else {
+            std::cout << "State digest " << (result.digestMatched ? "matches" : "DIFFERS from") << " the recording.\n";
+        }
+        Cleanup(state);
+        if (!ok) {
+            return 1;
+        }
+        return (result.digestRecorded && !result.digestMatched) ? 2 : 0;
+    }
+
+    TraceWriter trace;
+    if (!recordPath.empty() && !trace.Open(recordPath)) {
+        std::cerr << "Error opening trace: " << recordPath << "\n";
+        Cleanup(state);
         return 1;
     }
-    PrintWelcomeBanner();
-    ConfigureAdminCards(state);
-    PrintSnapshot(state.banks, state.atms);
-    RunConsole(state);
+
+    if (headless) {
+        RunHeadless(state, trace.IsOpen() ? &trace : nullptr, workers);
+    } else {
+        PrintWelcomeBanner();
+        ConfigureAdminCards(state);
+        state.snapshot.Print(state.banks, state.atms, ATMLanguage_English, std::cout);
+        RunConsole(state, trace.IsOpen() ? &trace : nullptr);
+    }
+    if (!exportPath.empty()) {
+        ExportTransactionsByName(exportPath, state, 0);
+    }
+    if (!settlePath.empty()) {
+        WriteSettlementFile(settlePath, state.settlement.CloseCycle());
+    }
+    if (replenish) {
+        PrintReplenishmentPlan(PlanReplenishment(state.atms, ReplenishmentPolicy()), std::cout);
+    }
+    if (reconcile) {
+        RunReconcile(state, nullptr);
+    }
+    if (trace.IsOpen()) {
+        trace.Finish(ComputeStateDigest(state));
+    }
     Cleanup(state);
     return 0;
 }
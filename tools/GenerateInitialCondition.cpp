@@ -0,0 +1,410 @@
+// Generates synthetic initial-condition files for large-scale runs.
+//
+// Build from the repository root:
+//   g++ -std=c++14 -O2 tools/GenerateInitialCondition.cpp -o gen_initial_condition
+//
+// Usage:
+//   gen_initial_condition [--banks 8] [--accounts 1000] [--atms 10] [--out initial_condition_large.txt]
+//                         [--seed 1] [--balance-dist uniform|lognormal|pareto]
+//                         [--balance-min 0] [--balance-max 1000000]
+//                         [--balance-median 300000] [--balance-sigma 1.0] [--pareto-alpha 1.5]
+//                         [--multi-ratio 0.7] [--bilingual-ratio 0.5] [--max-bills 200]
+//                         [--usage-out usage.txt] [--usage-count 100000]
+//                         [--card-skew 1.1] [--atm-skew 0.8]
+//
+// The output follows the initial_condition.txt format read by LoadInitialData.
+// With --usage-out, a companion file lists "<atmSerial> <cardNumber>" pairs in
+// which both cards and ATMs are drawn from Zipf distributions, so a few heavy
+// users and busy ATMs account for most of the traffic.
+//
+// Standard large fixture: --accounts 10000000 --atms 10000.
+
+#include <algorithm>
+#include <cmath>
+#include <cstdarg>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace {
+
+enum BalanceDistribution {
+    BalanceDistribution_Uniform,
+    BalanceDistribution_LogNormal,
+    BalanceDistribution_Pareto
+};
+
+struct GeneratorOptions {
+    long long banks = 8;
+    long long accounts = 1000;
+    long long atms = 10;
+    std::string outPath = "initial_condition_large.txt";
+    unsigned long long seed = 1;
+    BalanceDistribution balanceDistribution = BalanceDistribution_LogNormal;
+    long long balanceMin = 0;
+    long long balanceMax = 1000000;
+    double balanceMedian = 300000.0;
+    double balanceSigma = 1.0;
+    double paretoAlpha = 1.5;
+    double multiRatio = 0.7;
+    double bilingualRatio = 0.5;
+    int maxBills = 200;
+    std::string usageOutPath;
+    long long usageCount = 100000;
+    double cardSkew = 1.1;
+    double atmSkew = 0.8;
+};
+
+// Buffered writer that formats into a large block and flushes with fwrite.
+class OutputBuffer {
+public:
+    explicit OutputBuffer(std::FILE* file) : file_(file), buffer_(1 << 20), used_(0) {}
+    ~OutputBuffer() { Flush(); }
+
+    void Append(const char* text, std::size_t length) {
+        if (used_ + length > buffer_.size()) {
+            Flush();
+        }
+        std::memcpy(buffer_.data() + used_, text, length);
+        used_ += length;
+    }
+
+    void Line(const char* format, ...);
+
+    void Flush() {
+        if (used_ > 0) {
+            std::fwrite(buffer_.data(), 1, used_, file_);
+            used_ = 0;
+        }
+    }
+
+private:
+    std::FILE* file_;
+    std::vector<char> buffer_;
+    std::size_t used_;
+};
+
+void OutputBuffer::Line(const char* format, ...) {
+    char line[256];
+    va_list args;
+    va_start(args, format);
+    int length = std::vsnprintf(line, sizeof(line), format, args);
+    va_end(args);
+    if (length > 0) {
+        Append(line, static_cast<std::size_t>(std::min(length, static_cast<int>(sizeof(line)) - 1)));
+    }
+}
+
+// Zipf sampler over ranks 1..n using rejection-inversion (Hormann and
+// Derflinger), so it needs no per-rank table even for millions of ranks.
+class ZipfSampler {
+public:
+    ZipfSampler(long long n, double exponent)
+        : n_(static_cast<double>(n)), s_(exponent) {
+        hIntegralX1_ = HIntegral(1.5) - 1.0;
+        hIntegralN_ = HIntegral(n_ + 0.5);
+        threshold_ = 2.0 - HIntegralInverse(HIntegral(2.5) - H(2.0));
+    }
+
+    template <typename Rng>
+    long long Sample(Rng& rng) {
+        if (s_ <= 0.0) {
+            std::uniform_int_distribution<long long> uniform(1, static_cast<long long>(n_));
+            return uniform(rng);
+        }
+        std::uniform_real_distribution<double> uniform(0.0, 1.0);
+        while (true) {
+            double u = hIntegralN_ + uniform(rng) * (hIntegralX1_ - hIntegralN_);
+            double x = HIntegralInverse(u);
+            double k = std::floor(x + 0.5);
+            if (k < 1.0) {
+                k = 1.0;
+            } else if (k > n_) {
+                k = n_;
+            }
+            if (k - x <= threshold_ || u >= HIntegral(k + 0.5) - H(k)) {
+                return static_cast<long long>(k);
+            }
+        }
+    }
+
+private:
+    double H(double x) const { return std::exp(-s_ * std::log(x)); }
+
+    double HIntegral(double x) const {
+        double logX = std::log(x);
+        return Helper2((1.0 - s_) * logX) * logX;
+    }
+
+    double HIntegralInverse(double x) const {
+        double t = x * (1.0 - s_);
+        if (t < -1.0) {
+            t = -1.0;
+        }
+        return std::exp(Helper1(t) * x);
+    }
+
+    // log1p(x) / x with a series expansion near zero.
+    static double Helper1(double x) {
+        if (std::fabs(x) > 1e-8) {
+            return std::log1p(x) / x;
+        }
+        return 1.0 - x * (0.5 - x * (1.0 / 3.0 - 0.25 * x));
+    }
+
+    // expm1(x) / x with a series expansion near zero.
+    static double Helper2(double x) {
+        if (std::fabs(x) > 1e-8) {
+            return std::expm1(x) / x;
+        }
+        return 1.0 + x * 0.5 * (1.0 + x * (1.0 / 3.0) * (1.0 + 0.25 * x));
+    }
+
+    double n_;
+    double s_;
+    double hIntegralX1_;
+    double hIntegralN_;
+    double threshold_;
+};
+
+// Maps Zipf ranks onto indexes so heavy users are spread over every bank
+// instead of clustering at the start of the file.
+class RankPermutation {
+public:
+    explicit RankPermutation(long long n) : n_(n), multiplier_(1) {
+        long long candidate = static_cast<long long>(static_cast<double>(n) * 0.618) | 1;
+        while (candidate > 1 && Gcd(candidate, n) != 1) {
+            candidate += 2;
+        }
+        multiplier_ = candidate % (n > 0 ? n : 1);
+        if (multiplier_ == 0) {
+            multiplier_ = 1;
+        }
+    }
+
+    long long Map(long long rank) const {
+        return static_cast<long long>((static_cast<unsigned long long>(rank - 1) *
+                                       static_cast<unsigned long long>(multiplier_)) %
+                                      static_cast<unsigned long long>(n_));
+    }
+
+private:
+    static long long Gcd(long long a, long long b) {
+        while (b != 0) {
+            long long t = a % b;
+            a = b;
+            b = t;
+        }
+        return a;
+    }
+
+    long long n_;
+    long long multiplier_;
+};
+
+void FormatCardNumber(long long index, char* buffer, std::size_t size) {
+    std::snprintf(buffer, size, "%04lld-%04lld-%04lld",
+                  1000 + (index / 100000000) % 9000, (index / 10000) % 10000, index % 10000);
+}
+
+long long SampleBalance(const GeneratorOptions& options, std::mt19937_64& rng) {
+    double value = 0.0;
+    switch (options.balanceDistribution) {
+    case BalanceDistribution_Uniform: {
+        std::uniform_real_distribution<double> uniform(static_cast<double>(options.balanceMin),
+                                                       static_cast<double>(options.balanceMax));
+        value = uniform(rng);
+        break;
+    }
+    case BalanceDistribution_LogNormal: {
+        std::lognormal_distribution<double> logNormal(std::log(options.balanceMedian), options.balanceSigma);
+        value = logNormal(rng);
+        break;
+    }
+    case BalanceDistribution_Pareto: {
+        std::uniform_real_distribution<double> uniform(0.0, 1.0);
+        double scale = options.balanceMin > 0 ? static_cast<double>(options.balanceMin) : 10000.0;
+        value = scale / std::pow(1.0 - uniform(rng), 1.0 / options.paretoAlpha);
+        break;
+    }
+    }
+    long long balance = static_cast<long long>(value / 1000.0) * 1000;
+    if (balance < options.balanceMin) {
+        balance = options.balanceMin;
+    }
+    if (balance > options.balanceMax) {
+        balance = options.balanceMax;
+    }
+    return balance;
+}
+
+bool WriteInitialCondition(const GeneratorOptions& options, std::mt19937_64& rng) {
+    std::FILE* file = std::fopen(options.outPath.c_str(), "wb");
+    if (file == nullptr) {
+        std::cerr << "Error opening file: " << options.outPath << "\n";
+        return false;
+    }
+
+    {
+        OutputBuffer out(file);
+        out.Line("%lld %lld %lld\n", options.banks, options.accounts, options.atms);
+        for (long long b = 0; b < options.banks; ++b) {
+            out.Line("Bank%04lld\n", b);
+        }
+
+        std::uniform_int_distribution<int> pinDigits(0, 9999);
+        char cardNumber[32];
+        for (long long i = 0; i < options.accounts; ++i) {
+            FormatCardNumber(i, cardNumber, sizeof(cardNumber));
+            out.Line("Bank%04lld Owner%lld %03lld-%03lld-%06lld %lld %s %04d\n",
+                     i % options.banks,
+                     i,
+                     100 + (i / 1000000000) % 900, (i / 1000000) % 1000, i % 1000000,
+                     SampleBalance(options, rng),
+                     cardNumber,
+                     pinDigits(rng));
+        }
+
+        std::uniform_real_distribution<double> unit(0.0, 1.0);
+        std::uniform_int_distribution<int> bills(0, options.maxBills);
+        for (long long i = 0; i < options.atms; ++i) {
+            bool multi = unit(rng) < options.multiRatio;
+            bool bilingual = unit(rng) < options.bilingualRatio;
+            int count50k = bills(rng);
+            int count10k = bills(rng);
+            int count5k = bills(rng);
+            int count1k = bills(rng);
+            out.Line("Bank%04lld %06lld %s %s %d %d %d %d\n",
+                     i % options.banks,
+                     100000 + i,
+                     multi ? "Multi" : "Single",
+                     bilingual ? "Bilingual" : "Unilingual",
+                     count50k, count10k, count5k, count1k);
+        }
+    }
+
+    bool ok = std::ferror(file) == 0;
+    std::fclose(file);
+    return ok;
+}
+
+bool WriteUsage(const GeneratorOptions& options, std::mt19937_64& rng) {
+    std::FILE* file = std::fopen(options.usageOutPath.c_str(), "wb");
+    if (file == nullptr) {
+        std::cerr << "Error opening file: " << options.usageOutPath << "\n";
+        return false;
+    }
+
+    {
+        OutputBuffer out(file);
+        ZipfSampler cardRanks(options.accounts, options.cardSkew);
+        ZipfSampler atmRanks(options.atms, options.atmSkew);
+        RankPermutation cardOrder(options.accounts);
+        RankPermutation atmOrder(options.atms);
+        char cardNumber[32];
+        for (long long i = 0; i < options.usageCount; ++i) {
+            long long account = cardOrder.Map(cardRanks.Sample(rng));
+            long long atm = atmOrder.Map(atmRanks.Sample(rng));
+            FormatCardNumber(account, cardNumber, sizeof(cardNumber));
+            out.Line("%06lld %s\n", 100000 + atm, cardNumber);
+        }
+    }
+
+    bool ok = std::ferror(file) == 0;
+    std::fclose(file);
+    return ok;
+}
+
+bool ParseOptions(int argc, char** argv, GeneratorOptions& options) {
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (i + 1 >= argc) {
+            std::cerr << "Missing value for " << arg << "\n";
+            return false;
+        }
+        std::string value = argv[++i];
+        if (arg == "--banks") {
+            options.banks = std::atoll(value.c_str());
+        } else if (arg == "--accounts") {
+            options.accounts = std::atoll(value.c_str());
+        } else if (arg == "--atms") {
+            options.atms = std::atoll(value.c_str());
+        } else if (arg == "--out") {
+            options.outPath = value;
+        } else if (arg == "--seed") {
+            options.seed = std::strtoull(value.c_str(), nullptr, 10);
+        } else if (arg == "--balance-dist") {
+            if (value == "uniform") {
+                options.balanceDistribution = BalanceDistribution_Uniform;
+            } else if (value == "lognormal") {
+                options.balanceDistribution = BalanceDistribution_LogNormal;
+            } else if (value == "pareto") {
+                options.balanceDistribution = BalanceDistribution_Pareto;
+            } else {
+                std::cerr << "Unknown balance distribution: " << value << "\n";
+                return false;
+            }
+        } else if (arg == "--balance-min") {
+            options.balanceMin = std::atoll(value.c_str());
+        } else if (arg == "--balance-max") {
+            options.balanceMax = std::atoll(value.c_str());
+        } else if (arg == "--balance-median") {
+            options.balanceMedian = std::atof(value.c_str());
+        } else if (arg == "--balance-sigma") {
+            options.balanceSigma = std::atof(value.c_str());
+        } else if (arg == "--pareto-alpha") {
+            options.paretoAlpha = std::atof(value.c_str());
+        } else if (arg == "--multi-ratio") {
+            options.multiRatio = std::atof(value.c_str());
+        } else if (arg == "--bilingual-ratio") {
+            options.bilingualRatio = std::atof(value.c_str());
+        } else if (arg == "--max-bills") {
+            options.maxBills = std::atoi(value.c_str());
+        } else if (arg == "--usage-out") {
+            options.usageOutPath = value;
+        } else if (arg == "--usage-count") {
+            options.usageCount = std::atoll(value.c_str());
+        } else if (arg == "--card-skew") {
+            options.cardSkew = std::atof(value.c_str());
+        } else if (arg == "--atm-skew") {
+            options.atmSkew = std::atof(value.c_str());
+        } else {
+            std::cerr << "Unknown option: " << arg << "\n";
+            return false;
+        }
+    }
+
+    if (options.banks <= 0 || options.banks > 9999 || options.accounts <= 0 ||
+        options.atms <= 0 || options.atms > 899999) {
+        std::cerr << "Need 1-9999 banks, at least one account and 1-899999 ATMs.\n";
+        return false;
+    }
+    if (options.balanceMin < 0 || options.balanceMax < options.balanceMin || options.maxBills < 0 ||
+        options.paretoAlpha <= 0.0) {
+        std::cerr << "Invalid balance or bill range.\n";
+        return false;
+    }
+    return true;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    GeneratorOptions options;
+    if (!ParseOptions(argc, argv, options)) {
+        return 1;
+    }
+
+    std::mt19937_64 rng(options.seed);
+    if (!WriteInitialCondition(options, rng)) {
+        return 1;
+    }
+    if (!options.usageOutPath.empty() && !WriteUsage(options, rng)) {
+        return 1;
+    }
+    return 0;
+}